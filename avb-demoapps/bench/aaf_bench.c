@@ -0,0 +1,268 @@
+/*
+ * Copyright (c) 2014-2016 Renesas Electronics Corporation
+ * Released under the MIT license
+ * http://opensource.org/licenses/mit-license.php
+ */
+
+/*
+ * benchmark of the AAF PCM sample conversion of lib/avtp
+ *
+ * a buffer of samples is converted packet by packet into payloads at
+ * their offset in AVTP frames and back, from interleaved and from
+ * planar buffers, with the scalar and the SIMD implementation. the
+ * payloads of both must be equal and the samples must come back as
+ * they were, and a header must not be taken for more than the bytes
+ * of its packet. exits 1 on any mismatch.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <getopt.h>
+#include <inttypes.h>
+
+#include "avtp.h"
+#include "avtp_aaf.h"
+
+#define PROGNAME "aaf_bench"
+
+#define NSEC_SCALE   (1000000000ull)
+#define MEDIA_FRAMES (4800)   /* 100 ms at 48 kHz */
+#define CHANNELS_MAX (8)
+
+static const struct {
+	const char *name;
+	int        format;
+} formats[] = {
+	{ "INT_16BIT",   AVTP_AAF_FORMAT_INT_16BIT },
+	{ "INT_24BIT",   AVTP_AAF_FORMAT_INT_24BIT },
+	{ "INT_32BIT",   AVTP_AAF_FORMAT_INT_32BIT },
+	{ "FLOAT_32BIT", AVTP_AAF_FORMAT_FLOAT_32BIT },
+};
+
+static const int channels[] = { 1, 2, 8 };
+
+static int frames = 6;              /* 48 kHz, class A */
+static uint64_t total = 20000000;   /* samples per case */
+
+static inline uint64_t bench_now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return ts.tv_sec * NSEC_SCALE + ts.tv_nsec;
+}
+
+static void show_usage(void)
+{
+	fprintf(stderr,
+		"usage: " PROGNAME " [options]\n"
+		"\n"
+		"options:\n"
+		"    -f NUM     frames per packet (default:6)\n"
+		"    -n NUM     samples per case (default:20000000)\n"
+		"    -h         display this help\n");
+}
+
+struct bench_case {
+	struct avtp_aaf aaf;
+	int      packets;
+	size_t   slot;             /* bytes of an AVTP frame */
+	uint8_t  *src;             /* interleaved */
+	uint8_t  *dst;
+	uint8_t  *planes[CHANNELS_MAX];
+	uint8_t  *out[CHANNELS_MAX];
+	uint8_t  *pkts;
+	uint8_t  *ref;             /* payloads of the scalar conversion */
+};
+
+static inline uint8_t *payload_of(struct bench_case *bc, int i)
+{
+	return bc->pkts + bc->slot * i + AVTP_PAYLOAD_OFFSET;
+}
+
+/* samples of the range of the format, the same in both layouts */
+static void fill(struct bench_case *bc)
+{
+	struct avtp_aaf *aaf = &bc->aaf;
+	int hs = aaf->host_size, ch = aaf->channels;
+	int i, c;
+
+	for (i = 0; i < MEDIA_FRAMES; i++) {
+		for (c = 0; c < ch; c++) {
+			int32_t v = rand() ^ (rand() << 16);
+			float f = (float)v / 2147483648.0f;
+			uint8_t *s = bc->src + (i * ch + c) * hs;
+			uint8_t *p = bc->planes[c] + i * hs;
+
+			if (aaf->format == AVTP_AAF_FORMAT_INT_24BIT)
+				v = v << 8 >> 8;
+			if (aaf->format == AVTP_AAF_FORMAT_FLOAT_32BIT)
+				memcpy(&v, &f, sizeof(v));
+			memcpy(s, &v, hs);
+			memcpy(p, &v, hs);
+		}
+	}
+}
+
+static double run(struct bench_case *bc, int planar, int unpack)
+{
+	struct avtp_aaf *aaf = &bc->aaf;
+	size_t n = (size_t)frames * aaf->channels * aaf->host_size;
+	uint64_t start, samples = 0;
+	int i;
+
+	start = bench_now();
+	while (samples < total) {
+		for (i = 0; i < bc->packets; i++) {
+			size_t off = (size_t)i * frames;
+
+			if (!unpack && !planar)
+				avtp_aaf_pack(aaf, payload_of(bc, i),
+					      bc->src + off * aaf->channels *
+					      aaf->host_size, frames);
+			else if (!unpack)
+				avtp_aaf_pack_planar(aaf, payload_of(bc, i),
+						     (const void *const *)bc->planes,
+						     off, frames);
+			else if (!planar)
+				avtp_aaf_unpack(aaf, bc->dst + i * n,
+						payload_of(bc, i), frames);
+			else
+				avtp_aaf_unpack_planar(aaf, (void *const *)bc->out,
+						       off, payload_of(bc, i),
+						       frames);
+		}
+		samples += (uint64_t)bc->packets * frames * aaf->channels;
+	}
+
+	return (double)samples * 1000 / (bench_now() - start);
+}
+
+/* returns the number of mismatches */
+static int check(struct bench_case *bc, int save)
+{
+	struct avtp_aaf *aaf = &bc->aaf;
+	size_t plen = avtp_aaf_payload_size(aaf, frames);
+	size_t len = (size_t)bc->packets * frames * aaf->host_size;
+	int errors = 0;
+	int i, c;
+
+	for (i = 0; i < bc->packets; i++) {
+		if (save)
+			memcpy(bc->ref + i * plen, payload_of(bc, i), plen);
+		else if (memcmp(bc->ref + i * plen, payload_of(bc, i), plen))
+			errors++;
+	}
+
+	if (memcmp(bc->src, bc->dst, len * aaf->channels))
+		errors++;
+	for (c = 0; c < aaf->channels; c++)
+		if (memcmp(bc->planes[c], bc->out[c], len))
+			errors++;
+
+	return errors;
+}
+
+static int bench(int format, const char *name, int ch)
+{
+	static const char *impls[] = { "scalar", "simd" };
+	struct bench_case bc;
+	struct avtp_aaf rx;
+	double r[4];
+	int errors = 0;
+	int i, c, k, len;
+
+	memset(&bc, 0, sizeof(bc));
+	if (avtp_aaf_init(&bc.aaf, format, 48000, ch, 0) < 0)
+		return 1;
+
+	bc.packets = MEDIA_FRAMES / frames;
+	bc.slot = (AVTP_PAYLOAD_OFFSET + avtp_aaf_payload_size(&bc.aaf, frames)
+		   + 63) & ~63;
+	bc.src = malloc(MEDIA_FRAMES * ch * 4);
+	bc.dst = malloc(MEDIA_FRAMES * ch * 4);
+	bc.pkts = calloc(bc.packets, bc.slot);
+	bc.ref = malloc(MEDIA_FRAMES * ch * 4);
+	for (c = 0; c < ch; c++) {
+		bc.planes[c] = malloc(MEDIA_FRAMES * 4);
+		bc.out[c] = malloc(MEDIA_FRAMES * 4);
+	}
+	fill(&bc);
+
+	/* header round trip */
+	len = avtp_aaf_header(&bc.aaf, bc.pkts, frames);
+	if (avtp_aaf_parse(&rx, bc.pkts, len) != frames ||
+	    rx.format != bc.aaf.format || rx.nsr != AVTP_AAF_NSR_48KHZ ||
+	    rx.channels != ch || rx.bit_depth != bc.aaf.bit_depth ||
+	    avtp_aaf_parse(&rx, bc.pkts, len - 1) != -1)
+		errors++;
+
+	for (k = 0; k < 2; k++) {
+		if (avtp_aaf_select(impls[k]) < 0)
+			continue;
+
+		memset(bc.dst, 0, MEDIA_FRAMES * ch * 4);
+		for (c = 0; c < ch; c++)
+			memset(bc.out[c], 0, MEDIA_FRAMES * 4);
+
+		r[0] = run(&bc, 0, 0);
+		r[1] = run(&bc, 0, 1);
+		r[2] = run(&bc, 1, 0);
+		r[3] = run(&bc, 1, 1);
+		errors += check(&bc, k == 0);
+
+		printf("%-11s %dch %-6s: pack %7.1f unpack %7.1f planar pack %7.1f unpack %7.1f Msamples/s\n",
+		       name, ch, avtp_aaf_name(), r[0], r[1], r[2], r[3]);
+	}
+
+	free(bc.src);
+	free(bc.dst);
+	free(bc.pkts);
+	free(bc.ref);
+	for (i = 0; i < ch; i++) {
+		free(bc.planes[i]);
+		free(bc.out[i]);
+	}
+
+	return errors;
+}
+
+int main(int argc, char **argv)
+{
+	int errors = 0;
+	int c, i, j;
+
+	while ((c = getopt(argc, argv, "f:n:h")) != -1) {
+		switch (c) {
+		case 'f':
+			frames = atoi(optarg);
+			break;
+		case 'n':
+			total = strtoull(optarg, NULL, 0);
+			break;
+		case 'h':
+		default:
+			show_usage();
+			return (c == 'h') ? 0 : -1;
+		}
+	}
+
+	if (frames < 1 || frames > MEDIA_FRAMES) {
+		fprintf(stderr, PROGNAME ": invalid frames per packet\n");
+		return -1;
+	}
+	srand(1);
+
+	for (i = 0; i < (int)(sizeof(formats) / sizeof(formats[0])); i++)
+		for (j = 0; j < (int)(sizeof(channels) / sizeof(channels[0])); j++)
+			errors += bench(formats[i].format, formats[i].name,
+					channels[j]);
+	avtp_aaf_select("auto");
+
+	printf("mismatch   : %d\n", errors);
+
+	return errors ? 1 : 0;
+}
@@ -0,0 +1,448 @@
+/*
+ * Copyright (c) 2014-2016 Renesas Electronics Corporation
+ * Released under the MIT license
+ * http://opensource.org/licenses/mit-license.php
+ */
+
+/*
+ * benchmark of the IEC 61883-6 AM824 packetizer of lib/avtp
+ *
+ * samples are converted packet by packet into data blocks at their
+ * offset in AVTP frames and back, with the scalar and the SIMD
+ * implementation. the payloads of both must be equal and the samples
+ * must come back as they were, but for the lower 8 bits of 32-bit
+ * samples.
+ *
+ * then a stream of 48 kHz is packetized and packets are dropped at
+ * random, -l percent in bursts of up to -B packets. the listener side
+ * must tell the data blocks missing before every packet by DBC, find
+ * the timestamps on the packets of SYT_INTERVAL, and with silence for
+ * the blocks lost give back the samples at their place. packets late,
+ * repeated and after a loss longer than the sequence number tells
+ * must be dropped, or synced again on.
+ * exits 1 on any mismatch.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <getopt.h>
+#include <inttypes.h>
+
+#include "avtp.h"
+#include "avtp_aaf.h"
+#include "avtp_am824.h"
+
+#define PROGNAME "am824_bench"
+
+#define NSEC_SCALE   (1000000000ull)
+#define MEDIA_BLOCKS (4800)   /* 100 ms at 48 kHz */
+#define RATE         (48000)
+
+static const struct {
+	const char *name;
+	int        format;
+} formats[] = {
+	{ "INT_16BIT", AVTP_AAF_FORMAT_INT_16BIT },
+	{ "INT_24BIT", AVTP_AAF_FORMAT_INT_24BIT },
+	{ "INT_32BIT", AVTP_AAF_FORMAT_INT_32BIT },
+};
+
+static const int channels[] = { 2, 8 };
+
+static int blocks = 6;              /* 48 kHz, class A */
+static uint64_t total = 20000000;   /* samples per case */
+static int packets = 100000;        /* of the stream */
+static double loss = 1.0;           /* percent of packets dropped */
+static int burst = 64;              /* packets dropped at most at once */
+
+static inline uint64_t bench_now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return ts.tv_sec * NSEC_SCALE + ts.tv_nsec;
+}
+
+static void show_usage(void)
+{
+	fprintf(stderr,
+		"usage: " PROGNAME " [options]\n"
+		"\n"
+		"options:\n"
+		"    -b NUM     data blocks per packet (default:6)\n"
+		"    -n NUM     samples per case (default:20000000)\n"
+		"    -p NUM     packets of the stream (default:100000)\n"
+		"    -l NUM     percent of packets dropped (default:1)\n"
+		"    -B NUM     packets dropped at most at once (default:64)\n"
+		"    -h         display this help\n");
+}
+
+struct bench_case {
+	struct avtp_am824 am;
+	int      packets;
+	size_t   slot;             /* bytes of an AVTP frame */
+	uint8_t  *src;
+	uint8_t  *dst;
+	uint8_t  *pkts;
+	uint8_t  *ref;             /* payloads of the scalar conversion */
+};
+
+static inline uint8_t *payload_of(struct bench_case *bc, int i)
+{
+	return bc->pkts + bc->slot * i + AVTP_61883_PAYLOAD_OFFSET;
+}
+
+/* samples of the range of the format */
+static void fill(uint8_t *buf, int format, size_t n)
+{
+	int hs = (format == AVTP_AAF_FORMAT_INT_16BIT) ? 2 : 4;
+	size_t i;
+
+	for (i = 0; i < n; i++) {
+		int32_t v = rand() ^ (rand() << 16);
+
+		if (format == AVTP_AAF_FORMAT_INT_24BIT)
+			v = v << 8 >> 8;
+		memcpy(buf + i * hs, &v, hs);
+	}
+}
+
+static double run(struct bench_case *bc, int unpack)
+{
+	struct avtp_am824 *am = &bc->am;
+	size_t n = (size_t)blocks * am->dbs * am->host_size;
+	uint64_t start, samples = 0;
+	int i;
+
+	start = bench_now();
+	while (samples < total) {
+		for (i = 0; i < bc->packets; i++) {
+			if (!unpack)
+				avtp_am824_pack(am, payload_of(bc, i),
+						bc->src + i * n, blocks);
+			else
+				avtp_am824_unpack(am, bc->dst + i * n,
+						  payload_of(bc, i), blocks);
+		}
+		samples += (uint64_t)bc->packets * blocks * am->dbs;
+	}
+
+	return (double)samples * 1000 / (bench_now() - start);
+}
+
+/* returns the number of mismatches */
+static int check(struct bench_case *bc, int save)
+{
+	struct avtp_am824 *am = &bc->am;
+	size_t plen = (size_t)blocks * am->dbs * 4;
+	size_t n = (size_t)bc->packets * blocks * am->dbs;
+	int32_t a, b;
+	int errors = 0;
+	size_t i;
+
+	for (i = 0; i < (size_t)bc->packets; i++) {
+		if (save)
+			memcpy(bc->ref + i * plen, payload_of(bc, i), plen);
+		else if (memcmp(bc->ref + i * plen, payload_of(bc, i), plen))
+			errors++;
+	}
+
+	if (am->format != AVTP_AAF_FORMAT_INT_32BIT) {
+		if (memcmp(bc->src, bc->dst, n * am->host_size))
+			errors++;
+	} else {
+		for (i = 0; i < n; i++) {
+			memcpy(&a, bc->src + i * 4, 4);
+			memcpy(&b, bc->dst + i * 4, 4);
+			if ((a & ~0xff) != b) {
+				errors++;
+				break;
+			}
+		}
+	}
+
+	if (am->label_errors)
+		errors++;
+
+	/* a quadlet of another label is told */
+	payload_of(bc, 0)[4] ^= 0x01;
+	avtp_am824_unpack(am, bc->dst, payload_of(bc, 0), blocks);
+	payload_of(bc, 0)[4] ^= 0x01;
+	if (am->label_errors != 1)
+		errors++;
+	am->label_errors = 0;
+
+	return errors;
+}
+
+static int bench(int format, const char *name, int ch)
+{
+	static const char *impls[] = { "scalar", "simd" };
+	struct bench_case bc;
+	double r[2];
+	int errors = 0;
+	int k;
+
+	memset(&bc, 0, sizeof(bc));
+	if (avtp_am824_init(&bc.am, format, RATE, ch) < 0)
+		return 1;
+
+	bc.packets = MEDIA_BLOCKS / blocks;
+	bc.slot = (AVTP_PAYLOAD_OFFSET + avtp_am824_payload_size(&bc.am, blocks)
+		   + 63) & ~63;
+	bc.src = malloc(MEDIA_BLOCKS * ch * 4);
+	bc.dst = malloc(MEDIA_BLOCKS * ch * 4);
+	bc.pkts = calloc(bc.packets, bc.slot);
+	bc.ref = malloc(MEDIA_BLOCKS * ch * 4);
+	fill(bc.src, format, (size_t)MEDIA_BLOCKS * ch);
+
+	for (k = 0; k < 2; k++) {
+		if (avtp_am824_select(impls[k]) < 0)
+			continue;
+
+		memset(bc.dst, 0, MEDIA_BLOCKS * ch * 4);
+		r[0] = run(&bc, 0);
+		r[1] = run(&bc, 1);
+		errors += check(&bc, k == 0);
+
+		printf("%-9s %dch %-6s: pack %7.1f unpack %7.1f Msamples/s\n",
+		       name, ch, avtp_am824_name(), r[0], r[1]);
+	}
+
+	free(bc.src);
+	free(bc.dst);
+	free(bc.pkts);
+	free(bc.ref);
+
+	return errors;
+}
+
+/* returns the number of mismatches */
+static int stream(void)
+{
+	struct avtp_am824 tx, rx;
+	const int ch = 2;
+	size_t bsize = (size_t)ch * 2;          /* INT_16BIT */
+	size_t len = (size_t)packets * blocks * bsize;
+	uint8_t *src, *out, *drop, *pkt;
+	uint64_t start, elapsed = 0, time0 = 1000000000ull;
+	uint64_t dropped = 0, missed = 0, stamps = 0;
+	size_t off = 0, slot;
+	int errors = 0;
+	int i, j, n, lost, pending = 0;
+
+	if (avtp_am824_init(&tx, AVTP_AAF_FORMAT_INT_16BIT, RATE, ch) < 0 ||
+	    avtp_am824_init(&rx, AVTP_AAF_FORMAT_INT_16BIT, 0, 0) < 0)
+		return 1;
+
+	slot = AVTP_PAYLOAD_OFFSET + avtp_am824_payload_size(&tx, blocks);
+	src = malloc(len);
+	out = calloc(1, len);
+	drop = calloc(packets, 1);
+	pkt = calloc(1, slot);
+	fill(src, AVTP_AAF_FORMAT_INT_16BIT, len / 2);
+	copy_avtp_61883_6_template(pkt);
+
+	/* bursts of random length, the first packet is kept */
+	for (i = 1; i < packets; i++) {
+		if (rand() % 10000 >= loss * 100 / ((burst + 1) / 2.0))
+			continue;
+		n = 1 + rand() % burst;
+		for (j = i; j < i + n && j < packets; j++)
+			drop[j] = 1;
+		i += n;
+	}
+
+	for (i = 0; i < packets; i++) {
+		uint64_t t = time0 + (uint64_t)i * blocks * NSEC_SCALE / RATE;
+		int syt;
+
+		avtp_am824_header(&tx, pkt, blocks, t);
+		set_avtp_sequence_num(pkt, i);
+		avtp_am824_pack(&tx, pkt + AVTP_61883_PAYLOAD_OFFSET,
+				src + (size_t)i * blocks * bsize, blocks);
+		syt = tx.syt;
+
+		if (drop[i]) {
+			dropped++;
+			pending += blocks;
+			continue;
+		}
+
+		start = bench_now();
+		n = avtp_am824_parse(&rx, pkt, slot, &lost);
+		if (n > 0) {
+			/* silence where data blocks are lost */
+			memset(out + off, 0, (size_t)lost * bsize);
+			off += (size_t)lost * bsize;
+			avtp_am824_unpack(&rx, out + off,
+					  pkt + AVTP_61883_PAYLOAD_OFFSET, n);
+			off += (size_t)n * bsize;
+		}
+		elapsed += bench_now() - start;
+
+		if (n != blocks || lost != pending || rx.syt != syt)
+			errors++;
+		missed += pending;
+		pending = 0;
+
+		/* the presentation time of the data block of SYT_INTERVAL */
+		if (get_avtp_tv(pkt)) {
+			stamps++;
+			if (get_avtp_timestamp(pkt) != (uint32_t)(t + syt *
+			    NSEC_SCALE / RATE) ||
+			    (uint8_t)(i * blocks + syt) % rx.syt_interval)
+				errors++;
+		}
+	}
+
+	/* silence at the blocks of packets dropped */
+	for (i = 0; i < packets; i++)
+		if (drop[i])
+			memset(src + (size_t)i * blocks * bsize, 0,
+			       (size_t)blocks * bsize);
+	if (off != len - (size_t)pending * bsize || memcmp(src, out, off))
+		errors++;
+
+	if (rx.lost != missed || rx.syt_errors || rx.label_errors ||
+	    rx.errors || rx.rate != RATE || rx.dbs != ch)
+		errors++;
+
+	printf("stream    %dch %-6s: %d packets %" PRIu64 " dropped %" PRIu64 " data blocks lost by DBC in %" PRIu64 " gaps %" PRIu64 " timestamps, parse and unpack %6.1f Msamples/s\n",
+	       ch, avtp_am824_name(), packets, dropped, rx.lost,
+	       rx.discontinuities, stamps,
+	       (double)rx.data_blocks * ch * 1000 / elapsed);
+
+	free(src);
+	free(out);
+	free(drop);
+	free(pkt);
+
+	return errors;
+}
+
+/* the packet of sequence number seq is received, of no silence */
+static int resync_one(struct avtp_am824 *tx, struct avtp_am824 *rx,
+		      uint8_t *pkt, size_t size, int seq, int expect)
+{
+	int n, lost;
+
+	tx->dbc = seq * blocks;
+	avtp_am824_header(tx, pkt, blocks, 0);
+	set_avtp_sequence_num(pkt, seq);
+	n = avtp_am824_parse(rx, pkt, size, &lost);
+
+	return n != expect || lost;
+}
+
+/*
+ * a loss of 200 packets, taken as late until the second one after it,
+ * a repeated packet, and a loss of 150 packets counted by DBC. then a
+ * packet of 700 data blocks in a frame of the MTU and a packet cut
+ * short by a quadlet, which are dropped.
+ */
+static int resync(void)
+{
+	struct avtp_am824 tx, rx;
+	uint8_t *pkt;
+	size_t size;
+	int errors = 0;
+	int i, lost;
+
+	avtp_am824_init(&tx, AVTP_AAF_FORMAT_INT_16BIT, RATE, 2);
+	avtp_am824_init(&rx, AVTP_AAF_FORMAT_INT_16BIT, 0, 0);
+	size = AVTP_PAYLOAD_OFFSET + avtp_am824_payload_size(&tx, blocks);
+	pkt = calloc(1, size);
+	copy_avtp_61883_6_template(pkt);
+
+	for (i = 0; i < 10; i++)
+		errors += resync_one(&tx, &rx, pkt, size, i, blocks);
+	errors += resync_one(&tx, &rx, pkt, size, 210, -1);
+	for (i = 211; i < 220; i++)
+		errors += resync_one(&tx, &rx, pkt, size, i, blocks);
+	if (avtp_am824_parse(&rx, pkt, size, &lost) != -1)
+		errors++;
+	errors += resync_one(&tx, &rx, pkt, size, 220, blocks);
+
+	i = 221 + 150;
+	tx.dbc = i * blocks;
+	avtp_am824_header(&tx, pkt, blocks, 0);
+	set_avtp_sequence_num(pkt, i);
+	if (avtp_am824_parse(&rx, pkt, size, &lost) != blocks ||
+	    lost != 150 * blocks)
+		errors++;
+
+	/* only the header is read of a packet beyond the bytes received */
+	set_avtp_stream_data_length(pkt, avtp_am824_payload_size(&rx, 700));
+	set_avtp_sequence_num(pkt, i + 1);
+	if (avtp_am824_parse(&rx, pkt, 1518, &lost) != -1)
+		errors++;
+	errors += resync_one(&tx, &rx, pkt, size - 4, i + 1, -1);
+	errors += resync_one(&tx, &rx, pkt, size, i + 1, blocks);
+
+	if (rx.errors != 4 || rx.discontinuities != 2 ||
+	    rx.lost != (uint64_t)150 * blocks)
+		errors++;
+
+	printf("resync    : %" PRIu64 " packets %" PRIu64 " errors %" PRIu64 " gaps %" PRIu64 " data blocks lost by DBC\n",
+	       rx.packets, rx.errors, rx.discontinuities, rx.lost);
+
+	free(pkt);
+
+	return errors;
+}
+
+int main(int argc, char **argv)
+{
+	int errors = 0;
+	int c, i, j;
+
+	while ((c = getopt(argc, argv, "b:n:p:l:B:h")) != -1) {
+		switch (c) {
+		case 'b':
+			blocks = atoi(optarg);
+			break;
+		case 'n':
+			total = strtoull(optarg, NULL, 0);
+			break;
+		case 'p':
+			packets = atoi(optarg);
+			break;
+		case 'l':
+			loss = atof(optarg);
+			break;
+		case 'B':
+			burst = atoi(optarg);
+			break;
+		case 'h':
+		default:
+			show_usage();
+			return (c == 'h') ? 0 : -1;
+		}
+	}
+
+	/* a longer burst is taken as late packets */
+	if (blocks < 1 || blocks > MEDIA_BLOCKS || packets < 1 ||
+	    loss < 0 || loss > 50 || burst < 1 ||
+	    burst >= 256 - AVTP_AM824_LATE_WINDOW) {
+		fprintf(stderr, PROGNAME ": invalid options\n");
+		return -1;
+	}
+	srand(1);
+
+	for (i = 0; i < (int)(sizeof(formats) / sizeof(formats[0])); i++)
+		for (j = 0; j < (int)(sizeof(channels) / sizeof(channels[0])); j++)
+			errors += bench(formats[i].format, formats[i].name,
+					channels[j]);
+	avtp_am824_select("auto");
+
+	errors += stream();
+	errors += resync();
+
+	printf("mismatch   : %d\n", errors);
+
+	return errors ? 1 : 0;
+}
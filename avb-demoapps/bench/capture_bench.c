@@ -0,0 +1,255 @@
+/*
+ * Copyright (c) 2014-2016 Renesas Electronics Corporation
+ * Released under the MIT license
+ * http://opensource.org/licenses/mit-license.php
+ */
+
+/*
+ * throughput benchmark of the simple_listener file sink.
+ *
+ * payload buffers are fed to the writer thread as fast as it takes
+ * them back, or at a given rate.
+ *   writev:  writev() of the payloads into a file opened with O_TRUNC
+ *   capture: payloads copied into blocks written with O_DIRECT into
+ *            preallocated files
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+#include <fcntl.h>
+#include <getopt.h>
+#include <inttypes.h>
+#include <limits.h>
+#include <stdbool.h>
+
+#include "file_sink.h"
+
+#define PROGNAME "capture_bench"
+
+#define BATCH        (32)
+#define WAIT_TIME    (1000)
+
+#define NSEC_SCALE   (1000000000ull)
+
+static const char *dir = ".";
+static int payload_size = 1024;
+static uint64_t total_size = 256ull << 20;
+static uint64_t rotate_size;
+static uint64_t rate;
+static int bufnum = 2048;
+static bool keep;
+
+static void *bufs;
+static int *frees;
+
+static inline uint64_t bench_now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return ts.tv_sec * NSEC_SCALE + ts.tv_nsec;
+}
+
+static void show_usage(void)
+{
+	fprintf(stderr,
+		"usage: " PROGNAME " [options]\n"
+		"\n"
+		"options:\n"
+		"    -d DIR     directory of the files (default:.)\n"
+		"    -s SIZE    payload size (default:1024)\n"
+		"    -t MB      data written per mode (default:256)\n"
+		"    -r MB      rotate capture files by size (default:0=off)\n"
+		"    -R MB/S    rate of payloads, 0 is back to back (default:0)\n"
+		"    -n NUM     number of payload buffers (default:2048)\n"
+		"    -k         keep the files\n"
+		"    -h         display this help\n");
+}
+
+/* upper bound of the write latency below which p of the writes are */
+static uint64_t hist_percentile(struct file_sink *sink, double p)
+{
+	uint64_t sum = 0;
+	int i;
+
+	for (i = 0; i < FILE_SINK_HIST; i++) {
+		sum += sink->hist[i];
+		if (sum >= p * sink->writes)
+			break;
+	}
+
+	return 1ull << i;
+}
+
+static void remove_files(const char *path, struct file_sink *sink)
+{
+	char name[PATH_MAX + 16];
+	int i;
+
+	if (!sink->block || !rotate_size) {
+		unlink(path);
+		return;
+	}
+
+	for (i = 0; i < sink->files; i++) {
+		snprintf(name, sizeof(name), "%s.%04d", path, i);
+		unlink(name);
+	}
+}
+
+static int run(const char *mode)
+{
+	struct file_sink *sink;
+	char path[PATH_MAX];
+	uint64_t start, end, now, wait, wait_max = 0, total = 0;
+	int fd = -1, freenum, idx, i, n;
+	bool capture = !strcmp(mode, "capture");
+
+	snprintf(path, sizeof(path), "%s/" PROGNAME ".%s", dir, mode);
+
+	if (capture) {
+		sink = file_sink_open_capture(path, bufnum, rotate_size, 0);
+	} else {
+		fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+		if (fd < 0) {
+			perror(path);
+			return -1;
+		}
+		sink = file_sink_open(fd, bufnum);
+	}
+	if (!sink) {
+		if (fd >= 0)
+			close(fd);
+		return -1;
+	}
+
+	for (i = 0; i < bufnum; i++)
+		frees[i] = i;
+	freenum = bufnum;
+
+	start = bench_now();
+	while (total < total_size) {
+		freenum += file_sink_reclaim(sink, frees + freenum,
+					     bufnum - freenum);
+		if (!freenum) {
+			/* the process loop would stall here */
+			now = bench_now();
+			file_sink_wait(sink, WAIT_TIME);
+			wait = bench_now() - now;
+			if (wait > wait_max)
+				wait_max = wait;
+			continue;
+		}
+
+		n = freenum < BATCH ? freenum : BATCH;
+		for (i = 0; i < n; i++) {
+			idx = frees[--freenum];
+			file_sink_write(sink, bufs + (size_t)idx * payload_size,
+					payload_size, idx);
+		}
+		total += (uint64_t)n * payload_size;
+		file_sink_flush(sink);
+
+		if (rate) {
+			now = start + total * NSEC_SCALE / rate;
+			while (bench_now() < now)
+				usleep(100);
+		}
+	}
+
+	file_sink_stop(sink);
+	/* the page cache is not part of the throughput */
+	if (fd >= 0)
+		fdatasync(fd);
+	end = bench_now();
+
+	printf("%-8s %10.1f %8" PRIu64 " %12.1f %12" PRIu64 " %12.1f %12.1f %6d\n",
+	       mode,
+	       (double)sink->bytes / (1 << 20) /
+	       ((double)(end - start) / NSEC_SCALE),
+	       sink->writes,
+	       sink->writes ?
+	       (double)sink->stall_total / sink->writes / 1000 : 0,
+	       hist_percentile(sink, 0.99),
+	       (double)sink->stall_max / 1000,
+	       (double)wait_max / 1000,
+	       sink->block ? sink->files : 1);
+
+	if (sink->errors)
+		fprintf(stderr, PROGNAME ": %s: %" PRIu64 " write errors\n",
+			mode, sink->errors);
+
+	if (!keep)
+		remove_files(path, sink);
+
+	file_sink_close(sink);
+	if (fd >= 0)
+		close(fd);
+
+	return 0;
+}
+
+int main(int argc, char **argv)
+{
+	int c, i;
+
+	while ((c = getopt(argc, argv, "d:s:t:r:R:n:kh")) != -1) {
+		switch (c) {
+		case 'd':
+			dir = optarg;
+			break;
+		case 's':
+			payload_size = strtol(optarg, NULL, 0);
+			break;
+		case 't':
+			total_size = strtoull(optarg, NULL, 0) << 20;
+			break;
+		case 'r':
+			rotate_size = strtoull(optarg, NULL, 0) << 20;
+			break;
+		case 'R':
+			rate = strtoull(optarg, NULL, 0) << 20;
+			break;
+		case 'n':
+			bufnum = strtol(optarg, NULL, 0);
+			break;
+		case 'k':
+			keep = true;
+			break;
+		case 'h':
+		default:
+			show_usage();
+			return (c == 'h') ? 0 : -1;
+		}
+	}
+
+	if (payload_size <= 0 || bufnum <= 0) {
+		fprintf(stderr, PROGNAME ": invalid payload size or number\n");
+		return -1;
+	}
+
+	bufs = malloc((size_t)payload_size * bufnum);
+	frees = calloc(bufnum, sizeof(*frees));
+	if (!bufs || !frees) {
+		perror("cannot allocate payload buffers");
+		return -1;
+	}
+	for (i = 0; i < payload_size * bufnum; i++)
+		((uint8_t *)bufs)[i] = i;
+
+	printf("%-8s %10s %8s %12s %12s %12s %12s %6s\n",
+	       "mode", "MB/s", "writes", "lat avg[us]", "lat p99[us]",
+	       "lat max[us]", "stall[us]", "files");
+
+	run("writev");
+	run("capture");
+
+	free(frees);
+	free(bufs);
+
+	return 0;
+}
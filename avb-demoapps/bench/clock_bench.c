@@ -0,0 +1,189 @@
+/*
+ * Copyright (c) 2014-2016 Renesas Electronics Corporation
+ * Released under the MIT license
+ * http://opensource.org/licenses/mit-license.php
+ */
+
+/*
+ * benchmark of the calibrated time source of demo/common/clock.c
+ *
+ * cost per read of the clock read directly and interpolated from
+ * CLOCK_MONOTONIC_RAW, and the difference of the interpolation from
+ * direct reads taken between two interpolated reads.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+#include <getopt.h>
+#include <inttypes.h>
+#include <sys/syscall.h>
+
+#include "clock.h"
+
+#define PROGNAME "clock_bench"
+
+#define NSEC_SCALE   (1000000000ull)
+
+static char *clkname = "CLOCK_REALTIME";
+static uint64_t interval = 100000000;
+static int reads = 1000000;
+static int duration = 2;
+
+static void show_usage(void)
+{
+	fprintf(stderr,
+		"usage: " PROGNAME " [options]\n"
+		"\n"
+		"options:\n"
+		"    -p CLOCK   clock, CLOCK_* or PTP device (default:CLOCK_REALTIME)\n"
+		"    -i MSEC    calibration interval (default:100)\n"
+		"    -n NUM     reads per cost measurement (default:1000000)\n"
+		"    -t SEC     duration of the accuracy measurement (default:2)\n"
+		"    -h         display this help\n");
+}
+
+static uint64_t cost_direct(clockid_t clkid)
+{
+	uint64_t start, sum = 0;
+	int i;
+
+	start = clock_getcount(CLOCK_MONOTONIC);
+	for (i = 0; i < reads; i++)
+		sum += clock_getcount(clkid);
+
+	/* keep the reads */
+	if (!sum)
+		printf(" ");
+
+	return clock_getcount(CLOCK_MONOTONIC) - start;
+}
+
+/* lower bound of a PTP clock read, which has no vDSO */
+static uint64_t cost_syscall(clockid_t clkid)
+{
+	struct timespec ts;
+	uint64_t start;
+	int i;
+
+	start = clock_getcount(CLOCK_MONOTONIC);
+	for (i = 0; i < reads; i++)
+		syscall(SYS_clock_gettime, clkid, &ts);
+
+	return clock_getcount(CLOCK_MONOTONIC) - start;
+}
+
+static uint64_t cost_cal(struct clock_cal *cal)
+{
+	uint64_t start, sum = 0;
+	int i;
+
+	start = clock_getcount(CLOCK_MONOTONIC);
+	for (i = 0; i < reads; i++)
+		sum += clock_cal_getcount(cal);
+
+	if (!sum)
+		printf(" ");
+
+	return clock_getcount(CLOCK_MONOTONIC) - start;
+}
+
+static void accuracy(struct clock_cal *cal)
+{
+	uint64_t end, a, b, d, diff, window;
+	uint64_t count = 0, diff_total = 0, diff_max = 0, window_max = 0;
+	uint64_t error_max = 0, over = 0;
+
+	end = clock_getcount(CLOCK_MONOTONIC) + duration * NSEC_SCALE;
+	while (clock_getcount(CLOCK_MONOTONIC) < end) {
+		a = clock_cal_getcount(cal);
+		d = clock_getcount(cal->clkid);
+		b = clock_cal_getcount(cal);
+
+		/* the direct read is somewhere between a and b */
+		window = (int64_t)(b - a) > 0 ? (b - a) / 2 : 0;
+		diff = llabs((int64_t)(d - (a + (int64_t)(b - a) / 2)));
+
+		count++;
+		diff_total += diff;
+		if (diff > diff_max)
+			diff_max = diff;
+		if (window > window_max)
+			window_max = window;
+		if (cal->error > error_max)
+			error_max = cal->error;
+		if (diff > cal->error + window)
+			over++;
+
+		usleep(1000);
+	}
+
+	printf("accuracy   : %" PRIu64 " reads, diff avg %" PRIu64
+	       " ns max %" PRIu64 " ns (read window max %" PRIu64 " ns)\n",
+	       count, count ? diff_total / count : 0, diff_max, window_max);
+	printf("bound      : error max %" PRIu64 " ns, exceeded %" PRIu64
+	       " times\n", error_max, over);
+}
+
+int main(int argc, char **argv)
+{
+	struct clock_cal cal;
+	clockid_t clkid;
+	uint64_t direct, sys, calibrated;
+	char buf[256];
+	int c;
+
+	while ((c = getopt(argc, argv, "p:i:n:t:h")) != -1) {
+		switch (c) {
+		case 'p':
+			clkname = optarg;
+			break;
+		case 'i':
+			interval = strtoull(optarg, NULL, 0) * 1000000;
+			break;
+		case 'n':
+			reads = strtol(optarg, NULL, 0);
+			break;
+		case 't':
+			duration = strtol(optarg, NULL, 0);
+			break;
+		case 'h':
+		default:
+			show_usage();
+			return (c == 'h') ? 0 : -1;
+		}
+	}
+
+	if (reads <= 0 || !interval) {
+		fprintf(stderr, PROGNAME ": invalid number or interval\n");
+		return -1;
+	}
+
+	clkid = clock_parse(clkname);
+	if (clkid == CLOCK_INVALID) {
+		fprintf(stderr, PROGNAME ": invalid clock %s\n", clkname);
+		return -1;
+	}
+
+	if (clock_cal_init(&cal, clkid, interval) < 0)
+		return -1;
+
+	direct = cost_direct(clkid);
+	sys = cost_syscall(clkid);
+	calibrated = cost_cal(&cal);
+
+	printf("clock      : %s, calibrated by %s\n", clkname,
+	       clock_cal_method_name(cal.method));
+	printf("direct     : %.1f ns/read\n", (double)direct / reads);
+	printf("syscall    : %.1f ns/read\n", (double)sys / reads);
+	printf("calibrated : %.1f ns/read\n", (double)calibrated / reads);
+
+	accuracy(&cal);
+
+	clock_cal_report(&cal, buf, sizeof(buf));
+	printf("%s\n", buf);
+
+	return 0;
+}
@@ -0,0 +1,319 @@
+/*
+ * Copyright (c) 2014-2016 Renesas Electronics Corporation
+ * Released under the MIT license
+ * http://opensource.org/licenses/mit-license.php
+ */
+
+/*
+ * wakeup benchmark of the libeavb event loop against eavb_wait().
+ *
+ * eventfds stand in for the stream queues, a producer signals them
+ * in turn and the consumers measure the time until they are woken.
+ *   poll:   one thread per queue blocking in eavb_wait()
+ *   rr:     one thread calling eavb_wait() on each queue in turn
+ *   evloop: one thread servicing all queues with eavb_evloop
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+#include <getopt.h>
+#include <inttypes.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <sys/eventfd.h>
+#include <sys/resource.h>
+
+#include "eavb.h"
+
+#define PROGNAME "evloop_bench"
+
+#define QUEUE_MAX    (EAVB_EVLOOP_SOURCE_MAX)
+#define WAIT_TIME    (1000)
+#define RR_WAIT_TIME (1)
+
+#define NSEC_SCALE   (1000000000ull)
+
+struct bench_queue {
+	int      fd;
+	uint64_t stamp;    /* time of the first unread signal */
+};
+
+struct bench_result {
+	uint64_t wakeups;
+	uint64_t events;
+	uint64_t latency_total;
+	uint64_t latency_max;
+};
+
+static struct bench_queue queues[QUEUE_MAX];
+static int queuenum = 18;
+static uint64_t eventnum = 100000;
+static uint64_t interval = 10000;
+static volatile bool done;
+static pthread_mutex_t result_lock = PTHREAD_MUTEX_INITIALIZER;
+static struct bench_result result;
+
+static inline uint64_t bench_now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return ts.tv_sec * NSEC_SCALE + ts.tv_nsec;
+}
+
+static void show_usage(void)
+{
+	fprintf(stderr,
+		"usage: " PROGNAME " [options]\n"
+		"\n"
+		"options:\n"
+		"    -q NUM     number of queues (default:18)\n"
+		"    -n NUM     number of events (default:100000)\n"
+		"    -i NSEC    interval of events, 0 is back to back (default:10000)\n"
+		"    -h         display this help\n");
+}
+
+/* consume signal of queue, returns 1 if there was one */
+static int queue_consume(struct bench_queue *q, struct bench_result *r)
+{
+	uint64_t count, stamp, latency;
+
+	if (read(q->fd, &count, sizeof(count)) != sizeof(count))
+		return 0;
+
+	stamp = __atomic_exchange_n(&q->stamp, 0, __ATOMIC_ACQ_REL);
+	if (stamp) {
+		latency = bench_now() - stamp;
+		r->latency_total += latency;
+		if (latency > r->latency_max)
+			r->latency_max = latency;
+	}
+	r->events += count;
+
+	return 1;
+}
+
+static void result_merge(struct bench_result *r)
+{
+	pthread_mutex_lock(&result_lock);
+	result.wakeups += r->wakeups;
+	result.events += r->events;
+	result.latency_total += r->latency_total;
+	if (r->latency_max > result.latency_max)
+		result.latency_max = r->latency_max;
+	pthread_mutex_unlock(&result_lock);
+}
+
+static void *poll_thread(void *arg)
+{
+	struct bench_queue *q = arg;
+	struct bench_result r = { 0 };
+
+	while (!done) {
+		if (eavb_wait(q->fd, EAVB_NOTIFY_READ, WAIT_TIME) > 0) {
+			r.wakeups++;
+			queue_consume(q, &r);
+		}
+	}
+
+	result_merge(&r);
+
+	return NULL;
+}
+
+static void *rr_thread(void *arg)
+{
+	struct bench_result r = { 0 };
+	int i;
+
+	while (!done) {
+		for (i = 0; i < queuenum; i++) {
+			if (eavb_wait(queues[i].fd, EAVB_NOTIFY_READ,
+				      RR_WAIT_TIME) > 0) {
+				r.wakeups++;
+				queue_consume(&queues[i], &r);
+			}
+		}
+	}
+
+	result_merge(&r);
+
+	return NULL;
+}
+
+static void evloop_event(int fd, int revents, void *arg)
+{
+	struct bench_result *r = arg;
+	int i;
+
+	for (i = 0; i < queuenum; i++) {
+		if (queues[i].fd == fd) {
+			queue_consume(&queues[i], r);
+			break;
+		}
+	}
+}
+
+static void *evloop_thread(void *arg)
+{
+	struct eavb_evloop *loop = arg;
+	struct bench_result r = { 0 };
+	int i;
+
+	for (i = 0; i < queuenum; i++)
+		eavb_evloop_add_fd(loop, queues[i].fd, EAVB_NOTIFY_READ,
+				   evloop_event, &r);
+	eavb_evloop_set_notify(loop, NULL, NULL);
+
+	while (!done) {
+		if (eavb_evloop_run_once(loop, WAIT_TIME) > 0)
+			r.wakeups++;
+	}
+
+	result_merge(&r);
+
+	return NULL;
+}
+
+static void produce(void)
+{
+	uint64_t i, one = 1, next, now;
+	struct timespec ts;
+	struct bench_queue *q;
+	int ret;
+
+	next = bench_now();
+	for (i = 0; i < eventnum; i++) {
+		if (interval) {
+			next += interval;
+			ts.tv_sec = next / NSEC_SCALE;
+			ts.tv_nsec = next % NSEC_SCALE;
+			clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts,
+					NULL);
+		}
+
+		q = &queues[i % queuenum];
+		now = bench_now();
+		__atomic_compare_exchange_n(&q->stamp, &(uint64_t){ 0 }, now,
+					    false, __ATOMIC_ACQ_REL,
+					    __ATOMIC_ACQUIRE);
+		ret = write(q->fd, &one, sizeof(one));
+		(void)ret;
+	}
+}
+
+static int run(const char *mode)
+{
+	pthread_t threads[QUEUE_MAX];
+	struct eavb_evloop *loop = NULL;
+	struct rusage ru0, ru1;
+	uint64_t start, end, cpu;
+	int i, threadnum;
+
+	memset(&result, 0, sizeof(result));
+	done = false;
+
+	for (i = 0; i < queuenum; i++) {
+		queues[i].fd = eventfd(0, EFD_NONBLOCK);
+		queues[i].stamp = 0;
+	}
+
+	getrusage(RUSAGE_SELF, &ru0);
+	start = bench_now();
+
+	if (!strcmp(mode, "poll")) {
+		threadnum = queuenum;
+		for (i = 0; i < threadnum; i++)
+			pthread_create(&threads[i], NULL, poll_thread,
+				       &queues[i]);
+	} else if (!strcmp(mode, "rr")) {
+		threadnum = 1;
+		pthread_create(&threads[0], NULL, rr_thread, NULL);
+	} else {
+		loop = eavb_evloop_new();
+		if (!loop)
+			return -1;
+		threadnum = 1;
+		pthread_create(&threads[0], NULL, evloop_thread, loop);
+	}
+
+	produce();
+
+	/* let the consumers drain, then wake them up */
+	usleep(100000);
+	done = true;
+	end = bench_now();
+	for (i = 0; i < queuenum; i++) {
+		uint64_t one = 1;
+
+		if (write(queues[i].fd, &one, sizeof(one)) < 0)
+			perror("write");
+	}
+	eavb_evloop_notify(loop);
+
+	for (i = 0; i < threadnum; i++)
+		pthread_join(threads[i], NULL);
+	getrusage(RUSAGE_SELF, &ru1);
+
+	cpu = (ru1.ru_utime.tv_sec - ru0.ru_utime.tv_sec +
+	       ru1.ru_stime.tv_sec - ru0.ru_stime.tv_sec) * NSEC_SCALE +
+	      (ru1.ru_utime.tv_usec - ru0.ru_utime.tv_usec +
+	       ru1.ru_stime.tv_usec - ru0.ru_stime.tv_usec) * 1000ll;
+
+	printf("%-8s %10.0f %8.2f %12.1f %12.1f %10" PRIu64 "\n",
+	       mode,
+	       result.wakeups / ((double)(end - start) / NSEC_SCALE),
+	       result.wakeups ? (double)result.events / result.wakeups : 0,
+	       result.wakeups ?
+	       (double)result.latency_total / result.wakeups / 1000 : 0,
+	       (double)result.latency_max / 1000,
+	       result.events ? cpu / result.events : 0);
+
+	eavb_evloop_free(loop);
+	for (i = 0; i < queuenum; i++)
+		close(queues[i].fd);
+
+	return 0;
+}
+
+int main(int argc, char **argv)
+{
+	int c;
+
+	while ((c = getopt(argc, argv, "q:n:i:h")) != -1) {
+		switch (c) {
+		case 'q':
+			queuenum = strtol(optarg, NULL, 0);
+			break;
+		case 'n':
+			eventnum = strtoull(optarg, NULL, 0);
+			break;
+		case 'i':
+			interval = strtoull(optarg, NULL, 0);
+			break;
+		case 'h':
+		default:
+			show_usage();
+			return (c == 'h') ? 0 : -1;
+		}
+	}
+
+	if (queuenum <= 0 || queuenum > QUEUE_MAX - 1) {
+		fprintf(stderr, PROGNAME ": invalid number of queues\n");
+		return -1;
+	}
+
+	printf("%-8s %10s %8s %12s %12s %10s\n",
+	       "mode", "wakeups/s", "ev/wake", "lat avg[us]", "lat max[us]",
+	       "cpu/ev[ns]");
+
+	run("poll");
+	run("rr");
+	run("evloop");
+
+	return 0;
+}
@@ -0,0 +1,256 @@
+/*
+ * Copyright (c) 2014-2016 Renesas Electronics Corporation
+ * Released under the MIT license
+ * http://opensource.org/licenses/mit-license.php
+ */
+
+/*
+ * startup benchmark of DMA frame allocation, one page per entry
+ * against the frame pool of libeavb, and bytes touched per frame
+ * of the talker frame layouts, over the loopback backend.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <stdbool.h>
+#include <sys/mman.h>
+
+#include "eavb.h"
+
+#define PROGNAME "frame_bench"
+
+#define TALKER_DEV   "/dev/avb_tx1"
+
+#define NSEC_SCALE   (1000000000ull)
+
+static const int entrynums[] = { 256, 1024, 4096 };
+static const int framesizes[] = { 142, 1518 };
+static const int payloadsizes[] = { 100, 500, 1000, 1476 };
+
+/* ethernet, VLAN and AVTP header of simple_talker */
+#define HEADER_SIZE  (42)
+#define CACHE_LINE   (64)
+#define TOUCH_FRAMES (256)
+
+static inline uint64_t bench_now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return ts.tv_sec * NSEC_SCALE + ts.tv_nsec;
+}
+
+/* one DMA page per entry, as the demos used to do */
+static int bench_per_page(struct eavb_ctx *ctx, int framesize, int entrynum,
+			  uint64_t *ns, int *pagenum)
+{
+	struct eavb_dma_alloc *pages;
+	uint64_t start;
+	int i, ret = 0;
+
+	pages = calloc(entrynum, sizeof(*pages));
+	if (!pages)
+		return -1;
+
+	start = bench_now();
+	for (i = 0; i < entrynum; i++) {
+		if (eavb_ctx_dma_malloc_page(ctx, &pages[i]) < 0) {
+			ret = -1;
+			break;
+		}
+		memset(pages[i].dma_vaddr, 0, framesize);
+	}
+	*ns = bench_now() - start;
+	*pagenum = i;
+
+	while (i--)
+		eavb_ctx_dma_free_page(ctx, &pages[i]);
+	free(pages);
+
+	return ret;
+}
+
+static int bench_pool(struct eavb_ctx *ctx, int framesize, int entrynum,
+		      uint64_t *ns, int *pagenum)
+{
+	struct eavb_frame_pool *pool;
+	uint64_t start;
+	int i;
+
+	start = bench_now();
+	pool = eavb_frame_pool_new(ctx, framesize, entrynum);
+	if (!pool)
+		return -1;
+	for (i = 0; i < entrynum; i++)
+		memset(pool->frames[i].vaddr, 0, framesize);
+	*ns = bench_now() - start;
+	*pagenum = pool->pagenum;
+
+	eavb_frame_pool_free(pool);
+
+	return 0;
+}
+
+static int cmp_line(const void *a, const void *b)
+{
+	uintptr_t x = *(const uintptr_t *)a, y = *(const uintptr_t *)b;
+
+	return (x > y) - (x < y);
+}
+
+static int add_lines(uintptr_t *lines, int n, void *addr, int len)
+{
+	uintptr_t line;
+
+	for (line = (uintptr_t)addr / CACHE_LINE;
+	     line <= ((uintptr_t)addr + len - 1) / CACHE_LINE; line++)
+		lines[n++] = line;
+
+	return n;
+}
+
+/*
+ * bytes simple_talker touches per frame, with the header copied into
+ * every frame (copy) or as vec[0] separated from the payload (sg).
+ * init: template written at startup, hot: distinct cache lines written
+ * by talker_process() for header fields and payload, iov: iovecs of
+ * one readv() of all frames.
+ */
+static int bench_touch(struct eavb_ctx *ctx, int payload, bool sg,
+		       double *init, double *hot, int *iov)
+{
+	struct eavb_frame_pool *hdr = NULL, *pld;
+	uintptr_t *lines;
+	void *h, *p, *next = NULL;
+	int i, n = 0, distinct;
+
+	lines = calloc(TOUCH_FRAMES * 64, sizeof(*lines));
+	if (!lines)
+		return -1;
+
+	if (sg) {
+		hdr = eavb_frame_pool_new(ctx, HEADER_SIZE, TOUCH_FRAMES);
+		pld = eavb_frame_pool_new_align(ctx, payload, TOUCH_FRAMES, 4);
+	} else {
+		pld = eavb_frame_pool_new(ctx, HEADER_SIZE + payload,
+					  TOUCH_FRAMES);
+	}
+	if (!pld || (sg && !hdr)) {
+		eavb_frame_pool_free(pld);
+		eavb_frame_pool_free(hdr);
+		free(lines);
+		return -1;
+	}
+
+	*iov = 0;
+	for (i = 0; i < TOUCH_FRAMES; i++) {
+		if (sg) {
+			h = hdr->frames[i].vaddr;
+			p = pld->frames[i].vaddr;
+		} else {
+			h = pld->frames[i].vaddr;
+			p = h + HEADER_SIZE;
+		}
+		n = add_lines(lines, n, h, HEADER_SIZE);
+		n = add_lines(lines, n, p, payload);
+		if (p != next)
+			(*iov)++;
+		next = p + payload;
+	}
+
+	qsort(lines, n, sizeof(*lines), cmp_line);
+	for (i = 0, distinct = 0; i < n; i++) {
+		if (!i || lines[i] != lines[i - 1])
+			distinct++;
+	}
+
+	*init = sg ? HEADER_SIZE : HEADER_SIZE + payload;
+	*hot = (double)distinct * CACHE_LINE / TOUCH_FRAMES;
+
+	eavb_frame_pool_free(pld);
+	eavb_frame_pool_free(hdr);
+	free(lines);
+
+	return 0;
+}
+
+int main(int argc, char **argv)
+{
+	struct eavb_ctx *ctx;
+	char shmname[64];
+	uint64_t ns_page, ns_pool;
+	int pages_page, pages_pool;
+	int pagesize = getpagesize();
+	unsigned int i, j;
+	int ret = -1;
+
+	/* private loopback segment for this run */
+	snprintf(shmname, sizeof(shmname), "/eavb_frame_bench.%d", getpid());
+	setenv("EAVB_LOOPBACK_NAME", shmname, 1);
+	eavb_set_backend("loopback");
+
+	ctx = eavb_ctx_open(TALKER_DEV, O_RDWR);
+	if (!ctx)
+		goto out;
+
+	printf("%8s %6s %12s %12s %10s %10s %10s %10s\n",
+	       "entries", "frame", "page[us]", "pool[us]",
+	       "page[KiB]", "pool[KiB]", "page[sys]", "pool[sys]");
+
+	for (i = 0; i < sizeof(framesizes) / sizeof(framesizes[0]); i++) {
+		for (j = 0; j < sizeof(entrynums) / sizeof(entrynums[0]); j++) {
+			if (bench_per_page(ctx, framesizes[i], entrynums[j],
+					   &ns_page, &pages_page) < 0 ||
+			    bench_pool(ctx, framesizes[i], entrynums[j],
+				       &ns_pool, &pages_pool) < 0) {
+				fprintf(stderr, PROGNAME ": allocation failed\n");
+				goto close;
+			}
+
+			/* MAPPAGE ioctl and mmap per page */
+			printf("%8d %6d %12.1f %12.1f %10d %10d %10d %10d\n",
+			       entrynums[j], framesizes[i],
+			       ns_page / 1000.0, ns_pool / 1000.0,
+			       pages_page * pagesize / 1024,
+			       pages_pool * pagesize / 1024,
+			       pages_page * 2, pages_pool * 2);
+		}
+	}
+
+	printf("\n%8s %10s %10s %10s %10s %8s %8s\n",
+	       "payload", "copy init", "sg init", "copy hot", "sg hot",
+	       "copy iov", "sg iov");
+
+	for (i = 0; i < sizeof(payloadsizes) / sizeof(payloadsizes[0]); i++) {
+		double init_copy, init_sg, hot_copy, hot_sg;
+		int iov_copy, iov_sg;
+
+		if (bench_touch(ctx, payloadsizes[i], false,
+				&init_copy, &hot_copy, &iov_copy) < 0 ||
+		    bench_touch(ctx, payloadsizes[i], true,
+				&init_sg, &hot_sg, &iov_sg) < 0) {
+			fprintf(stderr, PROGNAME ": allocation failed\n");
+			goto close;
+		}
+
+		/* bytes per frame, iovecs per TOUCH_FRAMES frames */
+		printf("%8d %10.0f %10.0f %10.1f %10.1f %8d %8d\n",
+		       payloadsizes[i], init_copy, init_sg, hot_copy, hot_sg,
+		       iov_copy, iov_sg);
+	}
+
+	ret = 0;
+
+close:
+	eavb_ctx_close(ctx);
+out:
+	shm_unlink(shmname);
+
+	return ret;
+}
@@ -0,0 +1,636 @@
+/*
+ * Copyright (c) 2014-2016 Renesas Electronics Corporation
+ * Released under the MIT license
+ * http://opensource.org/licenses/mit-license.php
+ */
+
+/*
+ * benchmark of the H.264 CVF packetizer of lib/avtp
+ *
+ * an Annex B byte stream of access units (SPS, PPS and IDR every GOP,
+ * slices of random size otherwise, start codes of 3 and 4 bytes) is
+ * generated, split into NAL units and packetized with the scalar and
+ * the SIMD start code search. the packets are reassembled and must
+ * give back every NAL unit, with M set on the last packet of every
+ * access unit.
+ *
+ * the packets are then put into AVTP frames and depacketized into
+ * iovecs, with no loss and with random loss. every access unit given
+ * back must be the one sent, the first one after a loss must be of an
+ * IDR picture, and every packet must be released once. STAP-A packets
+ * written by hand must give back their aggregates, and fill up the
+ * iovecs of a small depacketizer without overrunning them. exits 1 on
+ * any mismatch.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <getopt.h>
+#include <inttypes.h>
+
+#include "avtp.h"
+#include "avtp_h264.h"
+
+#define PROGNAME "h264_bench"
+
+#define NSEC_SCALE   (1000000000ull)
+#define GOP          (30)
+#define PAYLOAD_MAX  (1476)   /* 1500 - 24 byte AVTP header */
+
+struct gen_nal {
+	size_t   off;             /* from the header, in the stream */
+	size_t   len;
+	bool     au_end;
+};
+
+static int access_units = 3000;
+static size_t payload = PAYLOAD_MAX;
+static int rounds = 5;
+static double loss = 1.0;            /* percent of packets */
+
+static uint8_t *stream;
+static size_t stream_len, stream_size;
+static struct gen_nal *nals;
+static int nalnum, nalsize;
+
+/* AVTP frames of the stream, orig is kept as packetized */
+static uint8_t *pkts, *orig;
+static size_t slot;
+static int *pkt_au;                  /* access unit of packet */
+static int pktnum;
+static int *au_nal;                  /* first NAL unit of access unit */
+static int max_packets;              /* of an access unit */
+
+static inline uint64_t bench_now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return ts.tv_sec * NSEC_SCALE + ts.tv_nsec;
+}
+
+static void show_usage(void)
+{
+	fprintf(stderr,
+		"usage: " PROGNAME " [options]\n"
+		"\n"
+		"options:\n"
+		"    -a NUM     access units (default:3000)\n"
+		"    -s NUM     bytes of a payload (default:1476)\n"
+		"    -r NUM     rounds of each measurement (default:5)\n"
+		"    -o FILE    write the byte stream to FILE, e.g. for\n"
+		"               simple_talker --h264\n"
+		"    -h         display this help\n");
+}
+
+static void put(uint8_t b)
+{
+	if (stream_len == stream_size) {
+		stream_size = stream_size ? stream_size * 2 : 1 << 20;
+		stream = realloc(stream, stream_size);
+	}
+	stream[stream_len++] = b;
+}
+
+/* NAL unit of random bytes with emulation prevention */
+static void gen_nal(uint8_t header, int first_mb, size_t len, bool au_end)
+{
+	size_t start;
+	int zeros = 0;
+	uint8_t b;
+
+	/* 4 byte start code before parameter sets and the first slice */
+	if (first_mb || header != AVTP_H264_NAL_SLICE)
+		put(0);
+	put(0);
+	put(0);
+	put(1);
+
+	if (nalnum == nalsize) {
+		nalsize = nalsize ? nalsize * 2 : 1024;
+		nals = realloc(nals, nalsize * sizeof(*nals));
+	}
+
+	start = stream_len;
+	put(header);
+	while (stream_len - start < len) {
+		b = rand();
+		/* more zeros than random, to exercise the search */
+		if (!(rand() & 7))
+			b = 0;
+		if (stream_len - start == 1)
+			b = first_mb ? (b | 0x80) : (b & 0x7f);
+		if (zeros >= 2 && b <= 3) {
+			put(3);
+			zeros = 0;
+		}
+		put(b);
+		zeros = b ? 0 : zeros + 1;
+	}
+	/* the last byte has the rbsp_stop_one_bit */
+	if (!stream[stream_len - 1])
+		stream[stream_len - 1] = 0x80;
+
+	nals[nalnum].off = start;
+	nals[nalnum].len = stream_len - start;
+	nals[nalnum].au_end = au_end;
+	nalnum++;
+}
+
+static void generate(void)
+{
+	int i, j, slices;
+
+	for (i = 0; i < access_units; i++) {
+		slices = 1 + rand() % 4;
+		if (!(i % GOP)) {
+			gen_nal(0x67, 0, 12, false);
+			gen_nal(0x68, 0, 4, false);
+			for (j = 0; j < slices; j++)
+				gen_nal(0x65, !j, 8000 + rand() % 40000,
+					j == slices - 1);
+		} else {
+			for (j = 0; j < slices; j++)
+				gen_nal(0x41, !j, 16 + rand() % 8000,
+					j == slices - 1);
+		}
+	}
+	/* trailing_zero_8bits at the end */
+	put(0);
+}
+
+static double scan(void)
+{
+	struct avtp_h264_parser ps;
+	const uint8_t *nal;
+	size_t len;
+	uint64_t start;
+	int i, n = 0;
+
+	start = bench_now();
+	for (i = 0; i < rounds; i++) {
+		avtp_h264_parser_init(&ps, stream, stream_len);
+		while (!avtp_h264_parser_next(&ps, &nal, &len))
+			n++;
+	}
+
+	return (double)stream_len * rounds / (bench_now() - start);
+}
+
+/* returns the number of mismatches */
+static int packetize(double *nal_rate, double *gbps, uint64_t *packets)
+{
+	struct avtp_h264_packetizer pk;
+	uint8_t *pkt, *au;
+	uint64_t start, elapsed = 0;
+	size_t len, aulen = 0;
+	int errors = 0, i, k = 0;
+	bool m;
+
+	pkt = malloc(payload);
+	au = malloc(1 << 20);
+
+	for (i = 0; i < rounds; i++) {
+		avtp_h264_packetizer_init(&pk, stream, stream_len, payload);
+
+		*packets = 0;
+		start = bench_now();
+		while ((len = avtp_h264_packetize(&pk, pkt, &m)))
+			(*packets)++;
+		elapsed += bench_now() - start;
+
+		if (pk.nals != nalnum || pk.access_units != access_units)
+			errors++;
+	}
+	*nal_rate = (double)nalnum * rounds * NSEC_SCALE / elapsed;
+	*gbps = (double)stream_len * rounds / elapsed;
+
+	/* reassemble */
+	avtp_h264_packetizer_init(&pk, stream, stream_len, payload);
+	while ((len = avtp_h264_packetize(&pk, pkt, &m))) {
+		uint8_t *p = pkt + AVTP_H264_TIMESTAMP_SIZE;
+		bool done = true;
+
+		len -= AVTP_H264_TIMESTAMP_SIZE;
+		if (len > payload - AVTP_H264_TIMESTAMP_SIZE) {
+			errors++;
+			break;
+		}
+
+		if (AVTP_H264_NAL_TYPE(p[0]) == AVTP_H264_NAL_FU_A) {
+			if (p[1] & 0x80) {
+				au[0] = (p[0] & 0xe0) | AVTP_H264_NAL_TYPE(p[1]);
+				aulen = 1;
+			}
+			memcpy(au + aulen, p + 2, len - 2);
+			aulen += len - 2;
+			done = p[1] & 0x40;
+		} else {
+			memcpy(au, p, len);
+			aulen = len;
+		}
+		if (!done) {
+			if (m)
+				errors++;
+			continue;
+		}
+
+		if (k >= nalnum || aulen != nals[k].len ||
+		    memcmp(au, stream + nals[k].off, aulen) ||
+		    m != nals[k].au_end)
+			errors++;
+		k++;
+	}
+	if (k != nalnum)
+		errors++;
+
+	free(pkt);
+	free(au);
+
+	return errors;
+}
+
+/* AVTP frames of the packets, with the access unit of each */
+static void build(void)
+{
+	struct avtp_h264_packetizer pk;
+	uint8_t *pkt;
+	size_t len;
+	int i, au = 0, n = 0;
+	bool m;
+
+	slot = (AVTP_CVF_PAYLOAD_OFFSET + payload + 63) & ~63;
+
+	pkt = malloc(payload);
+	avtp_h264_packetizer_init(&pk, stream, stream_len, payload);
+	for (pktnum = 0; avtp_h264_packetize(&pk, pkt, &m); pktnum++)
+		;
+	free(pkt);
+
+	orig = malloc(pktnum * slot);
+	pkts = malloc(pktnum * slot);
+	pkt_au = malloc(pktnum * sizeof(*pkt_au));
+	au_nal = malloc((access_units + 1) * sizeof(*au_nal));
+
+	avtp_h264_packetizer_init(&pk, stream, stream_len, payload);
+	for (i = 0; i < pktnum; i++) {
+		pkt = orig + i * slot;
+		copy_avtp_cvf_h264_template(pkt);
+		len = avtp_h264_packetize(&pk, pkt + AVTP_CVF_PAYLOAD_OFFSET,
+					  &m);
+		set_avtp_sequence_num(pkt, i);
+		set_avtp_stream_data_length(pkt, len);
+		set_avtp_cvf_m(pkt, m);
+
+		pkt_au[i] = au;
+		n++;
+		if (m) {
+			if (n > max_packets)
+				max_packets = n;
+			n = 0;
+			au++;
+		}
+	}
+
+	for (i = 0, au = 0; i < nalnum; i++) {
+		if (!i || nals[i - 1].au_end)
+			au_nal[au++] = i;
+	}
+	au_nal[au] = nalnum;
+}
+
+static double depacketize(double *au_rate)
+{
+	struct avtp_h264_depacketizer dp;
+	uint64_t start, elapsed = 0, aus = 0;
+	int i, k;
+
+	for (k = 0; k < rounds; k++) {
+		memcpy(pkts, orig, pktnum * slot);
+		avtp_h264_depacketizer_init(&dp, max_packets);
+
+		start = bench_now();
+		for (i = 0; i < pktnum; i++)
+			avtp_h264_depacketize(&dp, pkts + i * slot, slot, i);
+		elapsed += bench_now() - start;
+
+		aus += dp.access_units;
+		avtp_h264_depacketizer_free(&dp);
+	}
+	*au_rate = (double)aus * NSEC_SCALE / elapsed;
+
+	return (double)stream_len * rounds / elapsed;
+}
+
+/* the access unit in iovecs must be access unit k of the stream */
+static int compare(struct avtp_h264_depacketizer *dp, int k, uint8_t *au,
+		   size_t size)
+{
+	struct avtp_h264_parser ps;
+	const uint8_t *nal;
+	size_t len = 0;
+	int i, j;
+
+	for (i = 0; i < dp->iovcnt; i++) {
+		if (len + dp->iov[i].iov_len > size)
+			return 1;
+		memcpy(au + len, dp->iov[i].iov_base, dp->iov[i].iov_len);
+		len += dp->iov[i].iov_len;
+	}
+
+	avtp_h264_parser_init(&ps, au, len);
+	for (j = au_nal[k]; !avtp_h264_parser_next(&ps, &nal, &len); j++) {
+		if (j == au_nal[k + 1] || len != nals[j].len ||
+		    memcmp(nal, stream + nals[j].off, len))
+			return 1;
+	}
+
+	return j != au_nal[k + 1];
+}
+
+/* returns the number of mismatches */
+static int recover(double percent)
+{
+	struct avtp_h264_depacketizer dp;
+	uint8_t *au, *released;
+	bool *au_lost, *au_out;
+	bool sync = false, gap = false;
+	int errors = 0, lost = 0, expected = 0;
+	int i, k;
+
+	memcpy(pkts, orig, pktnum * slot);
+	au = malloc(1 << 22);
+	released = calloc(pktnum, 1);
+	au_lost = calloc(access_units, sizeof(*au_lost));
+	au_out = calloc(access_units, sizeof(*au_out));
+
+	avtp_h264_depacketizer_init(&dp, max_packets);
+	for (i = 0; i < pktnum; i++) {
+		if (rand() < percent / 100 * ((double)RAND_MAX + 1)) {
+			au_lost[pkt_au[i]] = true;
+			released[i] = 1;
+			lost++;
+			gap = true;
+			continue;
+		}
+
+		/* the loss is found here, the access unit is skipped */
+		if (gap)
+			au_lost[pkt_au[i]] = true;
+		gap = false;
+
+		if (avtp_h264_depacketize(&dp, pkts + i * slot, slot, i)) {
+			k = pkt_au[i];
+			if (compare(&dp, k, au, 1 << 22))
+				errors++;
+			au_out[k] = true;
+			for (k = 0; k < dp.iovcnt; k++)
+				if (dp.cookies[k] >= 0)
+					released[dp.cookies[k]]++;
+		}
+		for (k = 0; k < dp.freenum; k++)
+			released[dp.frees[k]]++;
+	}
+
+	/* an access unit after a loss is taken from an IDR picture */
+	for (k = 0; k < access_units; k++) {
+		if (au_lost[k])
+			sync = false;
+		else if (!(k % GOP))
+			sync = true;
+		if (au_out[k] != (sync && !au_lost[k]))
+			errors++;
+		expected += sync && !au_lost[k];
+	}
+	for (i = 0; i < pktnum; i++)
+		if (released[i] != 1)
+			errors++;
+	if (dp.lost != lost)
+		errors++;
+
+	printf("loss %5.2f%% : %d packets lost, %" PRIu64 " of %d access units (%d expected), %" PRIu64 " dropped, %" PRIu64 " errors\n",
+	       percent, lost, dp.access_units, access_units, expected,
+	       dp.dropped, dp.errors);
+
+	avtp_h264_depacketizer_free(&dp);
+	free(au);
+	free(released);
+	free(au_lost);
+	free(au_out);
+
+	return errors;
+}
+
+/* AVTP frame of a payload after the h264_timestamp, returns its length */
+static size_t stap_frame(uint8_t *pkt, int seq, const uint8_t *data,
+			 size_t len, bool m)
+{
+	copy_avtp_cvf_h264_template(pkt);
+	memcpy(pkt + AVTP_CVF_PAYLOAD_OFFSET + AVTP_H264_TIMESTAMP_SIZE,
+	       data, len);
+	set_avtp_sequence_num(pkt, seq);
+	set_avtp_stream_data_length(pkt, AVTP_H264_TIMESTAMP_SIZE + len);
+	set_avtp_cvf_m(pkt, m);
+
+	return AVTP_CVF_PAYLOAD_OFFSET + AVTP_H264_TIMESTAMP_SIZE + len;
+}
+
+/* STAP-A payload of the NAL units in order, num of them */
+static size_t stap_payload(uint8_t *data, const uint8_t *const *nal,
+			   const size_t *len, const int *order, int num)
+{
+	size_t n = 0;
+	int i;
+
+	data[n++] = 0x60 | AVTP_H264_NAL_STAP_A;
+	for (i = 0; i < num; i++) {
+		data[n++] = len[order[i]] >> 8;
+		data[n++] = len[order[i]];
+		memcpy(data + n, nal[order[i]], len[order[i]]);
+		n += len[order[i]];
+	}
+
+	return n;
+}
+
+/* the access unit in iovecs must be the NAL units in order */
+static int stap_compare(struct avtp_h264_depacketizer *dp,
+			const uint8_t *const *nal, const size_t *len,
+			const int *order, int num)
+{
+	uint8_t au[256], expect[256];
+	size_t n = 0, m = 0;
+	int i;
+
+	for (i = 0; i < dp->iovcnt; i++) {
+		if (n + dp->iov[i].iov_len > sizeof(au))
+			return 1;
+		memcpy(au + n, dp->iov[i].iov_base, dp->iov[i].iov_len);
+		n += dp->iov[i].iov_len;
+	}
+	for (i = 0; i < num; i++) {
+		memcpy(expect + m, "\0\0\0\1", 4);
+		memcpy(expect + m + 4, nal[order[i]], len[order[i]]);
+		m += 4 + len[order[i]];
+	}
+
+	return n != m || memcmp(au, expect, n);
+}
+
+/*
+ * STAP-A with a depacketizer of 4 packets, 8 iovecs: an access unit,
+ * aggregates that take every iovec followed by a single NAL unit
+ * packet, too many aggregates in a packet, an access unit again, one
+ * of a stream_data_length beyond the bytes received, and one again
+ */
+static int stap(void)
+{
+	static const uint8_t sps[] = { 0x67, 0x42, 0x00, 0x1e };
+	static const uint8_t pps[] = { 0x68, 0xce, 0x38, 0x80 };
+	static const uint8_t idr[] = { 0x65, 0x88, 0x84, 0x21, 0xa0 };
+	static const uint8_t *const nal[] = { sps, pps, idr };
+	static const size_t len[] = { sizeof(sps), sizeof(pps), sizeof(idr) };
+	static const int au[] = { 0, 1, 2 };
+	static const int full[] = { 0, 1, 0, 1 };
+	static const int over[] = { 0, 1, 0, 1, 2 };
+	struct avtp_h264_depacketizer dp;
+	uint8_t pkt[7][AVTP_CVF_PAYLOAD_OFFSET + 128];
+	uint8_t data[128];
+	size_t size[7];
+	int released[7] = { 0 };
+	int errors = 0, out = 0;
+	int i, k;
+
+	size[0] = stap_frame(pkt[0], 0, data,
+			     stap_payload(data, nal, len, au, 3), true);
+	size[1] = stap_frame(pkt[1], 1, data,
+			     stap_payload(data, nal, len, full, 4), false);
+	size[2] = stap_frame(pkt[2], 2, idr, sizeof(idr), true);
+	size[3] = stap_frame(pkt[3], 3, data,
+			     stap_payload(data, nal, len, over, 5), true);
+	size[4] = stap_frame(pkt[4], 4, data,
+			     stap_payload(data, nal, len, au, 3), true);
+	size[5] = stap_frame(pkt[5], 5, data,
+			     stap_payload(data, nal, len, au, 3), true);
+	set_avtp_stream_data_length(pkt[5], 0xffff);
+	size[6] = stap_frame(pkt[6], 6, data,
+			     stap_payload(data, nal, len, au, 3), true);
+
+	avtp_h264_depacketizer_init(&dp, 4);
+	for (i = 0; i < 7; i++) {
+		if (avtp_h264_depacketize(&dp, pkt[i], size[i], i)) {
+			if (stap_compare(&dp, nal, len, au, 3))
+				errors++;
+			for (k = 0; k < dp.iovcnt; k++)
+				if (dp.cookies[k] >= 0)
+					released[dp.cookies[k]]++;
+			out |= 1 << i;
+		}
+		for (k = 0; k < dp.freenum; k++)
+			released[dp.frees[k]]++;
+	}
+
+	/* the packets beyond the iovecs are errors, not written */
+	if (out != (1 << 0 | 1 << 4 | 1 << 6) || dp.errors != 3 ||
+	    dp.nals != 17)
+		errors++;
+	for (i = 0; i < 7; i++)
+		if (released[i] != 1)
+			errors++;
+
+	printf("stap-a     : %" PRIu64 " access units %" PRIu64 " NAL units %" PRIu64 " errors\n",
+	       dp.access_units, dp.nals, dp.errors);
+
+	avtp_h264_depacketizer_free(&dp);
+
+	return errors;
+}
+
+int main(int argc, char **argv)
+{
+	static const char *impls[] = { "scalar", "simd" };
+	double gbps, nal_rate, au_rate, rate;
+	uint64_t packets = 0;
+	char *oname = NULL;
+	FILE *fp;
+	int errors = 0;
+	int c, i;
+
+	while ((c = getopt(argc, argv, "a:s:r:l:o:h")) != -1) {
+		switch (c) {
+		case 'a':
+			access_units = atoi(optarg);
+			break;
+		case 's':
+			payload = atoi(optarg);
+			break;
+		case 'r':
+			rounds = atoi(optarg);
+			break;
+		case 'l':
+			loss = atof(optarg);
+			break;
+		case 'o':
+			oname = optarg;
+			break;
+		case 'h':
+		default:
+			show_usage();
+			return (c == 'h') ? 0 : -1;
+		}
+	}
+
+	if (access_units < 1 || rounds < 1 || loss < 0 || loss > 100 ||
+	    payload <= AVTP_H264_TIMESTAMP_SIZE + AVTP_H264_FU_HEADER_SIZE) {
+		fprintf(stderr, PROGNAME ": invalid options\n");
+		return -1;
+	}
+	srand(1);
+	generate();
+
+	printf("stream     : %d access units, %d NAL units, %zu bytes\n",
+	       access_units, nalnum, stream_len);
+
+	if (oname) {
+		fp = fopen(oname, "w");
+		if (!fp || fwrite(stream, stream_len, 1, fp) != 1) {
+			perror(oname);
+			return -1;
+		}
+		fclose(fp);
+	}
+
+	for (i = 0; i < 2; i++) {
+		if (avtp_h264_select(impls[i]) < 0)
+			continue;
+
+		rate = scan();
+		errors += packetize(&nal_rate, &gbps, &packets);
+		printf("%-6s     : scan %6.2f GB/s packetize %6.2f GB/s %9.0f NAL/s %" PRIu64 " packets\n",
+		       avtp_h264_name(), rate, gbps, nal_rate, packets);
+	}
+	avtp_h264_select("auto");
+
+	build();
+	rate = depacketize(&au_rate);
+	printf("depacketize: %6.2f GB/s %9.0f access units/s %d packets\n",
+	       rate, au_rate, pktnum);
+	errors += recover(0);
+	if (loss > 0)
+		errors += recover(loss);
+	errors += stap();
+
+	printf("mismatch   : %d\n", errors);
+
+	free(stream);
+	free(nals);
+	free(orig);
+	free(pkts);
+	free(pkt_au);
+	free(au_nal);
+
+	return errors ? 1 : 0;
+}
@@ -0,0 +1,165 @@
+/*
+ * Copyright (c) 2014-2016 Renesas Electronics Corporation
+ * Released under the MIT license
+ * http://opensource.org/licenses/mit-license.php
+ */
+
+/*
+ * allocation counter, preloaded into simple_talker/simple_listener
+ * by simple_bench -A.
+ *
+ * allocations made after MALLOC_COUNT_ARM_MS (default:100) from
+ * process start are counted as steady state allocations. at exit
+ * the count and the callers are reported to stderr, and the exit
+ * status is replaced by MALLOC_COUNT_STATUS if any was found.
+ *
+ * needs glibc, the allocator is reached through __libc_malloc
+ * and friends instead of dlsym() to avoid recursion.
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <time.h>
+#include <dlfcn.h>
+#include <inttypes.h>
+#include <stdbool.h>
+
+#include "malloc_count.h"
+
+#define NSEC_SCALE        (1000000000ull)
+#define CALLER_MAX        (8)
+
+extern void *__libc_malloc(size_t size);
+extern void *__libc_calloc(size_t nmemb, size_t size);
+extern void *__libc_realloc(void *ptr, size_t size);
+extern void *__libc_memalign(size_t alignment, size_t size);
+
+static uint64_t arm_time;
+static volatile bool armed;
+static uint64_t count;
+static void *callers[CALLER_MAX];
+static uint64_t callers_count[CALLER_MAX];
+
+/* stdout is buffered from startup, not on the first print at exit */
+static char stdout_buf[BUFSIZ];
+
+static inline uint64_t mc_now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return ts.tv_sec * NSEC_SCALE + ts.tv_nsec;
+}
+
+static void mc_account(void *caller)
+{
+	int i;
+
+	if (!armed) {
+		if (!arm_time || mc_now() < arm_time)
+			return;
+		armed = true;
+	}
+
+	__atomic_fetch_add(&count, 1, __ATOMIC_RELAXED);
+
+	for (i = 0; i < CALLER_MAX; i++) {
+		if (callers[i] == caller) {
+			callers_count[i]++;
+			return;
+		}
+		if (!callers[i]) {
+			callers[i] = caller;
+			callers_count[i] = 1;
+			return;
+		}
+	}
+}
+
+void *malloc(size_t size)
+{
+	mc_account(__builtin_return_address(0));
+	return __libc_malloc(size);
+}
+
+void *calloc(size_t nmemb, size_t size)
+{
+	mc_account(__builtin_return_address(0));
+	return __libc_calloc(nmemb, size);
+}
+
+void *realloc(void *ptr, size_t size)
+{
+	mc_account(__builtin_return_address(0));
+	return __libc_realloc(ptr, size);
+}
+
+int posix_memalign(void **memptr, size_t alignment, size_t size)
+{
+	void *p;
+
+	mc_account(__builtin_return_address(0));
+	p = __libc_memalign(alignment, size);
+	if (!p)
+		return ENOMEM;
+	*memptr = p;
+
+	return 0;
+}
+
+void *aligned_alloc(size_t alignment, size_t size)
+{
+	mc_account(__builtin_return_address(0));
+	return __libc_memalign(alignment, size);
+}
+
+__attribute__((constructor))
+static void mc_init(void)
+{
+	char *env;
+	uint64_t ms = MALLOC_COUNT_ARM_MS;
+
+	env = getenv("MALLOC_COUNT_ARM_MS");
+	if (env)
+		ms = strtoull(env, NULL, 0);
+
+	setvbuf(stdout, stdout_buf,
+		isatty(STDOUT_FILENO) ? _IOLBF : _IOFBF, sizeof(stdout_buf));
+
+	arm_time = mc_now() + ms * 1000000ull;
+}
+
+__attribute__((destructor))
+static void mc_report(void)
+{
+	Dl_info info;
+	int i;
+
+	armed = false;
+	arm_time = 0;
+
+	fflush(stdout);
+
+	fprintf(stderr, "malloc_count: %s: %" PRIu64
+		" steady state allocations\n",
+		program_invocation_short_name, count);
+
+	for (i = 0; i < CALLER_MAX && callers[i]; i++) {
+		if (dladdr(callers[i], &info) && info.dli_fname)
+			fprintf(stderr, "malloc_count:   %" PRIu64
+				" from %s+0x%tx\n", callers_count[i],
+				info.dli_fname,
+				(char *)callers[i] - (char *)info.dli_fbase);
+		else
+			fprintf(stderr, "malloc_count:   %" PRIu64
+				" from %p\n", callers_count[i], callers[i]);
+	}
+
+	if (count)
+		_exit(MALLOC_COUNT_STATUS);
+}
@@ -0,0 +1,16 @@
+/*
+ * Copyright (c) 2014-2016 Renesas Electronics Corporation
+ * Released under the MIT license
+ * http://opensource.org/licenses/mit-license.php
+ */
+
+#ifndef __MALLOC_COUNT_H__
+#define __MALLOC_COUNT_H__
+
+/* allocations after this time from start are steady state */
+#define MALLOC_COUNT_ARM_MS  (100)
+
+/* exit status of a process with steady state allocations */
+#define MALLOC_COUNT_STATUS  (99)
+
+#endif /* __MALLOC_COUNT_H__ */
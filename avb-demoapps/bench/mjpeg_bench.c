@@ -0,0 +1,398 @@
+/*
+ * Copyright (c) 2014-2016 Renesas Electronics Corporation
+ * Released under the MIT license
+ * http://opensource.org/licenses/mit-license.php
+ */
+
+/*
+ * benchmark of the MJPEG CVF packetizer of lib/avtp
+ *
+ * baseline JPEG frames of 720p and 1080p YCbCr 4:2:0 are generated
+ * with random entropy coded data of -b bits per pixel (0xff stuffed,
+ * restart markers with -d), with quantization tables that change
+ * every -t frames. they are parsed and packetized as an MJPEG file.
+ * the packets are reassembled and must give back every scan, with
+ * the tables only in the first packet of a frame whose tables changed
+ * or are refreshed, and M on the last packet. exits 1 on any mismatch.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <getopt.h>
+#include <inttypes.h>
+
+#include "avtp_mjpeg.h"
+
+#define PROGNAME "mjpeg_bench"
+
+#define NSEC_SCALE   (1000000000ull)
+#define PAYLOAD_MAX  (1476)   /* 1500 - 24 byte AVTP header */
+
+struct gen_frame {
+	size_t   scan;             /* in the stream */
+	size_t   scan_len;
+	int      tables;           /* generation of tables */
+};
+
+static const struct {
+	const char *name;
+	int        width;
+	int        height;
+} sizes[] = {
+	{ "720p",  1280,  720 },
+	{ "1080p", 1920, 1080 },
+};
+
+static int frames = 300;
+static size_t payload = PAYLOAD_MAX;
+static int rounds = 5;
+static double bpp = 1.0;
+static int change = 30;
+static int refresh;
+static int dri;
+
+static uint8_t *stream;
+static size_t stream_len, stream_size;
+static struct gen_frame *gen;
+
+static inline uint64_t bench_now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return ts.tv_sec * NSEC_SCALE + ts.tv_nsec;
+}
+
+static void show_usage(void)
+{
+	fprintf(stderr,
+		"usage: " PROGNAME " [options]\n"
+		"\n"
+		"options:\n"
+		"    -n NUM     frames of each size (default:300)\n"
+		"    -s NUM     bytes of a payload (default:1476)\n"
+		"    -r NUM     rounds of each measurement (default:5)\n"
+		"    -b NUM     bits per pixel of the scan (default:1.0)\n"
+		"    -t NUM     frames the tables change (default:30)\n"
+		"    -R NUM     frames the tables are sent again (default:0=off)\n"
+		"    -d NUM     restart interval in MCUs (default:0=none)\n"
+		"    -o FILE    write the 720p frames to FILE, e.g. for\n"
+		"               simple_talker --mjpeg\n"
+		"    -h         display this help\n");
+}
+
+static void put(uint8_t b)
+{
+	if (stream_len == stream_size) {
+		stream_size = stream_size ? stream_size * 2 : 1 << 20;
+		stream = realloc(stream, stream_size);
+	}
+	stream[stream_len++] = b;
+}
+
+static void put16(uint16_t v)
+{
+	put(v >> 8);
+	put(v);
+}
+
+static uint8_t qvalue(int generation, int table, int i)
+{
+	return 1 + (i * 7 + table * 13 + generation * 5) % 99;
+}
+
+/* SOI, DQT, SOF0, DHT, DRI, SOS, the scan and EOI */
+static void gen_frame(struct gen_frame *g, int width, int height,
+		      int generation)
+{
+	static const uint8_t hv[3] = { 0x22, 0x11, 0x11 };
+	size_t len, n;
+	int i, t;
+	uint8_t b;
+
+	put(0xff);
+	put(0xd8);
+
+	put(0xff);
+	put(0xdb);
+	put16(2 + 2 * 65);
+	for (t = 0; t < 2; t++) {
+		put(t);
+		for (i = 0; i < 64; i++)
+			put(qvalue(generation, t, i));
+	}
+
+	put(0xff);
+	put(0xc0);
+	put16(2 + 6 + 3 * 3);
+	put(8);
+	put16(height);
+	put16(width);
+	put(3);
+	for (i = 0; i < 3; i++) {
+		put(i + 1);
+		put(hv[i]);
+		put(!!i);
+	}
+
+	/* only skipped, the tables of RFC 2435 are the ones of K.3 */
+	put(0xff);
+	put(0xc4);
+	put16(2 + 17);
+	put(0x00);
+	for (i = 0; i < 16; i++)
+		put(0);
+
+	if (dri) {
+		put(0xff);
+		put(0xdd);
+		put16(4);
+		put16(dri);
+	}
+
+	put(0xff);
+	put(0xda);
+	put16(2 + 1 + 3 * 2 + 3);
+	put(3);
+	for (i = 0; i < 3; i++) {
+		put(i + 1);
+		put(i ? 0x11 : 0x00);
+	}
+	put(0);
+	put(63);
+	put(0);
+
+	g->scan = stream_len;
+	g->tables = generation;
+	len = (size_t)(width * height * bpp / 8);
+	for (n = 0; n < len; n++) {
+		/* a restart marker every 256 bytes stands for dri MCUs */
+		if (dri && n && !(n % 256)) {
+			put(0xff);
+			put(0xd0 + (n / 256 - 1) % 8);
+		}
+		b = rand();
+		put(b);
+		if (b == 0xff)
+			put(0);
+	}
+	g->scan_len = stream_len - g->scan;
+
+	put(0xff);
+	put(0xd9);
+}
+
+static void generate(int width, int height)
+{
+	int i;
+
+	stream_len = 0;
+	for (i = 0; i < frames; i++)
+		gen_frame(&gen[i], width, height, change ? i / change : 0);
+}
+
+static double parse(void)
+{
+	struct avtp_mjpeg_frame f;
+	uint64_t start;
+	size_t off;
+	int i, n = 0;
+
+	start = bench_now();
+	for (i = 0; i < rounds; i++) {
+		for (off = 0; off < stream_len; off += f.len) {
+			if (avtp_mjpeg_parse(&f, stream + off,
+					     stream_len - off) < 0)
+				break;
+			n++;
+		}
+	}
+
+	return (double)n * NSEC_SCALE / (bench_now() - start);
+}
+
+static uint32_t get24(const uint8_t *p)
+{
+	return p[0] << 16 | p[1] << 8 | p[2];
+}
+
+/* returns the number of mismatches */
+static int packetize(int width, int height, double *fps, double *gbps,
+		     uint64_t *packets)
+{
+	struct avtp_mjpeg_packetizer pk;
+	uint8_t *pkt, *p, *q;
+	uint8_t tables[AVTP_MJPEG_QTABLE_MAX];
+	uint64_t start, elapsed = 0;
+	size_t len, off = 0, qlen;
+	int errors = 0, i, k = 0, sent = -1;
+	int qsent = -1, last = 0;
+	bool m;
+
+	pkt = malloc(payload);
+
+	for (i = 0; i < rounds; i++) {
+		avtp_mjpeg_packetizer_init(&pk, stream, stream_len, payload,
+					   refresh);
+
+		*packets = 0;
+		start = bench_now();
+		while ((len = avtp_mjpeg_packetize(&pk, pkt, &m)))
+			(*packets)++;
+		elapsed += bench_now() - start;
+
+		if (pk.frames != frames || pk.skipped)
+			errors++;
+	}
+	*fps = (double)frames * rounds * NSEC_SCALE / elapsed;
+	*gbps = (double)stream_len * rounds / elapsed;
+
+	/* reassemble */
+	avtp_mjpeg_packetizer_init(&pk, stream, stream_len, payload, refresh);
+	while ((len = avtp_mjpeg_packetize(&pk, pkt, &m))) {
+		struct gen_frame *g = &gen[k];
+
+		p = pkt;
+		if (len > payload || k >= frames || get24(p + 1) != off ||
+		    p[4] != (AVTP_MJPEG_TYPE_420 |
+			     (dri ? AVTP_MJPEG_TYPE_RESTART : 0)) ||
+		    p[6] != (width + 7) / 8 || p[7] != (height + 7) / 8) {
+			errors++;
+			break;
+		}
+		p += AVTP_MJPEG_HEADER_SIZE;
+		if (dri) {
+			if ((p[0] << 8 | p[1]) != dri)
+				errors++;
+			p += AVTP_MJPEG_RESTART_HEADER_SIZE;
+		}
+
+		if (!off) {
+			qlen = p[2] << 8 | p[3];
+			p += AVTP_MJPEG_QTABLE_HEADER_SIZE;
+
+			/* sent on a change or a refresh only */
+			if (!qlen != !(g->tables != sent ||
+				       (refresh && k - last >= refresh)))
+				errors++;
+
+			if (qlen) {
+				if (qlen != 128)
+					errors++;
+				for (i = 0; i < 128; i++)
+					tables[i] = qvalue(g->tables, i / 64,
+							   i % 64);
+				if (memcmp(p, tables, 128))
+					errors++;
+				sent = g->tables;
+				qsent = pkt[5];
+				last = k;
+				p += qlen;
+			} else if (g->tables != sent || pkt[5] != qsent) {
+				errors++;
+			}
+		}
+
+		q = pkt + len;
+		if (memcmp(p, stream + g->scan + off, q - p))
+			errors++;
+		off += q - p;
+
+		if (m != (off == g->scan_len))
+			errors++;
+		if (m) {
+			off = 0;
+			k++;
+		}
+	}
+	if (k != frames)
+		errors++;
+
+	free(pkt);
+
+	return errors;
+}
+
+int main(int argc, char **argv)
+{
+	double fps, gbps, rate;
+	uint64_t packets = 0;
+	char *oname = NULL;
+	FILE *fp;
+	int errors = 0;
+	int c, i;
+
+	while ((c = getopt(argc, argv, "n:s:r:b:t:R:d:o:h")) != -1) {
+		switch (c) {
+		case 'n':
+			frames = atoi(optarg);
+			break;
+		case 's':
+			payload = atoi(optarg);
+			break;
+		case 'r':
+			rounds = atoi(optarg);
+			break;
+		case 'b':
+			bpp = atof(optarg);
+			break;
+		case 't':
+			change = atoi(optarg);
+			break;
+		case 'R':
+			refresh = atoi(optarg);
+			break;
+		case 'd':
+			dri = atoi(optarg);
+			break;
+		case 'o':
+			oname = optarg;
+			break;
+		case 'h':
+		default:
+			show_usage();
+			return (c == 'h') ? 0 : -1;
+		}
+	}
+
+	if (frames < 1 || rounds < 1 || bpp <= 0 || bpp > 24 ||
+	    change < 0 || refresh < 0 || dri < 0 || dri > 0xffff ||
+	    payload <= AVTP_MJPEG_HEADER_SIZE +
+	    AVTP_MJPEG_RESTART_HEADER_SIZE +
+	    AVTP_MJPEG_QTABLE_HEADER_SIZE + AVTP_MJPEG_QTABLE_MAX) {
+		fprintf(stderr, PROGNAME ": invalid options\n");
+		return -1;
+	}
+	srand(1);
+	gen = calloc(frames, sizeof(*gen));
+
+	for (i = 0; i < (int)(sizeof(sizes) / sizeof(sizes[0])); i++) {
+		generate(sizes[i].width, sizes[i].height);
+
+		if (oname && !i) {
+			fp = fopen(oname, "w");
+			if (!fp || fwrite(stream, stream_len, 1, fp) != 1) {
+				perror(oname);
+				return -1;
+			}
+			fclose(fp);
+		}
+
+		rate = parse();
+		errors += packetize(sizes[i].width, sizes[i].height, &fps,
+				    &gbps, &packets);
+		printf("%-5s %4dx%-4d: %zu bytes/frame parse %8.0f frames/s packetize %7.0f frames/s %6.2f GB/s %" PRIu64 " packets\n",
+		       sizes[i].name, sizes[i].width, sizes[i].height,
+		       stream_len / frames, rate, fps, gbps, packets);
+	}
+
+	printf("mismatch   : %d\n", errors);
+
+	free(stream);
+	free(gen);
+
+	return errors ? 1 : 0;
+}
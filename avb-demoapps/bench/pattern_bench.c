@@ -0,0 +1,138 @@
+/*
+ * Copyright (c) 2014-2016 Renesas Electronics Corporation
+ * Released under the MIT license
+ * http://opensource.org/licenses/mit-license.php
+ */
+
+/*
+ * benchmark of the pattern frames of simple_talker --pattern and
+ * simple_listener --verify
+ *
+ * frames are generated and verified on one core with each CRC32C
+ * implementation the CPU has, then one bit of each is flipped to see
+ * that it is caught. exits 1 on any frame misjudged.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <getopt.h>
+#include <inttypes.h>
+
+#include "crc32c.h"
+#include "pattern.h"
+
+#define PROGNAME "pattern_bench"
+
+#define NSEC_SCALE   (1000000000ull)
+#define BUF_SIZE     (65536)
+
+static const size_t sizes[] = { 64, 256, 1500, 65536 };
+
+static uint64_t total = 256 * 1024 * 1024;
+
+static inline uint64_t bench_now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return ts.tv_sec * NSEC_SCALE + ts.tv_nsec;
+}
+
+static void show_usage(void)
+{
+	fprintf(stderr,
+		"usage: " PROGNAME " [options]\n"
+		"\n"
+		"options:\n"
+		"    -m NUM     megabytes per size (default:256)\n"
+		"    -h         display this help\n");
+}
+
+/* returns the number of frames misjudged */
+static uint64_t run(uint8_t *buf, size_t len)
+{
+	struct pattern p;
+	uint64_t n, i, start, fill, verify, errors = 0;
+
+	n = total / len;
+	if (!n)
+		n = 1;
+
+	pattern_init(&p, 1);
+	start = bench_now();
+	for (i = 0; i < n; i++)
+		pattern_fill(&p, buf, len);
+	fill = bench_now() - start;
+
+	start = bench_now();
+	for (i = 0; i < n; i++)
+		if (!pattern_verify(buf, len))
+			errors++;
+	verify = bench_now() - start;
+
+	/* a flipped bit anywhere in a frame */
+	for (i = 0; i < 1000; i++) {
+		size_t bit = rand() % (len * 8);
+
+		pattern_fill(&p, buf, len);
+		buf[bit / 8] ^= 1 << (bit % 8);
+		if (pattern_verify(buf, len))
+			errors++;
+	}
+
+	printf("  %6zu bytes: fill %6.2f GB/s verify %6.2f GB/s\n", len,
+	       (double)n * len / fill, (double)n * len / verify);
+
+	return errors;
+}
+
+int main(int argc, char **argv)
+{
+	static const char *impls[] = { "sw", "hw" };
+	uint8_t *buf;
+	uint64_t errors = 0;
+	int c, i, j;
+
+	while ((c = getopt(argc, argv, "m:h")) != -1) {
+		switch (c) {
+		case 'm':
+			total = strtoull(optarg, NULL, 0) * 1024 * 1024;
+			break;
+		case 'h':
+		default:
+			show_usage();
+			return (c == 'h') ? 0 : -1;
+		}
+	}
+
+	buf = malloc(BUF_SIZE);
+	if (!buf) {
+		perror("cannot allocate buffer");
+		return -1;
+	}
+	srand(1);
+
+	/* "123456789" is the check value of CRC32C */
+	for (i = 0; i < 2; i++) {
+		if (crc32c_select(impls[i]) < 0) {
+			printf("crc32c %s  : not supported\n", impls[i]);
+			continue;
+		}
+		if (crc32c(0, "123456789", 9) != 0xe3069283)
+			errors++;
+
+		printf("crc32c %s  :\n", crc32c_name());
+		for (j = 0; j < (int)(sizeof(sizes) / sizeof(sizes[0])); j++)
+			errors += run(buf, sizes[j]);
+	}
+	crc32c_select("auto");
+
+	printf("mismatch   : %" PRIu64 " frames\n", errors);
+
+	free(buf);
+
+	return errors ? 1 : 0;
+}
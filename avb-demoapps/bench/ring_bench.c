@@ -0,0 +1,237 @@
+/*
+ * Copyright (c) 2014-2016 Renesas Electronics Corporation
+ * Released under the MIT license
+ * http://opensource.org/licenses/mit-license.php
+ */
+
+/*
+ * push/take benchmark of the entry ring of eavb_device over the
+ * loopback backend, entries handed in place from the ring (ring)
+ * against bounced through a staging buffer as the demos used to do
+ * with entryworkbuf (work). the wire is made instant so the ring
+ * handling and the backend calls are measured, the modes alternate
+ * and the best of the rounds is reported.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+#include <fcntl.h>
+#include <getopt.h>
+#include <sys/mman.h>
+
+#include "eavb.h"
+#include "eavb_device.h"
+
+#define PROGNAME "ring_bench"
+
+#define TALKER_DEV   "/dev/avb_tx1"
+#define FRAME_SIZE   (64)
+
+#define NSEC_SCALE   (1000000000ull)
+
+/* line rate of the loopback wire [Mbps], fast enough to take no time */
+#define WIRE_SPEED   "1000000000"
+
+static const int entrynums[] = { 256, 1024 };
+static const int batches[] = { 8, 32, 100 };
+
+#define ROUNDS       (5)
+
+/* staging buffer of the work mode, sized for the largest ring */
+static struct eavb_entry workbuf[1024];
+
+static inline uint64_t bench_now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return ts.tv_sec * NSEC_SCALE + ts.tv_nsec;
+}
+
+/*
+ * the take and push of eavb_device through entryworkbuf
+ */
+static int work_take_entry(struct eavb_device *dev, int count)
+{
+	struct eavb_entry *ring = dev->entrybuf;
+	int ret, tmp;
+
+	ret = eavb_ctx_take(dev->ctx, workbuf, count);
+	if (ret <= 0)
+		return ret;
+
+	if (dev->rp + ret > dev->entrynum) {
+		tmp = dev->entrynum - dev->rp;
+		memcpy(&ring[dev->rp], workbuf, tmp * sizeof(*ring));
+		memcpy(ring, &workbuf[tmp], (ret - tmp) * sizeof(*ring));
+	} else {
+		memcpy(&ring[dev->rp], workbuf, ret * sizeof(*ring));
+	}
+
+	dev->remain += ret;
+	dev->filled -= ret;
+	dev->rp = (dev->rp + ret) % dev->entrynum;
+
+	return ret;
+}
+
+static int work_push_entry(struct eavb_device *dev, int count)
+{
+	struct eavb_entry *ring = dev->entrybuf;
+	int ret, tmp;
+
+	if (dev->wp + count > dev->entrynum) {
+		tmp = dev->entrynum - dev->wp;
+		memcpy(workbuf, &ring[dev->wp], tmp * sizeof(*ring));
+		memcpy(&workbuf[tmp], ring, (count - tmp) * sizeof(*ring));
+		ret = eavb_ctx_push(dev->ctx, workbuf, count);
+	} else {
+		ret = eavb_ctx_push(dev->ctx, &ring[dev->wp], count);
+	}
+
+	if (ret <= 0)
+		return ret;
+
+	dev->remain -= ret;
+	dev->filled += ret;
+	dev->wp = (dev->wp + ret) % dev->entrynum;
+
+	return ret;
+}
+
+/*
+ * push and take batches of entries until total have been taken back,
+ * every entry must come back to the slot of the ring it was pushed from.
+ */
+static int bench_ring(int entrynum, int batch, int work, long total,
+		      double *rate)
+{
+	struct eavb_device *dev;
+	struct eavb_entry *e;
+	struct eavb_frame *p;
+	uint64_t start;
+	long taken = 0;
+	int i, n, ret = -1;
+
+	dev = eavb_device_new(TALKER_DEV, entrynum, O_RDWR);
+	if (!dev)
+		return -1;
+
+	if (eavb_device_alloc_frames(dev, FRAME_SIZE) < 0)
+		goto out;
+
+	for (i = 0, e = dev->entrybuf, p = dev->framebuf; i < entrynum;
+	     i++, e++, p++) {
+		e->vec[0].base = p->paddr;
+		e->vec[0].len = FRAME_SIZE;
+	}
+
+	if (work) {
+		dev->push_entry = work_push_entry;
+		dev->take_entry = work_take_entry;
+	}
+
+	start = bench_now();
+	while (taken < total) {
+		n = (dev->remain < batch) ? dev->remain : batch;
+		if (n && dev->push_entry(dev, n) < 0)
+			goto out;
+
+		n = (dev->filled < batch) ? dev->filled : batch;
+		if (n) {
+			n = dev->take_entry(dev, n);
+			if (n < 0)
+				goto out;
+			taken += n;
+		}
+	}
+	*rate = taken * (double)NSEC_SCALE / (bench_now() - start);
+
+	for (i = 0, e = dev->entrybuf, p = dev->framebuf; i < entrynum;
+	     i++, e++, p++) {
+		if (e->vec[0].base != p->paddr || e->vec[0].len != FRAME_SIZE) {
+			fprintf(stderr, PROGNAME ": entry %d of %d moved\n",
+				i, entrynum);
+			goto out;
+		}
+	}
+
+	ret = 0;
+out:
+	eavb_device_free(dev);
+
+	return ret;
+}
+
+static void usage(void)
+{
+	fprintf(stderr,
+		"usage: " PROGNAME " [-n ENTRIES]\n"
+		"  -n  entries taken back per measurement (default 1000000)\n");
+}
+
+int main(int argc, char **argv)
+{
+	char shmname[64];
+	double ring, work, rate;
+	long total = 1000000;
+	unsigned int i, j, r;
+	int c, ret = -1;
+
+	while ((c = getopt(argc, argv, "n:h")) != -1) {
+		switch (c) {
+		case 'n':
+			total = atol(optarg);
+			break;
+		default:
+			usage();
+			return (c == 'h') ? 0 : -1;
+		}
+	}
+
+	if (total <= 0) {
+		usage();
+		return -1;
+	}
+
+	/* private loopback segment for this run */
+	snprintf(shmname, sizeof(shmname), "/eavb_ring_bench.%d", getpid());
+	setenv("EAVB_LOOPBACK_NAME", shmname, 1);
+	setenv("EAVB_LOOPBACK_SPEED", WIRE_SPEED, 1);
+	eavb_set_backend("loopback");
+
+	printf("%8s %6s %14s %14s %8s\n",
+	       "entries", "batch", "ring[Mops/s]", "work[Mops/s]", "ratio");
+
+	for (i = 0; i < sizeof(entrynums) / sizeof(entrynums[0]); i++) {
+		for (j = 0; j < sizeof(batches) / sizeof(batches[0]); j++) {
+			ring = work = 0;
+			for (r = 0; r < ROUNDS * 2; r++) {
+				if (bench_ring(entrynums[i], batches[j], r & 1,
+					       total, &rate) < 0) {
+					fprintf(stderr, PROGNAME ": failed\n");
+					goto out;
+				}
+				if (r & 1)
+					work = (rate > work) ? rate : work;
+				else
+					ring = (rate > ring) ? rate : ring;
+			}
+
+			/* entries pushed and taken back per second */
+			printf("%8d %6d %14.2f %14.2f %8.2f\n",
+			       entrynums[i], batches[j],
+			       ring / 1e6, work / 1e6, ring / work);
+		}
+	}
+
+	ret = 0;
+out:
+	shm_unlink(shmname);
+
+	return ret;
+}
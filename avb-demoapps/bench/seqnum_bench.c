@@ -0,0 +1,203 @@
+/*
+ * Copyright (c) 2014-2016 Renesas Electronics Corporation
+ * Released under the MIT license
+ * http://opensource.org/licenses/mit-license.php
+ */
+
+/*
+ * benchmark of the per stream sequence number checker of simple_listener
+ *
+ * packets of many streams are interleaved with losses, swapped pairs
+ * and duplicates injected at random, and the counters of each stream
+ * are checked against what was injected. one loss in ten is longer
+ * than the 8-bit sequence number. exits 1 on any mismatch.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <getopt.h>
+#include <inttypes.h>
+
+#include "stats.h"
+
+#define PROGNAME "seqnum_bench"
+
+#define NSEC_SCALE   (1000000000ull)
+#define RUN          (8)    /* packets of a stream in a row */
+#define LOSS_MAX     (20)
+#define LONG_LOSS_MAX (1000)
+#define INTERVAL     (125000)  /* class A [ns] */
+
+struct sim_stream {
+	uint8_t  id[STATS_STREAMID_SIZE];
+	uint64_t next;
+	int64_t  pending;        /* held back to be swapped, -1:none */
+	uint64_t lost;
+	uint64_t reordered;
+	uint64_t duplicates;
+};
+
+static int streamnum = 48;
+static uint64_t packets = 10000000;
+static int permille = 5;
+
+static struct app_stats stats;
+static struct sim_stream *sims;
+
+static inline uint64_t bench_now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return ts.tv_sec * NSEC_SCALE + ts.tv_nsec;
+}
+
+static void show_usage(void)
+{
+	fprintf(stderr,
+		"usage: " PROGNAME " [options]\n"
+		"\n"
+		"options:\n"
+		"    -s NUM     number of streams (default:48, max:%d)\n"
+		"    -n NUM     number of packets (default:10000000)\n"
+		"    -e NUM     events per 1000 packets, each of loss,\n"
+		"               reorder and duplicate (default:5)\n"
+		"    -h         display this help\n", STATS_STREAM_MAX);
+}
+
+static inline void feed(struct sim_stream *sim, uint64_t n)
+{
+	struct stats_stream *st;
+
+	st = stats_stream_get(&stats, sim->id);
+	if (st)
+		stats_sequence(&stats, st, n, n * INTERVAL, true);
+}
+
+/* next packet of a stream with the events injected */
+static void send_one(struct sim_stream *sim)
+{
+	int r = rand() % 1000;
+	int n;
+
+	if (sim->pending >= 0) {
+		/* the later one went first */
+		feed(sim, sim->next++);
+		feed(sim, sim->pending);
+		sim->pending = -1;
+		sim->reordered++;
+		return;
+	}
+
+	if (r < permille) {
+		if (rand() % 10)
+			n = 1 + rand() % LOSS_MAX;
+		else
+			n = 1 + rand() % LONG_LOSS_MAX;
+		sim->next += n;
+		sim->lost += n;
+	} else if (r < 2 * permille) {
+		sim->pending = sim->next++;
+		return;
+	} else if (r < 3 * permille) {
+		feed(sim, sim->next);
+		sim->duplicates++;
+	}
+
+	feed(sim, sim->next++);
+}
+
+int main(int argc, char **argv)
+{
+	struct stats_stream *st;
+	uint64_t start, elapsed, sent = 0, errors = 0;
+	uint64_t lost = 0, others = 0;
+	int c, i, j;
+
+	while ((c = getopt(argc, argv, "s:n:e:h")) != -1) {
+		switch (c) {
+		case 's':
+			streamnum = atoi(optarg);
+			break;
+		case 'n':
+			packets = strtoull(optarg, NULL, 0);
+			break;
+		case 'e':
+			permille = atoi(optarg);
+			break;
+		case 'h':
+		default:
+			show_usage();
+			return (c == 'h') ? 0 : -1;
+		}
+	}
+
+	if (streamnum <= 0 || streamnum > STATS_STREAM_MAX ||
+	    permille < 0 || permille > 333) {
+		fprintf(stderr, PROGNAME ": invalid streams or events\n");
+		return -1;
+	}
+
+	sims = calloc(streamnum, sizeof(*sims));
+	if (!sims) {
+		perror("cannot allocate streams");
+		return -1;
+	}
+	srand(1);
+	for (i = 0; i < streamnum; i++) {
+		sims[i].id[0] = 0x02;
+		sims[i].id[5] = i;
+		sims[i].id[7] = 1;
+		sims[i].next = rand();
+		sims[i].pending = -1;
+
+		/*
+		 * a loss before the first packet is not seen, and the
+		 * interval is known from the first two in a row
+		 */
+		feed(&sims[i], sims[i].next++);
+		feed(&sims[i], sims[i].next++);
+	}
+
+	start = bench_now();
+	while (sent < packets) {
+		for (i = 0; i < streamnum; i++)
+			for (j = 0; j < RUN; j++)
+				send_one(&sims[i]);
+		sent += (uint64_t)streamnum * RUN;
+	}
+	elapsed = bench_now() - start;
+
+	for (i = 0; i < streamnum; i++) {
+		/* a swap left pending is the last packet, in order */
+		if (sims[i].pending >= 0)
+			feed(&sims[i], sims[i].pending);
+
+		st = stats_stream_get(&stats, sims[i].id);
+		if (!st || st->seq.lost != sims[i].lost ||
+		    st->seq.reordered != sims[i].reordered ||
+		    st->seq.duplicates != sims[i].duplicates ||
+		    st->seq.resyncs) {
+			errors++;
+			continue;
+		}
+		lost += sims[i].lost;
+		others += sims[i].reordered + sims[i].duplicates;
+	}
+
+	if (stats.dropped != lost || stats.errors != others)
+		errors++;
+
+	printf("streams    : %d, %" PRIu64 " packets, %.1f ns/packet\n",
+	       streamnum, sent, (double)elapsed / sent);
+	printf("detected   : dropped %" PRIu64 " errors %" PRIu64 "\n",
+	       stats.dropped, stats.errors);
+	printf("mismatch   : %" PRIu64 " streams\n", errors);
+
+	free(sims);
+
+	return errors ? 1 : 0;
+}
@@ -0,0 +1,562 @@
+/*
+ * Copyright (c) 2014-2016 Renesas Electronics Corporation
+ * Released under the MIT license
+ * http://opensource.org/licenses/mit-license.php
+ */
+
+/*
+ * end-to-end benchmark of simple_talker into simple_listener
+ * over the loopback backend of libeavb.
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <signal.h>
+#include <time.h>
+#include <fcntl.h>
+#include <getopt.h>
+#include <inttypes.h>
+#include <limits.h>
+#include <libgen.h>
+#include <stdbool.h>
+#include <pthread.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+#include <sys/mman.h>
+
+#include "eavb.h"
+#include "malloc_count.h"
+
+#define PROGNAME "simple_bench"
+
+#define TALKER_DEV   "/dev/avb_tx1"
+#define LISTENER_DEV "/dev/avb_rx0"
+
+#define NSEC_SCALE   (1000000000ull)
+
+#define MALLOC_COUNT_LIB "malloc_count.so"
+
+/* the listener output pipe stalls once per period */
+#define STALL_PERIOD_MS  (250)
+#define STALL_PIPE_SIZE  (4096)
+
+struct bench_config {
+	char     *dir;
+	char     *ifname;
+	char     *class;
+	char     *payload_size;
+	char     *intervals;
+	char     *speed;
+	char     *waitmode;
+	char     *latency;
+	char     *pace;
+	char     *interval;
+	char     *file;
+	char     *source;
+	bool     uncache;
+	bool     malloc_count;
+	int      stall;
+	bool     sync_write;
+	char     *backlog;
+	uint64_t framenums;
+	bool     sg;
+	bool     verbose;
+};
+
+struct bench_sink {
+	int       fd;
+	int       stall;
+	pthread_t thread;
+	uint64_t  bytes;
+	uint64_t  stalls;
+};
+
+struct bench_proc {
+	pid_t         pid;
+	struct rusage rusage;
+	int           status;
+};
+
+static void show_usage(void)
+{
+	fprintf(stderr,
+		"usage: " PROGNAME " [options]\n"
+		"\n"
+		"options:\n"
+		"    -d DIR     directory of simple_talker/simple_listener (default:.)\n"
+		"    -n NUM     number of frames (default:16000)\n"
+		"    -c SRCLASS SRClassID A/B/C (default:A)\n"
+		"    -s SIZE    payload size (default:100)\n"
+		"    -F NUM     MaxIntervalFrames (default:1)\n"
+		"    -S MBPS    link speed of the loopback (default:100)\n"
+		"    -w MODE    wait mode of talker and listener (default:0)\n"
+		"    -L USEC    latency target of talker and listener (default:0=off)\n"
+		"    -P USEC    talker pushes frames due every USEC (default:0=off)\n"
+		"    -T MS      talker and listener report statistics every MS\n"
+		"               (default:0=off, shown with -v)\n"
+		"    -g         talker sends header and payload as separate vectors\n"
+		"    -f FILE    talker source file (default:/dev/zero)\n"
+		"    -M MODE    talker file source mode (default:read)\n"
+		"    -D         drop FILE from the page cache before the run\n"
+		"    -A         fail on allocations in the streaming loops\n"
+		"    -o MS      listener writes into a pipe stalling MS every %dms\n"
+		"    -y         listener writes in its process loop\n"
+		"    -b NUM     frames held by the listener writer thread (default:1024)\n"
+		"    -i IFNAME  network interface for the talker MAC address (default:eth0)\n"
+		"    -v         show output of talker and listener\n"
+		"    -h         display this help\n", STALL_PERIOD_MS);
+}
+
+static inline uint64_t bench_now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return ts.tv_sec * NSEC_SCALE + ts.tv_nsec;
+}
+
+static inline uint64_t rusage_ns(struct rusage *ru)
+{
+	return (ru->ru_utime.tv_sec + ru->ru_stime.tv_sec) * NSEC_SCALE +
+		(ru->ru_utime.tv_usec + ru->ru_stime.tv_usec) * 1000ull;
+}
+
+static pid_t bench_spawn(struct bench_config *cfg, char **argv)
+{
+	pid_t pid;
+	int fd;
+
+	pid = fork();
+	if (pid < 0) {
+		perror("fork");
+		return -1;
+	}
+
+	if (!pid) {
+		if (!cfg->verbose) {
+			fd = open("/dev/null", O_WRONLY);
+			if (fd >= 0) {
+				dup2(fd, STDOUT_FILENO);
+				close(fd);
+			}
+		}
+		execv(argv[0], argv);
+		perror(argv[0]);
+		_exit(127);
+	}
+
+	return pid;
+}
+
+/*
+ * preload a library next to this program into talker and listener
+ *
+ * @lib      file name of library
+ */
+static int bench_preload(const char *lib)
+{
+	char self[PATH_MAX], path[PATH_MAX];
+	ssize_t len;
+
+	len = readlink("/proc/self/exe", self, sizeof(self) - 1);
+	if (len < 0) {
+		perror("readlink");
+		return -1;
+	}
+	self[len] = '\0';
+
+	snprintf(path, sizeof(path), "%s/%s", dirname(self), lib);
+	if (access(path, R_OK) < 0) {
+		perror(path);
+		return -1;
+	}
+
+	return setenv("LD_PRELOAD", path, 1);
+}
+
+/*
+ * report steady state allocations found by malloc_count
+ *
+ * @name     name of process
+ * @proc     process
+ */
+static bool bench_malloc_failed(const char *name, struct bench_proc *proc)
+{
+	if (!WIFEXITED(proc->status) ||
+	    WEXITSTATUS(proc->status) != MALLOC_COUNT_STATUS)
+		return false;
+
+	fprintf(stderr, PROGNAME ": %s allocated in the streaming loop\n",
+		name);
+
+	return true;
+}
+
+static void *bench_sink_thread(void *arg)
+{
+	struct bench_sink *sink = arg;
+	char buf[STALL_PIPE_SIZE];
+	uint64_t next;
+	ssize_t ret;
+
+	next = bench_now() + STALL_PERIOD_MS * 1000000ull;
+	while ((ret = read(sink->fd, buf, sizeof(buf))) > 0) {
+		sink->bytes += ret;
+		if (bench_now() < next)
+			continue;
+
+		/* the storage does not take data for a while */
+		usleep(sink->stall * 1000);
+		sink->stalls++;
+		next = bench_now() + STALL_PERIOD_MS * 1000000ull;
+	}
+
+	return NULL;
+}
+
+/*
+ * open pipe for the listener output, drained by a thread with stalls
+ *
+ * @sink     pipe reader
+ * @path     file name of the write side for the listener
+ * @len      size of path
+ */
+static int bench_sink_open(struct bench_sink *sink, char *path, int len)
+{
+	int fds[2];
+
+	if (pipe(fds) < 0) {
+		perror("pipe");
+		return -1;
+	}
+
+	/* a small pipe does not hide the stalls */
+	fcntl(fds[1], F_SETPIPE_SZ, STALL_PIPE_SIZE);
+	fcntl(fds[0], F_SETFD, FD_CLOEXEC);
+
+	sink->fd = fds[0];
+	if (pthread_create(&sink->thread, NULL, bench_sink_thread, sink)) {
+		fprintf(stderr, PROGNAME ": cannot create sink thread\n");
+		close(fds[0]);
+		close(fds[1]);
+		sink->fd = -1;
+		return -1;
+	}
+	snprintf(path, len, "/dev/fd/%d", fds[1]);
+
+	return fds[1];
+}
+
+static int bench_wait(struct bench_proc *proc, int timeout_ms)
+{
+	pid_t ret;
+	uint64_t deadline;
+
+	deadline = bench_now() + (uint64_t)timeout_ms * 1000000;
+
+	for (;;) {
+		ret = wait4(proc->pid, &proc->status, WNOHANG, &proc->rusage);
+		if (ret == proc->pid)
+			return 0;
+		if (ret < 0) {
+			perror("wait4");
+			return -1;
+		}
+		if (timeout_ms >= 0 && bench_now() > deadline)
+			return 1;
+		usleep(10000);
+	}
+}
+
+static int bench_wait_listener(int timeout_ms)
+{
+	struct eavb_loopback_stats stats;
+	int i;
+
+	for (i = 0; i < timeout_ms / 10; i++) {
+		if (!eavb_loopback_get_stats(LISTENER_DEV, &stats) &&
+		    stats.users && stats.pending)
+			return 0;
+		usleep(10000);
+	}
+
+	return -1;
+}
+
+/* write back and drop the pages of file from the page cache */
+static int bench_uncache(const char *file)
+{
+	int fd, ret;
+
+	fd = open(file, O_RDONLY);
+	if (fd < 0)
+		return -1;
+
+	fdatasync(fd);
+	ret = posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+	close(fd);
+
+	return ret ? -1 : 0;
+}
+
+int main(int argc, char **argv)
+{
+	struct bench_config cfg = {
+		.dir          = ".",
+		.ifname       = "eth0",
+		.class        = "A",
+		.payload_size = "100",
+		.intervals    = "1",
+		.speed        = "100",
+		.waitmode     = "0",
+		.latency      = "0",
+		.pace         = "0",
+		.interval     = "0",
+		.file         = "/dev/zero",
+		.source       = "read",
+		.framenums    = 16000,
+		.stall        = -1,
+		.backlog      = "1024",
+	};
+	struct bench_sink sink = { .fd = -1 };
+	char sinkpath[32];
+	struct bench_proc talker, listener;
+	struct eavb_loopback_stats tx, rx;
+	char shmname[64], frames[32];
+	char talker_path[PATH_MAX], listener_path[PATH_MAX];
+	uint64_t start, end, cpu;
+	double duration;
+	int c, ret = -1;
+
+	while ((c = getopt(argc, argv, "d:n:c:s:F:S:w:L:P:T:i:gf:M:DAo:yb:vh")) != -1) {
+		switch (c) {
+		case 'd':
+			cfg.dir = optarg;
+			break;
+		case 'n':
+			cfg.framenums = strtoull(optarg, NULL, 0);
+			break;
+		case 'c':
+			cfg.class = optarg;
+			break;
+		case 's':
+			cfg.payload_size = optarg;
+			break;
+		case 'F':
+			cfg.intervals = optarg;
+			break;
+		case 'S':
+			cfg.speed = optarg;
+			break;
+		case 'w':
+			cfg.waitmode = optarg;
+			break;
+		case 'L':
+			cfg.latency = optarg;
+			break;
+		case 'P':
+			cfg.pace = optarg;
+			break;
+		case 'T':
+			cfg.interval = optarg;
+			break;
+		case 'g':
+			cfg.sg = true;
+			break;
+		case 'f':
+			cfg.file = optarg;
+			break;
+		case 'M':
+			cfg.source = optarg;
+			break;
+		case 'D':
+			cfg.uncache = true;
+			break;
+		case 'A':
+			cfg.malloc_count = true;
+			break;
+		case 'o':
+			cfg.stall = atoi(optarg);
+			break;
+		case 'y':
+			cfg.sync_write = true;
+			break;
+		case 'b':
+			cfg.backlog = optarg;
+			break;
+		case 'i':
+			cfg.ifname = optarg;
+			break;
+		case 'v':
+			cfg.verbose = true;
+			break;
+		case 'h':
+		default:
+			show_usage();
+			return (c == 'h') ? 0 : -1;
+		}
+	}
+
+	if (!cfg.framenums) {
+		fprintf(stderr, PROGNAME ": specify number of frames\n");
+		return -1;
+	}
+
+	/* private loopback segment for this run */
+	snprintf(shmname, sizeof(shmname), "/eavb_bench.%d", getpid());
+	setenv("EAVB_BACKEND", "loopback", 1);
+	setenv("EAVB_LOOPBACK_NAME", shmname, 1);
+	setenv("EAVB_LOOPBACK_SPEED", cfg.speed, 1);
+	eavb_set_backend("loopback");
+
+	if (cfg.malloc_count && bench_preload(MALLOC_COUNT_LIB) < 0)
+		return -1;
+
+	snprintf(frames, sizeof(frames), "%" PRIu64, cfg.framenums);
+	snprintf(talker_path, sizeof(talker_path), "%s/simple_talker", cfg.dir);
+	snprintf(listener_path, sizeof(listener_path), "%s/simple_listener",
+		 cfg.dir);
+
+	{
+		char *argv_listener[] = {
+			listener_path,
+			"-m", "0",
+			"-d", LISTENER_DEV,
+			"-p", "CLOCK_MONOTONIC",
+			"-n", frames,
+			"-w", cfg.waitmode,
+			"--latency-target", cfg.latency,
+			"--write-backlog", cfg.backlog,
+			"--stats-interval", cfg.interval,
+			cfg.stall >= 0 ? "-f" : NULL, sinkpath,
+			cfg.sync_write ? "--sync-write" : NULL,
+			NULL,
+		};
+		int fd = -1;
+
+		if (cfg.stall >= 0) {
+			sink.stall = cfg.stall;
+			fd = bench_sink_open(&sink, sinkpath, sizeof(sinkpath));
+			if (fd < 0)
+				goto out;
+		}
+
+		listener.pid = bench_spawn(&cfg, argv_listener);
+		/* the listener has the only write side */
+		if (fd >= 0)
+			close(fd);
+		if (listener.pid < 0)
+			goto out;
+	}
+
+	if (bench_wait_listener(5000) < 0) {
+		fprintf(stderr, PROGNAME ": listener did not start\n");
+		kill(listener.pid, SIGKILL);
+		bench_wait(&listener, -1);
+		goto out;
+	}
+
+	if (cfg.uncache && bench_uncache(cfg.file) < 0)
+		fprintf(stderr, PROGNAME ": cannot drop %s from cache\n",
+			cfg.file);
+
+	start = bench_now();
+
+	{
+		char *argv_talker[] = {
+			talker_path,
+			"-m", "0",
+			"-p", "CLOCK_MONOTONIC",
+			"-f", cfg.file,
+			"-i", cfg.ifname,
+			"-c", cfg.class,
+			"-s", cfg.payload_size,
+			"-F", cfg.intervals,
+			"-S", cfg.speed,
+			"-w", cfg.waitmode,
+			"--latency-target", cfg.latency,
+			"--file-source", cfg.source,
+			"--pace", cfg.pace,
+			"--stats-interval", cfg.interval,
+			"-n", frames,
+			cfg.sg ? "-g" : NULL,
+			NULL,
+		};
+
+		talker.pid = bench_spawn(&cfg, argv_talker);
+		if (talker.pid < 0) {
+			kill(listener.pid, SIGKILL);
+			bench_wait(&listener, -1);
+			goto out;
+		}
+	}
+
+	bench_wait(&talker, -1);
+
+	/* the listener stops by itself once all frames arrived */
+	if (bench_wait(&listener, 2000) > 0) {
+		kill(listener.pid, SIGINT);
+		bench_wait(&listener, -1);
+	}
+	end = bench_now();
+
+	if (sink.fd >= 0) {
+		pthread_join(sink.thread, NULL);
+		close(sink.fd);
+		printf("sink       : %" PRIu64 " bytes, %" PRIu64
+		       " stalls of %d ms\n", sink.bytes, sink.stalls,
+		       sink.stall);
+		sink.fd = -1;
+	}
+
+	if (eavb_loopback_get_stats(TALKER_DEV, &tx) < 0 ||
+	    eavb_loopback_get_stats(LISTENER_DEV, &rx) < 0)
+		goto out;
+
+	if (cfg.malloc_count) {
+		bool failed;
+
+		failed = bench_malloc_failed("talker", &talker);
+		failed |= bench_malloc_failed("listener", &listener);
+		if (failed)
+			goto out;
+	}
+
+	if (!WIFEXITED(talker.status) || WEXITSTATUS(talker.status))
+		fprintf(stderr, PROGNAME ": talker failed (status %d)\n",
+			talker.status);
+
+	duration = (double)(end - start) / NSEC_SCALE;
+	cpu = rusage_ns(&talker.rusage) + rusage_ns(&listener.rusage);
+
+	printf("frames     : tx %" PRIu64 " rx %" PRIu64
+	       " dropped %" PRIu64 " overrun %" PRIu64 "\n",
+	       tx.frames, rx.frames, tx.dropped, rx.dropped);
+	printf("throughput : %.6f Mpps (%.3fs)\n",
+	       rx.frames / duration / 1000000, duration);
+	if (rx.frames) {
+		printf("cpu/packet : %" PRIu64 " ns (talker %" PRIu64
+		       " ns, listener %" PRIu64 " ns)\n",
+		       cpu / rx.frames,
+		       rusage_ns(&talker.rusage) / rx.frames,
+		       rusage_ns(&listener.rusage) / rx.frames);
+	}
+	if (rx.latency_count) {
+		printf("latency    : avg %.1f us, max %.1f us\n",
+		       (double)rx.latency_total / rx.latency_count / 1000,
+		       (double)rx.latency_max / 1000);
+	}
+
+	ret = 0;
+
+out:
+	shm_unlink(shmname);
+
+	return ret;
+}
@@ -0,0 +1,158 @@
+/*
+ * Copyright (c) 2014-2016 Renesas Electronics Corporation
+ * Released under the MIT license
+ * http://opensource.org/licenses/mit-license.php
+ */
+
+/*
+ * simulation of the media timeline of lib/avtp
+ *
+ * frames of several stream rates are stamped incrementally for a day
+ * of media time and checked against the exact time of each frame at
+ * checkpoints. the drift of a whole nanosecond step, as simple_talker
+ * stamped before, is shown for comparison. exits 1 on any mismatch.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <getopt.h>
+#include <inttypes.h>
+#include <stdbool.h>
+
+#include "avtp_timeline.h"
+
+#define PROGNAME "timeline_bench"
+
+#define NSEC_SCALE   (1000000000ull)
+#define CHECK_MASK   ((1ull << 20) - 1)
+
+/* a PTP time of the 2020s */
+#define START_TIME   (1700000000ull * NSEC_SCALE + 123456789)
+
+static const struct {
+	const char *name;
+	uint64_t   rate;
+	uint64_t   per;
+} streams[] = {
+	{ "class A",            8000,  1 },
+	{ "class B",            4000,  1 },
+	{ "class A x3",        24000,  1 },
+	{ "48kHz/6",           48000,  6 },
+	{ "44.1kHz/6",         44100,  6 },
+	{ "44.1kHz/7",         44100,  7 },
+	{ "29.97fps",          30000, 1001 },
+};
+
+static int hours = 24;
+
+static inline uint64_t bench_now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return ts.tv_sec * NSEC_SCALE + ts.tv_nsec;
+}
+
+static void show_usage(void)
+{
+	fprintf(stderr,
+		"usage: " PROGNAME " [options]\n"
+		"\n"
+		"options:\n"
+		"    -H HOURS   simulated media time (default:24)\n"
+		"    -h         display this help\n");
+}
+
+static bool check(struct avtp_timeline *tl, uint64_t n, uint64_t t)
+{
+	/* frame n is the last one earlier than t + 1 */
+	return t == avtp_timeline_at(tl, n) &&
+		avtp_timeline_count(tl, t + 1) == n + 1 &&
+		avtp_timeline_count(tl, t) == n;
+}
+
+static int run(int idx)
+{
+	struct avtp_timeline tl;
+	uint64_t frames, n, t, prev, start, elapsed;
+	uint64_t errors = 0, delta;
+	int64_t drift;
+
+	if (avtp_timeline_init(&tl, streams[idx].rate, streams[idx].per) < 0)
+		return -1;
+
+	frames = hours * 3600ull * streams[idx].rate / streams[idx].per;
+
+	avtp_timeline_anchor(&tl, START_TIME);
+
+	start = bench_now();
+	prev = avtp_timeline_next(&tl);
+	for (n = 1; n < frames; n++) {
+		t = avtp_timeline_next(&tl);
+
+		/* every period is the whole step or a nanosecond more */
+		delta = t - prev;
+		if (delta != tl.step && delta != tl.step + 1)
+			errors++;
+		prev = t;
+
+		if (!(n & CHECK_MASK) && !check(&tl, n, t))
+			errors++;
+	}
+	elapsed = bench_now() - start;
+
+	if (!check(&tl, frames - 1, prev))
+		errors++;
+
+	/* timeline after exactly the simulated time */
+	t = avtp_timeline_peek(&tl) - START_TIME;
+	if (!((hours * 3600ull * streams[idx].rate) % streams[idx].per) &&
+	    t != hours * 3600ull * NSEC_SCALE)
+		errors++;
+
+	/* stamped by a whole nanosecond step from the start */
+	drift = (int64_t)(avtp_timeline_at(&tl, frames) - START_TIME) -
+		(int64_t)(frames * tl.step);
+
+	printf("%-12s %12" PRIu64 " %10" PRIu64 ".%02" PRIu64
+	       " %8.2f %12" PRIu64 " %14.1f\n",
+	       streams[idx].name, frames, tl.step,
+	       tl.step_frac * 100 / tl.rate,
+	       (double)elapsed / frames, errors, (double)drift / 1000);
+
+	return errors ? -1 : 0;
+}
+
+int main(int argc, char **argv)
+{
+	int c, i, ret = 0;
+
+	while ((c = getopt(argc, argv, "H:h")) != -1) {
+		switch (c) {
+		case 'H':
+			hours = atoi(optarg);
+			break;
+		case 'h':
+		default:
+			show_usage();
+			return (c == 'h') ? 0 : -1;
+		}
+	}
+
+	if (hours <= 0) {
+		fprintf(stderr, PROGNAME ": invalid hours\n");
+		return -1;
+	}
+
+	printf("%d hours of frames\n", hours);
+	printf("%-12s %12s %13s %8s %12s %14s\n", "stream", "frames",
+	       "period[ns]", "ns/frame", "errors", "int drift[us]");
+
+	for (i = 0; i < sizeof(streams) / sizeof(streams[0]); i++)
+		if (run(i) < 0)
+			ret = 1;
+
+	return ret;
+}
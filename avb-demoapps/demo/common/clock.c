@@ -11,12 +11,135 @@
 #include <unistd.h>
 #include <sys/ioctl.h>
 #include <fcntl.h>
+#include <inttypes.h>
 
 #include "clock.h"
 
 #define ARRAY_SIZE(a) (sizeof(a)/sizeof(a[0]))
 #define NSEC_SCALE (1000000000)
 
+#define CLOCK_CAL_SAMPLES (5)
+/* a prediction error beyond this is a step of the clock */
+#define CLOCK_CAL_STEP    (1000000ull)
+
+static inline uint64_t ptp_time_ns(struct ptp_clock_time *t)
+{
+	return (uint64_t)t->sec * NSEC_SCALE + t->nsec;
+}
+
+/*
+ * offset of CLOCK_REALTIME from CLOCK_MONOTONIC_RAW, the system
+ * timestamps of PTP_SYS_OFFSET(_EXTENDED) are CLOCK_REALTIME
+ */
+static void clock_cal_realtime_offset(uint64_t *offset, uint64_t *err)
+{
+	uint64_t a, b, t;
+	int i;
+
+	*err = UINT64_MAX;
+	for (i = 0; i < CLOCK_CAL_SAMPLES; i++) {
+		a = clock_getcount(CLOCK_MONOTONIC_RAW);
+		t = clock_getcount(CLOCK_REALTIME);
+		b = clock_getcount(CLOCK_MONOTONIC_RAW);
+		if ((b - a) / 2 < *err) {
+			*err = (b - a) / 2;
+			*offset = t - (a + (b - a) / 2);
+		}
+	}
+}
+
+/*
+ * take a correlation of the clock with CLOCK_MONOTONIC_RAW
+ *
+ * @cal      calibrated time source
+ * @raw      CLOCK_MONOTONIC_RAW [ns]
+ * @clk      the clock at raw [ns]
+ * @err      uncertainty of the correlation [ns]
+ */
+static int clock_cal_sample(struct clock_cal *cal, uint64_t *raw,
+			    uint64_t *clk, uint64_t *err)
+{
+	struct ptp_sys_offset_precise precise;
+	struct ptp_sys_offset_extended extended;
+	struct ptp_sys_offset offset;
+	uint64_t a, b, t, rtoffset, rterr;
+	int fd = get_clockfd(cal->clkid);
+	int i;
+
+	*err = UINT64_MAX;
+
+	switch (cal->method) {
+	case CLOCK_CAL_PRECISE:
+		/* cross timestamp by the hardware */
+		memset(&precise, 0, sizeof(precise));
+		if (ioctl(fd, PTP_SYS_OFFSET_PRECISE, &precise))
+			return -1;
+		*raw = ptp_time_ns(&precise.sys_monoraw);
+		*clk = ptp_time_ns(&precise.device);
+		*err = 0;
+		break;
+	case CLOCK_CAL_EXTENDED:
+		memset(&extended, 0, sizeof(extended));
+		extended.n_samples = CLOCK_CAL_SAMPLES;
+		if (ioctl(fd, PTP_SYS_OFFSET_EXTENDED, &extended))
+			return -1;
+		clock_cal_realtime_offset(&rtoffset, &rterr);
+		for (i = 0; i < extended.n_samples; i++) {
+			a = ptp_time_ns(&extended.ts[i][0]);
+			b = ptp_time_ns(&extended.ts[i][2]);
+			if ((b - a) / 2 >= *err)
+				continue;
+			*err = (b - a) / 2;
+			*raw = a + (b - a) / 2 - rtoffset;
+			*clk = ptp_time_ns(&extended.ts[i][1]);
+		}
+		*err += rterr;
+		break;
+	case CLOCK_CAL_OFFSET:
+		memset(&offset, 0, sizeof(offset));
+		offset.n_samples = CLOCK_CAL_SAMPLES;
+		if (ioctl(fd, PTP_SYS_OFFSET, &offset))
+			return -1;
+		clock_cal_realtime_offset(&rtoffset, &rterr);
+		for (i = 0; i < offset.n_samples; i++) {
+			a = ptp_time_ns(&offset.ts[2 * i]);
+			b = ptp_time_ns(&offset.ts[2 * i + 2]);
+			if ((b - a) / 2 >= *err)
+				continue;
+			*err = (b - a) / 2;
+			*raw = a + (b - a) / 2 - rtoffset;
+			*clk = ptp_time_ns(&offset.ts[2 * i + 1]);
+		}
+		*err += rterr;
+		break;
+	case CLOCK_CAL_GETTIME:
+		for (i = 0; i < CLOCK_CAL_SAMPLES; i++) {
+			a = clock_getcount(CLOCK_MONOTONIC_RAW);
+			t = clock_getcount(cal->clkid);
+			b = clock_getcount(CLOCK_MONOTONIC_RAW);
+			if ((b - a) / 2 >= *err)
+				continue;
+			*err = (b - a) / 2;
+			*raw = a + (b - a) / 2;
+			*clk = t;
+		}
+		break;
+	default:
+		return -1;
+	}
+
+	return 0;
+}
+
+static inline uint64_t clock_cal_interpolate(struct clock_cal *cal,
+					     uint64_t raw)
+{
+	unsigned int last = (cal->samples - 1) % CLOCK_CAL_HISTORY;
+	int64_t delta = raw - cal->raw[last];
+
+	return cal->clk[last] + delta + (int64_t)(delta * cal->ratio);
+}
+
 /*
  * public functions
  */
@@ -83,3 +206,159 @@ uint64_t clock_getcount(clockid_t clk_id)
 
 	return t;
 }
+
+/*
+ * initialize calibrated time source
+ *
+ * @cal      calibrated time source
+ * @clk_id   clock to be read
+ * @interval calibration interval [ns], 0 reads the clock directly
+ *
+ * PTP clocks are correlated by the most precise ioctl the driver
+ * supports, other clocks by clock_gettime() between two raw reads.
+ */
+int clock_cal_init(struct clock_cal *cal, clockid_t clk_id,
+		   uint64_t interval)
+{
+	static const enum clock_cal_method methods[] = {
+		CLOCK_CAL_PRECISE,
+		CLOCK_CAL_EXTENDED,
+		CLOCK_CAL_OFFSET,
+		CLOCK_CAL_GETTIME,
+	};
+	int i;
+
+	memset(cal, 0, sizeof(*cal));
+	cal->clkid = clk_id;
+	cal->interval = interval;
+	cal->method = CLOCK_CAL_DIRECT;
+
+	if (!interval)
+		return 0;
+
+	for (i = clock_is_fd(clk_id) ? 0 : ARRAY_SIZE(methods) - 1;
+	     i < ARRAY_SIZE(methods); i++) {
+		cal->method = methods[i];
+		if (!clock_cal_calibrate(cal))
+			return 0;
+	}
+
+	fprintf(stderr, "cannot calibrate clock, read it directly\n");
+	cal->method = CLOCK_CAL_DIRECT;
+
+	return -1;
+}
+
+/*
+ * correlate the clock with CLOCK_MONOTONIC_RAW again
+ *
+ * @cal      calibrated time source
+ */
+int clock_cal_calibrate(struct clock_cal *cal)
+{
+	uint64_t raw, clk, err, residual = 0;
+	unsigned int first, last;
+
+	if (clock_cal_sample(cal, &raw, &clk, &err) < 0) {
+		cal->failures++;
+		return -1;
+	}
+
+	if (cal->samples) {
+		residual = llabs((int64_t)(clk - clock_cal_interpolate(cal,
+								       raw)));
+		if (residual > CLOCK_CAL_STEP) {
+			/* the clock was set, measure the rate again */
+			cal->steps++;
+			cal->samples = 0;
+			cal->ratio = 0;
+			residual = 0;
+		}
+	}
+
+	last = cal->samples % CLOCK_CAL_HISTORY;
+	cal->raw[last] = raw;
+	cal->clk[last] = clk;
+	cal->samples++;
+
+	if (cal->samples > 1) {
+		first = cal->samples > CLOCK_CAL_HISTORY ?
+			cal->samples % CLOCK_CAL_HISTORY : 0;
+		if (raw != cal->raw[first])
+			cal->ratio = (double)(int64_t)((clk - cal->clk[first]) -
+						       (raw - cal->raw[first])) /
+				(raw - cal->raw[first]);
+	}
+
+	cal->calibrations++;
+	if (err > cal->window_max)
+		cal->window_max = err;
+	if (residual > cal->residual_max)
+		cal->residual_max = residual;
+
+	/* the last prediction error is expected again by the next one */
+	cal->error = err + residual;
+
+	return 0;
+}
+
+/*
+ * read calibrated time source
+ *
+ * @cal      calibrated time source
+ */
+uint64_t clock_cal_getcount(struct clock_cal *cal)
+{
+	uint64_t raw;
+
+	if (cal->method == CLOCK_CAL_DIRECT)
+		return clock_getcount(cal->clkid);
+
+	raw = clock_getcount(CLOCK_MONOTONIC_RAW);
+	if (raw - cal->raw[(cal->samples - 1) % CLOCK_CAL_HISTORY] >=
+	    cal->interval && !clock_cal_calibrate(cal))
+		raw = clock_getcount(CLOCK_MONOTONIC_RAW);
+
+	return clock_cal_interpolate(cal, raw);
+}
+
+const char *clock_cal_method_name(enum clock_cal_method method)
+{
+	static const char * const names[] = {
+		[CLOCK_CAL_DIRECT]   = "direct",
+		[CLOCK_CAL_PRECISE]  = "precise",
+		[CLOCK_CAL_EXTENDED] = "extended",
+		[CLOCK_CAL_OFFSET]   = "offset",
+		[CLOCK_CAL_GETTIME]  = "gettime",
+	};
+
+	if (method < 0 || method >= ARRAY_SIZE(names))
+		return "unknown";
+
+	return names[method];
+}
+
+/*
+ * report calibration
+ *
+ * @cal      calibrated time source
+ * @buf      output buffer
+ * @buflen   size of output buffer
+ */
+void clock_cal_report(struct clock_cal *cal, char *buf, int buflen)
+{
+	if (cal->method == CLOCK_CAL_DIRECT) {
+		snprintf(buf, buflen, "clock read directly");
+		return;
+	}
+
+	snprintf(buf, buflen,
+		 "clock %s every %" PRIu64 " ms, %" PRIu64 " calibrations"
+		 " (failed %" PRIu64 " steps %" PRIu64 ") rate %+.3f ppm"
+		 " error %" PRIu64 " ns window max %" PRIu64 " ns"
+		 " residual max %" PRIu64 " ns",
+		 clock_cal_method_name(cal->method), cal->interval / 1000000,
+		 cal->calibrations, cal->failures, cal->steps,
+		 cal->ratio * 1000000, cal->error, cal->window_max,
+		 cal->residual_max);
+}
@@ -8,6 +8,7 @@
 #define __CLOCK_H__
 
 #include <stdint.h>
+#include <stdbool.h>
 #include <time.h>
 #include <linux/ptp_clock.h>
 
@@ -27,7 +28,60 @@ static inline int get_clockfd(clockid_t clk_id)
 	return (int)~((clk_id & ~((clockid_t)CLOCKFD)) >> 3);
 }
 
+/* dynamic posix clock of a PTP device, read by a system call */
+static inline bool clock_is_fd(clockid_t clk_id)
+{
+	return clk_id < 0 && (clk_id & CLOCKFD) == CLOCKFD;
+}
+
+#define CLOCK_CAL_HISTORY (8)
+
+enum clock_cal_method {
+	CLOCK_CAL_DIRECT,	/* clock_gettime() on every read */
+	CLOCK_CAL_PRECISE,	/* PTP_SYS_OFFSET_PRECISE */
+	CLOCK_CAL_EXTENDED,	/* PTP_SYS_OFFSET_EXTENDED */
+	CLOCK_CAL_OFFSET,	/* PTP_SYS_OFFSET */
+	CLOCK_CAL_GETTIME,	/* clock_gettime() between two raw reads */
+};
+
+/*
+ * calibrated time source
+ *
+ * the clock is correlated with CLOCK_MONOTONIC_RAW every interval and
+ * read in between by interpolation from the raw clock, which is served
+ * by the vDSO. the rate is measured over the last CLOCK_CAL_HISTORY
+ * calibrations so that frequency adjustments of the PTP servo are
+ * followed.
+ */
+struct clock_cal {
+	clockid_t             clkid;
+	enum clock_cal_method method;
+	uint64_t              interval;  /* calibration interval [ns] */
+
+	/* correlations (raw, clock) of the last calibrations */
+	uint64_t              raw[CLOCK_CAL_HISTORY];
+	uint64_t              clk[CLOCK_CAL_HISTORY];
+	unsigned int          samples;
+	double                ratio;     /* clock rate - 1 against raw */
+
+	/* error bound of the interpolation [ns] */
+	uint64_t              error;
+
+	/* telemetry */
+	uint64_t              calibrations;
+	uint64_t              failures;
+	uint64_t              steps;
+	uint64_t              window_max;   /* sample uncertainty [ns] */
+	uint64_t              residual_max; /* prediction error [ns] */
+};
+
 clockid_t clock_parse(char *name);
 extern uint64_t clock_getcount(clockid_t clk_id);
+extern int clock_cal_init(struct clock_cal *cal, clockid_t clk_id,
+			  uint64_t interval);
+extern int clock_cal_calibrate(struct clock_cal *cal);
+extern uint64_t clock_cal_getcount(struct clock_cal *cal);
+extern const char *clock_cal_method_name(enum clock_cal_method method);
+extern void clock_cal_report(struct clock_cal *cal, char *buf, int buflen);
 
 #endif /* __CLOCK_H_ */
@@ -0,0 +1,179 @@
+/*
+ * Copyright (c) 2014-2016 Renesas Electronics Corporation
+ * Released under the MIT license
+ * http://opensource.org/licenses/mit-license.php
+ */
+
+#include <string.h>
+#include <endian.h>
+
+#if defined(__x86_64__)
+#include <nmmintrin.h>
+#elif defined(__aarch64__)
+#include <arm_acle.h>
+#include <sys/auxv.h>
+#include <asm/hwcap.h>
+#endif
+
+#include "crc32c.h"
+
+/* reversed polynomial of Castagnoli */
+#define CRC32C_POLY (0x82f63b78)
+
+typedef uint32_t (*crc32c_func)(uint32_t crc, const uint8_t *p, size_t len);
+
+static uint32_t crc32c_table[8][256];
+
+/* slicing by 8 bytes */
+static uint32_t crc32c_sw(uint32_t crc, const uint8_t *p, size_t len)
+{
+	uint32_t (*t)[256] = crc32c_table;
+	uint64_t v;
+
+	while (len && ((uintptr_t)p & 7)) {
+		crc = t[0][(crc ^ *p++) & 0xff] ^ (crc >> 8);
+		len--;
+	}
+
+	for (; len >= 8; p += 8, len -= 8) {
+		memcpy(&v, p, sizeof(v));
+		v = le64toh(v) ^ crc;
+		crc = t[7][v & 0xff] ^ t[6][(v >> 8) & 0xff] ^
+			t[5][(v >> 16) & 0xff] ^ t[4][(v >> 24) & 0xff] ^
+			t[3][(v >> 32) & 0xff] ^ t[2][(v >> 40) & 0xff] ^
+			t[1][(v >> 48) & 0xff] ^ t[0][v >> 56];
+	}
+
+	while (len--)
+		crc = t[0][(crc ^ *p++) & 0xff] ^ (crc >> 8);
+
+	return crc;
+}
+
+#if defined(__x86_64__)
+__attribute__((target("sse4.2")))
+static uint32_t crc32c_hw(uint32_t crc, const uint8_t *p, size_t len)
+{
+	uint64_t c = crc, v;
+
+	while (len && ((uintptr_t)p & 7)) {
+		c = _mm_crc32_u8(c, *p++);
+		len--;
+	}
+
+	for (; len >= 8; p += 8, len -= 8) {
+		memcpy(&v, p, sizeof(v));
+		c = _mm_crc32_u64(c, v);
+	}
+
+	while (len--)
+		c = _mm_crc32_u8(c, *p++);
+
+	return c;
+}
+
+static inline int crc32c_hw_supported(void)
+{
+	return __builtin_cpu_supports("sse4.2");
+}
+#elif defined(__aarch64__)
+__attribute__((target("+crc")))
+static uint32_t crc32c_hw(uint32_t crc, const uint8_t *p, size_t len)
+{
+	uint64_t v;
+
+	while (len && ((uintptr_t)p & 7)) {
+		crc = __crc32cb(crc, *p++);
+		len--;
+	}
+
+	for (; len >= 8; p += 8, len -= 8) {
+		memcpy(&v, p, sizeof(v));
+		crc = __crc32cd(crc, v);
+	}
+
+	while (len--)
+		crc = __crc32cb(crc, *p++);
+
+	return crc;
+}
+
+static inline int crc32c_hw_supported(void)
+{
+	return !!(getauxval(AT_HWCAP) & HWCAP_CRC32);
+}
+#else
+#define crc32c_hw crc32c_sw
+
+static inline int crc32c_hw_supported(void)
+{
+	return 0;
+}
+#endif
+
+static crc32c_func crc32c_impl = crc32c_sw;
+
+__attribute__((constructor))
+static void crc32c_init(void)
+{
+	uint32_t c;
+	int i, j;
+
+	for (i = 0; i < 256; i++) {
+		c = i;
+		for (j = 0; j < 8; j++)
+			c = (c >> 1) ^ (c & 1 ? CRC32C_POLY : 0);
+		crc32c_table[0][i] = c;
+	}
+
+	for (i = 0; i < 256; i++)
+		for (j = 1; j < 8; j++)
+			crc32c_table[j][i] = (crc32c_table[j - 1][i] >> 8) ^
+				crc32c_table[0][crc32c_table[j - 1][i] & 0xff];
+
+	crc32c_select("auto");
+}
+
+/*
+ * compute CRC32C
+ *
+ * @crc      CRC32C of the data before, 0 at first
+ * @buf      data
+ * @len      length of data
+ */
+uint32_t crc32c(uint32_t crc, const void *buf, size_t len)
+{
+	return ~crc32c_impl(~crc, buf, len);
+}
+
+/*
+ * select implementation
+ *
+ * @name     auto, hw or sw
+ *
+ * returns -1 if the CPU has no CRC32 instructions for hw.
+ */
+int crc32c_select(const char *name)
+{
+	if (!strcmp(name, "sw")) {
+		crc32c_impl = crc32c_sw;
+	} else if (!strcmp(name, "hw")) {
+		if (!crc32c_hw_supported())
+			return -1;
+		crc32c_impl = crc32c_hw;
+	} else if (!strcmp(name, "auto")) {
+		crc32c_impl = crc32c_hw_supported() ? crc32c_hw : crc32c_sw;
+	} else {
+		return -1;
+	}
+
+	return 0;
+}
+
+const char *crc32c_name(void)
+{
+	if (crc32c_impl != crc32c_sw)
+		return "hw";
+
+	return "sw";
+}
@@ -0,0 +1,23 @@
+/*
+ * Copyright (c) 2014-2016 Renesas Electronics Corporation
+ * Released under the MIT license
+ * http://opensource.org/licenses/mit-license.php
+ */
+
+#ifndef __CRC32C_H__
+#define __CRC32C_H__
+
+#include <stdint.h>
+#include <stddef.h>
+
+/*
+ * CRC32C (Castagnoli)
+ *
+ * computed by the CRC32 instructions of SSE4.2 or ARMv8 when the CPU
+ * has them, by tables otherwise.
+ */
+extern uint32_t crc32c(uint32_t crc, const void *buf, size_t len);
+extern int crc32c_select(const char *name);
+extern const char *crc32c_name(void);
+
+#endif /* __CRC32C_H__ */
@@ -0,0 +1,203 @@
+/*
+ * Copyright (c) 2014-2016 Renesas Electronics Corporation
+ * Released under the MIT license
+ * http://opensource.org/licenses/mit-license.php
+ */
+
+#include <stdio.h>
+#include <time.h>
+#include <inttypes.h>
+
+#include "depth_ctl.h"
+
+#define NSEC_SCALE (1000000000ull)
+
+static inline uint64_t depth_ctl_now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return ts.tv_sec * NSEC_SCALE + ts.tv_nsec;
+}
+
+static inline int clamp(int value, int min, int max)
+{
+	if (value < min)
+		return min;
+	if (value > max)
+		return max;
+	return value;
+}
+
+static void depth_ctl_update_limit(struct depth_ctl *ctl)
+{
+	int frames;
+
+	frames = ctl->target / ctl->interval;
+
+	if (ctl->tx) {
+		/* keep two entries in flight at least to avoid underrun */
+		ctl->limit = clamp(frames, 2, ctl->entrynum);
+		ctl->batch = clamp(ctl->batch, 1, ctl->limit);
+	} else {
+		ctl->limit = ctl->entrynum;
+		ctl->batch = clamp(frames, 1, ctl->entrynum / 2);
+	}
+}
+
+/*
+ * initialize depth controller
+ *
+ * @ctl      depth controller
+ * @tx       true on Talker
+ * @entrynum number of entries of the ring
+ * @target   latency target [ns], 0 disables the controller
+ * @interval frame interval of the stream [ns]
+ * @estimate estimate the interval from taken entries
+ */
+void depth_ctl_init(struct depth_ctl *ctl, bool tx, int entrynum,
+		    uint64_t target, uint64_t interval, bool estimate)
+{
+	ctl->tx = tx;
+	ctl->entrynum = entrynum;
+	ctl->target = target;
+	ctl->interval = interval ? interval : 1;
+	ctl->estimate = estimate;
+	ctl->last = 0;
+	ctl->limit = entrynum;
+	ctl->batch = (entrynum / 8) ? entrynum / 8 : 1;
+
+	ctl->samples = 0;
+	ctl->depth_total = 0;
+	ctl->depth_max = 0;
+	ctl->capped = 0;
+
+	if (ctl->target)
+		depth_ctl_update_limit(ctl);
+}
+
+/*
+ * number of entries to push
+ *
+ * @ctl      depth controller
+ * @filled   entries owned by the stream queue
+ * @remain   free entries of the ring
+ */
+int depth_ctl_push_count(struct depth_ctl *ctl, int filled, int remain)
+{
+	int count;
+
+	if (!ctl->target || !ctl->tx)
+		return remain;
+
+	count = ctl->limit - filled;
+	if (count > remain)
+		count = remain;
+
+	/* wait for room of a quarter of the limit to batch the writes */
+	if (count < remain && count < ctl->limit / 4)
+		count = 0;
+
+	if (count <= 0) {
+		ctl->capped++;
+		return 0;
+	}
+
+	return count;
+}
+
+/*
+ * number of entries to take
+ *
+ * @ctl      depth controller
+ * @filled   entries owned by the stream queue
+ */
+int depth_ctl_take_count(struct depth_ctl *ctl, int filled)
+{
+	return (filled > ctl->batch) ? ctl->batch : filled;
+}
+
+/*
+ * notify pushed entries, samples the Tx depth
+ *
+ * @ctl      depth controller
+ * @filled   entries owned by the stream queue after the push
+ */
+void depth_ctl_pushed(struct depth_ctl *ctl, int filled)
+{
+	if (!ctl->tx)
+		return;
+
+	ctl->samples++;
+	ctl->depth_total += filled;
+	if (filled > ctl->depth_max)
+		ctl->depth_max = filled;
+}
+
+/*
+ * notify taken entries, adapts the batch and samples the Rx depth
+ *
+ * @ctl      depth controller
+ * @taken    entries taken from the stream queue
+ */
+void depth_ctl_taken(struct depth_ctl *ctl, int taken)
+{
+	uint64_t now;
+
+	if (taken <= 0)
+		return;
+
+	if (!ctl->tx) {
+		ctl->samples++;
+		ctl->depth_total += taken;
+		if (taken > ctl->depth_max)
+			ctl->depth_max = taken;
+	}
+
+	if (!ctl->target)
+		return;
+
+	if (ctl->estimate) {
+		now = depth_ctl_now();
+		if (ctl->last)
+			ctl->interval = (ctl->interval * 7 +
+					 (now - ctl->last) / taken) / 8;
+		ctl->last = now;
+		if (!ctl->interval)
+			ctl->interval = 1;
+		depth_ctl_update_limit(ctl);
+	}
+
+	/* Tx: reclaim in larger batches while completions keep up */
+	if (ctl->tx) {
+		if (taken >= ctl->batch && ctl->batch * 2 <= ctl->limit)
+			ctl->batch *= 2;
+		else if (taken < ctl->batch / 4 && ctl->batch > 1)
+			ctl->batch /= 2;
+	}
+}
+
+/*
+ * report achieved depth
+ *
+ * @ctl      depth controller
+ * @buf      output buffer
+ * @buflen   size of output buffer
+ */
+void depth_ctl_report(struct depth_ctl *ctl, char *buf, int buflen)
+{
+	double avg = 0;
+
+	if (ctl->samples)
+		avg = (double)ctl->depth_total / ctl->samples;
+
+	snprintf(buf, buflen,
+		 "depth avg %.1f max %d (%.1f/%.1f us) limit %d batch %d"
+		 " target %" PRIu64 " us capped %" PRIu64,
+		 avg, ctl->depth_max,
+		 avg * ctl->interval / 1000,
+		 (double)ctl->depth_max * ctl->interval / 1000,
+		 ctl->limit, ctl->batch,
+		 ctl->target / 1000, ctl->capped);
+}
@@ -0,0 +1,50 @@
+/*
+ * Copyright (c) 2014-2016 Renesas Electronics Corporation
+ * Released under the MIT license
+ * http://opensource.org/licenses/mit-license.php
+ */
+
+#ifndef __DEPTH_CTL_H__
+#define __DEPTH_CTL_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/*
+ * queue depth controller for a latency target
+ *
+ * Tx: entries pushed but not yet transmitted are media delay, the
+ *     number of in-flight entries is capped to target / interval.
+ * Rx: entries received but not yet taken are media delay, the take
+ *     batch is capped to target / interval so that a blocking take
+ *     does not wait longer than the target.
+ *
+ * without a target, the fixed behavior of entrynum / 8 is kept.
+ */
+struct depth_ctl {
+	bool     tx;
+	int      entrynum;
+	uint64_t target;      /* latency target [ns], 0:disabled */
+	uint64_t interval;    /* frame interval [ns] */
+	bool     estimate;    /* estimate interval from taken entries */
+	int      limit;       /* Tx: max in-flight entries */
+	int      batch;       /* take batch */
+	uint64_t last;        /* time of the last take with entries */
+
+	/* telemetry */
+	uint64_t samples;
+	uint64_t depth_total;
+	int      depth_max;
+	uint64_t capped;      /* pushes held back by the limit */
+};
+
+extern void depth_ctl_init(struct depth_ctl *ctl, bool tx, int entrynum,
+			   uint64_t target, uint64_t interval, bool estimate);
+extern int depth_ctl_push_count(struct depth_ctl *ctl, int filled,
+				int remain);
+extern int depth_ctl_take_count(struct depth_ctl *ctl, int filled);
+extern void depth_ctl_pushed(struct depth_ctl *ctl, int filled);
+extern void depth_ctl_taken(struct depth_ctl *ctl, int taken);
+extern void depth_ctl_report(struct depth_ctl *ctl, char *buf, int buflen);
+
+#endif /* __DEPTH_CTL_H__ */
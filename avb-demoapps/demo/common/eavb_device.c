@@ -13,6 +13,9 @@
 
 #define EAVBDEVICE_DEBUG (0)
 
+/* DMA alignment of payload vectors */
+#define EAVBDEVICE_PAYLOAD_ALIGN (4)
+
 static int eavb_device_get_separation_filter(
 		struct eavb_device *dev, char streamid[AVTP_STREAMID_SIZE])
 {
@@ -35,30 +38,26 @@ static int eavb_device_get_separation_filter(
 
 static int eavb_device_take_entry(struct eavb_device *dev, int count)
 {
-	int ret, tmp;
-	char *buf;
+	int ret;
+	void *buf;
 
 	if (!dev)
 		return -1;
 
-	buf = dev->entryworkbuf;
+	/*
+	 * take into the ring directly, bounded by the end of the ring.
+	 * the wrapped remainder is taken into the head of the ring
+	 * by the next call.
+	 */
+	if (dev->rp + count > dev->entrynum)
+		count = dev->entrynum - dev->rp;
 
-	ret = eavb_take(dev->fd, (struct eavb_entry *)buf, count);
+	buf = dev->entrybuf + (dev->rp * sizeof(struct eavb_entry));
+	ret = eavb_ctx_take(dev->ctx, (struct eavb_entry *)buf, count);
 
 	if (ret <= 0)
 		return ret;
 
-	if (dev->rp + ret > dev->entrynum) {
-		tmp = dev->entrynum - dev->rp;
-		memcpy(dev->entrybuf+(dev->rp*sizeof(struct eavb_entry)),
-				buf, tmp * sizeof(struct eavb_entry));
-		memcpy(dev->entrybuf, buf+(tmp*sizeof(struct eavb_entry)),
-				(ret - tmp) * sizeof(struct eavb_entry));
-	} else {
-		memcpy(dev->entrybuf+(dev->rp*sizeof(struct eavb_entry)),
-				buf, ret*sizeof(struct eavb_entry));
-	}
-
 	dev->remain += ret;
 	dev->filled -= ret;
 
@@ -74,30 +73,26 @@ static int eavb_device_take_entry(struct eavb_device *dev, int count)
 
 static int eavb_device_push_entry(struct eavb_device *dev, int count)
 {
-	int ret, tmp;
-	char *buf;
-	void *from, *to;
+	int ret, tmp, len;
+	void *buf;
 
 	if (!dev)
 		return -1;
 
-	buf = dev->entryworkbuf;
-
-	if (dev->wp + count > dev->entrynum) {
-		tmp = dev->entrynum - dev->wp;
+	/* push the contiguous segment up to the end of the ring */
+	len = count;
+	if (dev->wp + count > dev->entrynum)
+		len = dev->entrynum - dev->wp;
 
-		from = dev->entrybuf+(dev->wp*sizeof(struct eavb_entry));
-		to = buf;
-		memcpy(to, from, tmp * sizeof(struct eavb_entry));
+	buf = dev->entrybuf + (dev->wp * sizeof(struct eavb_entry));
+	ret = eavb_ctx_push(dev->ctx, (struct eavb_entry *)buf, len);
 
-		from = dev->entrybuf,
-		to = buf+(tmp*sizeof(struct eavb_entry));
-		memcpy(to, from, (count - tmp) * sizeof(struct eavb_entry));
-
-		ret = eavb_push(dev->fd, (struct eavb_entry *)buf, count);
-	} else {
-		buf = dev->entrybuf+(dev->wp*sizeof(struct eavb_entry));
-		ret = eavb_push(dev->fd, (struct eavb_entry *)buf, count);
+	/* wrapped, push the rest from the head of the ring */
+	if (ret == len && count > len) {
+		tmp = eavb_ctx_push(dev->ctx, (struct eavb_entry *)dev->entrybuf,
+				    count - len);
+		if (tmp > 0)
+			ret += tmp;
 	}
 
 	if (ret <= 0)
@@ -123,7 +118,6 @@ static int eavb_device_push_entry(struct eavb_device *dev, int count)
 struct eavb_device *eavb_device_new(char *name, int entrynum, mode_t mode)
 {
 	struct eavb_device *dev;
-	int fd = -1;
 
 	if (!name)
 		return NULL;
@@ -139,10 +133,10 @@ struct eavb_device *eavb_device_new(char *name, int entrynum, mode_t mode)
 	dev->push_entry = eavb_device_push_entry;
 
 	/* open device */
-	fd = eavb_open(name, mode);
-	if (fd < 0)
+	dev->ctx = eavb_ctx_open(name, mode);
+	if (!dev->ctx)
 		goto error;
-	dev->fd = fd;
+	dev->fd = dev->ctx->fd;
 
 	/* allocate entry buffer */
 	dev->entrybuf = calloc(dev->entrynum, sizeof(struct eavb_entry));
@@ -151,48 +145,109 @@ struct eavb_device *eavb_device_new(char *name, int entrynum, mode_t mode)
 		goto error;
 	}
 
-	/* allocate entry work buffer */
-	dev->entryworkbuf = calloc(dev->entrynum, sizeof(struct eavb_entry));
-	if (!dev->entryworkbuf) {
-		fprintf(stderr, "[AVB] cannot allocate entryworkbuf\n");
-		goto error;
-	}
-
-	/* allocate frame info buffer */
-	dev->framebuf = calloc(dev->entrynum, sizeof(struct eavb_dma_alloc));
-	if (!dev->framebuf) {
-		fprintf(stderr, "[AVB] cannot allocate framebuf\n");
-		goto error;
-	}
-
 	return dev; /* Success */
 
 error:
-	if (dev->framebuf)
-		free(dev->framebuf);
-	if (dev->entryworkbuf)
-		free(dev->entryworkbuf);
 	if (dev->entrybuf)
 		free(dev->entrybuf);
-	if (fd > 0)
-		eavb_close(fd);
+	if (dev->ctx)
+		eavb_ctx_close(dev->ctx);
 	free(dev);
 
 	return NULL;
 }
 
+/*
+ * allocate DMA frames of all entries, framebuf is array of eavb_frame
+ */
+int eavb_device_alloc_frames(struct eavb_device *dev, int framesize)
+{
+	if (!dev)
+		return -1;
+
+	return eavb_device_alloc_frames_num(dev, framesize, dev->entrynum);
+}
+
+/*
+ * allocate DMA frames more than entries, framebuf is array of eavb_frame.
+ * the caller attaches frames to entries before pushing them.
+ */
+int eavb_device_alloc_frames_num(struct eavb_device *dev, int framesize,
+				 int framenum)
+{
+	if (!dev || !dev->ctx || framenum < dev->entrynum)
+		return -1;
+
+	dev->framepool = eavb_frame_pool_new(dev->ctx, framesize, framenum);
+	if (!dev->framepool) {
+		fprintf(stderr, "[AVB] cannot allocate frames\n");
+		return -1;
+	}
+
+	dev->framebuf = dev->framepool->frames;
+
+	return 0;
+}
+
+/*
+ * allocate DMA frames of all entries split into header and payload,
+ * hdrbuf and framebuf are arrays of eavb_frame.
+ * payloads are packed back to back as far as the DMA alignment allows.
+ */
+int eavb_device_alloc_sg_frames(struct eavb_device *dev, int hdrsize,
+				int payloadsize)
+{
+	if (!dev || !dev->ctx)
+		return -1;
+
+	dev->hdrpool = eavb_frame_pool_new(dev->ctx, hdrsize, dev->entrynum);
+	if (!dev->hdrpool) {
+		fprintf(stderr, "[AVB] cannot allocate header frames\n");
+		return -1;
+	}
+
+	dev->framepool = eavb_frame_pool_new_align(dev->ctx, payloadsize,
+						   dev->entrynum,
+						   EAVBDEVICE_PAYLOAD_ALIGN);
+	if (!dev->framepool) {
+		fprintf(stderr, "[AVB] cannot allocate payload frames\n");
+		return -1;
+	}
+
+	dev->hdrbuf = dev->hdrpool->frames;
+	dev->framebuf = dev->framepool->frames;
+
+	return 0;
+}
+
+/*
+ * close stream queue of device, DMA frames are freed with it
+ */
+void eavb_device_close(struct eavb_device *dev)
+{
+	if (!dev || !dev->ctx)
+		return;
+
+	eavb_frame_pool_free(dev->framepool);
+	dev->framepool = NULL;
+	dev->framebuf = NULL;
+
+	eavb_frame_pool_free(dev->hdrpool);
+	dev->hdrpool = NULL;
+	dev->hdrbuf = NULL;
+
+	eavb_ctx_close(dev->ctx);
+	dev->ctx = NULL;
+	dev->fd = -1;
+}
+
 void eavb_device_free(struct eavb_device *dev)
 {
 	if (!dev)
 		return;
 
-	if (dev->framebuf)
-		free(dev->framebuf);
-	if (dev->entryworkbuf)
-		free(dev->entryworkbuf);
 	if (dev->entrybuf)
 		free(dev->entrybuf);
-	if (dev->fd > 0)
-		eavb_close(dev->fd);
+	eavb_device_close(dev);
 	free(dev);
 }
@@ -8,15 +8,19 @@
 #define __EAVB_DEVICE_H__
 
 #include "avtp.h"
+#include "eavb.h"
 
 #include <stdint.h>
 #include <linux/if_ether.h>
 
 struct eavb_device {
+	struct eavb_ctx *ctx;
 	int       fd;
 	void      *framebuf;
+	struct eavb_frame_pool *framepool;
+	void      *hdrbuf;   /* headers of scatter-gather frames */
+	struct eavb_frame_pool *hdrpool;
 	void      *entrybuf;
-	void      *entryworkbuf;
 
 	uint8_t   dest_addr[ETH_ALEN]; /* TODO remove */
 	uint8_t   StreamID[AVTP_STREAMID_SIZE]; /* TODO remove */
@@ -36,6 +40,12 @@ struct eavb_device {
 };
 
 struct eavb_device *eavb_device_new(char *name, int entrynum, mode_t mode);
+int eavb_device_alloc_frames(struct eavb_device *dev, int framesize);
+int eavb_device_alloc_frames_num(struct eavb_device *dev, int framesize,
+				 int framenum);
+int eavb_device_alloc_sg_frames(struct eavb_device *dev, int hdrsize,
+				int payloadsize);
+void eavb_device_close(struct eavb_device *dev);
 void eavb_device_free(struct eavb_device *dev);
 
 #endif /* __EAVB_DEVICE_H__ */
@@ -0,0 +1,636 @@
+/*
+ * Copyright (c) 2014-2016 Renesas Electronics Corporation
+ * Released under the MIT license
+ * http://opensource.org/licenses/mit-license.php
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <limits.h>
+#include <time.h>
+#include <inttypes.h>
+#include <sched.h>
+
+#include "file_sink.h"
+
+/* buffers written by one writev() */
+#define FILE_SINK_IOV_MAX  (256)
+/* period the writer checks the queue without a signal */
+#define FILE_SINK_PERIOD   (5000000)
+/* capture files are written in blocks of */
+#define FILE_SINK_BLOCK    (1024 * 1024)
+/* alignment of O_DIRECT */
+#define FILE_SINK_ALIGN    (4096)
+/* capture files are preallocated by */
+#define FILE_SINK_PREALLOC (64 * 1024 * 1024)
+
+#define NSEC_SCALE         (1000000000ull)
+
+#define ALIGN(x, a) (((x) + (a) - 1) & ~((a) - 1))
+
+static inline uint64_t file_sink_now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return ts.tv_sec * NSEC_SCALE + ts.tv_nsec;
+}
+
+/* write all of iov, partial writes are continued */
+static int file_sink_writev(int fd, struct iovec *iov, int iovcnt)
+{
+	ssize_t ret;
+
+	while (iovcnt > 0) {
+		ret = writev(fd, iov, iovcnt);
+		if (ret < 0) {
+			if (errno == EINTR)
+				continue;
+			return -1;
+		}
+
+		while (iovcnt > 0 && ret >= (ssize_t)iov->iov_len) {
+			ret -= iov->iov_len;
+			iov++;
+			iovcnt--;
+		}
+		if (iovcnt > 0) {
+			iov->iov_base += ret;
+			iov->iov_len -= ret;
+		}
+	}
+
+	return 0;
+}
+
+static void file_sink_account(struct file_sink *sink, uint64_t duration)
+{
+	int i;
+
+	sink->writes++;
+	sink->stall_total += duration;
+	if (duration > sink->stall_max)
+		sink->stall_max = duration;
+
+	/* log2 of us */
+	for (i = 0, duration /= 1000; duration && i < FILE_SINK_HIST - 1; i++)
+		duration >>= 1;
+	sink->hist[i]++;
+}
+
+/* buffers until done can be reused by the process loop */
+static void file_sink_release(struct file_sink *sink, unsigned int done)
+{
+	__atomic_store_n(&sink->done, done, __ATOMIC_SEQ_CST);
+
+	if (__atomic_load_n(&sink->waiting, __ATOMIC_SEQ_CST)) {
+		pthread_mutex_lock(&sink->lock);
+		pthread_cond_signal(&sink->wait_cond);
+		pthread_mutex_unlock(&sink->lock);
+	}
+}
+
+/* open next capture file, the previous one is closed */
+static int file_sink_capture_open(struct file_sink *sink)
+{
+	char name[PATH_MAX];
+	int flags = O_WRONLY | O_CREAT | O_TRUNC;
+
+	if (sink->rotate_size || sink->rotate_time)
+		snprintf(name, sizeof(name), "%s.%04d", sink->name,
+			 sink->files);
+	else
+		snprintf(name, sizeof(name), "%s", sink->name);
+
+	if (sink->direct)
+		flags |= O_DIRECT;
+
+	sink->fd = open(name, flags, 0644);
+	if (sink->fd < 0 && sink->direct && errno == EINVAL) {
+		/* not supported by the filesystem */
+		fprintf(stderr, "file sink: %s: no O_DIRECT, buffered\n", name);
+		sink->direct = false;
+		sink->fd = open(name, flags & ~O_DIRECT, 0644);
+	}
+	if (sink->fd < 0) {
+		perror(name);
+		return -1;
+	}
+
+	sink->files++;
+	sink->offset = 0;
+	sink->allocated = 0;
+	sink->opened = file_sink_now();
+
+	return 0;
+}
+
+/* cut the preallocated area and close capture file */
+static void file_sink_capture_close(struct file_sink *sink)
+{
+	if (sink->fd < 0)
+		return;
+
+	if (ftruncate(sink->fd, sink->offset) < 0 && !sink->errors++)
+		perror("file sink");
+	close(sink->fd);
+	sink->fd = -1;
+}
+
+/* rotate capture file before writing len bytes, if due */
+static int file_sink_rotate(struct file_sink *sink, size_t len, uint64_t now)
+{
+	if (!sink->offset)
+		return 0;
+
+	if ((!sink->rotate_size ||
+	     sink->offset + len <= sink->rotate_size) &&
+	    (!sink->rotate_time ||
+	     now - sink->opened < sink->rotate_time))
+		return 0;
+
+	file_sink_capture_close(sink);
+
+	return file_sink_capture_open(sink);
+}
+
+/* write the rest of block, it is padded for O_DIRECT and truncated */
+static void file_sink_write_tail(struct file_sink *sink)
+{
+	uint64_t start = file_sink_now();
+	size_t len = sink->blocklen;
+	ssize_t ret;
+
+	if (!len || file_sink_rotate(sink, len, start) < 0)
+		return;
+
+	if (sink->direct) {
+		memset(sink->block + len, 0, ALIGN(len, FILE_SINK_ALIGN) - len);
+		len = ALIGN(len, FILE_SINK_ALIGN);
+	}
+
+	ret = pwrite(sink->fd, sink->block, len, sink->offset);
+	if (ret < 0) {
+		if (!sink->errors++)
+			perror("file sink");
+	} else {
+		sink->bytes += sink->blocklen;
+	}
+	sink->offset += sink->blocklen;
+	sink->blocklen = 0;
+
+	file_sink_account(sink, file_sink_now() - start);
+}
+
+/* write a full block, the file is rotated before if due */
+static void file_sink_write_block(struct file_sink *sink)
+{
+	uint64_t start = file_sink_now();
+	size_t len = sink->blocksize;
+	off_t prealloc;
+	ssize_t ret;
+
+	if (sink->fd < 0 || file_sink_rotate(sink, len, start) < 0) {
+		/* keep the drain going, the data is lost */
+		sink->errors++;
+		sink->blocklen = 0;
+		return;
+	}
+
+	/* extents are reserved ahead, the file size stays */
+	if (sink->offset + (off_t)len > sink->allocated && sink->prealloc) {
+		prealloc = sink->rotate_size ?
+			ALIGN(sink->rotate_size, sink->blocksize) :
+			FILE_SINK_PREALLOC;
+		if (!fallocate(sink->fd, FALLOC_FL_KEEP_SIZE,
+			       sink->allocated, prealloc))
+			sink->allocated += prealloc;
+		else
+			sink->prealloc = false;
+	}
+
+	ret = pwrite(sink->fd, sink->block, len, sink->offset);
+	if (ret != (ssize_t)len) {
+		if (!sink->errors++)
+			perror("file sink");
+	} else {
+		sink->bytes += len;
+	}
+	sink->offset += len;
+	sink->blocklen = 0;
+
+	file_sink_account(sink, file_sink_now() - start);
+}
+
+/* copy [done, head) of ring into blocks, called without the lock */
+static void file_sink_copy(struct file_sink *sink, unsigned int head)
+{
+	struct file_sink_desc *d;
+	unsigned int done = sink->done;
+	size_t len, off;
+	int i, n;
+
+	if (head - done > sink->backlog_max)
+		sink->backlog_max = head - done;
+
+	n = head - done;
+	if (n > FILE_SINK_IOV_MAX)
+		n = FILE_SINK_IOV_MAX;
+
+	for (i = 0; i < n; i++) {
+		d = &sink->ring[(done + i) & (sink->size - 1)];
+		for (off = 0; off < d->len; off += len) {
+			len = d->len - off;
+			if (len > sink->blocksize - sink->blocklen)
+				len = sink->blocksize - sink->blocklen;
+			memcpy(sink->block + sink->blocklen, d->base + off, len);
+			sink->blocklen += len;
+
+			if (sink->blocklen == sink->blocksize)
+				file_sink_write_block(sink);
+		}
+	}
+
+	/* copied, the buffers are not needed anymore */
+	file_sink_release(sink, done + n);
+}
+
+/* write [done, head) of ring, called without the lock */
+static void file_sink_drain(struct file_sink *sink, unsigned int head)
+{
+	struct file_sink_desc *d;
+	unsigned int done = sink->done;
+	uint64_t start;
+	size_t bytes = 0;
+	int i, n;
+
+	if (head - done > sink->backlog_max)
+		sink->backlog_max = head - done;
+
+	n = head - done;
+	if (n > FILE_SINK_IOV_MAX)
+		n = FILE_SINK_IOV_MAX;
+
+	for (i = 0; i < n; i++) {
+		d = &sink->ring[(done + i) & (sink->size - 1)];
+		sink->iov[i].iov_base = d->base;
+		sink->iov[i].iov_len = d->len;
+		bytes += d->len;
+	}
+
+	start = file_sink_now();
+	if (file_sink_writev(sink->fd, sink->iov, n) < 0) {
+		/* the data is lost, but the buffers are returned */
+		if (!sink->errors++)
+			perror("file sink");
+	} else {
+		sink->bytes += bytes;
+	}
+	file_sink_account(sink, file_sink_now() - start);
+
+	file_sink_release(sink, done + n);
+}
+
+static void file_sink_timeout(struct timespec *ts, uint64_t ns)
+{
+	clock_gettime(CLOCK_MONOTONIC, ts);
+	ts->tv_sec += ns / NSEC_SCALE;
+	ts->tv_nsec += ns % NSEC_SCALE;
+	if (ts->tv_nsec >= NSEC_SCALE) {
+		ts->tv_sec++;
+		ts->tv_nsec -= NSEC_SCALE;
+	}
+}
+
+static void *file_sink_thread(void *arg)
+{
+	struct file_sink *sink = arg;
+	struct timespec ts;
+	unsigned int head;
+
+	pthread_mutex_lock(&sink->lock);
+	for (;;) {
+		head = __atomic_load_n(&sink->head, __ATOMIC_ACQUIRE);
+		if (head != sink->done) {
+			pthread_mutex_unlock(&sink->lock);
+			if (sink->block)
+				file_sink_copy(sink, head);
+			else
+				file_sink_drain(sink, head);
+			pthread_mutex_lock(&sink->lock);
+			continue;
+		}
+
+		if (sink->stop)
+			break;
+
+		/* recheck after the flag, file_sink_flush() does reverse */
+		__atomic_store_n(&sink->sleeping, true, __ATOMIC_SEQ_CST);
+		if (__atomic_load_n(&sink->head, __ATOMIC_SEQ_CST) ==
+		    sink->done) {
+			file_sink_timeout(&ts, FILE_SINK_PERIOD);
+			pthread_cond_timedwait(&sink->cond, &sink->lock, &ts);
+		}
+		__atomic_store_n(&sink->sleeping, false, __ATOMIC_RELAXED);
+	}
+	pthread_mutex_unlock(&sink->lock);
+
+	if (sink->block) {
+		file_sink_write_tail(sink);
+		file_sink_capture_close(sink);
+	}
+
+	return NULL;
+}
+
+static struct file_sink *file_sink_new(int size)
+{
+	struct file_sink *sink;
+
+	if (size <= 0)
+		return NULL;
+
+	sink = calloc(1, sizeof(*sink));
+	if (!sink) {
+		perror("cannot allocate file sink");
+		return NULL;
+	}
+
+	sink->fd = -1;
+	sink->size = 1;
+	while (sink->size < size)
+		sink->size <<= 1;
+
+	sink->ring = calloc(sink->size, sizeof(*sink->ring));
+	sink->iov = calloc(FILE_SINK_IOV_MAX, sizeof(*sink->iov));
+	if (!sink->ring || !sink->iov) {
+		perror("cannot allocate file sink");
+		file_sink_close(sink);
+		return NULL;
+	}
+
+	pthread_mutex_init(&sink->lock, NULL);
+	sink->initialized = true;
+
+	return sink;
+}
+
+static int file_sink_start(struct file_sink *sink)
+{
+	pthread_condattr_t cattr;
+	pthread_attr_t attr;
+	struct sched_param param;
+	int ret;
+
+	pthread_condattr_init(&cattr);
+	pthread_condattr_setclock(&cattr, CLOCK_MONOTONIC);
+	pthread_cond_init(&sink->cond, &cattr);
+	pthread_cond_init(&sink->wait_cond, &cattr);
+	pthread_condattr_destroy(&cattr);
+
+	/* never preempt the process loop, even if it is RT */
+	pthread_attr_init(&attr);
+	pthread_attr_setinheritsched(&attr, PTHREAD_EXPLICIT_SCHED);
+	pthread_attr_setschedpolicy(&attr, SCHED_OTHER);
+	param.sched_priority = 0;
+	pthread_attr_setschedparam(&attr, &param);
+	ret = pthread_create(&sink->thread, &attr, file_sink_thread, sink);
+	pthread_attr_destroy(&attr);
+	if (ret) {
+		fprintf(stderr, "cannot create writer thread\n");
+		return -1;
+	}
+	sink->running = true;
+
+	return 0;
+}
+
+/*
+ * open file sink, start the writer thread
+ *
+ * @fd       file descriptor, owned by the caller
+ * @size     number of buffers in flight, rounded up to power of 2
+ */
+struct file_sink *file_sink_open(int fd, int size)
+{
+	struct file_sink *sink;
+
+	sink = file_sink_new(size);
+	if (!sink)
+		return NULL;
+
+	sink->fd = fd;
+
+	if (file_sink_start(sink) < 0) {
+		file_sink_close(sink);
+		return NULL;
+	}
+
+	return sink;
+}
+
+/*
+ * open file sink for long captures, start the writer thread
+ *
+ * payloads are copied into large blocks written with O_DIRECT to
+ * files preallocated with fallocate(). the files are named NAME, or
+ * NAME.0000, NAME.0001, ... if rotated. the buffers are given back
+ * once copied.
+ *
+ * @name        file name
+ * @size        number of buffers in flight, rounded up to power of 2
+ * @rotate_size rotate file after bytes, 0 for no rotation by size
+ * @rotate_time rotate file after ns, 0 for no rotation by time
+ */
+struct file_sink *file_sink_open_capture(const char *name, int size,
+					 uint64_t rotate_size,
+					 uint64_t rotate_time)
+{
+	struct file_sink *sink;
+
+	sink = file_sink_new(size);
+	if (!sink)
+		return NULL;
+
+	sink->name = strdup(name);
+	sink->blocksize = FILE_SINK_BLOCK;
+	sink->rotate_size = rotate_size;
+	sink->rotate_time = rotate_time;
+	sink->direct = true;
+	sink->prealloc = true;
+
+	if (posix_memalign(&sink->block, FILE_SINK_ALIGN, sink->blocksize)) {
+		sink->block = NULL;
+		perror("cannot allocate capture block");
+		file_sink_close(sink);
+		return NULL;
+	}
+
+	if (!sink->name || file_sink_capture_open(sink) < 0 ||
+	    file_sink_start(sink) < 0) {
+		file_sink_close(sink);
+		return NULL;
+	}
+
+	return sink;
+}
+
+/*
+ * queue a buffer, it is written after file_sink_flush()
+ *
+ * @sink     file sink
+ * @base     buffer, valid until reclaimed
+ * @len      length of buffer
+ * @cookie   identifier of buffer given back by file_sink_reclaim()
+ */
+int file_sink_write(struct file_sink *sink, void *base, size_t len,
+		    int cookie)
+{
+	struct file_sink_desc *d;
+
+	if (sink->queued - sink->reclaimed >= sink->size)
+		return -1;
+
+	d = &sink->ring[sink->queued & (sink->size - 1)];
+	d->base = base;
+	d->len = len;
+	d->cookie = cookie;
+	sink->queued++;
+
+	return 0;
+}
+
+/*
+ * pass the queued buffers to the writer
+ *
+ * @sink     file sink
+ */
+void file_sink_flush(struct file_sink *sink)
+{
+	__atomic_store_n(&sink->head, sink->queued, __ATOMIC_SEQ_CST);
+
+	/* the lock is taken only to wake up an idle writer */
+	if (__atomic_load_n(&sink->sleeping, __ATOMIC_SEQ_CST)) {
+		pthread_mutex_lock(&sink->lock);
+		pthread_cond_signal(&sink->cond);
+		pthread_mutex_unlock(&sink->lock);
+	}
+}
+
+/*
+ * get back written buffers, in the order of file_sink_write()
+ *
+ * @sink     file sink
+ * @cookies  cookies of written buffers
+ * @max      size of cookies
+ */
+int file_sink_reclaim(struct file_sink *sink, int *cookies, int max)
+{
+	unsigned int done = __atomic_load_n(&sink->done, __ATOMIC_ACQUIRE);
+	int i, n;
+
+	n = done - sink->reclaimed;
+	if (n > max)
+		n = max;
+
+	for (i = 0; i < n; i++)
+		cookies[i] = sink->ring[(sink->reclaimed + i) &
+					(sink->size - 1)].cookie;
+	sink->reclaimed += n;
+
+	return n;
+}
+
+/*
+ * wait until a buffer can be reclaimed
+ *
+ * @sink       file sink
+ * @timeout_ms timeout in ms
+ */
+int file_sink_wait(struct file_sink *sink, int timeout_ms)
+{
+	struct timespec ts;
+	int ret = 0;
+
+	file_sink_timeout(&ts, timeout_ms * 1000000ull);
+
+	pthread_mutex_lock(&sink->lock);
+	__atomic_store_n(&sink->waiting, true, __ATOMIC_SEQ_CST);
+	while (__atomic_load_n(&sink->done, __ATOMIC_SEQ_CST) ==
+	       sink->reclaimed && !ret)
+		ret = pthread_cond_timedwait(&sink->wait_cond, &sink->lock,
+					     &ts);
+	__atomic_store_n(&sink->waiting, false, __ATOMIC_RELAXED);
+	pthread_mutex_unlock(&sink->lock);
+
+	return ret ? -1 : 0;
+}
+
+/*
+ * stop the writer thread after all queued buffers are written
+ *
+ * @sink     file sink
+ */
+void file_sink_stop(struct file_sink *sink)
+{
+	if (!sink->running || sink->stop)
+		return;
+
+	file_sink_flush(sink);
+	pthread_mutex_lock(&sink->lock);
+	sink->stop = true;
+	pthread_cond_signal(&sink->cond);
+	pthread_mutex_unlock(&sink->lock);
+	pthread_join(sink->thread, NULL);
+}
+
+/*
+ * close file sink, queued buffers are written before.
+ * the file descriptor is not closed.
+ *
+ * @sink     file sink
+ */
+void file_sink_close(struct file_sink *sink)
+{
+	if (!sink)
+		return;
+
+	if (sink->running) {
+		file_sink_stop(sink);
+		pthread_cond_destroy(&sink->wait_cond);
+		pthread_cond_destroy(&sink->cond);
+	} else if (sink->block) {
+		/* the first file is open before the writer starts */
+		file_sink_capture_close(sink);
+	}
+	if (sink->initialized)
+		pthread_mutex_destroy(&sink->lock);
+
+	free(sink->block);
+	free(sink->name);
+	free(sink->iov);
+	free(sink->ring);
+	free(sink);
+}
+
+void file_sink_report(struct file_sink *sink, char *buf, int buflen)
+{
+	int len;
+
+	len = snprintf(buf, buflen,
+		       "writer writes %" PRIu64 " bytes %" PRIu64
+		       " errors %" PRIu64 " stall max %" PRIu64
+		       " us backlog max %u/%u",
+		       sink->writes, sink->bytes, sink->errors,
+		       sink->stall_max / 1000, sink->backlog_max, sink->size);
+
+	if (sink->block && len < buflen)
+		snprintf(buf + len, buflen - len, " files %d%s",
+			 sink->files, sink->direct ? " direct" : "");
+}
@@ -0,0 +1,90 @@
+/*
+ * Copyright (c) 2014-2016 Renesas Electronics Corporation
+ * Released under the MIT license
+ * http://opensource.org/licenses/mit-license.php
+ */
+
+#ifndef __FILE_SINK_H__
+#define __FILE_SINK_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <pthread.h>
+#include <sys/types.h>
+#include <sys/uio.h>
+
+#define FILE_SINK_HIST (24)
+
+struct file_sink_desc {
+	void   *base;
+	size_t len;
+	int    cookie;  /* returned by file_sink_reclaim() once written */
+};
+
+/*
+ * file sink of Listener
+ *
+ * buffers are handed to a writer thread through a single producer
+ * single consumer queue, so that the process loop does not wait
+ * for the storage. a buffer must stay valid until it is reclaimed.
+ */
+struct file_sink {
+	int                   fd;
+	unsigned int          size;      /* number of slots, power of 2 */
+	struct file_sink_desc *ring;
+
+	/* free running indexes of ring */
+	unsigned int          queued;    /* process loop only */
+	unsigned int          head;      /* published by the process loop */
+	unsigned int          done;      /* written by the writer */
+	unsigned int          reclaimed; /* process loop only */
+
+	pthread_t             thread;
+	bool                  initialized;
+	bool                  running;
+	bool                  stop;
+	bool                  sleeping;
+	bool                  waiting;   /* process loop in file_sink_wait() */
+	pthread_mutex_t       lock;
+	pthread_cond_t        cond;
+	pthread_cond_t        wait_cond;
+	struct iovec          *iov;
+
+	/* capture files, see file_sink_open_capture() */
+	char                  *name;
+	uint64_t              rotate_size;
+	uint64_t              rotate_time;
+	uint64_t              opened;    /* time the file was opened */
+	bool                  direct;    /* O_DIRECT */
+	bool                  prealloc;  /* fallocate() works */
+	void                  *block;
+	size_t                blocksize;
+	size_t                blocklen;
+	off_t                 offset;    /* end of data in the file */
+	off_t                 allocated;
+	int                   files;
+
+	/* statistics, written by the writer */
+	uint64_t              writes;
+	uint64_t              bytes;
+	uint64_t              errors;
+	uint64_t              stall_max; /* longest write in ns */
+	uint64_t              stall_total;
+	uint64_t              hist[FILE_SINK_HIST]; /* log2 of write in us */
+	unsigned int          backlog_max;
+};
+
+extern struct file_sink *file_sink_open(int fd, int size);
+extern struct file_sink *file_sink_open_capture(const char *name, int size,
+						uint64_t rotate_size,
+						uint64_t rotate_time);
+extern int file_sink_write(struct file_sink *sink, void *base, size_t len,
+			   int cookie);
+extern void file_sink_flush(struct file_sink *sink);
+extern int file_sink_reclaim(struct file_sink *sink, int *cookies, int max);
+extern int file_sink_wait(struct file_sink *sink, int timeout_ms);
+extern void file_sink_stop(struct file_sink *sink);
+extern void file_sink_close(struct file_sink *sink);
+extern void file_sink_report(struct file_sink *sink, char *buf, int buflen);
+
+#endif /* __FILE_SINK_H__ */
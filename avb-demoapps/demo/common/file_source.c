@@ -0,0 +1,329 @@
+/*
+ * Copyright (c) 2014-2016 Renesas Electronics Corporation
+ * Released under the MIT license
+ * http://opensource.org/licenses/mit-license.php
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <time.h>
+#include <sched.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+
+#include "file_source.h"
+
+/* data kept ahead of the process loop */
+#define FILE_SOURCE_WINDOW (4 * 1024 * 1024)
+/* unit of a read ahead */
+#define FILE_SOURCE_CHUNK  (256 * 1024)
+/* period the read ahead thread checks the position without a signal */
+#define FILE_SOURCE_PERIOD (5000000)
+/* nice value of the read ahead thread */
+#define FILE_SOURCE_NICE   (10)
+
+static const char * const mode_names[] = {
+	[FILE_SOURCE_AUTO]    = "auto",
+	[FILE_SOURCE_READ]    = "read",
+	[FILE_SOURCE_MMAP]    = "mmap",
+	[FILE_SOURCE_FADVISE] = "fadvise",
+};
+
+/* read ahead [from, from + len), called without the lock */
+static void file_source_fill(struct file_source *src, off_t from, size_t len)
+{
+	volatile uint8_t *p;
+	long pagesize = sysconf(_SC_PAGESIZE);
+	off_t off;
+	ssize_t ret;
+
+	if (src->mode == FILE_SOURCE_MMAP) {
+		madvise(src->map + (from & ~(pagesize - 1)),
+			len + (from & (pagesize - 1)), MADV_WILLNEED);
+		/* fault the pages in here, not in the process loop */
+		for (off = from; off < from + (off_t)len; off += pagesize) {
+			p = src->map + off;
+			(void)*p;
+		}
+	} else {
+		posix_fadvise(src->fd, from, len, POSIX_FADV_WILLNEED);
+		/* wait for the storage here, not in the process loop */
+		for (off = from; off < from + (off_t)len; off += ret) {
+			ret = pread(src->fd, src->scratch,
+				    from + len - off, off);
+			if (ret <= 0)
+				break;
+		}
+	}
+}
+
+static void *file_source_thread(void *arg)
+{
+	struct file_source *src = arg;
+	struct timespec ts;
+	off_t from, pos;
+	size_t len;
+
+	/* lower than the process loop, nice applies per thread on Linux */
+	setpriority(PRIO_PROCESS, syscall(SYS_gettid), FILE_SOURCE_NICE);
+
+	pthread_mutex_lock(&src->lock);
+	while (!src->stop) {
+		pos = __atomic_load_n(&src->pos, __ATOMIC_RELAXED);
+		if (src->ahead < pos)
+			__atomic_store_n(&src->ahead, pos, __ATOMIC_RELAXED);
+
+		if (src->ahead >= src->size ||
+		    src->ahead - pos >= (off_t)src->window) {
+			clock_gettime(CLOCK_MONOTONIC, &ts);
+			ts.tv_nsec += FILE_SOURCE_PERIOD;
+			if (ts.tv_nsec >= 1000000000) {
+				ts.tv_sec++;
+				ts.tv_nsec -= 1000000000;
+			}
+			pthread_cond_timedwait(&src->cond, &src->lock, &ts);
+			continue;
+		}
+
+		from = src->ahead;
+		len = FILE_SOURCE_CHUNK;
+		if (from + (off_t)len > src->size)
+			len = src->size - from;
+
+		pthread_mutex_unlock(&src->lock);
+		file_source_fill(src, from, len);
+		pthread_mutex_lock(&src->lock);
+
+		__atomic_store_n(&src->ahead, from + len, __ATOMIC_RELAXED);
+	}
+	pthread_mutex_unlock(&src->lock);
+
+	return NULL;
+}
+
+/*
+ * open file source
+ *
+ * @fd       file descriptor, owned by the caller
+ * @mode     read mode, falls back to read on other than regular files
+ */
+struct file_source *file_source_open(int fd, enum file_source_mode mode)
+{
+	struct file_source *src;
+	pthread_condattr_t cattr;
+	pthread_attr_t attr;
+	struct sched_param param;
+	struct stat st;
+	int ret;
+
+	src = calloc(1, sizeof(*src));
+	if (!src) {
+		perror("cannot allocate file source");
+		return NULL;
+	}
+
+	src->fd = fd;
+	src->window = FILE_SOURCE_WINDOW;
+
+	if (fstat(fd, &st) < 0 || !S_ISREG(st.st_mode) || !st.st_size)
+		mode = FILE_SOURCE_READ;
+	else if (mode == FILE_SOURCE_AUTO)
+		mode = FILE_SOURCE_MMAP;
+
+	src->mode = mode;
+	src->size = st.st_size;
+	src->pos = lseek(fd, 0, SEEK_CUR);
+	if (src->pos < 0)
+		src->pos = 0;
+	src->ahead = src->pos;
+
+	if (mode == FILE_SOURCE_READ)
+		return src;
+
+	posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+
+	if (mode == FILE_SOURCE_MMAP) {
+		src->map = mmap(NULL, src->size, PROT_READ, MAP_SHARED, fd, 0);
+		if (src->map == MAP_FAILED) {
+			perror("cannot map file, using read");
+			src->map = NULL;
+			src->mode = FILE_SOURCE_READ;
+			return src;
+		}
+	} else {
+		src->scratch = malloc(FILE_SOURCE_CHUNK);
+		if (!src->scratch) {
+			perror("cannot allocate read ahead buffer");
+			src->mode = FILE_SOURCE_READ;
+			return src;
+		}
+	}
+
+	pthread_mutex_init(&src->lock, NULL);
+	pthread_condattr_init(&cattr);
+	pthread_condattr_setclock(&cattr, CLOCK_MONOTONIC);
+	pthread_cond_init(&src->cond, &cattr);
+	pthread_condattr_destroy(&cattr);
+
+	/* never run ahead of the process loop, even if it is RT */
+	pthread_attr_init(&attr);
+	pthread_attr_setinheritsched(&attr, PTHREAD_EXPLICIT_SCHED);
+	pthread_attr_setschedpolicy(&attr, SCHED_OTHER);
+	param.sched_priority = 0;
+	pthread_attr_setschedparam(&attr, &param);
+	ret = pthread_create(&src->thread, &attr, file_source_thread, src);
+	pthread_attr_destroy(&attr);
+	if (ret) {
+		fprintf(stderr, "cannot create read ahead thread\n");
+		return src;
+	}
+	src->running = true;
+
+	return src;
+}
+
+/*
+ * read from file source into iovec, same result as readv()
+ *
+ * @src      file source
+ * @iov      destination buffers
+ * @iovcnt   number of destination buffers
+ */
+ssize_t file_source_readv(struct file_source *src, const struct iovec *iov,
+			  int iovcnt)
+{
+	off_t pos = src->pos;	/* written only by the process loop */
+	ssize_t ret = 0;
+	size_t len;
+	int i;
+
+	if (src->mode != FILE_SOURCE_MMAP) {
+		ret = readv(src->fd, iov, iovcnt);
+	} else {
+		for (i = 0; i < iovcnt && pos + ret < src->size; i++) {
+			len = iov[i].iov_len;
+			if (pos + ret + (off_t)len > src->size)
+				len = src->size - pos - ret;
+			memcpy(iov[i].iov_base, src->map + pos + ret, len);
+			ret += len;
+		}
+	}
+
+	if (ret <= 0)
+		return ret;
+
+	__atomic_store_n(&src->pos, pos + ret, __ATOMIC_RELAXED);
+
+	/*
+	 * wake up the thread only when half of the window is consumed,
+	 * a lost signal is caught by the period of the thread.
+	 */
+	if (src->running) {
+		off_t ahead = __atomic_load_n(&src->ahead, __ATOMIC_RELAXED);
+
+		if (ahead < src->size &&
+		    ahead - (pos + ret) < (off_t)src->window / 2)
+			pthread_cond_signal(&src->cond);
+	}
+
+	return ret;
+}
+
+/*
+ * close file source, the file descriptor is not closed
+ *
+ * @src      file source
+ */
+void file_source_close(struct file_source *src)
+{
+	if (!src)
+		return;
+
+	if (src->running) {
+		pthread_mutex_lock(&src->lock);
+		src->stop = true;
+		pthread_cond_signal(&src->cond);
+		pthread_mutex_unlock(&src->lock);
+		pthread_join(src->thread, NULL);
+	}
+
+	if (src->mode != FILE_SOURCE_READ) {
+		pthread_cond_destroy(&src->cond);
+		pthread_mutex_destroy(&src->lock);
+	}
+
+	if (src->map)
+		munmap(src->map, src->size);
+	free(src->scratch);
+	free(src);
+}
+
+/*
+ * read a whole file into memory
+ *
+ * @fd       file descriptor, pipes included
+ * @len      length read
+ *
+ * for sources parsed as a whole, e.g. video byte streams.
+ */
+void *file_source_load(int fd, size_t *len)
+{
+	size_t size = FILE_SOURCE_CHUNK;
+	char *buf = NULL, *tmp;
+	ssize_t n;
+
+	*len = 0;
+	for (;;) {
+		if (!buf || *len == size) {
+			if (buf)
+				size *= 2;
+			tmp = realloc(buf, size);
+			if (!tmp)
+				goto error;
+			buf = tmp;
+		}
+
+		n = read(fd, buf + *len, size - *len);
+		if (n < 0) {
+			if (errno == EINTR)
+				continue;
+			goto error;
+		}
+		if (!n)
+			break;
+		*len += n;
+	}
+
+	return buf;
+
+error:
+	perror("file_source_load");
+	free(buf);
+
+	return NULL;
+}
+
+int file_source_parse_mode(const char *name, enum file_source_mode *mode)
+{
+	int i;
+
+	for (i = 0; i < sizeof(mode_names) / sizeof(mode_names[0]); i++) {
+		if (!strcmp(name, mode_names[i])) {
+			*mode = i;
+			return 0;
+		}
+	}
+
+	return -1;
+}
+
+const char *file_source_mode_name(enum file_source_mode mode)
+{
+	return mode_names[mode];
+}
@@ -0,0 +1,56 @@
+/*
+ * Copyright (c) 2014-2016 Renesas Electronics Corporation
+ * Released under the MIT license
+ * http://opensource.org/licenses/mit-license.php
+ */
+
+#ifndef __FILE_SOURCE_H__
+#define __FILE_SOURCE_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <pthread.h>
+#include <sys/types.h>
+#include <sys/uio.h>
+
+enum file_source_mode {
+	FILE_SOURCE_AUTO = 0, /* mmap for regular files, read otherwise */
+	FILE_SOURCE_READ,     /* readv() only */
+	FILE_SOURCE_MMAP,     /* copy from mapping, pages faulted ahead */
+	FILE_SOURCE_FADVISE,  /* readv(), page cache filled ahead */
+};
+
+/*
+ * file source of Talker
+ *
+ * regular files are read ahead by a thread, so that the process
+ * loop does not wait for the storage on page cache misses.
+ */
+struct file_source {
+	int                   fd;
+	enum file_source_mode mode;
+	off_t                 size;
+	void                  *map;
+	off_t                 pos;    /* consumed by the process loop */
+	off_t                 ahead;  /* read ahead by the thread */
+	size_t                window;
+
+	pthread_t             thread;
+	bool                  running;
+	bool                  stop;
+	pthread_mutex_t       lock;
+	pthread_cond_t        cond;
+	void                  *scratch;
+};
+
+extern struct file_source *file_source_open(int fd,
+					    enum file_source_mode mode);
+extern ssize_t file_source_readv(struct file_source *src,
+				 const struct iovec *iov, int iovcnt);
+extern void file_source_close(struct file_source *src);
+extern void *file_source_load(int fd, size_t *len);
+extern int file_source_parse_mode(const char *name,
+				  enum file_source_mode *mode);
+extern const char *file_source_mode_name(enum file_source_mode mode);
+
+#endif /* __FILE_SOURCE_H__ */
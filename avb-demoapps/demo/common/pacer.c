@@ -0,0 +1,134 @@
+/*
+ * Copyright (c) 2014-2016 Renesas Electronics Corporation
+ * Released under the MIT license
+ * http://opensource.org/licenses/mit-license.php
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <inttypes.h>
+
+#include "clock.h"
+#include "pacer.h"
+
+#define NSEC_SCALE (1000000000ull)
+
+static inline void ns_to_timespec(uint64_t ns, struct timespec *ts)
+{
+	ts->tv_sec = ns / NSEC_SCALE;
+	ts->tv_nsec = ns % NSEC_SCALE;
+}
+
+/* sleep until deadline of clkid */
+static int pacer_sleep(struct pacer *p, uint64_t deadline)
+{
+	struct timespec ts;
+	uint64_t now;
+	int ret;
+
+	if (!p->mapped) {
+		ns_to_timespec(deadline, &ts);
+		ret = clock_nanosleep(p->clkid, TIMER_ABSTIME, &ts, NULL);
+		return ret ? -1 : 0;
+	}
+
+	/* the clocks drift apart slowly, map again on early wakeup */
+	while ((now = clock_getcount(p->clkid)) < deadline) {
+		ns_to_timespec(clock_getcount(CLOCK_MONOTONIC) +
+			       (deadline - now), &ts);
+		ret = clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts,
+				      NULL);
+		if (ret)
+			return -1;
+	}
+
+	return 0;
+}
+
+/*
+ * initialize pacer
+ *
+ * @p        pacer
+ * @clkid    clock of the deadlines
+ * @period   period of the deadlines [ns]
+ * @start    first deadline on clkid [ns]
+ */
+int pacer_init(struct pacer *p, clockid_t clkid, uint64_t period,
+	       uint64_t start)
+{
+	struct timespec ts = { 0, 0 };
+
+	if (!period)
+		return -1;
+
+	memset(p, 0, sizeof(*p));
+	p->clkid = clkid;
+	p->period = period;
+	p->next = start;
+
+	/* a deadline in the past returns at once if supported */
+	if (clock_nanosleep(clkid, TIMER_ABSTIME, &ts, NULL))
+		p->mapped = true;
+
+	return 0;
+}
+
+/*
+ * wait for the next deadline
+ *
+ * @p        pacer
+ * @deadline the deadline waited for, on clkid [ns]
+ *
+ * returns -1 if interrupted by a signal, the deadline stays pending.
+ */
+int pacer_wait(struct pacer *p, uint64_t *deadline)
+{
+	uint64_t late;
+	int i;
+
+	if (pacer_sleep(p, p->next) < 0)
+		return -1;
+
+	late = clock_getcount(p->clkid) - p->next;
+
+	p->count++;
+	p->late_total += late;
+	if (late > p->late_max)
+		p->late_max = late;
+	p->missed += late / p->period;
+
+	for (i = 0, late /= 1000; late && i < PACER_HIST - 1; i++)
+		late >>= 1;
+	p->hist[i]++;
+
+	*deadline = p->next;
+	p->next += p->period;
+
+	return 0;
+}
+
+/*
+ * report lateness of the wakeups
+ *
+ * @p        pacer
+ * @buf      output buffer
+ * @buflen   size of output buffer
+ */
+void pacer_report(struct pacer *p, char *buf, int buflen)
+{
+	int i, len;
+
+	len = snprintf(buf, buflen,
+		       "pace %" PRIu64 " us%s late avg %.1f max %.1f us"
+		       " missed %" PRIu64 " hist[us]",
+		       p->period / 1000, p->mapped ? " (mapped)" : "",
+		       p->count ? (double)p->late_total / p->count / 1000 : 0,
+		       (double)p->late_max / 1000, p->missed);
+
+	for (i = 0; i < PACER_HIST && len < buflen; i++) {
+		if (!p->hist[i])
+			continue;
+		len += snprintf(buf + len, buflen - len, " <%d:%" PRIu64,
+				1 << i, p->hist[i]);
+	}
+}
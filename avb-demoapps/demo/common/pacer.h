@@ -0,0 +1,42 @@
+/*
+ * Copyright (c) 2014-2016 Renesas Electronics Corporation
+ * Released under the MIT license
+ * http://opensource.org/licenses/mit-license.php
+ */
+
+#ifndef __PACER_H__
+#define __PACER_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <time.h>
+
+#define PACER_HIST (16)
+
+/*
+ * periodic wakeup on absolute deadlines of a clock
+ *
+ * deadlines are kept on the clock given to pacer_init(). clocks
+ * clock_nanosleep() does not support, such as PTP clocks, are slept
+ * on CLOCK_MONOTONIC with the deadline mapped at each wait.
+ */
+struct pacer {
+	clockid_t clkid;
+	bool      mapped;     /* sleeping on CLOCK_MONOTONIC */
+	uint64_t  period;     /* [ns] */
+	uint64_t  next;       /* next deadline on clkid [ns] */
+
+	/* telemetry, lateness of the wakeups */
+	uint64_t  count;
+	uint64_t  late_total;
+	uint64_t  late_max;
+	uint64_t  missed;     /* periods passed while late */
+	uint64_t  hist[PACER_HIST]; /* log2 of lateness in us */
+};
+
+extern int pacer_init(struct pacer *p, clockid_t clkid, uint64_t period,
+		      uint64_t start);
+extern int pacer_wait(struct pacer *p, uint64_t *deadline);
+extern void pacer_report(struct pacer *p, char *buf, int buflen);
+
+#endif /* __PACER_H__ */
@@ -0,0 +1,148 @@
+/*
+ * Copyright (c) 2014-2016 Renesas Electronics Corporation
+ * Released under the MIT license
+ * http://opensource.org/licenses/mit-license.php
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <endian.h>
+#include <inttypes.h>
+
+#include "crc32c.h"
+#include "pattern.h"
+
+/* independent generators, so that the compiler vectorizes them */
+#define PATTERN_LANES (4)
+
+static inline void put_le32(uint8_t *p, uint32_t v)
+{
+	v = htole32(v);
+	memcpy(p, &v, sizeof(v));
+}
+
+static inline void put_le64(uint8_t *p, uint64_t v)
+{
+	v = htole64(v);
+	memcpy(p, &v, sizeof(v));
+}
+
+static inline uint32_t get_le32(const uint8_t *p)
+{
+	uint32_t v;
+
+	memcpy(&v, p, sizeof(v));
+
+	return le32toh(v);
+}
+
+static inline uint64_t splitmix64(uint64_t x)
+{
+	x += 0x9e3779b97f4a7c15ull;
+	x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ull;
+	x = (x ^ (x >> 27)) * 0x94d049bb133111ebull;
+
+	return x ^ (x >> 31);
+}
+
+/* bytes of xorshift64 lanes, interleaved by 8 bytes */
+static void pattern_body(uint64_t seed, uint64_t frame, uint8_t *p,
+			 size_t len)
+{
+	uint64_t s[PATTERN_LANES], w[PATTERN_LANES];
+	int i;
+
+	for (i = 0; i < PATTERN_LANES; i++)
+		s[i] = splitmix64(seed ^ (frame * PATTERN_LANES + i)) | 1;
+
+	while (len) {
+		for (i = 0; i < PATTERN_LANES; i++) {
+			s[i] ^= s[i] << 13;
+			s[i] ^= s[i] >> 7;
+			s[i] ^= s[i] << 17;
+			w[i] = htole64(s[i]);
+		}
+
+		if (len < sizeof(w)) {
+			memcpy(p, w, len);
+			break;
+		}
+		memcpy(p, w, sizeof(w));
+		p += sizeof(w);
+		len -= sizeof(w);
+	}
+}
+
+/*
+ * initialize pattern generator
+ *
+ * @p        generator
+ * @seed     seed of the pattern
+ */
+void pattern_init(struct pattern *p, uint64_t seed)
+{
+	p->seed = seed;
+	p->frame = 0;
+}
+
+/*
+ * fill the payload of the next frame
+ *
+ * @p        generator
+ * @buf      payload
+ * @len      length of payload, PATTERN_HEADER_SIZE at least
+ */
+int pattern_fill(struct pattern *p, void *buf, size_t len)
+{
+	uint8_t *b = buf;
+
+	if (len < PATTERN_HEADER_SIZE)
+		return -1;
+
+	put_le32(b + 4, len);
+	put_le64(b + 8, p->frame);
+	pattern_body(p->seed, p->frame, b + PATTERN_HEADER_SIZE,
+		     len - PATTERN_HEADER_SIZE);
+	put_le32(b, crc32c(0, b + 4, len - 4));
+	p->frame++;
+
+	return 0;
+}
+
+/*
+ * whether the payload of a frame is intact
+ *
+ * @buf      payload
+ * @len      length of payload
+ */
+bool pattern_verify(const void *buf, size_t len)
+{
+	const uint8_t *b = buf;
+
+	return len >= PATTERN_HEADER_SIZE && get_le32(b + 4) == len &&
+		get_le32(b) == crc32c(0, b + 4, len - 4);
+}
+
+/*
+ * account the payload of a frame
+ *
+ * @c        verifier
+ * @buf      payload
+ * @len      length of payload
+ */
+void pattern_check(struct pattern_check *c, const void *buf, size_t len)
+{
+	c->frames++;
+
+	if (len < PATTERN_HEADER_SIZE)
+		c->short_frames++;
+	else if (!pattern_verify(buf, len))
+		c->corrupted++;
+}
+
+void pattern_check_report(struct pattern_check *c, char *buf, int buflen)
+{
+	snprintf(buf, buflen, "verify %" PRIu64 " frames corrupted %" PRIu64
+		 " short %" PRIu64 " (crc32c %s)", c->frames, c->corrupted,
+		 c->short_frames, crc32c_name());
+}
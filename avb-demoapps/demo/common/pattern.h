@@ -0,0 +1,45 @@
+/*
+ * Copyright (c) 2014-2016 Renesas Electronics Corporation
+ * Released under the MIT license
+ * http://opensource.org/licenses/mit-license.php
+ */
+
+#ifndef __PATTERN_H__
+#define __PATTERN_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+/*
+ * payload of a pattern frame, little endian
+ *
+ *  0: CRC32C of the payload from offset 4
+ *  4: length of the payload
+ *  8: frame number
+ * 16: pseudo random bytes seeded by the seed and the frame number
+ */
+#define PATTERN_HEADER_SIZE (16)
+
+/* generator of pattern frames */
+struct pattern {
+	uint64_t seed;
+	uint64_t frame;
+};
+
+/* verifier of pattern frames */
+struct pattern_check {
+	uint64_t frames;
+	uint64_t corrupted;   /* CRC32C or length mismatch */
+	uint64_t short_frames; /* shorter than the header */
+};
+
+extern void pattern_init(struct pattern *p, uint64_t seed);
+extern int pattern_fill(struct pattern *p, void *buf, size_t len);
+extern bool pattern_verify(const void *buf, size_t len);
+extern void pattern_check(struct pattern_check *c, const void *buf,
+			  size_t len);
+extern void pattern_check_report(struct pattern_check *c, char *buf,
+				 int buflen);
+
+#endif /* __PATTERN_H__ */
@@ -0,0 +1,191 @@
+/*
+ * Copyright (c) 2014-2016 Renesas Electronics Corporation
+ * Released under the MIT license
+ * http://opensource.org/licenses/mit-license.php
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <inttypes.h>
+
+#include "seqnum.h"
+
+static inline void seqnum_set(struct seqnum *s, uint8_t seq)
+{
+	s->seen[seq / 64] |= 1ull << (seq % 64);
+}
+
+static inline void seqnum_clear(struct seqnum *s, uint8_t seq)
+{
+	s->seen[seq / 64] &= ~(1ull << (seq % 64));
+}
+
+static inline bool seqnum_test(struct seqnum *s, uint8_t seq)
+{
+	return s->seen[seq / 64] & (1ull << (seq % 64));
+}
+
+/* start tracking again from seq */
+static void seqnum_start(struct seqnum *s, uint8_t seq, uint32_t ts, bool tv)
+{
+	memset(s->seen, 0, sizeof(s->seen));
+	seqnum_set(s, seq);
+	s->expected = seq + 1;
+	s->timed = tv;
+	s->last_ts = ts;
+	s->since = 0;
+	s->interval = 0;
+	s->started = true;
+}
+
+/*
+ * seq is the next one after a gap of packets, the gap is measured
+ * by the timestamps unless known by the sequence number
+ */
+static void seqnum_advance(struct seqnum *s, uint8_t seq, uint32_t ts,
+			   bool tv, uint64_t gap, bool known)
+{
+	uint8_t i;
+	int k;
+
+	/* a number passed by is either received or cleared as a gap */
+	for (i = s->expected; i != seq; i++)
+		seqnum_clear(s, i);
+	seqnum_set(s, seq);
+	s->expected = seq + 1;
+
+	/*
+	 * until the interval is known, a gap of the sequence number may
+	 * have wrapped, so that only packets in a row give the interval
+	 */
+	if (!tv) {
+		s->since += gap + 1;
+		if (gap && !s->interval)
+			s->timed = false;
+	} else {
+		if (known && s->timed && (s->interval || !gap) &&
+		    (int32_t)(ts - s->last_ts) > 0)
+			s->interval = (ts - s->last_ts) /
+				(s->since + gap + 1);
+		s->timed = true;
+		s->last_ts = ts;
+		s->since = 0;
+	}
+
+	if (!gap)
+		return;
+
+	s->lost += gap;
+	s->bursts++;
+	if (gap > s->burst_max)
+		s->burst_max = gap;
+	for (k = 0; gap >> (k + 1) && k < SEQNUM_BURST_HIST - 1; k++)
+		;
+	s->burst_hist[k]++;
+}
+
+/*
+ * check sequence number of a packet
+ *
+ * @s        checker of the stream
+ * @seq      sequence_num of the packet
+ * @ts       avtp_timestamp of the packet
+ * @tv       the timestamp is valid
+ *
+ * a loss of more than SEQNUM_REORDER_WINDOW packets is measured by
+ * the timestamps, as the sequence number wraps within it.
+ */
+enum seqnum_class seqnum_check(struct seqnum *s, uint8_t seq, uint32_t ts,
+			       bool tv)
+{
+	uint8_t ahead;
+	uint64_t gap, n;
+	int32_t elapsed;
+
+	s->received++;
+
+	if (!s->started) {
+		seqnum_start(s, seq, ts, tv);
+		return SEQNUM_IN_ORDER;
+	}
+
+	ahead = seq - s->expected;
+	gap = ahead;
+
+	elapsed = ts - s->last_ts;
+	if (tv && s->timed && s->interval && elapsed > 0) {
+		/* packets from the last one in order by the timestamps */
+		n = ((uint64_t)elapsed + s->interval / 2) / s->interval;
+		n = (n > s->since) ? n - s->since : 0;
+		if (n > SEQNUM_RESYNC_GAP)
+			goto resync;
+
+		/* the gap nearest to n - 1 with the sequence number */
+		if (n > SEQNUM_REORDER_WINDOW) {
+			if (n - 1 > ahead)
+				gap += (n - 1 - ahead + 128) / 256 * 256;
+			seqnum_advance(s, seq, ts, tv, gap, false);
+			return gap ? SEQNUM_LOSS : SEQNUM_IN_ORDER;
+		}
+	}
+
+	if (!ahead) {
+		seqnum_advance(s, seq, ts, tv, 0, true);
+		return SEQNUM_IN_ORDER;
+	}
+
+	if (ahead < 256 - SEQNUM_REORDER_WINDOW) {
+		seqnum_advance(s, seq, ts, tv, gap, true);
+		return SEQNUM_LOSS;
+	}
+
+	/* behind by SEQNUM_REORDER_WINDOW at most, as ahead is not less */
+	if (seqnum_test(s, seq)) {
+		s->duplicates++;
+		return SEQNUM_DUPLICATE;
+	}
+
+	/* arrived after a later one, it was not lost after all */
+	seqnum_set(s, seq);
+	s->reordered++;
+	if (s->lost)
+		s->lost--;
+
+	return SEQNUM_REORDER;
+
+resync:
+	s->resyncs++;
+	seqnum_start(s, seq, ts, tv);
+
+	return SEQNUM_RESYNC;
+}
+
+/*
+ * report sequence number checker
+ *
+ * @s        checker of the stream
+ * @buf      output buffer
+ * @buflen   size of output buffer
+ */
+void seqnum_report(struct seqnum *s, char *buf, int buflen)
+{
+	int i, len;
+
+	len = snprintf(buf, buflen,
+		       "seq received %" PRIu64 " lost %" PRIu64
+		       " reordered %" PRIu64 " duplicates %" PRIu64
+		       " resyncs %" PRIu64 " bursts %" PRIu64
+		       " max %" PRIu64,
+		       s->received, s->lost, s->reordered, s->duplicates,
+		       s->resyncs, s->bursts, s->burst_max);
+
+	if (!s->bursts)
+		return;
+
+	for (i = 0; i < SEQNUM_BURST_HIST && len < buflen; i++) {
+		if (!s->burst_hist[i])
+			continue;
+		len += snprintf(buf + len, buflen - len, " <%d:%" PRIu64,
+				2 << i, s->burst_hist[i]);
+	}
+}
@@ -0,0 +1,59 @@
+/*
+ * Copyright (c) 2014-2016 Renesas Electronics Corporation
+ * Released under the MIT license
+ * http://opensource.org/licenses/mit-license.php
+ */
+
+#ifndef __SEQNUM_H__
+#define __SEQNUM_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/* sequence numbers behind the expected one that are still reordering */
+#define SEQNUM_REORDER_WINDOW (64)
+/* packets lost by the timestamps beyond which the stream starts again */
+#define SEQNUM_RESYNC_GAP     (65536)
+#define SEQNUM_BURST_HIST     (12)
+
+enum seqnum_class {
+	SEQNUM_IN_ORDER,
+	SEQNUM_LOSS,       /* after the expected, the gap is lost */
+	SEQNUM_REORDER,    /* behind, counted lost before */
+	SEQNUM_DUPLICATE,  /* behind, received before */
+	SEQNUM_RESYNC,     /* too far by the timestamps, starts again */
+};
+
+/*
+ * sequence number checker of a stream
+ *
+ * the 8-bit sequence_num of AVTP is tracked with a bitmap of the
+ * numbers received, so that a late packet is told from a duplicate.
+ * the avtp_timestamp of packets in order gives the interval, which
+ * measures losses longer than the sequence number can. a packet
+ * without tv is placed by the sequence number only.
+ */
+struct seqnum {
+	bool     started;
+	uint8_t  expected;
+	uint64_t seen[256 / 64];
+	bool     timed;        /* last_ts is of a packet of the stream */
+	uint32_t last_ts;      /* of the last packet in order with tv */
+	uint64_t since;        /* packets after the one of last_ts */
+	uint32_t interval;     /* of avtp_timestamp, 0:unknown */
+
+	uint64_t received;
+	uint64_t lost;         /* net of reordered packets */
+	uint64_t reordered;
+	uint64_t duplicates;
+	uint64_t resyncs;
+	uint64_t bursts;       /* gaps */
+	uint64_t burst_max;
+	uint64_t burst_hist[SEQNUM_BURST_HIST]; /* log2 of gap length */
+};
+
+extern enum seqnum_class seqnum_check(struct seqnum *s, uint8_t seq,
+				      uint32_t ts, bool tv);
+extern void seqnum_report(struct seqnum *s, char *buf, int buflen);
+
+#endif /* __SEQNUM_H__ */
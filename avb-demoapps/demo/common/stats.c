@@ -37,18 +37,364 @@ static inline char *stats_guess_label(double value)
 		return "G";
 }
 
+#define NSEC_SCALE (1000000000ull)
+
+static inline uint64_t stats_ns(struct timespec *ts)
+{
+	return ts->tv_sec * NSEC_SCALE + ts->tv_nsec;
+}
+
+static void stats_batches_add(struct stats_batches *b, bool measured,
+			      uint64_t gap, int count)
+{
+	uint64_t jitter;
+	int k;
+
+	b->count++;
+	b->packets += count;
+	if (count > b->burst_max)
+		b->burst_max = count;
+	for (k = 0; count >> (k + 1) && k < STATS_BURST_HIST - 1; k++)
+		;
+	b->burst_hist[k]++;
+
+	if (!measured)
+		return;
+
+	if (!b->gaps || gap < b->gap_min)
+		b->gap_min = gap;
+	if (gap > b->gap_max)
+		b->gap_max = gap;
+	b->gap_total += gap;
+
+	if (b->gaps) {
+		jitter = gap > b->gap_last ? gap - b->gap_last :
+			b->gap_last - gap;
+		b->jitter_total += jitter;
+		if (jitter > b->jitter_max)
+			b->jitter_max = jitter;
+	}
+	b->gap_last = gap;
+	b->gaps++;
+}
+
+static void stats_rate_add(struct stats_rate *r, double bps)
+{
+	if (!r->windows || bps < r->min)
+		r->min = bps;
+	if (bps > r->max)
+		r->max = bps;
+	r->windows++;
+}
+
+static inline void stats_id_name(const uint8_t *id, char *buf, int buflen)
+{
+	snprintf(buf, buflen, "%02x%02x%02x%02x%02x%02x:%02x%02x",
+		 id[0], id[1], id[2], id[3], id[4], id[5], id[6], id[7]);
+}
+
 /*
  * public functions
  */
-void stats_process(struct app_stats *stats, int length)
+
+/*
+ * account packets
+ *
+ * @stats    statistics
+ * @st       stream of the packets, NULL:none
+ * @packets  number of packets
+ * @bytes    length of the packets
+ */
+void stats_add(struct app_stats *stats, struct stats_stream *st,
+	       int packets, uint64_t bytes)
 {
 	if (!stats->start) {
 		clock_gettime(CLOCK_MONOTONIC, &stats->stime);
+		stats->win_start = stats_ns(&stats->stime);
 		stats->start = true;
 	}
 
-	stats->bytes += length;
-	stats->packets++;
+	stats->bytes += bytes;
+	stats->packets += packets;
+
+	if (st) {
+		st->bytes += bytes;
+		st->packets += packets;
+		stats->dirty |= st->bit;
+	}
+}
+
+static void stats_publish(struct app_stats *stats, uint64_t now)
+{
+	struct stats_shm_counters v;
+	struct stats_stream *st;
+	uint64_t dirty;
+	int i;
+
+	while (stats->published < stats->streamnum)
+		stats_shm_add_stream(stats->shm,
+				     stats->streams[stats->published++].id);
+
+	for (dirty = stats->dirty; dirty; dirty &= dirty - 1) {
+		i = __builtin_ctzll(dirty);
+		st = &stats->streams[i];
+
+		v.time = now;
+		v.packets = st->packets;
+		v.bytes = st->bytes;
+		v.lost = st->seq.lost;
+		v.errors = st->seq.reordered + st->seq.duplicates +
+			st->seq.resyncs;
+		v.late = st->margin.late;
+		v.early = st->margin.early;
+		stats_shm_write(&stats->shm->streams[i], &v);
+	}
+	stats->dirty = 0;
+
+	memset(&v, 0, sizeof(v));
+	v.time = now;
+	v.packets = stats->packets;
+	v.bytes = stats->bytes;
+	v.lost = stats->dropped;
+	v.errors = stats->errors;
+	stats_shm_write(&stats->shm->total, &v);
+}
+
+/*
+ * account a batch of packets
+ *
+ * @stats    statistics
+ * @now      time of the batch [ns] of CLOCK_MONOTONIC, see stats_now()
+ * @count    packets of the batch
+ *
+ * the counters of the batch are published to the segment, if any.
+ */
+void stats_batch(struct app_stats *stats, uint64_t now, int count)
+{
+	bool measured = stats->last_batch != 0;
+	uint64_t gap = now - stats->last_batch;
+
+	if (count <= 0)
+		return;
+
+	stats_batches_add(&stats->batches, measured, gap, count);
+	stats_batches_add(&stats->win, measured, gap, count);
+	stats->last_batch = now;
+
+	if (stats->shm)
+		stats_publish(stats, now);
+}
+
+/*
+ * whether the window of the periodic report is over
+ *
+ * @stats    statistics
+ * @now      [ns] of CLOCK_MONOTONIC
+ *
+ * the window is reported and stats_window_next() starts the next one.
+ */
+bool stats_tick(struct app_stats *stats, uint64_t now)
+{
+	return stats->period && stats->start &&
+		now - stats->win_start >= stats->period;
+}
+
+void stats_window_report(struct app_stats *stats, uint64_t now,
+			 char *buf, int buflen)
+{
+	double duration, bps;
+	int len;
+
+	duration = (double)(now - stats->win_start) / NSEC_SCALE;
+	bps = (double)((stats->bytes - stats->win_bytes) * 8) / duration;
+
+	len = snprintf(buf, buflen, "window %.3fs %"PRIu64"packets"
+		       " %.3f%sbps dropped %"PRIu64" errors %"PRIu64" ",
+		       duration, stats->packets - stats->win_packets,
+		       bps/stats_guess_unit(bps), stats_guess_label(bps),
+		       stats->dropped - stats->win_dropped,
+		       stats->errors - stats->win_errors);
+	if (len < buflen)
+		stats_batches_report(&stats->win, buf + len, buflen - len);
+}
+
+/*
+ * start the next window of the periodic report
+ *
+ * @stats    statistics
+ * @now      [ns] of CLOCK_MONOTONIC
+ *
+ * the rate of the window is accounted in the range of the rates, of
+ * the streams which were received at the start of the window.
+ */
+void stats_window_next(struct app_stats *stats, uint64_t now)
+{
+	struct stats_stream *st;
+	double duration;
+	int i;
+
+	duration = (double)(now - stats->win_start) / NSEC_SCALE;
+	if (duration <= 0)
+		return;
+
+	stats_rate_add(&stats->rate,
+		       (stats->bytes - stats->win_bytes) * 8 / duration);
+	stats->win_start = now;
+	stats->win_bytes = stats->bytes;
+	stats->win_packets = stats->packets;
+	stats->win_dropped = stats->dropped;
+	stats->win_errors = stats->errors;
+	memset(&stats->win, 0, sizeof(stats->win));
+
+	for (i = 0; i < stats->streamnum; i++) {
+		st = &stats->streams[i];
+		if (st->win_packets)
+			stats_rate_add(&st->rate, (st->bytes - st->win_bytes) *
+				       8 / duration);
+		st->win_bytes = st->bytes;
+		st->win_packets = st->packets;
+		st->win_lost = st->seq.lost;
+	}
+}
+
+static void stats_json_batches(FILE *fp, struct stats_batches *b)
+{
+	fprintf(fp, ",\"batches\":%"PRIu64",\"burst_avg\":%.2f"
+		",\"burst_max\":%"PRIu64, b->count,
+		b->count ? (double)b->packets / b->count : 0.0, b->burst_max);
+
+	if (!b->gaps)
+		return;
+
+	fprintf(fp, ",\"arrival_ns\":{\"min\":%"PRIu64",\"avg\":%"PRIu64
+		",\"max\":%"PRIu64"},\"jitter_ns\":{\"avg\":%"PRIu64
+		",\"max\":%"PRIu64"}", b->gap_min, b->gap_total / b->gaps,
+		b->gap_max, b->gaps > 1 ? b->jitter_total / (b->gaps - 1) : 0,
+		b->jitter_max);
+}
+
+static void stats_json_stream(FILE *fp, struct stats_stream *st,
+			      double duration, bool total)
+{
+	struct stats_margin *m = &st->margin;
+	uint64_t bytes, packets, lost;
+	char name[32];
+
+	stats_id_name(st->id, name, sizeof(name));
+
+	bytes = st->bytes - (total ? 0 : st->win_bytes);
+	packets = st->packets - (total ? 0 : st->win_packets);
+	lost = st->seq.lost - (total ? 0 : st->win_lost);
+
+	fprintf(fp, "{\"id\":\"%s\",\"packets\":%"PRIu64
+		",\"bytes\":%"PRIu64",\"bps\":%.1f,\"lost\":%"PRIu64,
+		name, packets, bytes, bytes * 8 / duration, lost);
+
+	if (total) {
+		fprintf(fp, ",\"reordered\":%"PRIu64",\"duplicates\":%"PRIu64
+			",\"resyncs\":%"PRIu64, st->seq.reordered,
+			st->seq.duplicates, st->seq.resyncs);
+		if (st->rate.windows)
+			fprintf(fp, ",\"bps_min\":%.1f,\"bps_max\":%.1f",
+				st->rate.min, st->rate.max);
+		if (m->count)
+			fprintf(fp, ",\"margin_ns\":{\"min\":%"PRId64
+				",\"avg\":%"PRId64",\"max\":%"PRId64
+				",\"p1\":%"PRId64",\"p50\":%"PRId64
+				",\"late\":%"PRIu64",\"early\":%"PRIu64"}",
+				m->min, m->total / (int64_t)m->count, m->max,
+				stats_margin_percentile(m, 0.01),
+				stats_margin_percentile(m, 0.5),
+				m->late, m->early);
+	}
+
+	fputc('}', fp);
+}
+
+/*
+ * open output of JSON lines
+ *
+ * @name     file name, or stdout, stderr and - for stdout
+ */
+FILE *stats_open_json(const char *name)
+{
+	if (!strcmp(name, "-") || !strcmp(name, "stdout"))
+		return stdout;
+	if (!strcmp(name, "stderr"))
+		return stderr;
+
+	return fopen(name, "w");
+}
+
+void stats_close_json(FILE *fp)
+{
+	if (fp && fp != stdout && fp != stderr)
+		fclose(fp);
+}
+
+/*
+ * write a JSON line of the statistics
+ *
+ * @stats    statistics
+ * @now      [ns] of CLOCK_MONOTONIC
+ * @total    the whole run instead of the window
+ */
+void stats_json(struct app_stats *stats, uint64_t now, bool total)
+{
+	FILE *fp = stats->json;
+	struct stats_batches *b;
+	uint64_t start, bytes, packets, dropped, errors;
+	double duration;
+	int i;
+
+	if (!fp || !stats->start)
+		return;
+
+	start = stats_ns(&stats->stime);
+	if (total) {
+		b = &stats->batches;
+		bytes = stats->bytes;
+		packets = stats->packets;
+		dropped = stats->dropped;
+		errors = stats->errors;
+	} else {
+		b = &stats->win;
+		bytes = stats->bytes - stats->win_bytes;
+		packets = stats->packets - stats->win_packets;
+		dropped = stats->dropped - stats->win_dropped;
+		errors = stats->errors - stats->win_errors;
+		start = stats->win_start;
+	}
+
+	duration = (double)(now - start) / NSEC_SCALE;
+	if (duration <= 0)
+		return;
+
+	fprintf(fp, "{\"type\":\"%s\",\"name\":\"%s\",\"time\":%.6f"
+		",\"duration\":%.6f,\"packets\":%"PRIu64",\"bytes\":%"PRIu64
+		",\"pps\":%.1f,\"bps\":%.1f,\"dropped\":%"PRIu64
+		",\"errors\":%"PRIu64, total ? "total" : "window",
+		stats->name ? stats->name : "",
+		(double)(now - stats_ns(&stats->stime)) / NSEC_SCALE,
+		duration, packets, bytes, packets / duration,
+		bytes * 8 / duration, dropped, errors);
+
+	stats_json_batches(fp, b);
+
+	if (total && stats->rate.windows)
+		fprintf(fp, ",\"bps_min\":%.1f,\"bps_max\":%.1f",
+			stats->rate.min, stats->rate.max);
+	if (total && stats->untracked)
+		fprintf(fp, ",\"untracked\":%"PRIu64, stats->untracked);
+
+	fputs(",\"streams\":[", fp);
+	for (i = 0; i < stats->streamnum; i++) {
+		if (i)
+			fputc(',', fp);
+		stats_json_stream(fp, &stats->streams[i], duration, total);
+	}
+	fputs("]}\n", fp);
+	fflush(fp);
 }
 
 void stats_report(struct app_stats *stats, char *buf, int buflen)
@@ -72,9 +418,287 @@ void stats_report(struct app_stats *stats, char *buf, int buflen)
 	duration = (double)(et - st) / 1000000;
 	bps = (double)(stats->bytes * 8) / duration;
 
-	snprintf(buf, buflen, "%"PRIu64"packets %.3f%sB/%.3fs=%.3f%sbps",
+	snprintf(buf, buflen, "%"PRIu64"packets %.3f%sB/%.3fs=%.3f%sbps"
+		" dropped %"PRIu64" errors %"PRIu64,
 		stats->packets,
 		total/stats_guess_unit(total), stats_guess_label(total),
 		duration,
-		bps/stats_guess_unit(bps), stats_guess_label(bps));
+		bps/stats_guess_unit(bps), stats_guess_label(bps),
+		stats->dropped, stats->errors);
+
+	if (stats->rate.windows)
+		snprintf(buf + strlen(buf), buflen - strlen(buf),
+			 " window min %.3f%sbps max %.3f%sbps",
+			 stats->rate.min/stats_guess_unit(stats->rate.min),
+			 stats_guess_label(stats->rate.min),
+			 stats->rate.max/stats_guess_unit(stats->rate.max),
+			 stats_guess_label(stats->rate.max));
+}
+
+/*
+ * report batches of packets
+ *
+ * @b        batches
+ * @buf      output buffer
+ * @buflen   size of output buffer
+ */
+void stats_batches_report(struct stats_batches *b, char *buf, int buflen)
+{
+	int len;
+
+	len = snprintf(buf, buflen, "batches %"PRIu64" burst avg %.2f"
+		       " max %"PRIu64, b->count,
+		       b->count ? (double)b->packets / b->count : 0.0,
+		       b->burst_max);
+
+	if (!b->gaps || len >= buflen)
+		return;
+
+	snprintf(buf + len, buflen - len, " arrival[us] min %.1f avg %.1f"
+		 " max %.1f jitter[us] avg %.1f max %.1f",
+		 (double)b->gap_min / 1000,
+		 (double)b->gap_total / b->gaps / 1000,
+		 (double)b->gap_max / 1000,
+		 b->gaps > 1 ? (double)b->jitter_total / (b->gaps - 1) / 1000 :
+		 0.0, (double)b->jitter_max / 1000);
+}
+
+/*
+ * report packets of a stream
+ *
+ * @st       stream
+ * @buf      output buffer
+ * @buflen   size of output buffer
+ */
+void stats_stream_report(struct stats_stream *st, char *buf, int buflen)
+{
+	double total = (double)st->bytes;
+	int len;
+
+	len = snprintf(buf, buflen, "%"PRIu64"packets %.3f%sB",
+		       st->packets, total/stats_guess_unit(total),
+		       stats_guess_label(total));
+
+	if (!st->rate.windows || len >= buflen)
+		return;
+
+	snprintf(buf + len, buflen - len, " window min %.3f%sbps max %.3f%sbps",
+		 st->rate.min/stats_guess_unit(st->rate.min),
+		 stats_guess_label(st->rate.min),
+		 st->rate.max/stats_guess_unit(st->rate.max),
+		 stats_guess_label(st->rate.max));
+}
+
+static inline uint64_t stats_stream_key(const uint8_t *id)
+{
+	uint64_t key = 0;
+	int i;
+
+	for (i = 0; i < STATS_STREAMID_SIZE; i++)
+		key = key << 8 | id[i];
+
+	return key;
+}
+
+/*
+ * stream of a packet
+ *
+ * @stats    statistics
+ * @id       StreamID of the packet
+ *
+ * returns NULL once STATS_STREAM_MAX streams are known.
+ */
+struct stats_stream *stats_stream_get(struct app_stats *stats,
+				      const uint8_t *id)
+{
+	struct stats_stream *st;
+	uint64_t key = stats_stream_key(id);
+	unsigned int h;
+
+	/* packets of a stream come in runs */
+	if (stats->last && stats->last->key == key)
+		return stats->last;
+
+	/* open addressing, the table is never more than half full */
+	h = (key * 0x9e3779b97f4a7c15ull) >> 32;
+	for (;; h++) {
+		h &= STATS_STREAM_HASH - 1;
+		if (!stats->hash[h])
+			break;
+		st = &stats->streams[stats->hash[h] - 1];
+		if (st->key == key)
+			goto found;
+	}
+
+	if (stats->streamnum == STATS_STREAM_MAX) {
+		stats->untracked++;
+		return NULL;
+	}
+
+	st = &stats->streams[stats->streamnum];
+	memcpy(st->id, id, STATS_STREAMID_SIZE);
+	st->key = key;
+	st->bit = 1ull << stats->streamnum++;
+	stats->hash[h] = stats->streamnum;
+
+found:
+	stats->last = st;
+
+	return st;
+}
+
+/*
+ * account sequence number of a packet
+ *
+ * @stats    statistics, for dropped and errors
+ * @st       stream of the packet
+ * @seq      sequence_num of the packet
+ * @ts       avtp_timestamp of the packet
+ * @tv       the timestamp is valid
+ */
+void stats_sequence(struct app_stats *stats, struct stats_stream *st,
+		    uint8_t seq, uint32_t ts, bool tv)
+{
+	uint64_t lost = st->seq.lost;
+
+	switch (seqnum_check(&st->seq, seq, ts, tv)) {
+	case SEQNUM_IN_ORDER:
+	case SEQNUM_LOSS:
+		break;
+	case SEQNUM_REORDER:
+	case SEQNUM_DUPLICATE:
+	case SEQNUM_RESYNC:
+		stats->errors++;
+		break;
+	}
+
+	/* a reordered packet takes back one lost before */
+	stats->dropped += st->seq.lost - lost;
+}
+
+static inline int stats_margin_bucket(uint64_t v)
+{
+	int k;
+
+	if (v < STATS_MARGIN_SUB)
+		return v;
+
+	k = 63 - __builtin_clzll(v);
+	if (k > 31)
+		return STATS_MARGIN_HIST - 1;
+
+	/* k >= 3: octave and the 3 bits below its top bit */
+	return STATS_MARGIN_SUB * (k - 2) +
+		((v >> (k - 3)) & (STATS_MARGIN_SUB - 1));
+}
+
+/* middle of the values of a bucket */
+static inline uint64_t stats_margin_value(int idx)
+{
+	int k, sub;
+
+	if (idx < STATS_MARGIN_SUB)
+		return idx;
+
+	k = idx / STATS_MARGIN_SUB + 2;
+	sub = idx % STATS_MARGIN_SUB;
+
+	return ((uint64_t)(STATS_MARGIN_SUB + sub) << (k - 3)) +
+		((1ull << (k - 3)) >> 1);
+}
+
+/*
+ * account presentation time margin of a packet
+ *
+ * @stats    statistics, for the early limit
+ * @st       stream of the packet
+ * @margin   presentation time - arrival time [ns]
+ */
+void stats_margin(struct app_stats *stats, struct stats_stream *st,
+		  int64_t margin)
+{
+	struct stats_margin *m = &st->margin;
+
+	if (!m->count || margin < m->min)
+		m->min = margin;
+	if (!m->count || margin > m->max)
+		m->max = margin;
+	m->count++;
+	m->total += margin;
+
+	if (margin < 0) {
+		m->late++;
+		m->hist_late[stats_margin_bucket(-margin)]++;
+	} else {
+		if (stats->early_limit && margin > stats->early_limit)
+			m->early++;
+		m->hist_early[stats_margin_bucket(margin)]++;
+	}
+}
+
+/*
+ * margin below which a fraction of the packets are
+ *
+ * @m        margin statistics
+ * @p        fraction, 0.0 to 1.0
+ */
+static inline int64_t stats_margin_clamp(struct stats_margin *m, int64_t v)
+{
+	/* a bucket is wider than the values seen */
+	if (v < m->min)
+		return m->min;
+	if (v > m->max)
+		return m->max;
+
+	return v;
+}
+
+int64_t stats_margin_percentile(struct stats_margin *m, double p)
+{
+	uint64_t target, sum = 0;
+	int i;
+
+	if (!m->count)
+		return 0;
+
+	target = p * m->count;
+	if (target < 1)
+		target = 1;
+
+	/* from the latest packet to the earliest */
+	for (i = STATS_MARGIN_HIST - 1; i >= 0; i--) {
+		sum += m->hist_late[i];
+		if (sum >= target)
+			return stats_margin_clamp(m,
+					-(int64_t)stats_margin_value(i));
+	}
+
+	for (i = 0; i < STATS_MARGIN_HIST; i++) {
+		sum += m->hist_early[i];
+		if (sum >= target)
+			return stats_margin_clamp(m, stats_margin_value(i));
+	}
+
+	return m->max;
+}
+
+void stats_margin_report(struct stats_margin *m, char *buf, int buflen)
+{
+	if (!m->count) {
+		snprintf(buf, buflen, "margin no packets");
+		return;
+	}
+
+	snprintf(buf, buflen,
+		 "margin[us] min %.1f avg %.1f max %.1f"
+		 " p0.1 %.1f p1 %.1f p50 %.1f p99 %.1f"
+		 " late %" PRIu64 " early %" PRIu64,
+		 (double)m->min / 1000,
+		 (double)m->total / m->count / 1000,
+		 (double)m->max / 1000,
+		 (double)stats_margin_percentile(m, 0.001) / 1000,
+		 (double)stats_margin_percentile(m, 0.01) / 1000,
+		 (double)stats_margin_percentile(m, 0.5) / 1000,
+		 (double)stats_margin_percentile(m, 0.99) / 1000,
+		 m->late, m->early);
 }
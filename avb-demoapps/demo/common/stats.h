@@ -9,18 +9,159 @@
 
 #include <stdint.h>
 #include <stdbool.h>
+#include <time.h>
+#include <stdio.h>
+#include "seqnum.h"
+#include "stats_shm.h"
+
+/* a bit each in the dirty mask of 64 bits and in the segment */
+#define STATS_STREAM_MAX  (STATS_SHM_STREAM_MAX)
+#define STATS_STREAM_HASH (2 * STATS_STREAM_MAX)  /* power of 2 */
+#define STATS_STREAMID_SIZE (8)
+
+#define STATS_BURST_HIST  (12)
+
+/* 8 buckets per power of 2, exact below 8 ns, up to 2^32 ns */
+#define STATS_MARGIN_SUB  (8)
+#define STATS_MARGIN_HIST (STATS_MARGIN_SUB * 30)
+
+/*
+ * presentation time margin
+ *
+ * time from the arrival of a packet to its presentation time, late
+ * packets have a negative margin.
+ */
+struct stats_margin {
+	uint64_t        count;
+	uint64_t        late;    /* margin < 0 */
+	uint64_t        early;   /* margin > early limit */
+	int64_t         min;
+	int64_t         max;
+	int64_t         total;
+	uint64_t        hist_late[STATS_MARGIN_HIST];
+	uint64_t        hist_early[STATS_MARGIN_HIST];
+};
+
+/*
+ * batches of packets
+ *
+ * packets are taken from or pushed to the entries in batches, so that
+ * the time between batches is the inter-arrival time of the packets
+ * and the packets of a batch are a burst.
+ */
+struct stats_batches {
+	uint64_t        count;
+	uint64_t        packets;
+	uint64_t        burst_max;
+	uint64_t        burst_hist[STATS_BURST_HIST]; /* log2 of packets */
+	uint64_t        gaps;      /* inter-arrival times measured */
+	uint64_t        gap_min;   /* [ns] */
+	uint64_t        gap_max;
+	uint64_t        gap_total;
+	uint64_t        gap_last;
+	/* jitter, change of the inter-arrival time from the last one */
+	uint64_t        jitter_total;
+	uint64_t        jitter_max;
+};
+
+/* rate over the windows of the periodic report */
+struct stats_rate {
+	uint64_t        windows;
+	double          min;       /* [bps] */
+	double          max;
+};
+
+struct stats_stream {
+	uint8_t             id[STATS_STREAMID_SIZE];
+	uint64_t            key;
+	uint64_t            bit;         /* in the dirty mask */
+	uint64_t            bytes;
+	uint64_t            packets;
+	uint64_t            win_bytes;   /* at the start of the window */
+	uint64_t            win_packets;
+	uint64_t            win_lost;
+	struct stats_rate   rate;
+	struct seqnum       seq;
+	struct stats_margin margin;
+};
 
 struct app_stats {
 	bool            start;
 	struct timespec stime;
 	uint64_t        bytes;
 	uint64_t        packets;
-	uint64_t        dropped; /* TODO */
-	uint64_t        errors;  /* TODO */
+	uint64_t        dropped; /* lost by sequence number */
+	uint64_t        errors;  /* out of sequence or short, not lost */
+
+	/* periodic report, every period from the first packet */
+	const char      *name;
+	uint64_t        period;      /* [ns], 0:off */
+	FILE            *json;       /* JSON lines, NULL:off */
+	uint64_t        win_start;   /* [ns] of CLOCK_MONOTONIC */
+	uint64_t        win_bytes;   /* at the start of the window */
+	uint64_t        win_packets;
+	uint64_t        win_dropped;
+	uint64_t        win_errors;
+	struct stats_batches win;
+	struct stats_rate    rate;
+
+	uint64_t        last_batch;  /* [ns] of CLOCK_MONOTONIC */
+	struct stats_batches batches;
+
+	/* published every batch, of the streams changed since */
+	struct stats_shm *shm;       /* NULL:off */
+	int             published;   /* streams in the segment */
+	uint64_t        dirty;
+
+	/* per stream, in order of the first packet */
+	int64_t             early_limit; /* [ns] */
+	int                 streamnum;
+	uint64_t            untracked;   /* packets beyond STATS_STREAM_MAX */
+	struct stats_stream *last;
+	uint8_t             hash[STATS_STREAM_HASH]; /* index + 1 */
+	struct stats_stream streams[STATS_STREAM_MAX];
 };
 
-extern void stats_process(struct app_stats *stats, int length);
+static inline uint64_t stats_now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+extern void stats_add(struct app_stats *stats, struct stats_stream *st,
+		      int packets, uint64_t bytes);
+extern void stats_batch(struct app_stats *stats, uint64_t now, int count);
+extern bool stats_tick(struct app_stats *stats, uint64_t now);
+extern void stats_window_report(struct app_stats *stats, uint64_t now,
+				char *buf, int buflen);
+extern void stats_window_next(struct app_stats *stats, uint64_t now);
+extern FILE *stats_open_json(const char *name);
+extern void stats_close_json(FILE *fp);
+extern void stats_json(struct app_stats *stats, uint64_t now, bool total);
 extern void stats_report(struct app_stats *stats, char *buf, int buflen);
+extern void stats_batches_report(struct stats_batches *b, char *buf,
+				 int buflen);
+extern void stats_stream_report(struct stats_stream *st, char *buf,
+				int buflen);
+extern struct stats_stream *stats_stream_get(struct app_stats *stats,
+					     const uint8_t *id);
+extern void stats_sequence(struct app_stats *stats, struct stats_stream *st,
+			   uint8_t seq, uint32_t ts, bool tv);
+extern void stats_margin(struct app_stats *stats, struct stats_stream *st,
+			 int64_t margin);
+extern int64_t stats_margin_percentile(struct stats_margin *m, double p);
+extern void stats_margin_report(struct stats_margin *m, char *buf,
+				int buflen);
+
+/* account a packet, of a stream unless st is NULL */
+static inline void stats_process(struct app_stats *stats,
+				 struct stats_stream *st, int length)
+{
+	stats_add(stats, st, 1, length);
+}
 
 #endif /* __STATS_H__ */
 
@@ -0,0 +1,199 @@
+/*
+ * Copyright (c) 2014-2016 Renesas Electronics Corporation
+ * Released under the MIT license
+ * http://opensource.org/licenses/mit-license.php
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "stats_shm.h"
+
+/* counters copied under the seqlock */
+#define STATS_SHM_COPY(dst, src, op)		\
+	do {					\
+		op(dst, src, time);		\
+		op(dst, src, packets);		\
+		op(dst, src, bytes);		\
+		op(dst, src, lost);		\
+		op(dst, src, errors);		\
+		op(dst, src, late);		\
+		op(dst, src, early);		\
+	} while (0)
+
+#define STATS_SHM_STORE(dst, src, f) \
+	__atomic_store_n(&(dst)->f, (src)->f, __ATOMIC_RELAXED)
+#define STATS_SHM_LOAD(dst, src, f) \
+	((dst)->f = __atomic_load_n(&(src)->f, __ATOMIC_RELAXED))
+
+/*
+ * create segment to publish statistics
+ *
+ * @shmname  name of POSIX shared memory
+ * @name     name of the statistics, e.g. device name
+ */
+struct stats_shm *stats_shm_create(const char *shmname, const char *name)
+{
+	struct stats_shm *shm;
+	int fd;
+
+	fd = shm_open(shmname, O_RDWR | O_CREAT | O_TRUNC, 0644);
+	if (fd < 0) {
+		perror("shm_open");
+		return NULL;
+	}
+
+	if (ftruncate(fd, sizeof(*shm)) < 0) {
+		perror("ftruncate");
+		close(fd);
+		return NULL;
+	}
+
+	shm = mmap(NULL, sizeof(*shm), PROT_READ | PROT_WRITE, MAP_SHARED,
+		   fd, 0);
+	close(fd);
+	if (shm == MAP_FAILED) {
+		perror("mmap");
+		return NULL;
+	}
+
+	shm->version = STATS_SHM_VERSION;
+	shm->size = sizeof(*shm);
+	shm->pid = getpid();
+	if (name)
+		snprintf(shm->name, sizeof(shm->name), "%s", name);
+
+	/* readers check the magic last */
+	__atomic_store_n(&shm->magic, STATS_SHM_MAGIC, __ATOMIC_RELEASE);
+
+	return shm;
+}
+
+void stats_shm_destroy(struct stats_shm *shm, const char *shmname)
+{
+	if (!shm)
+		return;
+
+	munmap(shm, sizeof(*shm));
+	shm_unlink(shmname);
+}
+
+/*
+ * open segment to read statistics
+ *
+ * @shmname  name of POSIX shared memory
+ */
+struct stats_shm *stats_shm_open(const char *shmname)
+{
+	struct stats_shm *shm;
+	struct stat st;
+	int fd;
+
+	fd = shm_open(shmname, O_RDONLY, 0);
+	if (fd < 0) {
+		perror("shm_open");
+		return NULL;
+	}
+
+	if (fstat(fd, &st) < 0 || st.st_size != sizeof(*shm)) {
+		fprintf(stderr, "%s: not a statistics segment\n", shmname);
+		close(fd);
+		return NULL;
+	}
+
+	shm = mmap(NULL, sizeof(*shm), PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+	if (shm == MAP_FAILED) {
+		perror("mmap");
+		return NULL;
+	}
+
+	if (__atomic_load_n(&shm->magic, __ATOMIC_ACQUIRE) !=
+	    STATS_SHM_MAGIC || shm->version != STATS_SHM_VERSION ||
+	    shm->size != sizeof(*shm)) {
+		fprintf(stderr, "%s: not a statistics segment\n", shmname);
+		munmap(shm, sizeof(*shm));
+		return NULL;
+	}
+
+	return shm;
+}
+
+void stats_shm_close(struct stats_shm *shm)
+{
+	if (shm)
+		munmap(shm, sizeof(*shm));
+}
+
+/*
+ * publish a stream
+ *
+ * @shm      segment
+ * @id       StreamID, streams are in the order of publishing
+ */
+void stats_shm_add_stream(struct stats_shm *shm, const uint8_t *id)
+{
+	uint32_t n = shm->streamnum;
+
+	if (n >= STATS_SHM_STREAM_MAX)
+		return;
+
+	memcpy(shm->streams[n].id, id, sizeof(shm->streams[n].id));
+	__atomic_store_n(&shm->streamnum, n + 1, __ATOMIC_RELEASE);
+}
+
+/*
+ * write counters, by the only writer
+ *
+ * @c        counters in the segment
+ * @v        values
+ */
+void stats_shm_write(struct stats_shm_counters *c,
+		     const struct stats_shm_counters *v)
+{
+	uint32_t seq = c->seq;
+
+	/* odd before any counter changes */
+	__atomic_store_n(&c->seq, seq + 1, __ATOMIC_RELAXED);
+	__atomic_thread_fence(__ATOMIC_RELEASE);
+
+	STATS_SHM_COPY(c, v, STATS_SHM_STORE);
+
+	__atomic_store_n(&c->seq, seq + 2, __ATOMIC_RELEASE);
+}
+
+/*
+ * read counters consistently
+ *
+ * @c        counters in the segment
+ * @v        values
+ * @tries    times to try while the writer updates them
+ *
+ * returns false if every try overlapped with the writer.
+ */
+bool stats_shm_read(struct stats_shm_counters *c,
+		    struct stats_shm_counters *v, int tries)
+{
+	uint32_t seq;
+
+	while (tries-- > 0) {
+		seq = __atomic_load_n(&c->seq, __ATOMIC_ACQUIRE);
+		if (seq & 1)
+			continue;
+
+		STATS_SHM_COPY(v, c, STATS_SHM_LOAD);
+
+		__atomic_thread_fence(__ATOMIC_ACQUIRE);
+		if (__atomic_load_n(&c->seq, __ATOMIC_RELAXED) == seq) {
+			v->seq = seq;
+			memcpy(v->id, c->id, sizeof(v->id));
+			return true;
+		}
+	}
+
+	return false;
+}
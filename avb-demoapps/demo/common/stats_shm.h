@@ -0,0 +1,63 @@
+/*
+ * Copyright (c) 2014-2016 Renesas Electronics Corporation
+ * Released under the MIT license
+ * http://opensource.org/licenses/mit-license.php
+ */
+
+#ifndef __STATS_SHM_H__
+#define __STATS_SHM_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#define STATS_SHM_MAGIC      (0x41565353) /* "AVSS" */
+#define STATS_SHM_VERSION    (1)
+#define STATS_SHM_STREAM_MAX (64)
+#define STATS_SHM_NAME_SIZE  (64)
+
+/*
+ * counters of a stream, or of all streams
+ *
+ * written under a seqlock: seq is odd while the counters are written,
+ * a reader retries while seq is odd or changed during its copy.
+ */
+struct stats_shm_counters {
+	uint32_t seq;
+	uint8_t  id[8];
+	uint64_t time;        /* of the update [ns] of CLOCK_MONOTONIC */
+	uint64_t packets;
+	uint64_t bytes;
+	uint64_t lost;
+	uint64_t errors;      /* reordered, duplicates and resyncs */
+	uint64_t late;        /* presentation time margin, of streams */
+	uint64_t early;
+} __attribute__((aligned(64)));
+
+/*
+ * segment of the statistics of a process
+ *
+ * a stream is published by its id before streamnum includes it.
+ */
+struct stats_shm {
+	uint32_t magic;
+	uint32_t version;
+	uint32_t size;
+	int32_t  pid;
+	char     name[STATS_SHM_NAME_SIZE];
+	uint32_t streamnum;
+	struct stats_shm_counters total;
+	struct stats_shm_counters streams[STATS_SHM_STREAM_MAX];
+};
+
+extern struct stats_shm *stats_shm_create(const char *shmname,
+					  const char *name);
+extern void stats_shm_destroy(struct stats_shm *shm, const char *shmname);
+extern struct stats_shm *stats_shm_open(const char *shmname);
+extern void stats_shm_close(struct stats_shm *shm);
+extern void stats_shm_add_stream(struct stats_shm *shm, const uint8_t *id);
+extern void stats_shm_write(struct stats_shm_counters *c,
+			    const struct stats_shm_counters *v);
+extern bool stats_shm_read(struct stats_shm_counters *c,
+			   struct stats_shm_counters *v, int tries);
+
+#endif /* __STATS_SHM_H__ */
@@ -16,6 +16,8 @@
 
 #define CONFIG_INIT_ENTRYNUM     (256)
 #define CONFIG_INIT_PAYLOAD_SIZE (100)
+#define CONFIG_INIT_WRITE_BACKLOG (1024)
+#define CONFIG_INIT_CLOCK_CAL    (100)	/* ms */
 
 #define MSRP_RANK (MSRP_RANK_NON_EMERGENCY)
 #define LATENCY_TIME_MSRP (3900)
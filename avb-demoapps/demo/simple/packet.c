@@ -44,7 +44,14 @@ int avtp_simple_header_build(void *dst, struct avtp_simple_param *param)
 	streamid[6] = (param->uniqueid & 0xff00) >> 8;
 	streamid[7] = param->uniqueid & 0x00ff;
 
-	copy_avtp_cvf_experimental_template(dst);
+	if (param->subtype == AVTP_SUBTYPE_61883_IIDC)
+		copy_avtp_61883_6_template(dst);
+	else if (param->format_subtype == AVTP_CVF_FORMAT_SUBTYPE_H264)
+		copy_avtp_cvf_h264_template(dst);
+	else if (param->format_subtype == AVTP_CVF_FORMAT_SUBTYPE_MJPEG)
+		copy_avtp_cvf_mjpeg_template(dst);
+	else
+		copy_avtp_cvf_experimental_template(dst);
 	set_avtp_stream_id(dst, streamid);
 	set_avtp_stream_data_length(dst, len);
 
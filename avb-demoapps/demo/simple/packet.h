@@ -30,6 +30,8 @@ struct avtp_simple_param {
 	int uniqueid;
 	int SRpriority;
 	int SRvid;
+	int subtype;        /* AVTP_SUBTYPE_CVF or _61883_IIDC of AM824 */
+	int format_subtype; /* AVTP_CVF_FORMAT_SUBTYPE_*, -1:experimental */
 };
 
 extern int avtp_simple_header_build(void *dst, struct avtp_simple_param *param);
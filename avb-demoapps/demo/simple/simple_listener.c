@@ -13,6 +13,8 @@
 #include <fcntl.h>
 #include <getopt.h>
 #include <stdbool.h>
+#include <inttypes.h>
+#include <sys/uio.h>
 
 #include "config.h"
 #include "eavb_device.h"
@@ -27,6 +29,9 @@
 #define PROGVERSION "0.13"
 
 #define ARRAY_SIZE(a)		(sizeof(a) / sizeof(a[0]))
+#define WRITEV_IOV_MAX		(1024)	/* UIO_MAXIOV of Linux */
+/* a gap of DBC is told up to 127 packets, of 4 bytes a quadlet at most */
+#define AM824_SILENCE_MAX	(128 * ETHFRAMEMTU_MAX)
 
 static int show_version(struct app_config *cfg)
 {
@@ -34,13 +39,27 @@ static int show_version(struct app_config *cfg)
 	return 0;
 }
 
-static const char *optstring = "d:f:n:m:w:h";
+static const char *optstring = "d:f:n:m:w:p:h";
 static const struct option long_options[] = {
 	{"device",            required_argument, NULL, 'd'},
 	{"file",              required_argument, NULL, 'f'},
 	{"frame-num",         required_argument, NULL, 'n'},
 	{"msrp",              required_argument, NULL, 'm'},
 	{"waitmode",          required_argument, NULL, 'w'},
+	{"ptp",               required_argument, NULL, 'p'},
+	{"latency-target",    required_argument, NULL,  2 },
+	{"sync-write",        no_argument,       NULL,  3 },
+	{"write-backlog",     required_argument, NULL,  4 },
+	{"capture",           required_argument, NULL,  5 },
+	{"rotate-size",       required_argument, NULL,  6 },
+	{"rotate-time",       required_argument, NULL,  7 },
+	{"early",             required_argument, NULL,  8 },
+	{"stats-interval",    required_argument, NULL,  9 },
+	{"stats-json",        required_argument, NULL, 10 },
+	{"stats-shm",         required_argument, NULL, 11 },
+	{"verify",            no_argument,       NULL, 12 },
+	{"h264",              no_argument,       NULL, 13 },
+	{"am824",             required_argument, NULL, 14 },
 	{"version",           no_argument,       NULL,  1 },
 	{"help",              no_argument,       NULL, 'h'},
 	{NULL,                0,                 NULL,  0 },
@@ -58,6 +77,30 @@ static int show_usage(struct app_config *cfg)
 			"    -m, --msrp=MODE             MSRP mode 0:static 1:dynamic (default:1 dynamic)\n"
 			"    -w, --waitmode=MODE         specify wait mode (default:0 poll)\n"
 			"                                0:poll, 1:blocking(NOWAIT) 2:blocking(WAITALL)\n"
+			"    -p, --ptp=CLOCK             specify PTP clock name for presentation time margin\n"
+			"                                (default:/dev/ptp0 if present)\n"
+			"        --latency-target=USEC   cap take batch to the latency (default:0=off)\n"
+			"        --sync-write            write the file in the process loop\n"
+			"        --write-backlog=NUM     frames held by the writer thread beyond the\n"
+			"                                entries (default:%d)\n"
+			"        --capture=NAME          write capture files NAME or NAME.NNNN with\n"
+			"                                O_DIRECT and preallocation instead of -f\n"
+			"        --rotate-size=MB        rotate capture file by size (default:0=off)\n"
+			"        --rotate-time=SEC       rotate capture file by time (default:0=off)\n"
+			"        --early=USEC            count margins beyond as early (default:%lu)\n"
+			"        --stats-interval=MSEC   report statistics of every interval (default:0=off)\n"
+			"        --stats-json=NAME       write statistics as JSON lines to NAME or -\n"
+			"                                at every interval and at exit\n"
+			"        --stats-shm=NAME        publish live counters in shared memory NAME\n"
+			"                                for simple_monitor\n"
+			"        --verify                check CRC32C of frames of simple_talker --pattern\n"
+			"        --h264                  write H.264 CVF as an Annex B byte stream,\n"
+			"                                access units are dropped after a loss up\n"
+			"                                to an IDR picture, held beyond the entries\n"
+			"                                up to --write-backlog frames\n"
+			"        --am824=BITS            write IEC 61883-6 AM824 as interleaved PCM\n"
+			"                                of 16, 24 (in 32) or 32 bits, with silence\n"
+			"                                for data blocks lost by DBC\n"
 			"    -h, --help                  display this help\n"
 			"        --version               print version information\n"
 			"\n"
@@ -67,7 +110,8 @@ static int show_usage(struct app_config *cfg)
 			" " PROGNAME " -d /dev/avb_rx1 -n 80000 -m 1\n"
 			" " PROGNAME " -m 0\n"
 			"\n"
-			PROGNAME " version " PROGVERSION "\n");
+			PROGNAME " version " PROGVERSION "\n",
+			CONFIG_INIT_WRITE_BACKLOG, TSOFFSET);
 	return 0;
 }
 
@@ -86,6 +130,8 @@ static int config_init(struct app_config *cfg)
 	cfg->framenums = 0;
 	cfg->msrp = MSRP_ON;
 	cfg->waitmode = WAIT_MODE_POLL;
+	cfg->backlog = CONFIG_INIT_WRITE_BACKLOG;
+	cfg->stats.early_limit = TSOFFSET * 1000;
 
 	return 0;
 }
@@ -124,10 +170,12 @@ static int config_parse_fname(char *name)
 
 static int config_parse(struct app_config *cfg, int argc, char **argv)
 {
-	int c;
+	int c, bits;
 	int option_index = 0;
 	char *dname = NULL;
 	char *fname = NULL;
+	char *cname = NULL;
+	char *jname = NULL;
 
 	config_init(cfg);
 
@@ -150,6 +198,59 @@ static int config_parse(struct app_config *cfg, int argc, char **argv)
 		case 'w':
 			cfg->waitmode = atoi(optarg);
 			break;
+		case 'p':
+			cname = strdup(optarg);
+			break;
+		case 2:
+			cfg->latency_target = strtoull(optarg, NULL, 0) * 1000;
+			break;
+		case 3:
+			cfg->sync_write = true;
+			break;
+		case 4:
+			cfg->backlog = atoi(optarg);
+			break;
+		case 5:
+			cfg->capture = strdup(optarg);
+			break;
+		case 6:
+			cfg->rotate_size = strtoull(optarg, NULL, 0) << 20;
+			break;
+		case 7:
+			cfg->rotate_time = strtoull(optarg, NULL, 0) *
+				1000000000ull;
+			break;
+		case 8:
+			cfg->stats.early_limit = strtoll(optarg, NULL, 0) * 1000;
+			break;
+		case 9:
+			cfg->stats.period = strtoull(optarg, NULL, 0) *
+				1000000ull;
+			break;
+		case 10:
+			jname = strdup(optarg);
+			break;
+		case 11:
+			cfg->shmname = strdup(optarg);
+			break;
+		case 12:
+			cfg->verify = true;
+			break;
+		case 13:
+			cfg->use_h264 = true;
+			break;
+		case 14:
+			cfg->use_am824 = true;
+			bits = atoi(optarg);
+			if (avtp_am824_init(&cfg->am824,
+					    (bits == 16) ? AVTP_AAF_FORMAT_INT_16BIT :
+					    (bits == 24) ? AVTP_AAF_FORMAT_INT_24BIT :
+					    (bits == 32) ? AVTP_AAF_FORMAT_INT_32BIT :
+					    -1, 0, 0) < 0) {
+				PRINTF1("[AVB] invalid bits %s\n", optarg);
+				return -1;
+			}
+			break;
 		case 1:
 			show_version(cfg);
 			exit(EXIT_SUCCESS);
@@ -174,6 +275,26 @@ static int config_parse(struct app_config *cfg, int argc, char **argv)
 		return -1;
 	}
 
+	if (cfg->backlog < 0) {
+		PRINTF1("[AVB] out of range write-backlog=%d\n", cfg->backlog);
+		return -1;
+	}
+
+	if (cfg->use_h264 && (cfg->verify || !cfg->backlog)) {
+		PRINTF1("[AVB] h264 needs write-backlog and excludes verify\n");
+		return -1;
+	}
+
+	if (cfg->use_am824 && (cfg->verify || cfg->use_h264)) {
+		PRINTF1("[AVB] am824 excludes verify and h264\n");
+		return -1;
+	}
+
+	if (cfg->capture && (fname || cfg->sync_write)) {
+		PRINTF1("[AVB] --capture excludes -f and --sync-write\n");
+		return -1;
+	}
+
 	if (fname) {
 		cfg->fd = config_parse_fname(fname);
 		if (cfg->fd < 0) {
@@ -187,23 +308,59 @@ static int config_parse(struct app_config *cfg, int argc, char **argv)
 		dname = strdup("/dev/avb_rx0");
 
 	cfg->devname = dname;
+	cfg->stats.name = dname;
+
+	if (jname) {
+		cfg->stats.json = stats_open_json(jname);
+		if (!cfg->stats.json) {
+			PRINTF("[AVB] cannot open file. %s\n", jname);
+			return -1;
+		}
+		free(jname);
+	}
+
+	/* the margin is off without the default clock */
+	cfg->clkid = CLOCK_INVALID;
+	if (cname || !access("/dev/ptp0", F_OK)) {
+		cfg->clkid = clock_parse(cname ? cname : "/dev/ptp0");
+		if (cfg->clkid == CLOCK_INVALID) {
+			PRINTF("[AVB] can't parse clock name %s\n",
+			       cname ? cname : "/dev/ptp0");
+			return -1;
+		}
+
+		/* other clocks are read by the vDSO already */
+		clock_cal_init(&cfg->clkcal, cfg->clkid,
+			       clock_is_fd(cfg->clkid) ?
+			       CONFIG_INIT_CLOCK_CAL * 1000000ull : 0);
+		free(cname);
+	}
 
 	return 0;
 }
 
 /* signal handler */
 static bool sigint;
+static struct eavb_evloop *sigint_evloop;
 static void sigint_handler(int s)
 {
 	sigint = true;
+	eavb_evloop_notify(sigint_evloop);
 }
 
-static int install_sighandler(int s, void (*handler)(int))
+static bool sigusr1;
+static void sigusr1_handler(int s)
+{
+	sigusr1 = true;
+}
+
+static int install_sighandler(int s, void (*handler)(int), int flags)
 {
 	struct sigaction sa;
 
 	memset(&sa, 0, sizeof(sa));
 	sa.sa_handler = handler;
+	sa.sa_flags = flags;
 	sigemptyset(&sa.sa_mask);
 	sigaddset(&sa.sa_mask, SIGQUIT);
 
@@ -215,42 +372,8 @@ static int install_sighandler(int s, void (*handler)(int))
 	return 0;
 }
 
-static int verify_1722packet(void *data)
-{
-	static int seqno = -1;
-	static int error = -1;
-	int tmp;
-	int ret = 0;
-
-	tmp = get_avtp_sequence_num(data);
-
-	if (seqno != tmp && seqno != -1) {
-		if (error == -1) {
-			PRINTF("avtp sequence number discontinuity,%d->%d=%d\n",
-				seqno, tmp,
-				(tmp + (AVTP_SEQUENCE_NUM_MAX + 1) - seqno)
-						% (AVTP_SEQUENCE_NUM_MAX + 1));
-			error = 1;
-		} else {
-			error++;
-		}
-		ret = -1;
-	} else {
-		if (error != -1) {
-			PRINTF("avtp sequence number recovery %d, error count=%d\n",
-					tmp, error);
-			error = -1;
-		}
-	}
-
-	seqno = (tmp + 1 + (AVTP_SEQUENCE_NUM_MAX + 1))
-				% (AVTP_SEQUENCE_NUM_MAX + 1);
-
-	return ret;
-}
-
 static struct eavb_device *eavb_device_new_for_listener
-					(char *name, int entrynum)
+					(char *name, int entrynum, int framenum)
 {
 	struct eavb_device *dev;
 	int ret;
@@ -270,18 +393,20 @@ static struct eavb_device *eavb_device_new_for_listener
 	/* allocate ether frame buffer and prepare hader */
 	{
 		int i;
-		struct eavb_dma_alloc *p;
+		struct eavb_frame *p;
 		struct eavb_entry *e;
 		struct eavb_entryvec *evec = NULL;
 
+		ret = eavb_device_alloc_frames_num(dev, ETHFRAMELEN_MAX,
+						   framenum);
+		if (ret < 0)
+			goto error;
+
 		for (i = 0, e = dev->entrybuf, p = dev->framebuf;
 				i < dev->entrynum;
 				i++, e++, p++) {
-			ret = eavb_dma_malloc_page(dev->fd, p);
-			if (ret < 0)
-				goto error;
 			evec = &e->vec[0];
-			evec->base = p->dma_paddr;
+			evec->base = p->paddr;
 			evec->len = ETHFRAMELEN_MAX;
 		}
 	}
@@ -294,40 +419,215 @@ error:
 	return NULL;
 }
 
+static bool use_writer(struct app_config *cfg)
+{
+	return cfg->capture || (cfg->fd && !cfg->sync_write);
+}
+
+static void frames_release(struct app_config *cfg, int frame)
+{
+	cfg->frees[(cfg->freehead + cfg->freenum) % cfg->framenum] = frame;
+	cfg->freenum++;
+}
+
+/*
+ * number of entries that can be pushed with a frame,
+ * frames written by the writer thread are released first
+ */
+static int frames_avail(struct app_config *cfg)
+{
+	int frames[64];
+	int i, n;
+
+	if (cfg->sink) {
+		while ((n = file_sink_reclaim(cfg->sink, frames,
+					      ARRAY_SIZE(frames))) > 0)
+			for (i = 0; i < n; i++)
+				if (frames[i] >= 0)
+					frames_release(cfg, frames[i]);
+	}
+
+	return cfg->attached + cfg->freenum;
+}
+
+/*
+ * attach free frames to the entries to be pushed
+ *
+ * @cfg      configuration
+ * @count    number of entries to be pushed
+ */
+static int frames_attach(struct app_config *cfg, int count)
+{
+	struct eavb_device *dev = cfg->device;
+	struct eavb_frame *frame;
+	struct eavb_entry *e;
+	int avail, p;
+
+	avail = frames_avail(cfg);
+	if (count > avail) {
+		cfg->starved++;
+		count = avail;
+	}
+
+	for (; cfg->attached < count; cfg->attached++) {
+		p = (dev->wp + cfg->attached) % cfg->entrynum;
+		cfg->slot[p] = cfg->frees[cfg->freehead];
+		cfg->freehead = (cfg->freehead + 1) % cfg->framenum;
+		cfg->freenum--;
+
+		frame = dev->framebuf + (cfg->slot[p] * sizeof(*frame));
+		e = dev->entrybuf + (p * sizeof(*e));
+		e->vec[0].base = frame->paddr;
+		e->vec[0].len = ETHFRAMELEN_MAX;
+	}
+
+	return count;
+}
+
+/*
+ * write the access unit of the depacketizer, the frames of it are
+ * released once written
+ */
+static void h264_write(struct app_config *cfg)
+{
+	struct avtp_h264_depacketizer *dp = &cfg->h264;
+	struct iovec *iov = dp->iov;
+	int i, n;
+
+	if (cfg->sink) {
+		for (i = 0; i < dp->iovcnt; i++) {
+			/* start codes of STAP-A take entries of their own */
+			while (file_sink_write(cfg->sink, iov[i].iov_base,
+					       iov[i].iov_len,
+					       dp->cookies[i]) < 0) {
+				file_sink_flush(cfg->sink);
+				file_sink_wait(cfg->sink, WAIT_TIME_PROCESS);
+				frames_avail(cfg);
+			}
+		}
+		return;
+	}
+
+	for (i = 0; cfg->fd && i < dp->iovcnt; i += n) {
+		n = dp->iovcnt - i;
+		if (n > WRITEV_IOV_MAX)
+			n = WRITEV_IOV_MAX;
+		if (writev(cfg->fd, iov + i, n) < 0)
+			PRINTF1("[AVB] File output error\n");
+	}
+
+	for (i = 0; i < dp->iovcnt; i++)
+		if (dp->cookies[i] >= 0)
+			frames_release(cfg, dp->cookies[i]);
+}
+
+static void h264_process(struct app_config *cfg, void *packet, size_t size,
+			 int frame)
+{
+	struct avtp_h264_depacketizer *dp = &cfg->h264;
+	int i;
+
+	if (avtp_h264_depacketize(dp, packet, size, frame))
+		h264_write(cfg);
+
+	for (i = 0; i < dp->freenum; i++)
+		frames_release(cfg, dp->frees[i]);
+}
+
+/*
+ * convert the data blocks of an AM824 packet to samples in place
+ *
+ * @cfg      configuration
+ * @packet   packet received
+ * @size     bytes received
+ * @silence  bytes of silence for the data blocks lost before it
+ *
+ * returns bytes of samples, 0 if the packet is not of the stream.
+ */
+static int am824_process(struct app_config *cfg, void *packet, size_t size,
+			 size_t *silence)
+{
+	struct avtp_am824 *am = &cfg->am824;
+	void *payload = packet + AVTP_61883_PAYLOAD_OFFSET;
+	int blocks, lost;
+
+	*silence = 0;
+	blocks = avtp_am824_parse(am, packet, size, &lost);
+	if (blocks < 0)
+		return 0;
+
+	*silence = (size_t)lost * am->dbs * am->host_size;
+	if (*silence > cfg->silence_len)
+		*silence = cfg->silence_len;
+	avtp_am824_unpack(am, payload, payload, blocks);
+
+	return blocks * am->dbs * am->host_size;
+}
+
 static void filedump_process(struct app_config *cfg, int count)
 {
 	static int total_count;
 	struct eavb_device *dev;
-	struct eavb_dma_alloc *dma;
+	struct eavb_frame *frame;
 	struct eavb_entry *e;
 	struct eavb_entryvec *evec;
 	struct iovec *iov;
 	int ret;
-	int i;
+	int i, n, p;
 	void *packet;
 	void *payload;
 	int payload_size;
+	size_t silence;
+	uint8_t id[AVTP_STREAMID_SIZE];
+	struct stats_stream *st;
+	uint32_t now = 0;
 
 	dev = cfg->device;
+	iov = cfg->iov;
+	p = dev->p;
 
-	iov = calloc(count, sizeof(*iov));
-	if (!iov) {
-		PRINTF("[AVB] cannot allocate iovec\n");
-		return;
-	}
+	/* the whole batch arrived by the take */
+	if (cfg->clkid != CLOCK_INVALID)
+		now = (uint32_t)clock_cal_getcount(&cfg->clkcal);
 
-	for (i = 0; i < count; i++) {
-		dma = dev->framebuf + (dev->p * sizeof(*dma));
+	for (i = 0, n = 0; i < count; i++) {
+		frame = dev->framebuf + (cfg->slot[dev->p] * sizeof(*frame));
 		e = dev->entrybuf + (dev->p * sizeof(*e));
 		evec = &e->vec[0];
-		packet = dma->dma_vaddr;
-
-		verify_1722packet(packet);
-		stats_process(&cfg->stats, evec->len);
+		packet = frame->vaddr;
+
+		get_avtp_stream_id(packet, id);
+		st = stats_stream_get(&cfg->stats, id);
+		stats_process(&cfg->stats, st, evec->len);
+		if (st) {
+			stats_sequence(&cfg->stats, st,
+				       get_avtp_sequence_num(packet),
+				       get_avtp_timestamp(packet),
+				       get_avtp_tv(packet));
+
+			/* presentation time is gPTP time in ns modulo 2^32 */
+			if (cfg->clkid != CLOCK_INVALID && get_avtp_tv(packet))
+				stats_margin(&cfg->stats, st, (int32_t)
+					     (get_avtp_timestamp(packet) - now));
+		}
 
+		/* a payload beyond the bytes received is not read nor written */
 		payload_size = get_avtp_stream_data_length(packet);
+		if (evec->len < AVTP_PAYLOAD_OFFSET ||
+		    payload_size > evec->len - AVTP_PAYLOAD_OFFSET) {
+			cfg->stats.errors++;
+			if (cfg->sink || cfg->use_h264)
+				frames_release(cfg, cfg->slot[dev->p]);
+			evec->len = ETHFRAMELEN_MAX;
+			dev->p = (dev->p + 1) % cfg->entrynum;
+			continue;
+		}
+
 		payload = packet + AVTP_PAYLOAD_OFFSET;
 
+		if (cfg->verify)
+			pattern_check(&cfg->check, payload, payload_size);
+
 		PRINTF3("count:%d subtype:%d sequence_num:%d timestamp:%d stream_data_length:%d\n",
 				total_count++,
 				get_avtp_subtype(packet),
@@ -335,20 +635,80 @@ static void filedump_process(struct app_config *cfg, int count)
 				get_avtp_timestamp(packet),
 				get_avtp_stream_data_length(packet));
 
-		iov[i].iov_base = payload;
-		iov[i].iov_len = payload_size;
+		/* silence is written before the samples, not held */
+		if (cfg->use_am824) {
+			payload_size = am824_process(cfg, packet, evec->len,
+						     &silence);
+			payload = packet + AVTP_61883_PAYLOAD_OFFSET;
+			if (silence && cfg->sink) {
+				file_sink_write(cfg->sink, cfg->silence,
+						silence, -1);
+			} else if (silence) {
+				iov[n].iov_base = cfg->silence;
+				iov[n].iov_len = silence;
+				n++;
+			}
+		}
+
+		iov[n].iov_base = payload;
+		iov[n].iov_len = payload_size;
+		n++;
+
+		/* the frame is held until written */
+		if (cfg->use_h264)
+			h264_process(cfg, packet, evec->len,
+				     cfg->slot[dev->p]);
+		else if (cfg->sink)
+			file_sink_write(cfg->sink, payload, payload_size,
+					cfg->slot[dev->p]);
 
 		evec->len = ETHFRAMELEN_MAX;
 		dev->p = (dev->p + 1) % cfg->entrynum;
 	}
 
-	if (cfg->fd) {
-		ret = writev(cfg->fd, iov, count);
-		if (ret < -1)
+	if (cfg->sink) {
+		file_sink_flush(cfg->sink);
+		return;
+	}
+
+	if (cfg->use_h264)
+		return;
+
+	for (i = 0; cfg->fd && i < n; i += ret) {
+		ret = n - i;
+		if (ret > WRITEV_IOV_MAX)
+			ret = WRITEV_IOV_MAX;
+		if (writev(cfg->fd, iov + i, ret) < 0)
 			PRINTF1("[AVB] File output error\n");
 	}
 
-	free(iov);
+	for (i = 0; i < count; i++, p = (p + 1) % cfg->entrynum)
+		frames_release(cfg, cfg->slot[p]);
+}
+
+static void process_event(int fd, int revents, void *arg)
+{
+	struct app_config *cfg = arg;
+
+	cfg->revents |= revents;
+}
+
+static int process_evloop_init(struct app_config *cfg)
+{
+	cfg->evloop = eavb_evloop_new();
+	if (!cfg->evloop)
+		return -1;
+
+	if (eavb_evloop_add(cfg->evloop, cfg->device->ctx, 0,
+			    process_event, cfg) < 0)
+		return -1;
+
+	/* wake up the loop on SIGINT and SIGTERM */
+	if (eavb_evloop_set_notify(cfg->evloop, NULL, NULL) < 0)
+		return -1;
+	sigint_evloop = cfg->evloop;
+
+	return 0;
 }
 
 static int process_wait(struct app_config *cfg, int waitflush)
@@ -363,53 +723,92 @@ static int process_wait(struct app_config *cfg, int waitflush)
 	if (cfg->waitmode) {
 		revents = events;
 	} else {
-		revents = eavb_wait(cfg->device->fd, events, WAIT_TIME_PROCESS);
-		if (revents < 0)
-			revents = 0;
+		eavb_evloop_mod(cfg->evloop, cfg->device->ctx, events);
+		cfg->revents = 0;
+		eavb_evloop_run_once(cfg->evloop, WAIT_TIME_PROCESS);
+		revents = cfg->revents;
 	}
 
 	return revents;
 }
 
+/* report the window of statistics when it is over */
+static void stats_period(struct app_config *cfg, uint64_t now)
+{
+	char buf[512];
+
+	if (!stats_tick(&cfg->stats, now))
+		return;
+
+	/* JSON lines replace the text report */
+	if (cfg->stats.json) {
+		stats_json(&cfg->stats, now, false);
+	} else {
+		stats_window_report(&cfg->stats, now, buf, sizeof(buf));
+		PRINTF("%s: %s\n", cfg->devname, buf);
+	}
+
+	stats_window_next(&cfg->stats, now);
+}
+
 static int filedump_loop(struct app_config *cfg)
 {
 	struct eavb_device *dev;
-	int tmp, thresh;
+	int tmp;
 	int process_size;
 
 	int inf, repeat;
-	bool waitflush;
+	bool waitflush, starving;
 	int revents;
+	uint64_t now;
+	char buf[256];
 
 	dev = cfg->device;
 
+	/* the Rx interval is estimated from the received entries */
+	depth_ctl_init(&cfg->depth, false, cfg->entrynum, cfg->latency_target,
+		       1000000000ull / MSRP_SR_CLASS_A_INTERVAL_FRAMES, true);
+
 	PRINTF1("[AVB] start file save process loop.\n");
 
 	/* repeat control info */
 	repeat = cfg->framenums;
 	inf = !repeat;
 	waitflush = false;
-	thresh = cfg->entrynum / 8;
 
 	if (inf)
 		repeat = 1;
 
 	while (inf || !(waitflush && !dev->filled)) {
-		revents = process_wait(cfg, waitflush);
+		/* all free entries wait for frames held by the writer */
+		starving = dev->remain && !frames_avail(cfg);
+		if (starving && !dev->filled) {
+			file_sink_wait(cfg->sink, WAIT_TIME_PROCESS);
+			if (sigint)
+				goto finish;
+			continue;
+		}
+
+		revents = process_wait(cfg, waitflush || starving);
 
 		if (revents & EAVB_NOTIFY_WRITE) {
-			process_size = dev->remain;
+			process_size = depth_ctl_push_count(&cfg->depth,
+							    dev->filled,
+							    dev->remain);
 
 			if (!inf)
 				if (process_size > repeat)
 					process_size = repeat;
 
+			process_size = frames_attach(cfg, process_size);
 			tmp = dev->push_entry(dev, process_size);
 			PRINTF3("-> push entry num of %d from %d\n",
 							tmp, dev->wp);
 			if (tmp < 0)
 				break;
 
+			cfg->attached -= tmp;
+
 			if (!inf) {
 				repeat -= tmp;
 				if (repeat <= 0)
@@ -419,25 +818,37 @@ static int filedump_loop(struct app_config *cfg)
 
 		if (revents & EAVB_NOTIFY_READ) {
 			tmp = dev->take_entry(dev,
-				(dev->filled > thresh) ? thresh : dev->filled);
+				depth_ctl_take_count(&cfg->depth, dev->filled));
 			if (cfg->waitmode == WAIT_MODE_BLOCK_WAITALL &&
 								tmp < 0) {
 				/* pull out fractional packets */
-				eavb_set_optblockmode(cfg->device->fd,
+				eavb_ctx_set_optblockmode(cfg->device->ctx,
 							EAVB_BLOCK_NOWAIT);
-				revents = eavb_wait(cfg->device->fd,
+				revents = eavb_ctx_wait(cfg->device->ctx,
 							EAVB_NOTIFY_READ, 1);
 				if (revents & EAVB_NOTIFY_READ)
 					tmp = dev->take_entry(dev,
-						(dev->filled > thresh) ?
-						thresh : dev->filled);
+						depth_ctl_take_count(
+							&cfg->depth,
+							dev->filled));
 			}
 			PRINTF3("<- take entry num of %d from %d\n",
 						tmp, dev->rp);
 			if (tmp < 0)
 				break;
 
+			depth_ctl_taken(&cfg->depth, tmp);
+			now = stats_now();
 			filedump_process(cfg, tmp);
+			stats_batch(&cfg->stats, now, tmp);
+		}
+
+		if (cfg->stats.period)
+			stats_period(cfg, stats_now());
+
+		if (sigusr1) {
+			sigusr1 = false;
+			eavb_ctx_stats_dump(dev->ctx, stdout, cfg->devname);
 		}
 
 		if (sigint)
@@ -447,6 +858,13 @@ static int filedump_loop(struct app_config *cfg)
 finish:
 	PRINTF1("[AVB] finish file save process loop.\n");
 
+	eavb_ctx_stats_dump(dev->ctx, stdout, cfg->devname);
+
+	if (cfg->latency_target) {
+		depth_ctl_report(&cfg->depth, buf, sizeof(buf));
+		PRINTF("%s: %s\n", cfg->devname, buf);
+	}
+
 	return 0;
 }
 
@@ -522,6 +940,7 @@ static void msrp_exit(struct msrp_ctx *ctx)
 int main(int argc, char **argv)
 {
 	int ret = -1;
+	int sinksize;
 	char stats_buf[2048];
 	struct msrp_ctx *ctx[] = {NULL, NULL};
 	struct app_config *cfg = calloc(1, sizeof(*cfg));
@@ -535,18 +954,97 @@ int main(int argc, char **argv)
 		return -1;
 
 	/* install signal handler */
-	install_sighandler(SIGINT, sigint_handler);
-	install_sighandler(SIGTERM, sigint_handler);
+	install_sighandler(SIGINT, sigint_handler, 0);
+	install_sighandler(SIGTERM, sigint_handler, 0);
+	/* dump queue statistics, see EAVB_STATS */
+	install_sighandler(SIGUSR1, sigusr1_handler, SA_RESTART);
+
+	/*
+	 * frames beyond the entries are held by the writer thread and by
+	 * the access unit being received
+	 */
+	cfg->framenum = cfg->entrynum;
+	if (use_writer(cfg) || cfg->use_h264)
+		cfg->framenum += cfg->backlog;
+
+	/* an access unit beyond the backlog would leave entries without frames */
+	if (cfg->use_h264 &&
+	    avtp_h264_depacketizer_init(&cfg->h264, cfg->backlog) < 0) {
+		PRINTF("[AVB] cannot allocate h264 depacketizer\n");
+		goto bad_usage;
+	}
+
+	/* data blocks lost are written as silence, zero in every format */
+	if (cfg->use_am824) {
+		cfg->silence_len = AM824_SILENCE_MAX;
+		cfg->silence = calloc(1, cfg->silence_len);
+		if (!cfg->silence) {
+			PRINTF("[AVB] cannot allocate silence\n");
+			goto bad_usage;
+		}
+	}
 
 	cfg->device = eavb_device_new_for_listener(cfg->devname,
-						cfg->entrynum);
+						cfg->entrynum, cfg->framenum);
 	if (!cfg->device) {
 		PRINTF("[AVB] can't open eavb device %s\n", cfg->devname);
 		goto bad_usage;
 	}
 
+	if (!cfg->waitmode && process_evloop_init(cfg) < 0) {
+		PRINTF("[AVB] cannot setup event loop\n");
+		goto bad_usage;
+	}
+
+	if (cfg->shmname) {
+		cfg->stats.shm = stats_shm_create(cfg->shmname, cfg->devname);
+		if (!cfg->stats.shm) {
+			PRINTF("[AVB] cannot create stats segment %s\n",
+			       cfg->shmname);
+			goto bad_usage;
+		}
+	}
+
+	/* one iovec per entry, and one of silence before it with AM824 */
+	cfg->iov = calloc(cfg->entrynum * (cfg->use_am824 ? 2 : 1),
+			  sizeof(*cfg->iov));
+	cfg->slot = calloc(cfg->entrynum, sizeof(*cfg->slot));
+	cfg->frees = calloc(cfg->framenum, sizeof(*cfg->frees));
+	if (!cfg->iov || !cfg->slot || !cfg->frees) {
+		PRINTF("[AVB] cannot allocate iovec\n");
+		goto bad_usage;
+	}
+
+	/* entries are set up with the first frames */
+	for (int i = 0; i < cfg->framenum; i++) {
+		if (i < cfg->entrynum)
+			cfg->slot[i] = i;
+		else
+			frames_release(cfg, i);
+	}
+	cfg->attached = cfg->entrynum;
+
+	/* an access unit takes an entry of the sink per iovec */
+	sinksize = cfg->framenum;
+	if (cfg->use_h264)
+		sinksize += cfg->h264.max;
+	if (cfg->use_am824)
+		sinksize += cfg->framenum;
+
+	if (cfg->capture)
+		cfg->sink = file_sink_open_capture(cfg->capture, sinksize,
+						   cfg->rotate_size,
+						   cfg->rotate_time);
+	else if (cfg->fd && !cfg->sync_write)
+		cfg->sink = file_sink_open(cfg->fd, sinksize);
+
+	if (use_writer(cfg) && !cfg->sink) {
+		PRINTF("[AVB] cannot start writer thread\n");
+		goto bad_usage;
+	}
+
 	if (cfg->waitmode == WAIT_MODE_BLOCK_WAITALL) {
-		ret = eavb_set_optblockmode(cfg->device->fd,
+		ret = eavb_ctx_set_optblockmode(cfg->device->ctx,
 						EAVB_BLOCK_WAITALL);
 		if (ret != 0) {
 			PRINTF("[AVB] cannot set blocking mode\n");
@@ -615,18 +1113,86 @@ TALKER_READY:
 	ret = filedump_loop(cfg);
 
 	/* report stats */
+	stats_json(&cfg->stats, stats_now(), true);
 	stats_report(&cfg->stats, stats_buf, sizeof(stats_buf));
 	PRINTF("%s: %s\n", cfg->devname, stats_buf);
+	stats_batches_report(&cfg->stats.batches, stats_buf,
+			     sizeof(stats_buf));
+	PRINTF("%s: %s\n", cfg->devname, stats_buf);
+
+	if (cfg->verify) {
+		pattern_check_report(&cfg->check, stats_buf,
+				     sizeof(stats_buf));
+		PRINTF("%s: %s\n", cfg->devname, stats_buf);
+	}
+
+	if (cfg->use_h264)
+		PRINTF("%s: h264: %" PRIu64 " access units %" PRIu64 " NAL units %" PRIu64 " FU-A packets %" PRIu64 " lost %" PRIu64 " dropped access units %" PRIu64 " errors\n",
+		       cfg->devname, cfg->h264.access_units, cfg->h264.nals,
+		       cfg->h264.fragments, cfg->h264.lost,
+		       cfg->h264.dropped, cfg->h264.errors);
+
+	if (cfg->use_am824)
+		PRINTF("%s: am824: %" PRIu64 " packets %" PRIu64 " data blocks %" PRIu64 " lost in %" PRIu64 " gaps %" PRIu64 " syt errors %" PRIu64 " label errors %" PRIu64 " errors\n",
+		       cfg->devname, cfg->am824.packets,
+		       cfg->am824.data_blocks, cfg->am824.lost,
+		       cfg->am824.discontinuities, cfg->am824.syt_errors,
+		       cfg->am824.label_errors, cfg->am824.errors);
+
+	for (int i = 0; i < cfg->stats.streamnum; i++) {
+		struct stats_stream *st = &cfg->stats.streams[i];
+		uint8_t *id = st->id;
+		int len;
+
+		len = snprintf(stats_buf, sizeof(stats_buf),
+			       "%02x%02x%02x%02x%02x%02x:%02x%02x ",
+			       id[0], id[1], id[2], id[3], id[4], id[5],
+			       id[6], id[7]);
+		stats_stream_report(st, stats_buf + len,
+				    sizeof(stats_buf) - len);
+		PRINTF("%s: %s\n", cfg->devname, stats_buf);
+
+		seqnum_report(&st->seq, stats_buf + len,
+			      sizeof(stats_buf) - len);
+		PRINTF("%s: %s\n", cfg->devname, stats_buf);
+
+		if (cfg->clkid == CLOCK_INVALID)
+			continue;
+
+		stats_margin_report(&st->margin, stats_buf + len,
+				    sizeof(stats_buf) - len);
+		PRINTF("%s: %s\n", cfg->devname, stats_buf);
+	}
+	if (cfg->stats.untracked)
+		PRINTF("%s: %" PRIu64 " packets of untracked streams\n",
+		       cfg->devname, cfg->stats.untracked);
+
+	if (cfg->sink) {
+		/* write out the rest before the report */
+		file_sink_stop(cfg->sink);
+		file_sink_report(cfg->sink, stats_buf, sizeof(stats_buf));
+		PRINTF("%s: %s starved %" PRIu64 "\n", cfg->devname,
+		       stats_buf, cfg->starved);
+	}
 
 bad_usage:
 	if (cfg->fd  > 2) {
 		close(cfg->fd);
 		PRINTF1("[AVB] closed the save file.\n");
 	}
+	stats_close_json(cfg->stats.json);
+	stats_shm_destroy(cfg->stats.shm, cfg->shmname);
+	free(cfg->shmname);
+
+	sigint_evloop = NULL;
+	eavb_evloop_free(cfg->evloop);
+
+	/* frames are in use until the writer has finished */
+	file_sink_close(cfg->sink);
 
 	if (cfg->device) {
-		if (cfg->device->fd) {
-			eavb_close(cfg->device->fd);
+		if (cfg->device->ctx) {
+			eavb_device_close(cfg->device);
 			PRINTF1("[AVB] closed the device file.\n");
 		}
 
@@ -639,6 +1205,12 @@ bad_usage:
 		eavb_device_free(cfg->device);
 	}
 
+	avtp_h264_depacketizer_free(&cfg->h264);
+	free(cfg->silence);
+	free(cfg->capture);
+	free(cfg->frees);
+	free(cfg->slot);
+	free(cfg->iov);
 	free(cfg);
 
 	if (!ret)
@@ -12,7 +12,13 @@
 #include <stats.h>
 #include "packet.h"
 #include "eavb_device.h"
+#include "depth_ctl.h"
+#include "file_sink.h"
 #include "avtp.h"
+#include "avtp_h264.h"
+#include "avtp_am824.h"
+#include "clock.h"
+#include "pattern.h"
 
 struct app_config {
 	char               *devname;
@@ -26,8 +32,39 @@ struct app_config {
 	int                fd;
 	int                msrp;
 	int                waitmode;
+	uint64_t           latency_target;
+	struct depth_ctl   depth;
 	struct app_stats   stats;
+	char               *shmname;   /* stats segment, NULL:none */
+	bool               verify;     /* payloads of a pattern */
+	struct pattern_check check;
+	bool               use_h264;   /* write an Annex B byte stream */
+	struct avtp_h264_depacketizer h264;
+	bool               use_am824;  /* write AM824 samples as PCM */
+	struct avtp_am824  am824;
+	void               *silence;   /* for data blocks lost */
+	size_t             silence_len;
+	clockid_t          clkid;      /* CLOCK_INVALID: no margin */
+	struct clock_cal   clkcal;
 	struct eavb_device *device;
+	struct eavb_evloop *evloop;
+	int                revents;
+	struct iovec       *iov;
+
+	/* frames are rotated through entries while the writer holds them */
+	bool               sync_write;
+	int                backlog;
+	char               *capture;    /* name of capture files */
+	uint64_t           rotate_size;
+	uint64_t           rotate_time;
+	int                framenum;
+	struct file_sink   *sink;
+	int                *slot;      /* frame attached to entry */
+	int                *frees;     /* free frames in order of release */
+	int                freehead;
+	int                freenum;
+	int                attached;   /* entries from wp with a frame */
+	uint64_t           starved;
 };
 
 #endif /* __SIMPLE_LISTENER_H__ */
@@ -0,0 +1,254 @@
+/*
+ * Copyright (c) 2014-2017 Renesas Electronics Corporation
+ * Released under the MIT license
+ * http://opensource.org/licenses/mit-license.php
+ */
+
+/*
+ * monitor of the counters simple_talker and simple_listener publish
+ * with --stats-shm, sampled without any syscall into the streaming
+ * process.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <signal.h>
+#include <time.h>
+#include <errno.h>
+#include <getopt.h>
+#include <stdbool.h>
+#include <inttypes.h>
+
+#include "stats_shm.h"
+
+#define PROGNAME "simple_monitor"
+#define PROGVERSION "0.13"
+
+#define NSEC_SCALE   (1000000000ull)
+
+/* a read overlaps with the writer at most for a few counters */
+#define READ_TRIES   (100)
+
+struct monitor_config {
+	char     *shmname;
+	int      interval;     /* [ms] */
+	uint64_t count;        /* samples, 0:infinite */
+	int      bench;        /* [ms] of sampling as fast as possible */
+};
+
+static const char *optstring = "s:i:n:b:h";
+static const struct option long_options[] = {
+	{"shm",               required_argument, NULL, 's'},
+	{"interval",          required_argument, NULL, 'i'},
+	{"count",             required_argument, NULL, 'n'},
+	{"bench",             required_argument, NULL, 'b'},
+	{"version",           no_argument,       NULL,  1 },
+	{"help",              no_argument,       NULL, 'h'},
+	{0, 0, 0, 0}
+};
+
+static bool sigint;
+static void sigint_handler(int s)
+{
+	sigint = true;
+}
+
+static void show_usage(void)
+{
+	fprintf(stderr,
+		"usage: " PROGNAME " [options] -s <name>\n"
+		"\n"
+		"options:\n"
+		"    -s, --shm=NAME              shared memory of --stats-shm\n"
+		"    -i, --interval=MSEC         sampling interval (default:1000)\n"
+		"    -n, --count=NUM             number of samples (default:0=infinite)\n"
+		"    -b, --bench=MSEC            sample as fast as possible for MSEC and\n"
+		"                                report the cost of a sample\n"
+		"    -h, --help                  display this help\n"
+		"        --version               print version information\n"
+		"\n"
+		"examples:\n"
+		" simple_listener --stats-shm=/avb_rx0 &\n"
+		" " PROGNAME " -s /avb_rx0 -i 100\n"
+		"\n"
+		PROGNAME " version " PROGVERSION "\n");
+}
+
+static inline uint64_t monitor_now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return ts.tv_sec * NSEC_SCALE + ts.tv_nsec;
+}
+
+/* counters of the segment, total first */
+static int monitor_sample(struct stats_shm *shm,
+			  struct stats_shm_counters *v, int *failed)
+{
+	uint32_t i, n;
+
+	n = __atomic_load_n(&shm->streamnum, __ATOMIC_ACQUIRE);
+	if (n > STATS_SHM_STREAM_MAX)
+		n = STATS_SHM_STREAM_MAX;
+
+	if (!stats_shm_read(&shm->total, &v[0], READ_TRIES))
+		(*failed)++;
+	for (i = 0; i < n; i++)
+		if (!stats_shm_read(&shm->streams[i], &v[i + 1], READ_TRIES))
+			(*failed)++;
+
+	return n;
+}
+
+static void monitor_print(const char *label, struct stats_shm_counters *v,
+			  struct stats_shm_counters *prev, double duration)
+{
+	printf("%-18s %10.1f %10.3f %10" PRIu64 " %8" PRIu64 " %8" PRIu64
+	       " %8" PRIu64 "\n", label,
+	       (v->packets - prev->packets) / duration,
+	       (v->bytes - prev->bytes) * 8 / duration / 1000000,
+	       v->packets, v->lost - prev->lost, v->errors - prev->errors,
+	       v->late - prev->late);
+}
+
+static int monitor_bench(struct stats_shm *shm, int ms)
+{
+	static struct stats_shm_counters v[STATS_SHM_STREAM_MAX + 1];
+	uint64_t start, end, samples = 0, updates = 0;
+	uint32_t seq = 0;
+	int failed = 0, n = 0;
+
+	start = monitor_now();
+	end = start + (uint64_t)ms * 1000000;
+	do {
+		n = monitor_sample(shm, v, &failed);
+		if (v[0].seq != seq)
+			updates++;
+		seq = v[0].seq;
+		samples++;
+	} while (monitor_now() < end && !sigint);
+	end = monitor_now();
+
+	printf("%" PRIu64 " samples of %d streams in %.3f s: %.1f ns/sample,"
+	       " %" PRIu64 " updates seen, %d reads failed\n", samples, n,
+	       (double)(end - start) / NSEC_SCALE,
+	       (double)(end - start) / samples, updates, failed);
+
+	return 0;
+}
+
+static int monitor_loop(struct stats_shm *shm, struct monitor_config *cfg)
+{
+	static struct stats_shm_counters cur[STATS_SHM_STREAM_MAX + 1];
+	static struct stats_shm_counters prev[STATS_SHM_STREAM_MAX + 1];
+	struct timespec ts;
+	uint64_t t, last, samples;
+	double duration;
+	char label[32];
+	uint8_t *id;
+	int failed = 0;
+	int i, n;
+
+	last = monitor_now();
+	monitor_sample(shm, prev, &failed);
+
+	ts.tv_sec = cfg->interval / 1000;
+	ts.tv_nsec = (cfg->interval % 1000) * 1000000;
+
+	for (samples = 0; !cfg->count || samples < cfg->count; samples++) {
+		if (nanosleep(&ts, NULL) < 0 && errno == EINTR)
+			break;
+
+		t = monitor_now();
+		n = monitor_sample(shm, cur, &failed);
+		duration = (double)(t - last) / NSEC_SCALE;
+
+		printf("%-18s %10s %10s %10s %8s %8s %8s\n", shm->name,
+		       "pps", "Mbps", "packets", "lost", "errors", "late");
+		monitor_print("total", &cur[0], &prev[0], duration);
+		for (i = 1; i <= n; i++) {
+			id = cur[i].id;
+			snprintf(label, sizeof(label),
+				 "%02x%02x%02x%02x%02x%02x:%02x%02x",
+				 id[0], id[1], id[2], id[3], id[4], id[5],
+				 id[6], id[7]);
+			monitor_print(label, &cur[i], &prev[i], duration);
+		}
+		fflush(stdout);
+
+		memcpy(prev, cur, sizeof(prev));
+		last = t;
+
+		/* the writer is gone */
+		if (kill(shm->pid, 0) < 0 && errno == ESRCH)
+			break;
+	}
+
+	if (failed)
+		fprintf(stderr, PROGNAME ": %d reads failed\n", failed);
+
+	return 0;
+}
+
+int main(int argc, char **argv)
+{
+	struct monitor_config cfg = {
+		.interval = 1000,
+	};
+	struct stats_shm *shm;
+	struct sigaction sa;
+	int c, ret;
+
+	while (EOF != (c = getopt_long(argc, argv, optstring,
+				       long_options, NULL))) {
+		switch (c) {
+		case 's':
+			cfg.shmname = optarg;
+			break;
+		case 'i':
+			cfg.interval = atoi(optarg);
+			break;
+		case 'n':
+			cfg.count = strtoull(optarg, NULL, 0);
+			break;
+		case 'b':
+			cfg.bench = atoi(optarg);
+			break;
+		case 1:
+			fprintf(stderr, PROGNAME " version " PROGVERSION "\n");
+			return 0;
+		case 'h':
+		default:
+			show_usage();
+			return (c == 'h') ? 0 : -1;
+		}
+	}
+
+	if (!cfg.shmname || cfg.interval <= 0) {
+		show_usage();
+		return -1;
+	}
+
+	memset(&sa, 0, sizeof(sa));
+	sa.sa_handler = sigint_handler;
+	sigemptyset(&sa.sa_mask);
+	sigaction(SIGINT, &sa, NULL);
+	sigaction(SIGTERM, &sa, NULL);
+
+	shm = stats_shm_open(cfg.shmname);
+	if (!shm)
+		return -1;
+
+	if (cfg.bench > 0)
+		ret = monitor_bench(shm, cfg.bench);
+	else
+		ret = monitor_loop(shm, &cfg);
+
+	stats_shm_close(shm);
+
+	return ret;
+}
@@ -9,6 +9,7 @@
 #include <string.h>
 #include <unistd.h>
 #include <sys/ioctl.h>
+#include <sys/uio.h>
 #include <time.h>
 #include <signal.h>
 #include <sys/types.h>
@@ -47,7 +48,7 @@ static int show_version(struct app_config *cfg)
 	return 0;
 }
 
-static const char *optstring = "c:i:p:u:s:f:F:n:m:w:a:h";
+static const char *optstring = "c:i:p:u:s:f:F:n:m:w:a:S:gh";
 static const struct option long_options[] = {
 	{"class",             required_argument, NULL, 'c'},
 	{"interface",         required_argument, NULL, 'i'},
@@ -60,6 +61,20 @@ static const struct option long_options[] = {
 	{"msrp",              required_argument, NULL, 'm'},
 	{"waitmode",          required_argument, NULL, 'w'},
 	{"dest-addr",         required_argument, NULL, 'a'},
+	{"speed",             required_argument, NULL, 'S'},
+	{"scatter-gather",    no_argument,       NULL, 'g'},
+	{"latency-target",    required_argument, NULL,  2 },
+	{"file-source",       required_argument, NULL,  3 },
+	{"pace",              required_argument, NULL,  4 },
+	{"lead",              required_argument, NULL,  5 },
+	{"clock-cal",         required_argument, NULL,  6 },
+	{"stats-interval",    required_argument, NULL,  7 },
+	{"stats-json",        required_argument, NULL,  8 },
+	{"stats-shm",         required_argument, NULL,  9 },
+	{"pattern",           required_argument, NULL, 10 },
+	{"h264",              required_argument, NULL, 11 },
+	{"mjpeg",             required_argument, NULL, 12 },
+	{"am824",             required_argument, NULL, 13 },
 	{"version",           no_argument,       NULL,  1 },
 	{"help",              no_argument,       NULL, 'h'},
 	{NULL,                0,                 NULL,  0 },
@@ -84,6 +99,33 @@ static int show_usage(struct app_config *cfg)
 		"                                0:poll, 1:blocking(NOWAIT) 2:blocking(WAITALL)\n"
 		"    -a, --dest-addr=DEST_ADDR   specify destination MAC address\n"
 		"                                (default:%02x:%02x:%02x:%02x:%02x:XX, XX=UniqueID(lower 8 bits))\n"
+		"    -S, --speed=MBPS            specify link speed for CBS parameter (default:detect)\n"
+		"    -g, --scatter-gather        separate header and payload entry vectors\n"
+		"        --latency-target=USEC   cap queued entries to the latency (default:0=off)\n"
+		"        --file-source=MODE      specify file read mode (default:read)\n"
+		"                                auto, read, mmap, fadvise (read ahead by thread)\n"
+		"        --pace=USEC             push frames due every period of the PTP clock\n"
+		"                                (default:0=push when writable, needs waitmode 0)\n"
+		"        --lead=USEC             presentation time after media time when paced,\n"
+		"                                after sending a frame of --h264 or --mjpeg\n"
+		"                                (default:%lu)\n"
+		"        --clock-cal=MSEC        interpolate the PTP clock between calibrations\n"
+		"                                every MSEC (default:%d, 0=read directly)\n"
+		"        --stats-interval=MSEC   report statistics of every interval (default:0=off)\n"
+		"        --stats-json=NAME       write statistics as JSON lines to NAME or -\n"
+		"                                at every interval and at exit\n"
+		"        --stats-shm=NAME        publish live counters in shared memory NAME\n"
+		"                                for simple_monitor\n"
+		"        --pattern=SEED          send frames of a seeded pattern with CRC32C\n"
+		"                                instead of -f, see simple_listener --verify\n"
+		"        --h264=FPS[/DIV]        send -f as an H.264 Annex B byte stream of\n"
+		"                                FPS/DIV access units per second in CVF\n"
+		"        --mjpeg=FPS[/DIV]       send -f as JPEG frames (baseline, YCbCr 4:2:2\n"
+		"                                or 4:2:0) of FPS/DIV per second in CVF\n"
+		"        --am824=RATE[/CH[/BITS]]  send -f as interleaved PCM of 16, 24 (in 32)\n"
+		"                                or 32 bits (default:2/16) in IEC 61883-6 AM824,\n"
+		"                                the payload size is of RATE per class interval,\n"
+		"                                not with -g\n"
 		"    -h, --help                  display this help\n"
 		"        --version               print version information\n"
 		"\n"
@@ -96,7 +138,8 @@ static int show_usage(struct app_config *cfg)
 		"\n"
 		PROGNAME " version " PROGVERSION "\n",
 		dest_addr[0], dest_addr[1], dest_addr[2],
-		dest_addr[3], dest_addr[4]);
+		dest_addr[3], dest_addr[4], TSOFFSET,
+		CONFIG_INIT_CLOCK_CAL);
 	return 0;
 }
 
@@ -119,6 +162,9 @@ static int config_init(struct app_config *cfg)
 	cfg->framenums = 0;
 	cfg->msrp = MSRP_ON;
 	cfg->waitmode = WAIT_MODE_POLL;
+	cfg->srcmode = FILE_SOURCE_READ;
+	cfg->lead = TSOFFSET * 1000;
+	cfg->clkcal_interval = CONFIG_INIT_CLOCK_CAL * 1000000ull;
 	memcpy(cfg->dest_addr, dest_addr, ETH_ALEN);
 
 	return 0;
@@ -155,6 +201,11 @@ static int config_parse_fname(char *name)
 	return fd;
 }
 
+static bool use_video(struct app_config *cfg)
+{
+	return cfg->use_h264 || cfg->use_mjpeg;
+}
+
 static int config_parse(struct app_config *cfg, int argc, char **argv)
 {
 	int c, i, ret;
@@ -162,7 +213,11 @@ static int config_parse(struct app_config *cfg, int argc, char **argv)
 	char *iname = NULL;
 	char *fname = NULL;
 	char *cname = NULL;
+	char *jname = NULL;
 	int header_size = AVTP_CVF_PAYLOAD_OFFSET - ETHOVERHEAD;
+	unsigned int am824_rate = 0;
+	int am824_ch = 2, am824_bits = 16;
+	uint64_t fps;
 	clockid_t clkid;
 
 	config_init(cfg);
@@ -228,6 +283,69 @@ static int config_parse(struct app_config *cfg, int argc, char **argv)
 			}
 			cfg->use_dest_addr = true;
 			break;
+		case 'S':
+			cfg->speed = atoi(optarg);
+			if (cfg->speed <= 0) {
+				PRINTF1("[AVB] out of range speed=%d\n",
+						cfg->speed);
+				return -1;
+			}
+			break;
+		case 'g':
+			cfg->sg = true;
+			break;
+		case 2:
+			cfg->latency_target = strtoull(optarg, NULL, 0) * 1000;
+			break;
+		case 3:
+			if (file_source_parse_mode(optarg, &cfg->srcmode) < 0) {
+				PRINTF1("[AVB] unknown file source %s\n",
+					optarg);
+				return -1;
+			}
+			break;
+		case 4:
+			cfg->pace = strtoull(optarg, NULL, 0) * 1000;
+			break;
+		case 5:
+			cfg->lead = strtoull(optarg, NULL, 0) * 1000;
+			break;
+		case 6:
+			cfg->clkcal_interval = strtoull(optarg, NULL, 0) * 1000000;
+			break;
+		case 7:
+			cfg->stats.period = strtoull(optarg, NULL, 0) * 1000000;
+			break;
+		case 8:
+			jname = strdup(optarg);
+			break;
+		case 9:
+			cfg->shmname = strdup(optarg);
+			break;
+		case 10:
+			cfg->use_pattern = true;
+			pattern_init(&cfg->pattern, strtoull(optarg, NULL, 0));
+			break;
+		case 11:
+		case 12:
+			cfg->use_h264 = (c == 11);
+			cfg->use_mjpeg = (c == 12);
+			cfg->video_per = 1;
+			if (sscanf(optarg, "%" SCNu64 "/%" SCNu64, &cfg->video_rate,
+				   &cfg->video_per) < 1 ||
+			    !cfg->video_rate || !cfg->video_per) {
+				PRINTF1("[AVB] invalid frame rate %s\n", optarg);
+				return -1;
+			}
+			break;
+		case 13:
+			cfg->use_am824 = true;
+			if (sscanf(optarg, "%u/%d/%d", &am824_rate, &am824_ch,
+				   &am824_bits) < 1) {
+				PRINTF1("[AVB] invalid sample rate %s\n", optarg);
+				return -1;
+			}
+			break;
 		case 1:
 			show_version(cfg);
 			exit(EXIT_SUCCESS);
@@ -238,17 +356,59 @@ static int config_parse(struct app_config *cfg, int argc, char **argv)
 		}
 	}
 
-	if (!fname) {
+	if (!fname && !cfg->use_pattern) {
 		PRINTF1("[AVB] Please specify the file name (-f option).\n");
 		return -1;
 	}
 
+	if (cfg->use_pattern && cfg->payload_size < PATTERN_HEADER_SIZE) {
+		PRINTF1("[AVB] pattern needs payload size of %d at least\n",
+			PATTERN_HEADER_SIZE);
+		return -1;
+	}
+
+	if (use_video(cfg) && (cfg->use_pattern || cfg->pace)) {
+		PRINTF1("[AVB] video is paced by its frames, not with pattern or pace\n");
+		return -1;
+	}
+
 	if (cfg->MaxIntervalFrames < 1) {
 		PRINTF1("[AVB] out of range MaxIntervalFrames=%d, specify greater than 0\n",
 				cfg->MaxIntervalFrames);
 		return -1;
 	}
 
+	/* the header vector of scatter-gather ends before the CIP header */
+	if (cfg->use_am824 && cfg->sg) {
+		PRINTF1("[AVB] am824 is not sent with scatter-gather\n");
+		return -1;
+	}
+
+	/*
+	 * a frame of every class interval carries the same number of data
+	 * blocks, rates of 44.1 kHz would need them to vary
+	 */
+	if (cfg->use_am824) {
+		fps = (uint64_t)cfg->SRclassIntervalFrames *
+			cfg->MaxIntervalFrames;
+		if (cfg->use_pattern || use_video(cfg) ||
+		    avtp_am824_init(&cfg->am824,
+				    (am824_bits == 16) ? AVTP_AAF_FORMAT_INT_16BIT :
+				    (am824_bits == 24) ? AVTP_AAF_FORMAT_INT_24BIT :
+				    (am824_bits == 32) ? AVTP_AAF_FORMAT_INT_32BIT : -1,
+				    am824_rate, am824_ch) < 0 ||
+		    am824_rate % fps) {
+			PRINTF1("[AVB] am824 of %u Hz %d channels %d bits is not supported\n",
+				am824_rate, am824_ch, am824_bits);
+			return -1;
+		}
+		cfg->am824_blocks = am824_rate / fps;
+		cfg->am824_size = (size_t)cfg->am824_blocks * am824_ch *
+			cfg->am824.host_size;
+		cfg->payload_size = avtp_am824_payload_size(&cfg->am824,
+							     cfg->am824_blocks);
+	}
+
 	if ((cfg->msrp < MSRP_OFF) || (cfg->msrp > MSRP_ON)) {
 		PRINTF1("[AVB] out of range msrp=%d, specify %d or %d\n",
 				cfg->msrp, MSRP_OFF, MSRP_ON);
@@ -269,6 +429,17 @@ static int config_parse(struct app_config *cfg, int argc, char **argv)
 		return -1;
 	}
 
+	if (cfg->pace && cfg->waitmode != WAIT_MODE_POLL) {
+		PRINTF1("[AVB] pace needs waitmode=%d\n", WAIT_MODE_POLL);
+		return -1;
+	}
+
+	/* frames are pushed up to a period before their media time */
+	if (cfg->pace && cfg->lead < cfg->pace)
+		PRINTF1("[AVB] lead %" PRIu64 " us is shorter than pace %"
+			PRIu64 " us, frames may be late\n",
+			cfg->lead / 1000, cfg->pace / 1000);
+
 	cfg->MaxFrameSize = header_size + cfg->payload_size;
 	if ((cfg->MaxFrameSize < ETHFRAMEMTU_MIN) ||
 				(cfg->MaxFrameSize > ETHFRAMEMTU_MAX)) {
@@ -279,12 +450,23 @@ static int config_parse(struct app_config *cfg, int argc, char **argv)
 		return -1;
 	}
 
-	cfg->fd = config_parse_fname(fname);
-	if (cfg->fd < 0) {
-		PRINTF1("[AVB] cannot open file %s.\n", fname);
-		return -1;
+	if (fname) {
+		cfg->fd = config_parse_fname(fname);
+		if (cfg->fd < 0) {
+			PRINTF1("[AVB] cannot open file %s.\n", fname);
+			return -1;
+		}
+		free(fname);
+	}
+
+	if (jname) {
+		cfg->stats.json = stats_open_json(jname);
+		if (!cfg->stats.json) {
+			PRINTF1("[AVB] cannot open file %s.\n", jname);
+			return -1;
+		}
+		free(jname);
 	}
-	free(fname);
 
 	/* The MAC Address of ethernet is got and it uses for StreamID. */
 	{
@@ -299,7 +481,8 @@ static int config_parse(struct app_config *cfg, int argc, char **argv)
 			PRINTF1("[AVB] can't get hw address\n");
 			return -1;
 		}
-		if (netif_getlinkspeed(iname, &cfg->speed) < 0) {
+		if (!cfg->speed &&
+		    netif_getlinkspeed(iname, &cfg->speed) < 0) {
 			PRINTF1("[AVB] can't get link speed\n");
 			return -1;
 		}
@@ -320,6 +503,10 @@ static int config_parse(struct app_config *cfg, int argc, char **argv)
 		PRINTF("[AVB] clock: select %s (%d)\n", cname, clkid);
 		cfg->clkid = clkid;
 
+		/* other clocks are read by the vDSO already */
+		clock_cal_init(&cfg->clkcal, clkid, clock_is_fd(clkid) ?
+			       cfg->clkcal_interval : 0);
+
 		free(cname);
 	}
 
@@ -328,17 +515,26 @@ static int config_parse(struct app_config *cfg, int argc, char **argv)
 
 /* signal handler */
 static bool sigint;
+static struct eavb_evloop *sigint_evloop;
 static void sigint_handler(int s)
 {
 	sigint = true;
+	eavb_evloop_notify(sigint_evloop);
+}
+
+static bool sigusr1;
+static void sigusr1_handler(int s)
+{
+	sigusr1 = true;
 }
 
-static int install_sighandler(int s, void (*handler)(int))
+static int install_sighandler(int s, void (*handler)(int), int flags)
 {
 	struct sigaction sa;
 
 	memset(&sa, 0, sizeof(sa));
 	sa.sa_handler = handler;
+	sa.sa_flags = flags;
 	sigemptyset(&sa.sa_mask);
 	sigaddset(&sa.sa_mask, SIGQUIT);
 
@@ -422,8 +618,10 @@ static struct eavb_device *eavb_device_new_for_talker
 	if (!dev)
 		return NULL;
 
+	cfg->devname = name;
+
 	if (cfg->waitmode == WAIT_MODE_BLOCK_WAITALL) {
-		ret = eavb_set_optblockmode(dev->fd, EAVB_BLOCK_WAITALL);
+		ret = eavb_ctx_set_optblockmode(dev->ctx, EAVB_BLOCK_WAITALL);
 		if (ret < 0)
 			goto error;
 	}
@@ -445,6 +643,11 @@ static struct eavb_device *eavb_device_new_for_talker
 		param.SRpriority = cfg->SRpriority;
 		param.SRvid = cfg->SRvid;
 		param.payload_size = cfg->payload_size;
+		param.subtype = cfg->use_am824 ?
+			AVTP_SUBTYPE_61883_IIDC : AVTP_SUBTYPE_CVF;
+		param.format_subtype = cfg->use_h264 ?
+			AVTP_CVF_FORMAT_SUBTYPE_H264 : cfg->use_mjpeg ?
+			AVTP_CVF_FORMAT_SUBTYPE_MJPEG : -1;
 
 		len = avtp_simple_header_build(template, &param);
 
@@ -455,22 +658,47 @@ static struct eavb_device *eavb_device_new_for_talker
 	}
 
 	/* allocate ether frame buffer and prepare hader */
-	{
+	if (cfg->sg) {
+		int i, hlen = AVTP_CVF_PAYLOAD_OFFSET;
+		struct eavb_frame *h, *p;
+		struct eavb_entry *e;
+
+		/*
+		 * vec[0] is the header, vec[1] the payload.
+		 * only the header is prepared from the template.
+		 */
+		ret = eavb_device_alloc_sg_frames(dev, hlen,
+						  cfg->payload_size);
+		if (ret < 0)
+			goto error;
+
+		for (i = 0, e = dev->entrybuf, h = dev->hdrbuf,
+				p = dev->framebuf;
+				i < dev->entrynum;
+				i++, e++, h++, p++) {
+			e->vec[0].base = h->paddr;
+			e->vec[0].len = hlen;
+			e->vec[1].base = p->paddr;
+			e->vec[1].len = cfg->payload_size;
+			memcpy(h->vaddr, template, hlen);
+		}
+	} else {
 		int i;
-		struct eavb_dma_alloc *p;
+		struct eavb_frame *p;
 		struct eavb_entry *e;
 		struct eavb_entryvec *evec = NULL;
 
+		ret = eavb_device_alloc_frames(dev, len);
+		if (ret < 0)
+			goto error;
+
 		for (i = 0, e = dev->entrybuf, p = dev->framebuf;
 				i < dev->entrynum;
 				i++, e++, p++) {
-			ret = eavb_dma_malloc_page(dev->fd, p);
-			if (ret < 0)
-				goto error;
 			evec = &e->vec[0];
-			evec->base = p->dma_paddr;
+			evec->base = p->paddr;
 			evec->len = len;
-			memcpy(p->dma_vaddr, template, len);
+			memcpy(p->vaddr, template, len);
 		}
 	}
 
@@ -497,65 +725,245 @@ error:
 	return NULL;
 }
 
+/* header of frame at entry p */
+static inline void *talker_header(struct eavb_device *dev, int p)
+{
+	struct eavb_frame *frame;
+
+	if (dev->hdrbuf)
+		frame = dev->hdrbuf + (p * sizeof(*frame));
+	else
+		frame = dev->framebuf + (p * sizeof(*frame));
+
+	return frame->vaddr;
+}
+
+/* payload of frame at entry p */
+static inline void *talker_payload(struct eavb_device *dev, int p)
+{
+	struct eavb_frame *frame = dev->framebuf + (p * sizeof(*frame));
+
+	if (dev->hdrbuf)
+		return frame->vaddr;
+
+	return frame->vaddr + AVTP_CVF_PAYLOAD_OFFSET;
+}
+
+static inline void talker_set_len(struct eavb_device *dev,
+				  struct eavb_entry *e, int payload_size)
+{
+	if (dev->hdrbuf)
+		e->vec[1].len = payload_size;
+	else
+		e->vec[0].len = AVTP_CVF_PAYLOAD_OFFSET + payload_size;
+}
+
+/* length of frame at entry p */
+static inline int talker_frame_len(struct eavb_device *dev, int p)
+{
+	struct eavb_entry *e = dev->entrybuf + (p * sizeof(*e));
+
+	if (dev->hdrbuf)
+		return e->vec[0].len + e->vec[1].len;
+
+	return e->vec[0].len;
+}
+
+/* number of frames due before t on the timeline, not yet stamped */
+static int talker_frames_due(struct app_config *cfg, uint64_t t)
+{
+	uint64_t due = avtp_timeline_count(&cfg->timeline, t);
+
+	if (due <= cfg->timeline.frames)
+		return 0;
+
+	due -= cfg->timeline.frames;
+
+	return due > INT_MAX ? INT_MAX : due;
+}
+
+/* payload of the next packet of the video file, 0 at the end */
+static size_t talker_packetize_video(struct app_config *cfg, void *payload,
+				     bool *m)
+{
+	if (cfg->use_h264)
+		return avtp_h264_packetize(&cfg->h264, payload, m);
+
+	return avtp_mjpeg_packetize(&cfg->mjpeg, payload, m);
+}
+
+/*
+ * packets of the access units due, each access unit is sent --lead
+ * before it is presented and all of its packets carry that time
+ */
+static int talker_process_video(struct app_config *cfg, int count)
+{
+	struct eavb_device *dev = cfg->device;
+	struct avtp_timeline *tl = &cfg->video;
+	static int seqnum;
+	struct eavb_entry *e;
+	void *packet, *payload;
+	uint64_t t;
+	size_t len;
+	bool m;
+	int i;
+
+	t = clock_cal_getcount(&cfg->clkcal) + cfg->lead;
+
+	/* late for its presentation, the timeline starts over */
+	if (!cfg->video_in_au &&
+	    (!tl->anchored || avtp_timeline_peek(tl) + cfg->lead < t))
+		avtp_timeline_anchor(tl, t);
+
+	for (i = 0; i < count; i++) {
+		if (!cfg->video_in_au && avtp_timeline_peek(tl) > t)
+			break;
+
+		e = dev->entrybuf + (dev->p * sizeof(*e));
+		packet = talker_header(dev, dev->p);
+		payload = talker_payload(dev, dev->p);
+
+		len = talker_packetize_video(cfg, payload, &m);
+		if (!len) {
+			PRINTF2("[AVB] File read end.\n");
+			read_end = true;
+			break;
+		}
+
+		set_avtp_sequence_num(packet, seqnum++);
+		set_avtp_timestamp(packet, (uint32_t)avtp_timeline_peek(tl));
+		set_avtp_cvf_m(packet, m);
+		set_avtp_stream_data_length(packet, len);
+
+		talker_set_len(dev, e, len);
+		dev->p = (dev->p + 1) % cfg->entrynum;
+
+		cfg->video_in_au = !m;
+		if (m)
+			avtp_timeline_next(tl);
+	}
+
+	/* nothing due, the loop sleeps until the next access unit is */
+	if (!i && !read_end) {
+		cfg->video_wait = avtp_timeline_peek(tl) - t;
+		if (cfg->video_wait > tl->step)
+			cfg->video_wait = tl->step;
+	}
+
+	return i;
+}
+
+/*
+ * convert the samples read to the payloads of count frames from entry
+ * p, DBC and the counters are taken back for the frames not read
+ *
+ * @cfg      configuration
+ * @p        entry of the first frame
+ * @count    frames read
+ * @stamped  frames stamped
+ */
+static void talker_pack_am824(struct app_config *cfg, int p, int count,
+			      int stamped)
+{
+	struct avtp_am824 *am = &cfg->am824;
+	int i;
+
+	for (i = 0; i < count; i++, p = (p + 1) % cfg->entrynum)
+		avtp_am824_pack(am, talker_payload(cfg->device, p) +
+				AVTP_CIP_HEADER_SIZE,
+				cfg->am824_buf + i * cfg->am824_size,
+				cfg->am824_blocks);
+
+	i = stamped - count;
+	am->dbc -= i * cfg->am824_blocks;
+	am->packets -= i;
+	am->data_blocks -= (uint64_t)i * cfg->am824_blocks;
+}
+
 static int talker_process(struct app_config *cfg, int p, int count)
 {
 	struct eavb_device *dev;
 	static int seqnum;
-	int read_size, hlen, payload_size;
-	int i;
-	uint32_t time_stamp, delta_ts, classIntervalFrames;
-	uint64_t t;
+	int read_size, read_unit, payload_size;
+	int i, n, start, stamped;
+	uint64_t t, first;
 
-	struct eavb_dma_alloc *dma;
 	struct eavb_entry *e;
-	struct eavb_entryvec *evec;
 	struct iovec *iov;
 	void *packet = NULL;
 	void *payload;
 
-	/* get current timestamp */
-	t = clock_getcount(cfg->clkid);
-	time_stamp = (uint32_t)t + TSOFFSET * 1000;
+	/* no free entry, nothing to read */
+	if (!count)
+		return 0;
 
-	PRINTF3("[AVB] talker proc entry num of %d (timestamp:%u)\n",
-							count, time_stamp);
+	if (use_video(cfg))
+		return talker_process_video(cfg, count);
+
+	/*
+	 * the timeline continues unless it would be presented sooner
+	 * than TSOFFSET from now, paced frames are always on time
+	 */
+	if (!cfg->pace) {
+		t = clock_cal_getcount(&cfg->clkcal) + TSOFFSET * 1000;
+		if (!cfg->timeline.anchored ||
+		    avtp_timeline_peek(&cfg->timeline) < t)
+			avtp_timeline_anchor(&cfg->timeline, t);
+	}
+	first = cfg->timeline.frames;
 
-	classIntervalFrames = cfg->SRclassIntervalFrames;
-	delta_ts = NSEC_SCALE / (classIntervalFrames * cfg->MaxIntervalFrames);
+	PRINTF3("[AVB] talker proc entry num of %d (timestamp:%u)\n",
+		count, (uint32_t)avtp_timeline_peek(&cfg->timeline));
 
-	hlen = AVTP_CVF_PAYLOAD_OFFSET;
 	payload_size = cfg->payload_size;
+	read_unit = cfg->use_am824 ? cfg->am824_size : payload_size;
 
 	dev = cfg->device;
+	iov = cfg->iov;
+	start = dev->p;
 
-	iov = calloc(count, sizeof(*iov));
-	if (!iov) {
-		PRINTF("[AVB] cannot allocate iovec\n");
-		read_end = true;
-		return count;
-	}
-
-	for (i = 0; i < count; i++) {
-		dma = (dev->framebuf + (dev->p * sizeof(*dma)));
+	for (i = 0, n = 0; i < count; i++) {
 		e = dev->entrybuf + (dev->p * sizeof(*e));
-		evec = &e->vec[0];
-		packet = dma->dma_vaddr;
-		payload = packet + AVTP_CVF_PAYLOAD_OFFSET;
-
-		iov[i].iov_base = payload;
-		iov[i].iov_len = payload_size;
+		packet = talker_header(dev, dev->p);
+		payload = talker_payload(dev, dev->p);
+
+		if (cfg->use_pattern) {
+			/* generated in place, the file is not read */
+			pattern_fill(&cfg->pattern, payload, payload_size);
+		} else if (cfg->use_am824) {
+			/* samples of all frames are read at once, then packed */
+			iov[0].iov_base = cfg->am824_buf;
+			iov[0].iov_len = (i + 1) * read_unit;
+			n = 1;
+		} else if (n && iov[n - 1].iov_base + iov[n - 1].iov_len ==
+			   payload) {
+			/* payloads back to back in DMA memory are read at once */
+			iov[n - 1].iov_len += payload_size;
+		} else {
+			iov[n].iov_base = payload;
+			iov[n].iov_len = payload_size;
+			n++;
+		}
 
 		set_avtp_sequence_num(packet, seqnum++);
-		set_avtp_timestamp(packet, time_stamp);
+		if (cfg->use_am824)
+			avtp_am824_header(&cfg->am824, packet,
+					  cfg->am824_blocks,
+					  avtp_timeline_next(&cfg->timeline));
+		else
+			set_avtp_timestamp(packet, (uint32_t)
+					   avtp_timeline_next(&cfg->timeline));
 		set_avtp_stream_data_length(packet, payload_size);
 
-		time_stamp += delta_ts;
-
-		evec->len = hlen + payload_size;
+		talker_set_len(dev, e, payload_size);
 		dev->p = (dev->p + 1) % cfg->entrynum;
 	}
 
-	read_size = readv(cfg->fd, iov, count);
+	stamped = count;
+	if (cfg->use_pattern)
+		read_size = payload_size * count;
+	else
+		read_size = file_source_readv(cfg->source, iov, n);
 	if (read_size < 0) {
 		PRINTF1("[AVB] error : File read\n");
 		read_end = true;
@@ -563,17 +971,16 @@ static int talker_process(struct app_config *cfg, int p, int count)
 		PRINTF2("[AVB] File read end.\n");
 		count = 0;
 		read_end = true;
-	} else if (read_size < payload_size * count) {
-		i = read_size / payload_size;
-		payload_size = read_size % payload_size;
+	} else if (read_size < read_unit * count) {
+		i = read_size / read_unit;
+		/* a frame is sent partly, but of whole data blocks */
+		payload_size = cfg->use_am824 ? 0 : read_size % read_unit;
 		dev->p = (dev->p + i + cfg->entrynum - count) % cfg->entrynum;
 		if (payload_size != 0) {
-			dma = (dev->framebuf + (dev->p * sizeof(*dma)));
 			e = dev->entrybuf + (dev->p * sizeof(*e));
-			evec = &e->vec[0];
-			packet = dma->dma_vaddr;
+			packet = talker_header(dev, dev->p);
 			set_avtp_stream_data_length(packet, payload_size);
-			evec->len = hlen + payload_size;
+			talker_set_len(dev, e, payload_size);
 			dev->p = (dev->p + 1) % cfg->entrynum;
 			count = i + 1;
 		} else {
@@ -581,11 +988,41 @@ static int talker_process(struct app_config *cfg, int p, int count)
 		}
 	}
 
-	free(iov);
+	/* frames not read are stamped again */
+	if (count != cfg->timeline.frames - first)
+		avtp_timeline_seek(&cfg->timeline, first + count);
+
+	if (cfg->use_am824)
+		talker_pack_am824(cfg, start, count, stamped);
 
 	return count;
 }
 
+static void process_event(int fd, int revents, void *arg)
+{
+	struct app_config *cfg = arg;
+
+	cfg->revents |= revents;
+}
+
+static int process_evloop_init(struct app_config *cfg)
+{
+	cfg->evloop = eavb_evloop_new();
+	if (!cfg->evloop)
+		return -1;
+
+	if (eavb_evloop_add(cfg->evloop, cfg->device->ctx, 0,
+			    process_event, cfg) < 0)
+		return -1;
+
+	/* wake up the loop on SIGINT and SIGTERM */
+	if (eavb_evloop_set_notify(cfg->evloop, NULL, NULL) < 0)
+		return -1;
+	sigint_evloop = cfg->evloop;
+
+	return 0;
+}
+
 static int process_wait(struct app_config *cfg, int waitflush)
 {
 	int events, revents;
@@ -598,27 +1035,78 @@ static int process_wait(struct app_config *cfg, int waitflush)
 	if (cfg->waitmode) {
 		revents = events;
 	} else {
-		revents = eavb_wait(cfg->device->fd, events, WAIT_TIME_PROCESS);
-		if (revents < 0)
-			revents = 0;
+		eavb_evloop_mod(cfg->evloop, cfg->device->ctx, events);
+		cfg->revents = 0;
+		eavb_evloop_run_once(cfg->evloop, WAIT_TIME_PROCESS);
+		revents = cfg->revents;
 	}
 
 	return revents;
 }
 
+static inline uint64_t loop_now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return ts.tv_sec * NSEC_SCALE + ts.tv_nsec;
+}
+
+/* account frames pushed from entry p */
+static void talker_stats(struct app_config *cfg, uint64_t now, int p,
+			 int count)
+{
+	uint64_t bytes = 0;
+	int i;
+
+	for (i = 0; i < count; i++)
+		bytes += talker_frame_len(cfg->device,
+					  (p + i) % cfg->entrynum);
+
+	stats_add(&cfg->stats, cfg->stream, count, bytes);
+	stats_batch(&cfg->stats, now, count);
+}
+
+/* report the window of statistics when it is over */
+static void stats_period(struct app_config *cfg, uint64_t now)
+{
+	char buf[512];
+
+	if (!stats_tick(&cfg->stats, now))
+		return;
+
+	/* JSON lines replace the text report */
+	if (cfg->stats.json) {
+		stats_json(&cfg->stats, now, false);
+	} else {
+		stats_window_report(&cfg->stats, now, buf, sizeof(buf));
+		PRINTF("%s: %s\n", cfg->devname, buf);
+	}
+
+	stats_window_next(&cfg->stats, now);
+}
+
 static int process_loop(struct app_config *cfg, struct msrp_ctx *ctx)
 {
 	struct eavb_device *dev;
-	int tmp, thresh;
-	int process_size;
+	int tmp;
+	int process_size, push_size;
 
 	bool inf, waitflush;
 	int repeat;
 	int revents;
+	int wp;
+	char buf[512];
+	uint64_t t, deadline, loop_max = 0, loop_total = 0, loop_count = 0;
 
 	/* entry control info */
 	dev = cfg->device;
 
+	depth_ctl_init(&cfg->depth, true, cfg->entrynum, cfg->latency_target,
+		       NSEC_SCALE / ((uint64_t)cfg->SRclassIntervalFrames *
+				     cfg->MaxIntervalFrames), false);
+
 	/* repeat control info */
 	repeat = cfg->framenums;
 	if (repeat)
@@ -627,29 +1115,86 @@ static int process_loop(struct app_config *cfg, struct msrp_ctx *ctx)
 		inf = true;
 
 	waitflush = false;
-	thresh = cfg->entrynum / 8;
 
 	if (inf)
 		repeat = 1;
 
+	/* of the same period, the media clock of samples is exact */
+	if (cfg->use_am824)
+		avtp_timeline_init(&cfg->timeline, cfg->am824.rate,
+				   cfg->am824_blocks);
+	else
+		avtp_timeline_init(&cfg->timeline,
+				   (uint64_t)cfg->SRclassIntervalFrames *
+				   cfg->MaxIntervalFrames, 1);
+	if (use_video(cfg))
+		avtp_timeline_init(&cfg->video, cfg->video_rate, cfg->video_per);
+
+	if (cfg->pace) {
+		/* the first period starts a period from now */
+		t = clock_cal_getcount(&cfg->clkcal) + cfg->pace;
+		pacer_init(&cfg->pacer, cfg->clkid, cfg->pace, t);
+		avtp_timeline_anchor(&cfg->timeline, t + cfg->lead);
+	}
+
 	while (inf || !waitflush) {
-		revents = process_wait(cfg, waitflush);
+		push_size = 0;
+		if (cfg->pace && !waitflush) {
+			/* push the frames due by the end of the period */
+			revents = 0;
+			if (!pacer_wait(&cfg->pacer, &deadline)) {
+				push_size = talker_frames_due(cfg,
+					deadline + cfg->pace + cfg->lead);
+				if (push_size > dev->remain)
+					push_size = dev->remain;
+				if (!inf && push_size > repeat)
+					push_size = repeat;
+				revents = EAVB_NOTIFY_READ;
+				if (push_size)
+					revents |= EAVB_NOTIFY_WRITE;
+			}
+		} else {
+			if (!waitflush)
+				push_size = depth_ctl_push_count(&cfg->depth,
+								 dev->filled,
+								 dev->remain);
+
+			if (cfg->video_wait) {
+				struct timespec ts = {
+					.tv_sec = cfg->video_wait / NSEC_SCALE,
+					.tv_nsec = cfg->video_wait % NSEC_SCALE,
+				};
+
+				nanosleep(&ts, NULL);
+				cfg->video_wait = 0;
+			}
+
+			/* wait only for reclaim while nothing can be pushed */
+			revents = process_wait(cfg, !push_size);
+		}
+
+		/* iteration time without the wait, blocking modes included */
+		t = loop_now();
 
 		if (revents & EAVB_NOTIFY_WRITE) {
 			process_size = talker_process
-					(cfg, dev->wp, dev->remain);
+					(cfg, dev->wp, push_size);
 
 			if (!inf) {
 				if (process_size > repeat)
 					process_size = repeat;
 			}
 
+			wp = dev->wp;
 			tmp = dev->push_entry(dev, process_size);
 			PRINTF3("-> push entry num of %d from %d\n",
 							tmp, dev->wp);
 			if (tmp < 0)
 				break;
 
+			depth_ctl_pushed(&cfg->depth, dev->filled);
+			talker_stats(cfg, t, wp, tmp);
+
 			if (!inf) {
 				repeat -= tmp;
 				if (repeat <= 0) {
@@ -661,11 +1206,13 @@ static int process_loop(struct app_config *cfg, struct msrp_ctx *ctx)
 
 		if (revents & EAVB_NOTIFY_READ) {
 			tmp = dev->take_entry(dev,
-				(dev->filled > thresh) ? thresh : dev->filled);
+				depth_ctl_take_count(&cfg->depth, dev->filled));
 			PRINTF3("<- take entry num of %d from %d\n",
 								tmp, dev->rp);
 			if (tmp < 0)
 				break;
+
+			depth_ctl_taken(&cfg->depth, tmp);
 		}
 
 		if (sigint || (cfg->msrp && !msrp_exist_listener(ctx))) {
@@ -678,6 +1225,76 @@ static int process_loop(struct app_config *cfg, struct msrp_ctx *ctx)
 			if (dev->filled == 0)
 				inf = false;
 		}
+
+		if (cfg->stats.period)
+			stats_period(cfg, loop_now());
+
+		t = loop_now() - t;
+		loop_total += t;
+		loop_count++;
+		if (t > loop_max)
+			loop_max = t;
+
+		if (sigusr1) {
+			sigusr1 = false;
+			eavb_ctx_stats_dump(dev->ctx, stdout, cfg->devname);
+		}
+	}
+
+	eavb_ctx_stats_dump(dev->ctx, stdout, cfg->devname);
+
+	t = loop_now();
+	stats_json(&cfg->stats, t, true);
+	stats_report(&cfg->stats, buf, sizeof(buf));
+	PRINTF("%s: %s\n", cfg->devname, buf);
+	stats_batches_report(&cfg->stats.batches, buf, sizeof(buf));
+	PRINTF("%s: %s\n", cfg->devname, buf);
+
+	if (loop_count)
+		PRINTF1("[AVB] loop: %" PRIu64 " iterations avg %" PRIu64
+			" us max %" PRIu64 " us (%s)\n", loop_count,
+			loop_total / loop_count / 1000, loop_max / 1000,
+			cfg->use_pattern ? "pattern" :
+			cfg->use_h264 ? "h264" :
+			cfg->use_mjpeg ? "mjpeg" :
+			cfg->use_am824 ? "am824" :
+			file_source_mode_name(cfg->source->mode));
+
+	if (cfg->latency_target || cfg->pace) {
+		depth_ctl_report(&cfg->depth, buf, sizeof(buf));
+		PRINTF("%s: %s\n", cfg->devname, buf);
+	}
+
+	if (cfg->pace) {
+		pacer_report(&cfg->pacer, buf, sizeof(buf));
+		PRINTF("%s: %s\n", cfg->devname, buf);
+	}
+
+	PRINTF1("[AVB] timeline: %" PRIu64 " discontinuities\n",
+		use_video(cfg) ? cfg->video.discontinuities :
+		cfg->timeline.discontinuities);
+
+	if (cfg->use_h264)
+		PRINTF1("[AVB] h264: %" PRIu64 " access units %" PRIu64
+			" NAL units %" PRIu64 " FU-A packets\n",
+			cfg->h264.access_units, cfg->h264.nals,
+			cfg->h264.fragments);
+
+	if (cfg->use_mjpeg)
+		PRINTF1("[AVB] mjpeg: %" PRIu64 " frames %" PRIu64
+			" packets %" PRIu64 " with tables %" PRIu64
+			" skipped\n", cfg->mjpeg.frames, cfg->mjpeg.packets,
+			cfg->mjpeg.table_headers, cfg->mjpeg.skipped);
+
+	if (cfg->use_am824)
+		PRINTF1("[AVB] am824: %" PRIu64 " packets %" PRIu64
+			" data blocks of %d channels at %u Hz\n",
+			cfg->am824.packets, cfg->am824.data_blocks,
+			cfg->am824.dbs, cfg->am824.rate);
+
+	if (cfg->clkcal.method != CLOCK_CAL_DIRECT) {
+		clock_cal_report(&cfg->clkcal, buf, sizeof(buf));
+		PRINTF("[AVB] %s\n", buf);
 	}
 
 	return 0;
@@ -694,9 +1311,10 @@ int main(int argc, char **argv)
 		return -1;
 
 	/* install signal handler */
-	install_sighandler(SIGINT, sigint_handler);
-	install_sighandler(SIGTERM, sigint_handler);
-	signal(SIGUSR1, SIG_IGN);
+	install_sighandler(SIGINT, sigint_handler, 0);
+	install_sighandler(SIGTERM, sigint_handler, 0);
+	/* dump queue statistics, see EAVB_STATS */
+	install_sighandler(SIGUSR1, sigusr1_handler, SA_RESTART);
 
 	dev = eavb_device_new_for_talker(&cfg, cfg.uid);
 	if (!dev) {
@@ -705,6 +1323,65 @@ int main(int argc, char **argv)
 	}
 	cfg.device = dev;
 
+	/* frames pushed are of the one stream */
+	cfg.stats.name = cfg.devname;
+	cfg.stream = stats_stream_get(&cfg.stats, dev->StreamID);
+
+	if (cfg.shmname) {
+		cfg.stats.shm = stats_shm_create(cfg.shmname, cfg.devname);
+		if (!cfg.stats.shm) {
+			PRINTF("[AVB] cannot create stats segment %s\n",
+			       cfg.shmname);
+			goto bad_usage;
+		}
+	}
+
+	if (!cfg.waitmode && process_evloop_init(&cfg) < 0) {
+		PRINTF("[AVB] cannot setup event loop\n");
+		goto bad_usage;
+	}
+
+	/* start reading ahead while the stream is set up */
+	if (cfg.use_h264) {
+		/* the byte stream is split into NAL units in place */
+		cfg.video_buf = file_source_load(cfg.fd, &cfg.video_len);
+		if (!cfg.video_buf ||
+		    avtp_h264_packetizer_init(&cfg.h264, cfg.video_buf,
+					      cfg.video_len,
+					      cfg.payload_size) < 0) {
+			PRINTF("[AVB] cannot setup h264 packetizer\n");
+			goto bad_usage;
+		}
+	} else if (cfg.use_mjpeg) {
+		/* frames are parsed in place, tables are sent every second */
+		int refresh = (cfg.video_rate + cfg.video_per - 1) /
+			cfg.video_per;
+
+		cfg.video_buf = file_source_load(cfg.fd, &cfg.video_len);
+		if (!cfg.video_buf ||
+		    avtp_mjpeg_packetizer_init(&cfg.mjpeg, cfg.video_buf,
+					       cfg.video_len, cfg.payload_size,
+					       refresh) < 0) {
+			PRINTF("[AVB] cannot setup mjpeg packetizer\n");
+			goto bad_usage;
+		}
+	} else if (!cfg.use_pattern) {
+		cfg.source = file_source_open(cfg.fd, cfg.srcmode);
+	}
+	/* samples of the entries are read before they are packed */
+	if (cfg.use_am824) {
+		cfg.am824_buf = malloc(cfg.entrynum * cfg.am824_size);
+		if (!cfg.am824_buf) {
+			PRINTF("[AVB] cannot allocate am824 buffer\n");
+			goto bad_usage;
+		}
+	}
+	cfg.iov = calloc(cfg.entrynum, sizeof(*cfg.iov));
+	if ((!cfg.source && !cfg.use_pattern && !use_video(&cfg)) || !cfg.iov) {
+		PRINTF("[AVB] cannot setup file source\n");
+		goto bad_usage;
+	}
+
 	PRINTF1("[AVB] %s: %dMbps / %02x:%02x:%02x:%02x:%02x:%02x+%02x:%02x\n",
 			cfg.ifname, cfg.speed,
 			dev->StreamID[0], dev->StreamID[1], dev->StreamID[2],
@@ -784,12 +1461,22 @@ int main(int argc, char **argv)
 	ret = 0;
 
 bad_usage:
+	file_source_close(cfg.source);
+	free(cfg.video_buf);
+	free(cfg.am824_buf);
+	free(cfg.iov);
 	if (cfg.fd > 2)
 		close(cfg.fd);
+	stats_close_json(cfg.stats.json);
+	stats_shm_destroy(cfg.stats.shm, cfg.shmname);
+	free(cfg.shmname);
+
+	sigint_evloop = NULL;
+	eavb_evloop_free(cfg.evloop);
 
 	if (cfg.device) {
-		if (cfg.device->fd) {
-			eavb_close(cfg.device->fd);
+		if (cfg.device->ctx) {
+			eavb_device_close(cfg.device);
 			PRINTF1("[AVB] closed the device file.\n");
 		}
 
@@ -12,11 +12,22 @@
 #include <linux/if_ether.h>
 #include "netif_util.h"
 #include "packet.h"
+#include "avtp_timeline.h"
 #include "eavb_device.h"
+#include "depth_ctl.h"
+#include "file_source.h"
+#include "pacer.h"
+#include "clock.h"
+#include "stats.h"
+#include "pattern.h"
+#include "avtp_h264.h"
+#include "avtp_mjpeg.h"
+#include "avtp_am824.h"
 
 #define NSEC_SCALE	(1000000000)
 
 struct app_config {
+	char               *devname;
 	int                fd;
 	char               ifname[IFNAMSIZ];
 	double             bandwidthFraction;
@@ -27,6 +38,8 @@ struct app_config {
 	uint8_t            SRvid;
 	int                SRclassIntervalFrames;
 	clockid_t          clkid;
+	uint64_t           clkcal_interval; /* [ns], 0:read directly */
+	struct clock_cal   clkcal;
 	int                uid;
 	uint8_t            StreamID[AVTP_STREAMID_SIZE];
 	uint8_t            dest_addr[ETH_ALEN];
@@ -39,7 +52,40 @@ struct app_config {
 	int                msrp;
 	int                waitmode;
 	bool               use_dest_addr;
+	bool               sg;
+	uint64_t           latency_target;
+	struct depth_ctl   depth;
+	uint64_t           pace;         /* [ns], 0:push when writable */
+	uint64_t           lead;         /* presentation after media time [ns] */
+	struct pacer       pacer;
+	struct avtp_timeline timeline;   /* presentation time of frames */
+	struct app_stats   stats;
+	struct stats_stream *stream;
+	char               *shmname;     /* stats segment, NULL:none */
+	enum file_source_mode srcmode;
+	struct file_source *source;
+	bool               use_pattern;  /* instead of the file source */
+	struct pattern     pattern;
+	bool               use_h264;     /* the file is an H.264 byte stream */
+	bool               use_mjpeg;    /* the file is of JPEG frames */
+	uint64_t           video_rate;   /* access units per video_per s */
+	uint64_t           video_per;
+	void               *video_buf;
+	size_t             video_len;
+	struct avtp_h264_packetizer h264;
+	struct avtp_mjpeg_packetizer mjpeg;
+	bool               video_in_au;  /* an access unit is being sent */
+	uint64_t           video_wait;   /* until the next is due [ns] */
+	struct avtp_timeline video;      /* presentation time of access units */
+	bool               use_am824;    /* the file is of PCM samples */
+	struct avtp_am824  am824;
+	int                am824_blocks; /* data blocks per frame */
+	size_t             am824_size;   /* bytes of samples per frame */
+	uint8_t            *am824_buf;   /* samples read for the entries */
+	struct iovec       *iov;
 	struct eavb_device *device;
+	struct eavb_evloop *evloop;
+	int                revents;
 };
 
 #endif /* __SIMPLE_TALKER_H__ */
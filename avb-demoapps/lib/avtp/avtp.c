@@ -116,6 +116,124 @@ struct avtp_cvf_hdr {
 } __attribute__((packed));
 #endif
 
+/* IEEE1722-2016 7.2 AAF PCM stream header */
+#if __BYTE_ORDER == __BIG_ENDIAN
+struct avtp_aaf_hdr {
+	uint8_t  subtype;
+	uint8_t  sv:1;
+	uint8_t  version:3;
+	uint8_t  mr:1;
+	uint8_t  reserved0:2;
+	uint8_t  tv:1;
+	uint8_t  sequence_num;
+	uint8_t  reserved1:7;
+	uint8_t  tu:1;
+	uint64_t stream_id;
+	uint32_t avtp_timestamp;
+	uint8_t  format;
+	uint16_t nsr_channels;
+	uint8_t  bit_depth;
+	uint16_t stream_data_length;
+	uint8_t  reserved2:3;
+	uint8_t  sp:1;
+	uint8_t  evt:4;
+	uint8_t  reserved3;
+	uint8_t  payload[0];
+} __attribute__((packed));
+#else
+struct avtp_aaf_hdr {
+	uint8_t  subtype;
+	uint8_t  tv:1;
+	uint8_t  reserved0:2;
+	uint8_t  mr:1;
+	uint8_t  version:3;
+	uint8_t  sv:1;
+	uint8_t  sequence_num;
+	uint8_t  tu:1;
+	uint8_t  reserved1:7;
+	uint64_t stream_id;
+	uint32_t avtp_timestamp;
+	uint8_t  format;
+	uint16_t nsr_channels;
+	uint8_t  bit_depth;
+	uint16_t stream_data_length;
+	uint8_t  evt:4;
+	uint8_t  sp:1;
+	uint8_t  reserved2:3;
+	uint8_t  reserved3;
+	uint8_t  payload[0];
+} __attribute__((packed));
+#endif
+
+/* IEEE1722-2016 5.2 IEC 61883 stream header, followed by the CIP header */
+#if __BYTE_ORDER == __BIG_ENDIAN
+struct avtp_61883_hdr {
+	uint8_t  subtype;
+	uint8_t  sv:1;
+	uint8_t  version:3;
+	uint8_t  mr:1;
+	uint8_t  reserved0:2;
+	uint8_t  tv:1;
+	uint8_t  sequence_num;
+	uint8_t  reserved1:7;
+	uint8_t  tu:1;
+	uint64_t stream_id;
+	uint32_t avtp_timestamp;
+	uint32_t gateway_info;
+	uint16_t stream_data_length;
+	uint8_t  tag:2;
+	uint8_t  channel:6;
+	uint8_t  tcode:4;
+	uint8_t  sy:4;
+	uint8_t  qi_1:2;
+	uint8_t  sid:6;
+	uint8_t  dbs;
+	uint8_t  fn:2;
+	uint8_t  qpc:3;
+	uint8_t  sph:1;
+	uint8_t  reserved2:2;
+	uint8_t  dbc;
+	uint8_t  qi_2:2;
+	uint8_t  fmt:6;
+	uint8_t  fdf;
+	uint16_t syt;
+	uint8_t  payload[0];
+} __attribute__((packed));
+#else
+struct avtp_61883_hdr {
+	uint8_t  subtype;
+	uint8_t  tv:1;
+	uint8_t  reserved0:2;
+	uint8_t  mr:1;
+	uint8_t  version:3;
+	uint8_t  sv:1;
+	uint8_t  sequence_num;
+	uint8_t  tu:1;
+	uint8_t  reserved1:7;
+	uint64_t stream_id;
+	uint32_t avtp_timestamp;
+	uint32_t gateway_info;
+	uint16_t stream_data_length;
+	uint8_t  channel:6;
+	uint8_t  tag:2;
+	uint8_t  sy:4;
+	uint8_t  tcode:4;
+	uint8_t  sid:6;
+	uint8_t  qi_1:2;
+	uint8_t  dbs;
+	uint8_t  reserved2:2;
+	uint8_t  sph:1;
+	uint8_t  qpc:3;
+	uint8_t  fn:2;
+	uint8_t  dbc;
+	uint8_t  fmt:6;
+	uint8_t  qi_2:2;
+	uint8_t  fdf;
+	uint16_t syt;
+	uint8_t  payload[0];
+} __attribute__((packed));
+#endif
+
 /* AVTP Streame common header */
 static const struct avtp_stream_hdr avtp_stream_hdr_tmpl = {
 	.subtype                = 0,
@@ -165,3 +283,120 @@ void copy_avtp_cvf_experimental_template(void *data)
 	memcpy(data + AVTP_OFFSET, &avtp_cvf_experimental_hdr_tmpl, sizeof(avtp_cvf_experimental_hdr_tmpl));
 }
 
+/* AVTP Video (CVF) H.264 header, h264_timestamp is in the payload */
+static const struct avtp_cvf_hdr avtp_cvf_h264_hdr_tmpl = {
+	.subtype               = AVTP_SUBTYPE_CVF,
+	.sv                    = 1,
+	.version               = 0,
+	.mr                    = 0,
+	.reserved0             = 0,
+	.tv                    = 1,
+	.sequence_num          = 0,
+	.reserved1             = 0,
+	.tu                    = 0,
+	.stream_id             = 0,
+	.avtp_timestamp        = 0,
+	.format                = AVTP_CVF_FORMAT_RFC,
+	.format_subtype        = AVTP_CVF_FORMAT_SUBTYPE_H264,
+	.reserved2             = 0,
+	.stream_data_length    = 0,
+	.reserved3             = 0,
+	.M                     = 0,
+	.evt                   = 0,
+	.reserved4             = 0,
+};
+void copy_avtp_cvf_h264_template(void *data)
+{
+	memcpy(data + AVTP_OFFSET, &avtp_cvf_h264_hdr_tmpl, sizeof(avtp_cvf_h264_hdr_tmpl));
+}
+
+/* AVTP Video (CVF) MJPEG header, the payload is of RFC 2435 */
+static const struct avtp_cvf_hdr avtp_cvf_mjpeg_hdr_tmpl = {
+	.subtype               = AVTP_SUBTYPE_CVF,
+	.sv                    = 1,
+	.version               = 0,
+	.mr                    = 0,
+	.reserved0             = 0,
+	.tv                    = 1,
+	.sequence_num          = 0,
+	.reserved1             = 0,
+	.tu                    = 0,
+	.stream_id             = 0,
+	.avtp_timestamp        = 0,
+	.format                = AVTP_CVF_FORMAT_RFC,
+	.format_subtype        = AVTP_CVF_FORMAT_SUBTYPE_MJPEG,
+	.reserved2             = 0,
+	.stream_data_length    = 0,
+	.reserved3             = 0,
+	.M                     = 0,
+	.evt                   = 0,
+	.reserved4             = 0,
+};
+void copy_avtp_cvf_mjpeg_template(void *data)
+{
+	memcpy(data + AVTP_OFFSET, &avtp_cvf_mjpeg_hdr_tmpl, sizeof(avtp_cvf_mjpeg_hdr_tmpl));
+}
+
+/* AVTP Audio (AAF) PCM header */
+static const struct avtp_aaf_hdr avtp_aaf_hdr_tmpl = {
+	.subtype               = AVTP_SUBTYPE_AAF,
+	.sv                    = 1,
+	.version               = 0,
+	.mr                    = 0,
+	.reserved0             = 0,
+	.tv                    = 1,
+	.sequence_num          = 0,
+	.reserved1             = 0,
+	.tu                    = 0,
+	.stream_id             = 0,
+	.avtp_timestamp        = 0,
+	.format                = AVTP_AAF_FORMAT_USER,
+	.nsr_channels          = 0,
+	.bit_depth             = 0,
+	.stream_data_length    = 0,
+	.reserved2             = 0,
+	.sp                    = 0,
+	.evt                   = 0,
+	.reserved3             = 0,
+};
+void copy_avtp_aaf_template(void *data)
+{
+	memcpy(data + AVTP_OFFSET, &avtp_aaf_hdr_tmpl, sizeof(avtp_aaf_hdr_tmpl));
+}
+
+/* AVTP Audio IEC 61883-6 header, SYT is of no info on AVTP */
+static const struct avtp_61883_hdr avtp_61883_6_hdr_tmpl = {
+	.subtype               = AVTP_SUBTYPE_61883_IIDC,
+	.sv                    = 1,
+	.version               = 0,
+	.mr                    = 0,
+	.reserved0             = 0,
+	.tv                    = 1,
+	.sequence_num          = 0,
+	.reserved1             = 0,
+	.tu                    = 0,
+	.stream_id             = 0,
+	.avtp_timestamp        = 0,
+	.gateway_info          = 0,
+	.stream_data_length    = 0,
+	.tag                   = AVTP_61883_TAG_CIP >> 6,
+	.channel               = AVTP_61883_CHANNEL,
+	.tcode                 = AVTP_61883_TCODE >> 4,
+	.sy                    = 0,
+	.qi_1                  = 0,
+	.sid                   = AVTP_CIP_SID,
+	.dbs                   = 0,
+	.fn                    = 0,
+	.qpc                   = 0,
+	.sph                   = 0,
+	.reserved2             = 0,
+	.dbc                   = 0,
+	.qi_2                  = AVTP_CIP_QI_2 >> 6,
+	.fmt                   = AVTP_CIP_FMT_61883_6,
+	.fdf                   = 0,
+	.syt                   = AVTP_CIP_SYT_NO_INFO,
+};
+void copy_avtp_61883_6_template(void *data)
+{
+	memcpy(data + AVTP_OFFSET, &avtp_61883_6_hdr_tmpl, sizeof(avtp_61883_6_hdr_tmpl));
+}
@@ -128,6 +128,76 @@ enum AVTP_CVF_FORMAT {
 	AVTP_CVF_FORMAT_EXPERIMENTAL = 0xff, /* P1722a/D5 */
 };
 
+/* IEEE1722-2016 Table 20. CVF format subtype field of RFC format */
+enum AVTP_CVF_FORMAT_SUBTYPE {
+	AVTP_CVF_FORMAT_SUBTYPE_MJPEG    = 0x00, /* RFC 2435 */
+	AVTP_CVF_FORMAT_SUBTYPE_H264     = 0x01, /* RFC 6184 */
+	AVTP_CVF_FORMAT_SUBTYPE_JPEG2000 = 0x02, /* RFC 5371 */
+};
+
+/* flags of byte 22 of the CVF header of RFC format */
+#define AVTP_CVF_PTV (0x20) /* h264_timestamp is valid */
+#define AVTP_CVF_M   (0x10) /* last packet of a video frame */
+
+/* IEEE1722-2016 Table 14. AAF format field */
+enum AVTP_AAF_FORMAT {
+	AVTP_AAF_FORMAT_USER        = 0x00, /* User specified */
+	AVTP_AAF_FORMAT_FLOAT_32BIT = 0x01, /* 32-bit floating point */
+	AVTP_AAF_FORMAT_INT_32BIT   = 0x02, /* 32-bit integer */
+	AVTP_AAF_FORMAT_INT_24BIT   = 0x03, /* 24-bit integer */
+	AVTP_AAF_FORMAT_INT_16BIT   = 0x04, /* 16-bit integer */
+	AVTP_AAF_FORMAT_AES3_32BIT  = 0x05, /* 32-bit AES3 */
+	/* 0x06-0xFF Reserved */
+};
+
+/* IEEE1722-2016 Table 15. AAF nominal sample rate field */
+enum AVTP_AAF_NSR {
+	AVTP_AAF_NSR_USER     = 0x0, /* User specified */
+	AVTP_AAF_NSR_8KHZ     = 0x1,
+	AVTP_AAF_NSR_16KHZ    = 0x2,
+	AVTP_AAF_NSR_32KHZ    = 0x3,
+	AVTP_AAF_NSR_44_1KHZ  = 0x4,
+	AVTP_AAF_NSR_48KHZ    = 0x5,
+	AVTP_AAF_NSR_88_2KHZ  = 0x6,
+	AVTP_AAF_NSR_96KHZ    = 0x7,
+	AVTP_AAF_NSR_176_4KHZ = 0x8,
+	AVTP_AAF_NSR_192KHZ   = 0x9,
+	AVTP_AAF_NSR_24KHZ    = 0xA,
+	/* 0xB-0xF Reserved */
+};
+
+#define AVTP_AAF_CHANNELS_MAX (1023)
+
+/* flag of byte 1, avtp_timestamp is valid */
+#define AVTP_TV (0x01)
+
+/*
+ * IEEE1722-2016 5.2 IEC 61883 stream, the CIP header of IEC 61883-1
+ * is the first 8 bytes of the payload and counted in the
+ * stream_data_length.
+ */
+#define AVTP_CIP_HEADER_SIZE (8)
+#define AVTP_61883_PAYLOAD_OFFSET (AVTP_PAYLOAD_OFFSET + AVTP_CIP_HEADER_SIZE)
+
+#define AVTP_61883_TAG_CIP     (0x40) /* tag of byte 22 */
+#define AVTP_61883_CHANNEL     (31)   /* originated on an AVB network */
+#define AVTP_61883_TCODE       (0xA0) /* tcode of byte 23 */
+#define AVTP_CIP_SID           (63)   /* source node ID */
+#define AVTP_CIP_QI_2          (0x80) /* EOH and form of quadlet 1 */
+#define AVTP_CIP_FMT_61883_6   (0x10) /* audio and music */
+#define AVTP_CIP_SYT_NO_INFO   (0xffff)
+
+/* IEC 61883-6 Table 3. sampling frequency code of FDF */
+enum AVTP_CIP_SFC {
+	AVTP_CIP_SFC_32KHZ    = 0,
+	AVTP_CIP_SFC_44_1KHZ  = 1,
+	AVTP_CIP_SFC_48KHZ    = 2,
+	AVTP_CIP_SFC_88_2KHZ  = 3,
+	AVTP_CIP_SFC_96KHZ    = 4,
+	AVTP_CIP_SFC_176_4KHZ = 5,
+	AVTP_CIP_SFC_192KHZ   = 6,
+};
+
 /**
  * Accessor - IEEE802.1Q
  */
@@ -182,6 +252,19 @@ DEF_AVTP_ACCESSER_UINT8(subtype, 0)
 DEF_AVTP_ACCESSER_UINT8(sequence_num, 2)
 DEF_AVTP_ACCESSER_UINT32(timestamp, 12)
 DEF_AVTP_ACCESSER_UINT16(stream_data_length, 20)
+DEF_AVTP_ACCESSER_UINT8(flags, 1)
+
+static inline int get_avtp_tv(void *data)
+{
+	return !!(get_avtp_flags(data) & AVTP_TV);
+}
+
+static inline void set_avtp_tv(void *data, int value)
+{
+	uint8_t flags = get_avtp_flags(data) & ~AVTP_TV;
+
+	set_avtp_flags(data, flags | (value ? AVTP_TV : 0));
+}
 
 static inline void get_avtp_stream_id(void *data, uint8_t value[8])
 {
@@ -207,10 +290,77 @@ static inline void set_avtp_stream_id(void *data, uint8_t value[8])
 	*((uint8_t *)(data + 11 + AVTP_OFFSET)) = value[7];
 }
 
+/**
+ * Accessor - IEEE1722 AAF PCM
+ */
+DEF_AVTP_ACCESSER_UINT8(aaf_format, 16)
+DEF_AVTP_ACCESSER_UINT16(aaf_nsr_channels, 17)
+DEF_AVTP_ACCESSER_UINT8(aaf_bit_depth, 19)
+DEF_AVTP_ACCESSER_UINT8(aaf_sp_evt, 22)
+
+static inline uint8_t get_avtp_aaf_nsr(void *data)
+{
+	return get_avtp_aaf_nsr_channels(data) >> 12;
+}
+
+static inline void set_avtp_aaf_nsr(void *data, uint8_t value)
+{
+	set_avtp_aaf_nsr_channels(data,
+		(get_avtp_aaf_nsr_channels(data) & 0x0fff) | (value << 12));
+}
+
+static inline uint16_t get_avtp_aaf_channels(void *data)
+{
+	return get_avtp_aaf_nsr_channels(data) & 0x03ff;
+}
+
+static inline void set_avtp_aaf_channels(void *data, uint16_t value)
+{
+	set_avtp_aaf_nsr_channels(data,
+		(get_avtp_aaf_nsr_channels(data) & 0xfc00) | (value & 0x03ff));
+}
+
+/**
+ * Accessor - IEEE1722 CVF of RFC format
+ */
+DEF_AVTP_ACCESSER_UINT8(cvf_format, 16)
+DEF_AVTP_ACCESSER_UINT8(cvf_format_subtype, 17)
+DEF_AVTP_ACCESSER_UINT8(cvf_flags, 22)
+
+static inline int get_avtp_cvf_m(void *data)
+{
+	return !!(get_avtp_cvf_flags(data) & AVTP_CVF_M);
+}
+
+static inline void set_avtp_cvf_m(void *data, int value)
+{
+	uint8_t flags = get_avtp_cvf_flags(data) & ~AVTP_CVF_M;
+
+	set_avtp_cvf_flags(data, flags | (value ? AVTP_CVF_M : 0));
+}
+
+/**
+ * Accessor - IEEE1722 IEC 61883 and its CIP header
+ */
+DEF_AVTP_ACCESSER_UINT32(iec61883_gateway_info, 16)
+DEF_AVTP_ACCESSER_UINT8(iec61883_tag_channel, 22)
+DEF_AVTP_ACCESSER_UINT8(iec61883_tcode_sy, 23)
+DEF_AVTP_ACCESSER_UINT8(cip_sid, 24)
+DEF_AVTP_ACCESSER_UINT8(cip_dbs, 25)
+DEF_AVTP_ACCESSER_UINT8(cip_fn_qpc_sph, 26)
+DEF_AVTP_ACCESSER_UINT8(cip_dbc, 27)
+DEF_AVTP_ACCESSER_UINT8(cip_fmt, 28)
+DEF_AVTP_ACCESSER_UINT8(cip_fdf, 29)
+DEF_AVTP_ACCESSER_UINT16(cip_syt, 30)
+
 /**
  * Template - IEEE1722/1722a
  */
 extern void copy_avtp_stream_template(void *data);
 extern void copy_avtp_cvf_experimental_template(void *data);
+extern void copy_avtp_aaf_template(void *data);
+extern void copy_avtp_cvf_h264_template(void *data);
+extern void copy_avtp_cvf_mjpeg_template(void *data);
+extern void copy_avtp_61883_6_template(void *data);
 
 #endif /* __AVTP_H__ */
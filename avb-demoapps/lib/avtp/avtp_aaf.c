@@ -0,0 +1,850 @@
+/*
+ * Copyright (c) 2014-2016 Renesas Electronics Corporation
+ * Released under the MIT license
+ * http://opensource.org/licenses/mit-license.php
+ */
+
+#include <string.h>
+
+#if defined(__x86_64__)
+#include <tmmintrin.h>
+#elif defined(__aarch64__)
+#include <arm_neon.h>
+#endif
+
+#include "avtp.h"
+#include "avtp_aaf.h"
+
+/* samples interleaved at once from planar buffers */
+#define AVTP_AAF_SCRATCH (1024)
+
+/* byte of a shuffle mask that gives zero, for PSHUFB and TBL */
+#define Z (0x80)
+
+struct avtp_aaf_ops {
+	const char *name;
+	void (*swap16)(void *dst, const void *src, size_t n);
+	void (*swap32)(void *dst, const void *src, size_t n);
+	void (*pack24)(void *dst, const void *src, size_t n);
+	void (*unpack24)(void *dst, const void *src, size_t n);
+	/* two channels, n samples of each */
+	void (*zip16)(void *dst, const void *l, const void *r, size_t n);
+	void (*zip32)(void *dst, const void *l, const void *r, size_t n);
+	void (*unzip16)(void *l, void *r, const void *src, size_t n);
+	void (*unzip32)(void *l, void *r, const void *src, size_t n);
+};
+
+static const struct {
+	unsigned int rate;
+	uint8_t      nsr;
+} aaf_rates[] = {
+	{   8000, AVTP_AAF_NSR_8KHZ },
+	{  16000, AVTP_AAF_NSR_16KHZ },
+	{  24000, AVTP_AAF_NSR_24KHZ },
+	{  32000, AVTP_AAF_NSR_32KHZ },
+	{  44100, AVTP_AAF_NSR_44_1KHZ },
+	{  48000, AVTP_AAF_NSR_48KHZ },
+	{  88200, AVTP_AAF_NSR_88_2KHZ },
+	{  96000, AVTP_AAF_NSR_96KHZ },
+	{ 176400, AVTP_AAF_NSR_176_4KHZ },
+	{ 192000, AVTP_AAF_NSR_192KHZ },
+};
+
+/*
+ * Scalar
+ *
+ * payloads follow the 18 + 24 byte headers, so that samples are not
+ * aligned to their size.
+ */
+static inline uint16_t ld16(const uint8_t *p)
+{
+	uint16_t v;
+
+	memcpy(&v, p, sizeof(v));
+
+	return v;
+}
+
+static inline uint32_t ld32(const uint8_t *p)
+{
+	uint32_t v;
+
+	memcpy(&v, p, sizeof(v));
+
+	return v;
+}
+
+static inline void st16(uint8_t *p, uint16_t v)
+{
+	memcpy(p, &v, sizeof(v));
+}
+
+static inline void st32(uint8_t *p, uint32_t v)
+{
+	memcpy(p, &v, sizeof(v));
+}
+
+static void swap16_scalar(void *dst, const void *src, size_t n)
+{
+	const uint8_t *s = src;
+	uint8_t *d = dst;
+	size_t i;
+
+	for (i = 0; i < n; i++)
+		st16(d + i * 2, __builtin_bswap16(ld16(s + i * 2)));
+}
+
+static void swap32_scalar(void *dst, const void *src, size_t n)
+{
+	const uint8_t *s = src;
+	uint8_t *d = dst;
+	size_t i;
+
+	for (i = 0; i < n; i++)
+		st32(d + i * 4, __builtin_bswap32(ld32(s + i * 4)));
+}
+
+static void pack24_scalar(void *dst, const void *src, size_t n)
+{
+	const uint8_t *s = src;
+	uint8_t *d = dst;
+	uint32_t v;
+	size_t i;
+
+	for (i = 0; i < n; i++) {
+		v = ld32(s + i * 4);
+		d[i * 3 + 0] = v >> 16;
+		d[i * 3 + 1] = v >> 8;
+		d[i * 3 + 2] = v;
+	}
+}
+
+static void unpack24_scalar(void *dst, const void *src, size_t n)
+{
+	const uint8_t *s = src;
+	uint8_t *d = dst;
+	uint32_t v;
+	size_t i;
+
+	for (i = 0; i < n; i++) {
+		v = s[i * 3] << 24 | s[i * 3 + 1] << 16 | s[i * 3 + 2] << 8;
+		st32(d + i * 4, (int32_t)v >> 8);
+	}
+}
+
+static void zip16_scalar(void *dst, const void *l, const void *r, size_t n)
+{
+	const uint8_t *a = l, *b = r;
+	uint8_t *d = dst;
+	size_t i;
+
+	for (i = 0; i < n; i++) {
+		st16(d + i * 4, ld16(a + i * 2));
+		st16(d + i * 4 + 2, ld16(b + i * 2));
+	}
+}
+
+static void zip32_scalar(void *dst, const void *l, const void *r, size_t n)
+{
+	const uint8_t *a = l, *b = r;
+	uint8_t *d = dst;
+	size_t i;
+
+	for (i = 0; i < n; i++) {
+		st32(d + i * 8, ld32(a + i * 4));
+		st32(d + i * 8 + 4, ld32(b + i * 4));
+	}
+}
+
+static void unzip16_scalar(void *l, void *r, const void *src, size_t n)
+{
+	const uint8_t *s = src;
+	uint8_t *a = l, *b = r;
+	size_t i;
+
+	for (i = 0; i < n; i++) {
+		st16(a + i * 2, ld16(s + i * 4));
+		st16(b + i * 2, ld16(s + i * 4 + 2));
+	}
+}
+
+static void unzip32_scalar(void *l, void *r, const void *src, size_t n)
+{
+	const uint8_t *s = src;
+	uint8_t *a = l, *b = r;
+	size_t i;
+
+	for (i = 0; i < n; i++) {
+		st32(a + i * 4, ld32(s + i * 8));
+		st32(b + i * 4, ld32(s + i * 8 + 4));
+	}
+}
+
+static const struct avtp_aaf_ops aaf_ops_scalar = {
+	.name     = "scalar",
+	.swap16   = swap16_scalar,
+	.swap32   = swap32_scalar,
+	.pack24   = pack24_scalar,
+	.unpack24 = unpack24_scalar,
+	.zip16    = zip16_scalar,
+	.zip32    = zip32_scalar,
+	.unzip16  = unzip16_scalar,
+	.unzip32  = unzip32_scalar,
+};
+
+/*
+ * SIMD
+ *
+ * 24-bit samples are packed 16 at a time: four vectors of 32-bit
+ * samples are shuffled to 12 bytes each and merged into three.
+ */
+static const uint8_t mask_swap16[16] = {
+	1, 0, 3, 2, 5, 4, 7, 6, 9, 8, 11, 10, 13, 12, 15, 14,
+};
+
+static const uint8_t mask_swap32[16] = {
+	3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12,
+};
+
+static const uint8_t mask_pack24[16] = {
+	2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, Z, Z, Z, Z,
+};
+
+/* to the upper 24 bits, sign extended by a shift */
+static const uint8_t mask_unpack24[2][16] = {
+	{ Z, 2, 1, 0, Z, 5, 4, 3, Z, 8, 7, 6, Z, 11, 10, 9 },
+	{ Z, 6, 5, 4, Z, 9, 8, 7, Z, 12, 11, 10, Z, 15, 14, 13 },
+};
+
+#if defined(__x86_64__)
+#define AVTP_AAF_SIMD
+
+__attribute__((target("ssse3")))
+static void swap16_simd(void *dst, const void *src, size_t n)
+{
+	const __m128i m = _mm_loadu_si128((const __m128i *)mask_swap16);
+	const uint8_t *s = src;
+	uint8_t *d = dst;
+	__m128i v;
+
+	for (; n >= 8; n -= 8, s += 16, d += 16) {
+		v = _mm_loadu_si128((const __m128i *)s);
+		_mm_storeu_si128((__m128i *)d, _mm_shuffle_epi8(v, m));
+	}
+	swap16_scalar(d, s, n);
+}
+
+__attribute__((target("ssse3")))
+static void swap32_simd(void *dst, const void *src, size_t n)
+{
+	const __m128i m = _mm_loadu_si128((const __m128i *)mask_swap32);
+	const uint8_t *s = src;
+	uint8_t *d = dst;
+	__m128i v;
+
+	for (; n >= 4; n -= 4, s += 16, d += 16) {
+		v = _mm_loadu_si128((const __m128i *)s);
+		_mm_storeu_si128((__m128i *)d, _mm_shuffle_epi8(v, m));
+	}
+	swap32_scalar(d, s, n);
+}
+
+__attribute__((target("ssse3")))
+static void pack24_simd(void *dst, const void *src, size_t n)
+{
+	const __m128i m = _mm_loadu_si128((const __m128i *)mask_pack24);
+	const uint8_t *s = src;
+	uint8_t *d = dst;
+	__m128i a, b, c, e;
+
+	for (; n >= 16; n -= 16, s += 64, d += 48) {
+		a = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)s), m);
+		b = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)(s + 16)), m);
+		c = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)(s + 32)), m);
+		e = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)(s + 48)), m);
+		_mm_storeu_si128((__m128i *)d,
+				 _mm_or_si128(a, _mm_slli_si128(b, 12)));
+		_mm_storeu_si128((__m128i *)(d + 16),
+				 _mm_or_si128(_mm_srli_si128(b, 4),
+					      _mm_slli_si128(c, 8)));
+		_mm_storeu_si128((__m128i *)(d + 32),
+				 _mm_or_si128(_mm_srli_si128(c, 8),
+					      _mm_slli_si128(e, 4)));
+	}
+	pack24_scalar(d, s, n);
+}
+
+__attribute__((target("ssse3")))
+static void unpack24_simd(void *dst, const void *src, size_t n)
+{
+	const __m128i m0 = _mm_loadu_si128((const __m128i *)mask_unpack24[0]);
+	const __m128i m1 = _mm_loadu_si128((const __m128i *)mask_unpack24[1]);
+	const uint8_t *s = src;
+	uint8_t *d = dst;
+	__m128i v;
+
+	/* the last four are loaded from byte 32, not to read past 48 */
+	for (; n >= 16; n -= 16, s += 48, d += 64) {
+		v = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)s), m0);
+		_mm_storeu_si128((__m128i *)d, _mm_srai_epi32(v, 8));
+		v = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)(s + 12)), m0);
+		_mm_storeu_si128((__m128i *)(d + 16), _mm_srai_epi32(v, 8));
+		v = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)(s + 24)), m0);
+		_mm_storeu_si128((__m128i *)(d + 32), _mm_srai_epi32(v, 8));
+		v = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)(s + 32)), m1);
+		_mm_storeu_si128((__m128i *)(d + 48), _mm_srai_epi32(v, 8));
+	}
+	unpack24_scalar(d, s, n);
+}
+
+static void zip16_simd(void *dst, const void *l, const void *r, size_t n)
+{
+	const uint8_t *a = l, *b = r;
+	uint8_t *d = dst;
+	__m128i x, y;
+
+	for (; n >= 8; n -= 8, a += 16, b += 16, d += 32) {
+		x = _mm_loadu_si128((const __m128i *)a);
+		y = _mm_loadu_si128((const __m128i *)b);
+		_mm_storeu_si128((__m128i *)d, _mm_unpacklo_epi16(x, y));
+		_mm_storeu_si128((__m128i *)(d + 16), _mm_unpackhi_epi16(x, y));
+	}
+	zip16_scalar(d, a, b, n);
+}
+
+static void zip32_simd(void *dst, const void *l, const void *r, size_t n)
+{
+	const uint8_t *a = l, *b = r;
+	uint8_t *d = dst;
+	__m128i x, y;
+
+	for (; n >= 4; n -= 4, a += 16, b += 16, d += 32) {
+		x = _mm_loadu_si128((const __m128i *)a);
+		y = _mm_loadu_si128((const __m128i *)b);
+		_mm_storeu_si128((__m128i *)d, _mm_unpacklo_epi32(x, y));
+		_mm_storeu_si128((__m128i *)(d + 16), _mm_unpackhi_epi32(x, y));
+	}
+	zip32_scalar(d, a, b, n);
+}
+
+static void unzip16_simd(void *l, void *r, const void *src, size_t n)
+{
+	const uint8_t *s = src;
+	uint8_t *a = l, *b = r;
+	__m128i x, y;
+
+	/* sign extended halves of each pair are packed back without loss */
+	for (; n >= 8; n -= 8, s += 32, a += 16, b += 16) {
+		x = _mm_loadu_si128((const __m128i *)s);
+		y = _mm_loadu_si128((const __m128i *)(s + 16));
+		_mm_storeu_si128((__m128i *)a, _mm_packs_epi32(
+			_mm_srai_epi32(_mm_slli_epi32(x, 16), 16),
+			_mm_srai_epi32(_mm_slli_epi32(y, 16), 16)));
+		_mm_storeu_si128((__m128i *)b, _mm_packs_epi32(
+			_mm_srai_epi32(x, 16), _mm_srai_epi32(y, 16)));
+	}
+	unzip16_scalar(a, b, s, n);
+}
+
+static void unzip32_simd(void *l, void *r, const void *src, size_t n)
+{
+	const uint8_t *s = src;
+	uint8_t *a = l, *b = r;
+	__m128 x, y;
+
+	for (; n >= 4; n -= 4, s += 32, a += 16, b += 16) {
+		x = _mm_loadu_ps((const float *)s);
+		y = _mm_loadu_ps((const float *)(s + 16));
+		_mm_storeu_ps((float *)a, _mm_shuffle_ps(x, y, _MM_SHUFFLE(2, 0, 2, 0)));
+		_mm_storeu_ps((float *)b, _mm_shuffle_ps(x, y, _MM_SHUFFLE(3, 1, 3, 1)));
+	}
+	unzip32_scalar(a, b, s, n);
+}
+
+static inline int aaf_simd_supported(void)
+{
+	return __builtin_cpu_supports("ssse3");
+}
+
+#define AVTP_AAF_SIMD_NAME "ssse3"
+#elif defined(__aarch64__)
+#define AVTP_AAF_SIMD
+
+static void swap16_simd(void *dst, const void *src, size_t n)
+{
+	const uint8_t *s = src;
+	uint8_t *d = dst;
+
+	for (; n >= 8; n -= 8, s += 16, d += 16)
+		vst1q_u8(d, vrev16q_u8(vld1q_u8(s)));
+	swap16_scalar(d, s, n);
+}
+
+static void swap32_simd(void *dst, const void *src, size_t n)
+{
+	const uint8_t *s = src;
+	uint8_t *d = dst;
+
+	for (; n >= 4; n -= 4, s += 16, d += 16)
+		vst1q_u8(d, vrev32q_u8(vld1q_u8(s)));
+	swap32_scalar(d, s, n);
+}
+
+static void pack24_simd(void *dst, const void *src, size_t n)
+{
+	const uint8x16_t m = vld1q_u8(mask_pack24);
+	const uint8x16_t z = vdupq_n_u8(0);
+	const uint8_t *s = src;
+	uint8_t *d = dst;
+	uint8x16_t a, b, c, e;
+
+	for (; n >= 16; n -= 16, s += 64, d += 48) {
+		a = vqtbl1q_u8(vld1q_u8(s), m);
+		b = vqtbl1q_u8(vld1q_u8(s + 16), m);
+		c = vqtbl1q_u8(vld1q_u8(s + 32), m);
+		e = vqtbl1q_u8(vld1q_u8(s + 48), m);
+		vst1q_u8(d, vorrq_u8(a, vextq_u8(z, b, 4)));
+		vst1q_u8(d + 16, vorrq_u8(vextq_u8(b, z, 4),
+					  vextq_u8(z, c, 8)));
+		vst1q_u8(d + 32, vorrq_u8(vextq_u8(c, z, 8),
+					  vextq_u8(z, e, 12)));
+	}
+	pack24_scalar(d, s, n);
+}
+
+static void unpack24_simd(void *dst, const void *src, size_t n)
+{
+	const uint8x16_t m0 = vld1q_u8(mask_unpack24[0]);
+	const uint8x16_t m1 = vld1q_u8(mask_unpack24[1]);
+	const uint8_t *s = src;
+	uint8_t *d = dst;
+	int32x4_t v;
+
+	/* the last four are loaded from byte 32, not to read past 48 */
+	for (; n >= 16; n -= 16, s += 48, d += 64) {
+		v = vreinterpretq_s32_u8(vqtbl1q_u8(vld1q_u8(s), m0));
+		vst1q_s32((int32_t *)d, vshrq_n_s32(v, 8));
+		v = vreinterpretq_s32_u8(vqtbl1q_u8(vld1q_u8(s + 12), m0));
+		vst1q_s32((int32_t *)(d + 16), vshrq_n_s32(v, 8));
+		v = vreinterpretq_s32_u8(vqtbl1q_u8(vld1q_u8(s + 24), m0));
+		vst1q_s32((int32_t *)(d + 32), vshrq_n_s32(v, 8));
+		v = vreinterpretq_s32_u8(vqtbl1q_u8(vld1q_u8(s + 32), m1));
+		vst1q_s32((int32_t *)(d + 48), vshrq_n_s32(v, 8));
+	}
+	unpack24_scalar(d, s, n);
+}
+
+static void zip16_simd(void *dst, const void *l, const void *r, size_t n)
+{
+	const uint8_t *a = l, *b = r;
+	uint8_t *d = dst;
+	uint16x8x2_t v;
+
+	for (; n >= 8; n -= 8, a += 16, b += 16, d += 32) {
+		v.val[0] = vreinterpretq_u16_u8(vld1q_u8(a));
+		v.val[1] = vreinterpretq_u16_u8(vld1q_u8(b));
+		vst2q_u16((uint16_t *)d, v);
+	}
+	zip16_scalar(d, a, b, n);
+}
+
+static void zip32_simd(void *dst, const void *l, const void *r, size_t n)
+{
+	const uint8_t *a = l, *b = r;
+	uint8_t *d = dst;
+	uint32x4x2_t v;
+
+	for (; n >= 4; n -= 4, a += 16, b += 16, d += 32) {
+		v.val[0] = vreinterpretq_u32_u8(vld1q_u8(a));
+		v.val[1] = vreinterpretq_u32_u8(vld1q_u8(b));
+		vst2q_u32((uint32_t *)d, v);
+	}
+	zip32_scalar(d, a, b, n);
+}
+
+static void unzip16_simd(void *l, void *r, const void *src, size_t n)
+{
+	const uint8_t *s = src;
+	uint8_t *a = l, *b = r;
+	uint16x8x2_t v;
+
+	for (; n >= 8; n -= 8, s += 32, a += 16, b += 16) {
+		v = vld2q_u16((const uint16_t *)s);
+		vst1q_u8(a, vreinterpretq_u8_u16(v.val[0]));
+		vst1q_u8(b, vreinterpretq_u8_u16(v.val[1]));
+	}
+	unzip16_scalar(a, b, s, n);
+}
+
+static void unzip32_simd(void *l, void *r, const void *src, size_t n)
+{
+	const uint8_t *s = src;
+	uint8_t *a = l, *b = r;
+	uint32x4x2_t v;
+
+	for (; n >= 4; n -= 4, s += 32, a += 16, b += 16) {
+		v = vld2q_u32((const uint32_t *)s);
+		vst1q_u8(a, vreinterpretq_u8_u32(v.val[0]));
+		vst1q_u8(b, vreinterpretq_u8_u32(v.val[1]));
+	}
+	unzip32_scalar(a, b, s, n);
+}
+
+/* Advanced SIMD is mandatory on ARMv8-A */
+static inline int aaf_simd_supported(void)
+{
+	return 1;
+}
+
+#define AVTP_AAF_SIMD_NAME "neon"
+#endif
+
+#ifdef AVTP_AAF_SIMD
+static const struct avtp_aaf_ops aaf_ops_simd = {
+	.name     = AVTP_AAF_SIMD_NAME,
+	.swap16   = swap16_simd,
+	.swap32   = swap32_simd,
+	.pack24   = pack24_simd,
+	.unpack24 = unpack24_simd,
+	.zip16    = zip16_simd,
+	.zip32    = zip32_simd,
+	.unzip16  = unzip16_simd,
+	.unzip32  = unzip32_simd,
+};
+#endif
+
+static const struct avtp_aaf_ops *aaf_ops = &aaf_ops_scalar;
+
+__attribute__((constructor))
+static void avtp_aaf_setup(void)
+{
+	avtp_aaf_select("auto");
+}
+
+/*
+ * select implementation of the sample conversion
+ *
+ * @name     auto, simd or scalar
+ *
+ * returns -1 if the CPU has no SIMD instructions for simd.
+ */
+int avtp_aaf_select(const char *name)
+{
+	if (!strcmp(name, "scalar")) {
+		aaf_ops = &aaf_ops_scalar;
+		return 0;
+	}
+#ifdef AVTP_AAF_SIMD
+	if (!strcmp(name, "simd") || !strcmp(name, "auto")) {
+		if (aaf_simd_supported()) {
+			aaf_ops = &aaf_ops_simd;
+			return 0;
+		}
+	}
+#endif
+	if (!strcmp(name, "auto")) {
+		aaf_ops = &aaf_ops_scalar;
+		return 0;
+	}
+
+	return -1;
+}
+
+const char *avtp_aaf_name(void)
+{
+	return aaf_ops->name;
+}
+
+/*
+ * initialize AAF PCM stream
+ *
+ * @aaf        stream
+ * @format     AVTP_AAF_FORMAT_INT_16BIT, _INT_24BIT, _INT_32BIT or
+ *             _FLOAT_32BIT
+ * @rate       sample rate [Hz], user specified if not of the table
+ * @channels   channels per frame
+ * @bit_depth  valid bits of a sample, 0:all
+ */
+int avtp_aaf_init(struct avtp_aaf *aaf, int format, unsigned int rate,
+		  int channels, int bit_depth)
+{
+	int i;
+
+	memset(aaf, 0, sizeof(*aaf));
+
+	switch (format) {
+	case AVTP_AAF_FORMAT_INT_16BIT:
+		aaf->sample_size = 2;
+		aaf->host_size = 2;
+		break;
+	case AVTP_AAF_FORMAT_INT_24BIT:
+		aaf->sample_size = 3;
+		aaf->host_size = 4;
+		break;
+	case AVTP_AAF_FORMAT_INT_32BIT:
+	case AVTP_AAF_FORMAT_FLOAT_32BIT:
+		aaf->sample_size = 4;
+		aaf->host_size = 4;
+		break;
+	default:
+		return -1;
+	}
+
+	if (!bit_depth)
+		bit_depth = aaf->sample_size * 8;
+	if (bit_depth < 1 || bit_depth > aaf->sample_size * 8 ||
+	    (format == AVTP_AAF_FORMAT_FLOAT_32BIT && bit_depth != 32))
+		return -1;
+
+	if (channels < 1 || channels > AVTP_AAF_CHANNELS_MAX)
+		return -1;
+
+	aaf->format = format;
+	aaf->channels = channels;
+	aaf->bit_depth = bit_depth;
+	aaf->nsr = AVTP_AAF_NSR_USER;
+	for (i = 0; i < (int)(sizeof(aaf_rates) / sizeof(aaf_rates[0])); i++)
+		if (aaf_rates[i].rate == rate)
+			aaf->nsr = aaf_rates[i].nsr;
+
+	return 0;
+}
+
+/*
+ * initialize AAF PCM stream from a received packet
+ *
+ * @aaf      stream
+ * @packet   packet from the Ethernet header
+ * @size     bytes of the packet received
+ *
+ * returns frames in the packet, -1 if not an AAF PCM packet of a
+ * supported format or if stream_data_length is beyond the bytes
+ * received.
+ */
+int avtp_aaf_parse(struct avtp_aaf *aaf, void *packet, size_t size)
+{
+	int frame_size;
+
+	if (size < AVTP_PAYLOAD_OFFSET ||
+	    get_avtp_subtype(packet) != AVTP_SUBTYPE_AAF ||
+	    AVTP_PAYLOAD_OFFSET + get_avtp_stream_data_length(packet) > size)
+		return -1;
+
+	if (avtp_aaf_init(aaf, get_avtp_aaf_format(packet), 0,
+			  get_avtp_aaf_channels(packet),
+			  get_avtp_aaf_bit_depth(packet)) < 0)
+		return -1;
+	aaf->nsr = get_avtp_aaf_nsr(packet);
+
+	frame_size = aaf->channels * aaf->sample_size;
+
+	return get_avtp_stream_data_length(packet) / frame_size;
+}
+
+/*
+ * build AAF PCM header
+ *
+ * @aaf      stream
+ * @packet   packet from the Ethernet header
+ * @frames   frames in the packet
+ *
+ * stream ID, sequence number and timestamp are left to the caller.
+ * returns the length of the packet.
+ */
+int avtp_aaf_header(const struct avtp_aaf *aaf, void *packet, int frames)
+{
+	size_t len = avtp_aaf_payload_size(aaf, frames);
+
+	copy_avtp_aaf_template(packet);
+	set_avtp_aaf_format(packet, aaf->format);
+	set_avtp_aaf_nsr(packet, aaf->nsr);
+	set_avtp_aaf_channels(packet, aaf->channels);
+	set_avtp_aaf_bit_depth(packet, aaf->bit_depth);
+	set_avtp_stream_data_length(packet, len);
+
+	return AVTP_PAYLOAD_OFFSET + len;
+}
+
+/*
+ * convert interleaved samples to the payload
+ *
+ * @aaf      stream
+ * @payload  payload of the packet
+ * @src      samples, frames * channels
+ * @frames   frames to convert
+ *
+ * returns bytes of the payload written.
+ */
+size_t avtp_aaf_pack(const struct avtp_aaf *aaf, void *payload,
+		     const void *src, int frames)
+{
+	size_t n = (size_t)frames * aaf->channels;
+
+	switch (aaf->sample_size) {
+	case 2:
+		aaf_ops->swap16(payload, src, n);
+		break;
+	case 3:
+		aaf_ops->pack24(payload, src, n);
+		break;
+	default:
+		aaf_ops->swap32(payload, src, n);
+		break;
+	}
+
+	return n * aaf->sample_size;
+}
+
+/*
+ * convert the payload to interleaved samples
+ *
+ * @aaf      stream
+ * @dst      samples, frames * channels
+ * @payload  payload of the packet
+ * @frames   frames to convert
+ */
+void avtp_aaf_unpack(const struct avtp_aaf *aaf, void *dst,
+		     const void *payload, int frames)
+{
+	size_t n = (size_t)frames * aaf->channels;
+
+	switch (aaf->sample_size) {
+	case 2:
+		aaf_ops->swap16(dst, payload, n);
+		break;
+	case 3:
+		aaf_ops->unpack24(dst, payload, n);
+		break;
+	default:
+		aaf_ops->swap32(dst, payload, n);
+		break;
+	}
+}
+
+static void aaf_interleave(const struct avtp_aaf *aaf, void *dst,
+			   const void *const *planes, size_t offset, int frames)
+{
+	size_t hs = aaf->host_size, ch = aaf->channels;
+	uint8_t *d = dst;
+	size_t c, i;
+
+	if (ch == 2) {
+		if (hs == 2)
+			aaf_ops->zip16(dst, planes[0] + offset * hs,
+				       planes[1] + offset * hs, frames);
+		else
+			aaf_ops->zip32(dst, planes[0] + offset * hs,
+				       planes[1] + offset * hs, frames);
+		return;
+	}
+
+	for (c = 0; c < ch; c++) {
+		const uint8_t *p = planes[c] + offset * hs;
+
+		if (hs == 2)
+			for (i = 0; i < frames; i++)
+				st16(d + (i * ch + c) * 2, ld16(p + i * 2));
+		else
+			for (i = 0; i < frames; i++)
+				st32(d + (i * ch + c) * 4, ld32(p + i * 4));
+	}
+}
+
+static void aaf_deinterleave(const struct avtp_aaf *aaf, void *const *planes,
+			     size_t offset, const void *src, int frames)
+{
+	size_t hs = aaf->host_size, ch = aaf->channels;
+	const uint8_t *s = src;
+	size_t c, i;
+
+	if (ch == 2) {
+		if (hs == 2)
+			aaf_ops->unzip16(planes[0] + offset * hs,
+					 planes[1] + offset * hs, src, frames);
+		else
+			aaf_ops->unzip32(planes[0] + offset * hs,
+					 planes[1] + offset * hs, src, frames);
+		return;
+	}
+
+	for (c = 0; c < ch; c++) {
+		uint8_t *p = planes[c] + offset * hs;
+
+		if (hs == 2)
+			for (i = 0; i < frames; i++)
+				st16(p + i * 2, ld16(s + (i * ch + c) * 2));
+		else
+			for (i = 0; i < frames; i++)
+				st32(p + i * 4, ld32(s + (i * ch + c) * 4));
+	}
+}
+
+/*
+ * convert samples of one buffer per channel to the payload
+ *
+ * @aaf      stream
+ * @payload  payload of the packet
+ * @planes   samples of each channel
+ * @offset   first frame in the planes
+ * @frames   frames to convert
+ *
+ * returns bytes of the payload written.
+ */
+size_t avtp_aaf_pack_planar(const struct avtp_aaf *aaf, void *payload,
+			    const void *const *planes, size_t offset,
+			    int frames)
+{
+	uint32_t tmp[AVTP_AAF_SCRATCH];
+	int chunk = AVTP_AAF_SCRATCH / aaf->channels;
+	uint8_t *p = payload;
+	int n;
+
+	if (aaf->channels == 1)
+		return avtp_aaf_pack(aaf, payload,
+				     planes[0] + offset * aaf->host_size,
+				     frames);
+
+	/* interleaved in a buffer of the L1 cache, then converted */
+	while (frames > 0) {
+		n = (frames < chunk) ? frames : chunk;
+		aaf_interleave(aaf, tmp, planes, offset, n);
+		p += avtp_aaf_pack(aaf, p, tmp, n);
+		offset += n;
+		frames -= n;
+	}
+
+	return p - (uint8_t *)payload;
+}
+
+/*
+ * convert the payload to samples of one buffer per channel
+ *
+ * @aaf      stream
+ * @planes   samples of each channel
+ * @offset   first frame in the planes
+ * @payload  payload of the packet
+ * @frames   frames to convert
+ */
+void avtp_aaf_unpack_planar(const struct avtp_aaf *aaf, void *const *planes,
+			    size_t offset, const void *payload, int frames)
+{
+	uint32_t tmp[AVTP_AAF_SCRATCH];
+	int chunk = AVTP_AAF_SCRATCH / aaf->channels;
+	const uint8_t *p = payload;
+	int n;
+
+	if (aaf->channels == 1) {
+		avtp_aaf_unpack(aaf, planes[0] + offset * aaf->host_size,
+				payload, frames);
+		return;
+	}
+
+	while (frames > 0) {
+		n = (frames < chunk) ? frames : chunk;
+		avtp_aaf_unpack(aaf, tmp, p, n);
+		aaf_deinterleave(aaf, planes, offset, tmp, n);
+		p += avtp_aaf_payload_size(aaf, n);
+		offset += n;
+		frames -= n;
+	}
+}
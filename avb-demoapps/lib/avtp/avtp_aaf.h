@@ -0,0 +1,61 @@
+/*
+ * Copyright (c) 2014-2016 Renesas Electronics Corporation
+ * Released under the MIT license
+ * http://opensource.org/licenses/mit-license.php
+ */
+
+#ifndef __AVTP_AAF_H__
+#define __AVTP_AAF_H__
+
+#include <stdint.h>
+#include <stddef.h>
+
+/*
+ * AAF PCM stream (IEEE1722-2016 7)
+ *
+ * samples in the payload are interleaved by channel and big endian.
+ * samples in memory are host endian, interleaved or one buffer per
+ * channel (planar), and of the type of the format:
+ *
+ *   AVTP_AAF_FORMAT_INT_16BIT:   int16_t
+ *   AVTP_AAF_FORMAT_INT_24BIT:   int32_t, sign extended from bit 23
+ *   AVTP_AAF_FORMAT_INT_32BIT:   int32_t
+ *   AVTP_AAF_FORMAT_FLOAT_32BIT: float
+ */
+struct avtp_aaf {
+	uint8_t  format;       /* AVTP_AAF_FORMAT_* */
+	uint8_t  nsr;          /* AVTP_AAF_NSR_* */
+	uint16_t channels;
+	uint8_t  bit_depth;
+	int      sample_size;  /* bytes of a sample in the payload */
+	int      host_size;    /* bytes of a sample in memory */
+};
+
+extern int avtp_aaf_init(struct avtp_aaf *aaf, int format, unsigned int rate,
+			 int channels, int bit_depth);
+extern int avtp_aaf_parse(struct avtp_aaf *aaf, void *packet, size_t size);
+extern int avtp_aaf_header(const struct avtp_aaf *aaf, void *packet,
+			   int frames);
+
+extern size_t avtp_aaf_pack(const struct avtp_aaf *aaf, void *payload,
+			    const void *src, int frames);
+extern size_t avtp_aaf_pack_planar(const struct avtp_aaf *aaf, void *payload,
+				   const void *const *planes, size_t offset,
+				   int frames);
+extern void avtp_aaf_unpack(const struct avtp_aaf *aaf, void *dst,
+			    const void *payload, int frames);
+extern void avtp_aaf_unpack_planar(const struct avtp_aaf *aaf,
+				   void *const *planes, size_t offset,
+				   const void *payload, int frames);
+
+extern int avtp_aaf_select(const char *name);
+extern const char *avtp_aaf_name(void);
+
+/* bytes of the payload of a packet of frames */
+static inline size_t avtp_aaf_payload_size(const struct avtp_aaf *aaf,
+					   int frames)
+{
+	return (size_t)frames * aaf->channels * aaf->sample_size;
+}
+
+#endif /* __AVTP_AAF_H__ */
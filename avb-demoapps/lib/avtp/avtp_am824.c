@@ -0,0 +1,636 @@
+/*
+ * Copyright (c) 2014-2016 Renesas Electronics Corporation
+ * Released under the MIT license
+ * http://opensource.org/licenses/mit-license.php
+ */
+
+#include <string.h>
+
+#if defined(__x86_64__)
+#include <tmmintrin.h>
+#elif defined(__aarch64__)
+#include <arm_neon.h>
+#endif
+
+#include "avtp.h"
+#include "avtp_am824.h"
+
+#define NSEC_SCALE (1000000000ull)
+
+/* byte of a shuffle mask that gives zero, for PSHUFB and TBL */
+#define Z (0x80)
+
+/* FDF of AM824: EVT 00 and N 0 above the SFC */
+#define CIP_FDF_SFC_MASK (0x07)
+
+/*
+ * 32-bit samples to quadlets of a zero label and the 24 bits of the
+ * sample big endian, and quadlets back to samples of the upper 24 bits
+ */
+static const uint8_t mask_quadlet24[16] = {
+	Z, 2, 1, 0, Z, 6, 5, 4, Z, 10, 9, 8, Z, 14, 13, 12,
+};
+
+static const uint8_t mask_quadlet32[16] = {
+	Z, 3, 2, 1, Z, 7, 6, 5, Z, 11, 10, 9, Z, 15, 14, 13,
+};
+
+/* 16-bit samples to the upper 16 of the 24 bits, and back */
+static const uint8_t mask_pack16[2][16] = {
+	{ Z, 1, 0, Z, Z, 3, 2, Z, Z, 5, 4, Z, Z, 7, 6, Z },
+	{ Z, 9, 8, Z, Z, 11, 10, Z, Z, 13, 12, Z, Z, 15, 14, Z },
+};
+
+static const uint8_t mask_unpack16[16] = {
+	2, 1, 6, 5, 10, 9, 14, 13, Z, Z, Z, Z, Z, Z, Z, Z,
+};
+
+struct am824_format {
+	uint8_t       format;
+	int           host_size;
+	uint8_t       label;
+	int           shift;      /* of the 24 bits in a 32-bit sample */
+	const uint8_t *mask;      /* of the packing of 32-bit samples */
+};
+
+static const struct am824_format am824_formats[] = {
+	{ AVTP_AAF_FORMAT_INT_16BIT, 2, AVTP_AM824_LABEL_MBLA_16BIT, 0, NULL },
+	{ AVTP_AAF_FORMAT_INT_24BIT, 4, AVTP_AM824_LABEL_MBLA_24BIT, 0,
+	  mask_quadlet24 },
+	{ AVTP_AAF_FORMAT_INT_32BIT, 4, AVTP_AM824_LABEL_MBLA_24BIT, 8,
+	  mask_quadlet32 },
+};
+
+/* IEC 61883-6 Table 3 and Table 8. SYT_INTERVAL of the non-blocking */
+static const struct {
+	unsigned int rate;
+	uint8_t      sfc;
+	int          syt_interval;
+} am824_rates[] = {
+	{  32000, AVTP_CIP_SFC_32KHZ,     8 },
+	{  44100, AVTP_CIP_SFC_44_1KHZ,   8 },
+	{  48000, AVTP_CIP_SFC_48KHZ,     8 },
+	{  88200, AVTP_CIP_SFC_88_2KHZ,  16 },
+	{  96000, AVTP_CIP_SFC_96KHZ,    16 },
+	{ 176400, AVTP_CIP_SFC_176_4KHZ, 32 },
+	{ 192000, AVTP_CIP_SFC_192KHZ,   32 },
+};
+
+#define AM824_FORMATS (sizeof(am824_formats) / sizeof(am824_formats[0]))
+#define AM824_RATES   (sizeof(am824_rates) / sizeof(am824_rates[0]))
+
+struct avtp_am824_ops {
+	const char *name;
+	void (*pack)(void *dst, const void *src, size_t n,
+		     const struct am824_format *f, uint8_t label);
+	/* returns quadlets of another label */
+	size_t (*unpack)(void *dst, const void *src, size_t n,
+			 const struct am824_format *f, uint8_t label);
+};
+
+static const struct am824_format *am824_format(uint8_t format)
+{
+	size_t i;
+
+	for (i = 0; i < AM824_FORMATS; i++)
+		if (am824_formats[i].format == format)
+			return &am824_formats[i];
+
+	return NULL;
+}
+
+/*
+ * Scalar
+ *
+ * payloads follow the 18 + 24 + 8 byte headers, so that quadlets are
+ * not aligned.
+ */
+static inline uint16_t ld16(const uint8_t *p)
+{
+	uint16_t v;
+
+	memcpy(&v, p, sizeof(v));
+
+	return v;
+}
+
+static inline uint32_t ld32(const uint8_t *p)
+{
+	uint32_t v;
+
+	memcpy(&v, p, sizeof(v));
+
+	return v;
+}
+
+static inline void st16(uint8_t *p, uint16_t v)
+{
+	memcpy(p, &v, sizeof(v));
+}
+
+static inline void st32(uint8_t *p, uint32_t v)
+{
+	memcpy(p, &v, sizeof(v));
+}
+
+static void pack_scalar(void *dst, const void *src, size_t n,
+			const struct am824_format *f, uint8_t label)
+{
+	const uint8_t *s = src;
+	uint8_t *d = dst;
+	uint32_t l = (uint32_t)label << 24;
+	size_t i;
+
+	if (f->host_size == 2) {
+		for (i = 0; i < n; i++)
+			st32(d + i * 4, __builtin_bswap32(
+				l | (uint32_t)ld16(s + i * 2) << 8));
+		return;
+	}
+
+	for (i = 0; i < n; i++)
+		st32(d + i * 4, __builtin_bswap32(
+			l | ((ld32(s + i * 4) >> f->shift) & 0xffffff)));
+}
+
+static size_t unpack_scalar(void *dst, const void *src, size_t n,
+			    const struct am824_format *f, uint8_t label)
+{
+	const uint8_t *s = src;
+	uint8_t *d = dst;
+	size_t i, errors = 0;
+	uint32_t v;
+
+	for (i = 0; i < n; i++) {
+		v = __builtin_bswap32(ld32(s + i * 4));
+		errors += (v >> 24) != label;
+		if (f->host_size == 2)
+			st16(d + i * 2, v >> 8);
+		else
+			st32(d + i * 4,
+			     (uint32_t)((int32_t)(v << 8) >> (8 - f->shift)));
+	}
+
+	return errors;
+}
+
+static const struct avtp_am824_ops am824_ops_scalar = {
+	.name   = "scalar",
+	.pack   = pack_scalar,
+	.unpack = unpack_scalar,
+};
+
+/*
+ * SIMD
+ *
+ * a vector of quadlets is shuffled from the samples and the label is
+ * or'ed in. labels are compared in lanes while unpacking, the lanes
+ * count the quadlets of the label.
+ */
+#if defined(__x86_64__)
+#define AVTP_AM824_SIMD
+
+__attribute__((target("ssse3")))
+static void pack_simd(void *dst, const void *src, size_t n,
+		      const struct am824_format *f, uint8_t label)
+{
+	const __m128i l = _mm_set1_epi32(label);
+	const uint8_t *s = src;
+	uint8_t *d = dst;
+	__m128i m0, m1, v;
+
+	if (f->host_size == 2) {
+		m0 = _mm_loadu_si128((const __m128i *)mask_pack16[0]);
+		m1 = _mm_loadu_si128((const __m128i *)mask_pack16[1]);
+		for (; n >= 8; n -= 8, s += 16, d += 32) {
+			v = _mm_loadu_si128((const __m128i *)s);
+			_mm_storeu_si128((__m128i *)d,
+					 _mm_or_si128(_mm_shuffle_epi8(v, m0), l));
+			_mm_storeu_si128((__m128i *)(d + 16),
+					 _mm_or_si128(_mm_shuffle_epi8(v, m1), l));
+		}
+	} else {
+		m0 = _mm_loadu_si128((const __m128i *)f->mask);
+		for (; n >= 8; n -= 8, s += 32, d += 32) {
+			v = _mm_loadu_si128((const __m128i *)s);
+			_mm_storeu_si128((__m128i *)d,
+					 _mm_or_si128(_mm_shuffle_epi8(v, m0), l));
+			v = _mm_loadu_si128((const __m128i *)(s + 16));
+			_mm_storeu_si128((__m128i *)(d + 16),
+					 _mm_or_si128(_mm_shuffle_epi8(v, m0), l));
+		}
+	}
+	pack_scalar(d, s, n, f, label);
+}
+
+__attribute__((target("ssse3")))
+static size_t unpack_simd(void *dst, const void *src, size_t n,
+			  const struct am824_format *f, uint8_t label)
+{
+	const __m128i l = _mm_set1_epi32(label);
+	const __m128i lm = _mm_set1_epi32(0xff);
+	const uint8_t *s = src;
+	uint8_t *d = dst;
+	__m128i m, a, b, ok = _mm_setzero_si128();
+	__m128i sh = _mm_cvtsi32_si128(8 - f->shift);
+	size_t done = 0;
+
+	if (f->host_size == 2) {
+		m = _mm_loadu_si128((const __m128i *)mask_unpack16);
+		for (; n >= 8; n -= 8, done += 8, s += 32, d += 16) {
+			a = _mm_loadu_si128((const __m128i *)s);
+			b = _mm_loadu_si128((const __m128i *)(s + 16));
+			ok = _mm_sub_epi32(ok, _mm_cmpeq_epi32(
+				_mm_and_si128(a, lm), l));
+			ok = _mm_sub_epi32(ok, _mm_cmpeq_epi32(
+				_mm_and_si128(b, lm), l));
+			_mm_storeu_si128((__m128i *)d, _mm_unpacklo_epi64(
+				_mm_shuffle_epi8(a, m), _mm_shuffle_epi8(b, m)));
+		}
+	} else {
+		m = _mm_loadu_si128((const __m128i *)mask_quadlet32);
+		for (; n >= 4; n -= 4, done += 4, s += 16, d += 16) {
+			a = _mm_loadu_si128((const __m128i *)s);
+			ok = _mm_sub_epi32(ok, _mm_cmpeq_epi32(
+				_mm_and_si128(a, lm), l));
+			_mm_storeu_si128((__m128i *)d, _mm_sra_epi32(
+				_mm_shuffle_epi8(a, m), sh));
+		}
+	}
+	ok = _mm_add_epi32(ok, _mm_srli_si128(ok, 8));
+	ok = _mm_add_epi32(ok, _mm_srli_si128(ok, 4));
+
+	return done - (uint32_t)_mm_cvtsi128_si32(ok) +
+		unpack_scalar(d, s, n, f, label);
+}
+
+static inline int am824_simd_supported(void)
+{
+	return __builtin_cpu_supports("ssse3");
+}
+
+#define AVTP_AM824_SIMD_NAME "ssse3"
+#elif defined(__aarch64__)
+#define AVTP_AM824_SIMD
+
+static void pack_simd(void *dst, const void *src, size_t n,
+		      const struct am824_format *f, uint8_t label)
+{
+	const uint8x16_t l = vreinterpretq_u8_u32(vdupq_n_u32(label));
+	const uint8_t *s = src;
+	uint8_t *d = dst;
+	uint8x16_t m0, m1, v;
+
+	if (f->host_size == 2) {
+		m0 = vld1q_u8(mask_pack16[0]);
+		m1 = vld1q_u8(mask_pack16[1]);
+		for (; n >= 8; n -= 8, s += 16, d += 32) {
+			v = vld1q_u8(s);
+			vst1q_u8(d, vorrq_u8(vqtbl1q_u8(v, m0), l));
+			vst1q_u8(d + 16, vorrq_u8(vqtbl1q_u8(v, m1), l));
+		}
+	} else {
+		m0 = vld1q_u8(f->mask);
+		for (; n >= 8; n -= 8, s += 32, d += 32) {
+			vst1q_u8(d, vorrq_u8(vqtbl1q_u8(vld1q_u8(s), m0), l));
+			vst1q_u8(d + 16,
+				 vorrq_u8(vqtbl1q_u8(vld1q_u8(s + 16), m0), l));
+		}
+	}
+	pack_scalar(d, s, n, f, label);
+}
+
+static size_t unpack_simd(void *dst, const void *src, size_t n,
+			  const struct am824_format *f, uint8_t label)
+{
+	const uint32x4_t l = vdupq_n_u32(label);
+	const uint32x4_t lm = vdupq_n_u32(0xff);
+	const int32x4_t sh = vdupq_n_s32(f->shift - 8);
+	const uint8_t *s = src;
+	uint8_t *d = dst;
+	uint32x4_t ok = vdupq_n_u32(0);
+	uint8x16_t m, a, b;
+	size_t done = 0;
+
+	if (f->host_size == 2) {
+		m = vld1q_u8(mask_unpack16);
+		for (; n >= 8; n -= 8, done += 8, s += 32, d += 16) {
+			a = vld1q_u8(s);
+			b = vld1q_u8(s + 16);
+			ok = vsubq_u32(ok, vceqq_u32(vandq_u32(
+				vreinterpretq_u32_u8(a), lm), l));
+			ok = vsubq_u32(ok, vceqq_u32(vandq_u32(
+				vreinterpretq_u32_u8(b), lm), l));
+			vst1q_u8(d, vcombine_u8(vget_low_u8(vqtbl1q_u8(a, m)),
+						vget_low_u8(vqtbl1q_u8(b, m))));
+		}
+	} else {
+		m = vld1q_u8(mask_quadlet32);
+		for (; n >= 4; n -= 4, done += 4, s += 16, d += 16) {
+			a = vld1q_u8(s);
+			ok = vsubq_u32(ok, vceqq_u32(vandq_u32(
+				vreinterpretq_u32_u8(a), lm), l));
+			vst1q_s32((int32_t *)d, vshlq_s32(
+				vreinterpretq_s32_u8(vqtbl1q_u8(a, m)), sh));
+		}
+	}
+
+	return done - vaddvq_u32(ok) + unpack_scalar(d, s, n, f, label);
+}
+
+/* Advanced SIMD is mandatory on ARMv8-A */
+static inline int am824_simd_supported(void)
+{
+	return 1;
+}
+
+#define AVTP_AM824_SIMD_NAME "neon"
+#endif
+
+#ifdef AVTP_AM824_SIMD
+static const struct avtp_am824_ops am824_ops_simd = {
+	.name   = AVTP_AM824_SIMD_NAME,
+	.pack   = pack_simd,
+	.unpack = unpack_simd,
+};
+#endif
+
+static const struct avtp_am824_ops *am824_ops = &am824_ops_scalar;
+
+__attribute__((constructor))
+static void avtp_am824_setup(void)
+{
+	avtp_am824_select("auto");
+}
+
+/*
+ * select implementation of the sample conversion
+ *
+ * @name     auto, simd or scalar
+ *
+ * returns -1 if the CPU has no SIMD instructions for simd.
+ */
+int avtp_am824_select(const char *name)
+{
+	if (!strcmp(name, "scalar")) {
+		am824_ops = &am824_ops_scalar;
+		return 0;
+	}
+#ifdef AVTP_AM824_SIMD
+	if (!strcmp(name, "simd") || !strcmp(name, "auto")) {
+		if (am824_simd_supported()) {
+			am824_ops = &am824_ops_simd;
+			return 0;
+		}
+	}
+#endif
+	if (!strcmp(name, "auto")) {
+		am824_ops = &am824_ops_scalar;
+		return 0;
+	}
+
+	return -1;
+}
+
+const char *avtp_am824_name(void)
+{
+	return am824_ops->name;
+}
+
+/* the stream of the i-th rate, counters are kept */
+static int am824_config(struct avtp_am824 *am, int format, int i,
+			int channels)
+{
+	const struct am824_format *f = am824_format(format);
+
+	if (!f || channels < 1 || channels > AVTP_AM824_CHANNELS_MAX)
+		return -1;
+
+	am->format = format;
+	am->host_size = f->host_size;
+	am->label = f->label;
+	am->dbs = channels;
+	am->rate = am824_rates[i].rate;
+	am->sfc = am824_rates[i].sfc;
+	am->syt_interval = am824_rates[i].syt_interval;
+
+	return 0;
+}
+
+/*
+ * data block of a packet whose DBC is a multiple of SYT_INTERVAL,
+ * -1 if none
+ */
+static int am824_syt_block(const struct avtp_am824 *am, uint8_t dbc,
+			   int blocks)
+{
+	int k = (am->syt_interval - dbc % am->syt_interval) % am->syt_interval;
+
+	return (k < blocks) ? k : -1;
+}
+
+/*
+ * initialize AM824 stream
+ *
+ * @am         stream
+ * @format     AVTP_AAF_FORMAT_INT_16BIT, _INT_24BIT or _INT_32BIT of
+ *             samples in memory
+ * @rate       sample rate [Hz] of IEC 61883-6, 0:of the first packet
+ * @channels   channels per data block, 0:of the first packet
+ */
+int avtp_am824_init(struct avtp_am824 *am, int format, unsigned int rate,
+		    int channels)
+{
+	size_t i;
+
+	memset(am, 0, sizeof(*am));
+	am->syt = -1;
+
+	if (!am824_format(format))
+		return -1;
+	am->format = format;
+
+	/* to be received */
+	if (!rate && !channels)
+		return 0;
+
+	for (i = 0; i < AM824_RATES; i++)
+		if (am824_rates[i].rate == rate)
+			return am824_config(am, format, i, channels);
+
+	return -1;
+}
+
+/*
+ * build AM824 header
+ *
+ * @am       stream
+ * @packet   packet from the Ethernet header
+ * @blocks   data blocks in the packet
+ * @time     presentation time of the first data block [ns]
+ *
+ * the packet is of copy_avtp_61883_6_template(), fields of the stream
+ * are set. DBC is counted up by the data blocks. the timestamp is set
+ * to the presentation time of the data block of SYT_INTERVAL if the
+ * packet has it. stream ID and sequence number are left to the caller.
+ * returns the length of the packet.
+ */
+int avtp_am824_header(struct avtp_am824 *am, void *packet, int blocks,
+		      uint64_t time)
+{
+	size_t len = avtp_am824_payload_size(am, blocks);
+	int syt = am824_syt_block(am, am->dbc, blocks);
+
+	set_avtp_stream_data_length(packet, len);
+	set_avtp_cip_dbs(packet, am->dbs);
+	set_avtp_cip_dbc(packet, am->dbc);
+	set_avtp_cip_fdf(packet, am->sfc);
+
+	set_avtp_tv(packet, syt >= 0);
+	set_avtp_timestamp(packet, (syt < 0) ? 0 :
+			   (uint32_t)(time + syt * NSEC_SCALE / am->rate));
+
+	am->dbc += blocks;
+	am->syt = syt;
+	am->packets++;
+	am->data_blocks += blocks;
+
+	return AVTP_PAYLOAD_OFFSET + len;
+}
+
+/*
+ * check a received AM824 packet
+ *
+ * @am       stream, of the first packet if initialized so
+ * @packet   packet from the Ethernet header
+ * @size     bytes of the packet received
+ * @lost     data blocks missing before the packet by DBC
+ *
+ * DBC wraps at 256 data blocks, a longer gap is told from the packets
+ * missing by the sequence number, up to AVTP_AM824_LATE_WINDOW short
+ * of its wrap. a packet behind the last one is late or repeated and
+ * counted as an error with those of another stream, the second in a
+ * row is of the stream gone on after a longer loss and synced again.
+ * a packet whose stream_data_length is beyond the bytes received is
+ * an error, its data blocks are not there to unpack.
+ * returns data blocks in the packet, -1 if it is to be dropped.
+ */
+int avtp_am824_parse(struct avtp_am824 *am, void *packet, size_t size,
+		     int *lost)
+{
+	uint8_t dbs, sfc, dbc, seq;
+	size_t len;
+	int blocks, n, gap;
+	size_t i;
+
+	*lost = 0;
+
+	if (size < AVTP_61883_PAYLOAD_OFFSET)
+		goto error;
+
+	dbs = get_avtp_cip_dbs(packet);
+	sfc = get_avtp_cip_fdf(packet);
+	len = get_avtp_stream_data_length(packet);
+	if (get_avtp_subtype(packet) != AVTP_SUBTYPE_61883_IIDC ||
+	    (get_avtp_iec61883_tag_channel(packet) & 0xc0) !=
+	    AVTP_61883_TAG_CIP ||
+	    (get_avtp_cip_sid(packet) & 0xc0) ||
+	    get_avtp_cip_fmt(packet) != (AVTP_CIP_QI_2 | AVTP_CIP_FMT_61883_6) ||
+	    (sfc & ~CIP_FDF_SFC_MASK) || !dbs || len < AVTP_CIP_HEADER_SIZE ||
+	    AVTP_PAYLOAD_OFFSET + len > size)
+		goto error;
+
+	if (!am->dbs) {
+		for (i = 0; i < AM824_RATES; i++)
+			if (am824_rates[i].sfc == sfc)
+				break;
+		if (i == AM824_RATES || am824_config(am, am->format, i, dbs) < 0)
+			goto error;
+	}
+
+	len -= AVTP_CIP_HEADER_SIZE;
+	if (dbs != am->dbs || sfc != am->sfc || len % (dbs * 4))
+		goto error;
+	blocks = len / (dbs * 4);
+
+	seq = get_avtp_sequence_num(packet);
+	dbc = get_avtp_cip_dbc(packet);
+	if (am->synced) {
+		n = (uint8_t)(seq - am->seq - 1);
+		if (n >= 256 - AVTP_AM824_LATE_WINDOW && !am->late++)
+			goto error;
+
+		if (n >= 256 - AVTP_AM824_LATE_WINDOW) {
+			/* the data blocks lost are not known */
+			am->discontinuities++;
+		} else {
+			gap = (uint8_t)(dbc - am->dbc);
+			if (n * am->blocks > gap + 128)
+				gap += (n * am->blocks - gap + 128) / 256 * 256;
+			if (gap) {
+				am->discontinuities++;
+				am->lost += gap;
+				*lost = gap;
+			}
+		}
+	}
+	am->synced = true;
+	am->late = 0;
+	am->seq = seq;
+	am->dbc = dbc + blocks;
+	am->blocks = blocks;
+
+	am->syt = am824_syt_block(am, dbc, blocks);
+	if (get_avtp_tv(packet) != (am->syt >= 0))
+		am->syt_errors++;
+
+	am->packets++;
+	am->data_blocks += blocks;
+
+	return blocks;
+
+error:
+	am->errors++;
+	return -1;
+}
+
+/*
+ * convert interleaved samples to data blocks of the payload
+ *
+ * @am       stream
+ * @payload  payload of the packet, after the CIP header
+ * @src      samples, blocks * channels
+ * @blocks   data blocks to convert
+ *
+ * returns bytes of the payload written.
+ */
+size_t avtp_am824_pack(const struct avtp_am824 *am, void *payload,
+		       const void *src, int blocks)
+{
+	size_t n = (size_t)blocks * am->dbs;
+
+	am824_ops->pack(payload, src, n, am824_format(am->format), am->label);
+
+	return n * 4;
+}
+
+/*
+ * convert data blocks of the payload to interleaved samples
+ *
+ * @am       stream
+ * @dst      samples, blocks * channels
+ * @payload  payload of the packet, after the CIP header
+ * @blocks   data blocks to convert
+ *
+ * quadlets of another label are counted, and converted as well. dst
+ * may be the payload, samples are converted in place.
+ */
+void avtp_am824_unpack(struct avtp_am824 *am, void *dst, const void *payload,
+		       int blocks)
+{
+	size_t n = (size_t)blocks * am->dbs;
+
+	am->label_errors += am824_ops->unpack(dst, payload, n,
+					      am824_format(am->format),
+					      am->label);
+}
@@ -0,0 +1,90 @@
+/*
+ * Copyright (c) 2014-2016 Renesas Electronics Corporation
+ * Released under the MIT license
+ * http://opensource.org/licenses/mit-license.php
+ */
+
+#ifndef __AVTP_AM824_H__
+#define __AVTP_AM824_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "avtp.h"
+
+/*
+ * IEC 61883-6 AM824 stream (IEEE1722-2016 5.2)
+ *
+ * the payload is the CIP header followed by data blocks of a quadlet
+ * per channel: a label and a big endian 24-bit sample. packets are of
+ * the non-blocking transmission, with a fixed number of data blocks.
+ * DBC counts the data blocks sent modulo 256. the timestamp is valid
+ * on a packet with a data block whose DBC is a multiple of
+ * SYT_INTERVAL and is its presentation time, SYT of the CIP header is
+ * of no info. samples in memory are interleaved by channel and of the
+ * type of the format, as of avtp_aaf.h:
+ *
+ *   AVTP_AAF_FORMAT_INT_16BIT:   int16_t, label of 16 bits
+ *   AVTP_AAF_FORMAT_INT_24BIT:   int32_t, sign extended from bit 23
+ *   AVTP_AAF_FORMAT_INT_32BIT:   int32_t, the lower 8 bits are lost
+ */
+#define AVTP_AM824_CHANNELS_MAX (255)
+/* sequence numbers behind the last packet that are taken as late */
+#define AVTP_AM824_LATE_WINDOW  (64)
+
+/* IEC 61883-6 Table 6. labels of multi-bit linear audio */
+enum AVTP_AM824_LABEL {
+	AVTP_AM824_LABEL_MBLA_24BIT = 0x40,
+	AVTP_AM824_LABEL_MBLA_20BIT = 0x41,
+	AVTP_AM824_LABEL_MBLA_16BIT = 0x42,
+};
+
+struct avtp_am824 {
+	uint8_t  format;       /* AVTP_AAF_FORMAT_* of memory */
+	uint8_t  sfc;          /* AVTP_CIP_SFC_* */
+	uint8_t  dbs;          /* channels, quadlets of a data block */
+	uint8_t  label;        /* of every channel */
+	unsigned int rate;
+	int      host_size;    /* bytes of a sample in memory */
+	int      syt_interval; /* data blocks between timestamps */
+
+	uint8_t  dbc;          /* of the next packet */
+	uint8_t  seq;          /* of the last packet received */
+	bool     synced;       /* a packet was received */
+	int      late;         /* packets behind the last one in a row */
+	int      blocks;       /* data blocks of the last packet */
+	int      syt;          /* data block of its timestamp, -1:none */
+
+	uint64_t packets;
+	uint64_t data_blocks;
+	uint64_t lost;            /* data blocks missing by DBC */
+	uint64_t discontinuities; /* packets after a gap or a resync */
+	uint64_t syt_errors;      /* tv not set as of DBC */
+	uint64_t label_errors;    /* quadlets of another label */
+	uint64_t errors;          /* packets not of the stream */
+};
+
+extern int avtp_am824_init(struct avtp_am824 *am, int format,
+			   unsigned int rate, int channels);
+extern int avtp_am824_header(struct avtp_am824 *am, void *packet, int blocks,
+			     uint64_t time);
+extern int avtp_am824_parse(struct avtp_am824 *am, void *packet, size_t size,
+			    int *lost);
+
+extern size_t avtp_am824_pack(const struct avtp_am824 *am, void *payload,
+			      const void *src, int blocks);
+extern void avtp_am824_unpack(struct avtp_am824 *am, void *dst,
+			      const void *payload, int blocks);
+
+extern int avtp_am824_select(const char *name);
+extern const char *avtp_am824_name(void);
+
+/* bytes of the payload of a packet of data blocks, with the CIP header */
+static inline size_t avtp_am824_payload_size(const struct avtp_am824 *am,
+					     int blocks)
+{
+	return AVTP_CIP_HEADER_SIZE + (size_t)blocks * am->dbs * 4;
+}
+
+#endif /* __AVTP_AM824_H__ */
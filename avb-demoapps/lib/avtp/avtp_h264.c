@@ -0,0 +1,610 @@
+/*
+ * Copyright (c) 2014-2016 Renesas Electronics Corporation
+ * Released under the MIT license
+ * http://opensource.org/licenses/mit-license.php
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__x86_64__)
+#include <emmintrin.h>
+#elif defined(__aarch64__)
+#include <arm_neon.h>
+#endif
+
+#include "avtp.h"
+#include "avtp_h264.h"
+
+typedef const uint8_t *(*find_start_func)(const uint8_t *p,
+					  const uint8_t *end);
+
+/*
+ * a start code is 00 00 01. where the third byte is greater than 1,
+ * none starts at any of the three bytes.
+ */
+static const uint8_t *find_start_scalar(const uint8_t *p, const uint8_t *end)
+{
+	for (; end - p >= 3; p++) {
+		if (p[2] > 1)
+			p += 2;
+		else if (p[2] == 1 && !p[1] && !p[0])
+			return p;
+	}
+
+	return end;
+}
+
+/*
+ * 16 positions are tested at once. most blocks of a slice have no zero
+ * byte at all and are skipped by the first compare.
+ */
+#if defined(__x86_64__)
+#define AVTP_H264_SIMD_NAME "sse2"
+
+static const uint8_t *find_start_simd(const uint8_t *p, const uint8_t *end)
+{
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i one = _mm_set1_epi8(1);
+	__m128i b, c;
+	unsigned int m;
+
+	for (; end - p >= 18; p += 16) {
+		m = _mm_movemask_epi8(_mm_cmpeq_epi8(
+			_mm_loadu_si128((const __m128i *)p), zero));
+		if (!m)
+			continue;
+
+		b = _mm_loadu_si128((const __m128i *)(p + 1));
+		c = _mm_loadu_si128((const __m128i *)(p + 2));
+		m &= _mm_movemask_epi8(_mm_and_si128(_mm_cmpeq_epi8(b, zero),
+						     _mm_cmpeq_epi8(c, one)));
+		if (m)
+			return p + __builtin_ctz(m);
+	}
+
+	return find_start_scalar(p, end);
+}
+#elif defined(__aarch64__)
+#define AVTP_H264_SIMD_NAME "neon"
+
+/* 4 bits per byte of a compare result, in order */
+static inline uint64_t neon_mask(uint8x16_t v)
+{
+	return vget_lane_u64(vreinterpret_u64_u8(
+		vshrn_n_u16(vreinterpretq_u16_u8(v), 4)), 0);
+}
+
+static const uint8_t *find_start_simd(const uint8_t *p, const uint8_t *end)
+{
+	const uint8x16_t zero = vdupq_n_u8(0);
+	const uint8x16_t one = vdupq_n_u8(1);
+	uint8x16_t z;
+	uint64_t m;
+
+	for (; end - p >= 18; p += 16) {
+		z = vceqq_u8(vld1q_u8(p), zero);
+		if (!neon_mask(z))
+			continue;
+
+		z = vandq_u8(z, vandq_u8(vceqq_u8(vld1q_u8(p + 1), zero),
+					 vceqq_u8(vld1q_u8(p + 2), one)));
+		m = neon_mask(z);
+		if (m)
+			return p + (__builtin_ctzll(m) >> 2);
+	}
+
+	return find_start_scalar(p, end);
+}
+#endif
+
+#ifdef AVTP_H264_SIMD_NAME
+static find_start_func find_start = find_start_simd;
+#else
+static find_start_func find_start = find_start_scalar;
+#endif
+
+/*
+ * select implementation of the start code search
+ *
+ * @name     auto, simd or scalar
+ *
+ * SSE2 and Advanced SIMD are always there on x86-64 and ARMv8-A.
+ */
+int avtp_h264_select(const char *name)
+{
+	if (!strcmp(name, "scalar")) {
+		find_start = find_start_scalar;
+		return 0;
+	}
+#ifdef AVTP_H264_SIMD_NAME
+	if (!strcmp(name, "simd") || !strcmp(name, "auto")) {
+		find_start = find_start_simd;
+		return 0;
+	}
+#else
+	if (!strcmp(name, "auto")) {
+		find_start = find_start_scalar;
+		return 0;
+	}
+#endif
+
+	return -1;
+}
+
+const char *avtp_h264_name(void)
+{
+#ifdef AVTP_H264_SIMD_NAME
+	if (find_start == find_start_simd)
+		return AVTP_H264_SIMD_NAME;
+#endif
+
+	return "scalar";
+}
+
+/*
+ * find the next start code
+ *
+ * @p        data
+ * @end      end of data
+ *
+ * returns the first byte of 00 00 01, end if there is none.
+ */
+const uint8_t *avtp_h264_find_start(const uint8_t *p, const uint8_t *end)
+{
+	return find_start(p, end);
+}
+
+/*
+ * initialize parser of an Annex B byte stream
+ *
+ * @ps       parser
+ * @buf      byte stream
+ * @len      length of byte stream
+ */
+void avtp_h264_parser_init(struct avtp_h264_parser *ps, const void *buf,
+			   size_t len)
+{
+	ps->pos = buf;
+	ps->end = ps->pos + len;
+}
+
+/*
+ * next NAL unit
+ *
+ * @ps       parser
+ * @nal      NAL unit from its header, without the start code
+ * @len      length of NAL unit
+ *
+ * returns -1 at the end of the byte stream.
+ */
+int avtp_h264_parser_next(struct avtp_h264_parser *ps, const uint8_t **nal,
+			  size_t *len)
+{
+	const uint8_t *p, *q;
+
+	for (;;) {
+		p = find_start(ps->pos, ps->end);
+		if (p == ps->end) {
+			ps->pos = ps->end;
+			return -1;
+		}
+		p += 3;
+
+		q = find_start(p, ps->end);
+		ps->pos = q;
+
+		/* zero_byte of the next start code, trailing_zero_8bits */
+		while (q > p && !q[-1])
+			q--;
+
+		if (q > p) {
+			*nal = p;
+			*len = q - p;
+			return 0;
+		}
+	}
+}
+
+static inline bool h264_is_vcl(const uint8_t *nal)
+{
+	int type = AVTP_H264_NAL_TYPE(nal[0]);
+
+	return type >= AVTP_H264_NAL_SLICE && type <= AVTP_H264_NAL_IDR;
+}
+
+/* H.264 7.4.1.2.3, NAL units that start an access unit after a slice */
+static bool h264_starts_au(const uint8_t *nal, size_t len)
+{
+	int type = AVTP_H264_NAL_TYPE(nal[0]);
+
+	switch (type) {
+	case AVTP_H264_NAL_SEI:
+	case AVTP_H264_NAL_SPS:
+	case AVTP_H264_NAL_PPS:
+	case AVTP_H264_NAL_AUD:
+	case 14 ... 18:
+		return true;
+	case AVTP_H264_NAL_SLICE:
+	case AVTP_H264_NAL_IDR:
+		/* first_mb_in_slice of 0 is ue(v) of a single 1 bit */
+		return len > 1 && (nal[1] & 0x80);
+	default:
+		return false;
+	}
+}
+
+/* the NAL unit after the current one is sent next */
+static void h264_advance(struct avtp_h264_packetizer *pk)
+{
+	pk->nal = pk->next;
+	pk->len = pk->next_len;
+	pk->off = 0;
+	if (!pk->nal)
+		return;
+
+	if (avtp_h264_parser_next(&pk->parser, &pk->next, &pk->next_len) < 0)
+		pk->next = NULL;
+
+	if (h264_is_vcl(pk->nal))
+		pk->vcl = true;
+	pk->au_end = !pk->next ||
+		(pk->vcl && h264_starts_au(pk->next, pk->next_len));
+	if (pk->au_end)
+		pk->vcl = false;
+}
+
+/*
+ * initialize packetizer
+ *
+ * @pk       packetizer
+ * @buf      Annex B byte stream, kept until the end
+ * @len      length of byte stream
+ * @max      bytes of a payload, h264_timestamp included
+ */
+int avtp_h264_packetizer_init(struct avtp_h264_packetizer *pk,
+			      const void *buf, size_t len, size_t max)
+{
+	memset(pk, 0, sizeof(*pk));
+
+	if (max <= AVTP_H264_TIMESTAMP_SIZE + AVTP_H264_FU_HEADER_SIZE)
+		return -1;
+
+	pk->max = max;
+	avtp_h264_parser_init(&pk->parser, buf, len);
+	if (avtp_h264_parser_next(&pk->parser, &pk->next, &pk->next_len) < 0)
+		pk->next = NULL;
+	h264_advance(pk);
+
+	return 0;
+}
+
+/*
+ * payload of the next packet
+ *
+ * @pk       packetizer
+ * @payload  payload of the packet, max bytes
+ * @m        set if the packet ends an access unit
+ *
+ * a NAL unit larger than the payload is sent in FU-A fragments.
+ * returns bytes of the payload, 0 at the end of the byte stream.
+ */
+size_t avtp_h264_packetize(struct avtp_h264_packetizer *pk, void *payload,
+			   bool *m)
+{
+	uint8_t *p = payload;
+	size_t room = pk->max - AVTP_H264_TIMESTAMP_SIZE;
+	size_t n;
+	bool last;
+
+	if (!pk->nal)
+		return 0;
+
+	/* h264_timestamp is not used, ptv is clear */
+	memset(p, 0, AVTP_H264_TIMESTAMP_SIZE);
+	p += AVTP_H264_TIMESTAMP_SIZE;
+
+	if (!pk->off && pk->len <= room) {
+		memcpy(p, pk->nal, pk->len);
+		n = pk->len;
+		last = true;
+	} else {
+		/* the NAL header is carried in the FU indicator and header */
+		if (!pk->off)
+			pk->off = 1;
+		n = pk->len - pk->off;
+		if (n > room - AVTP_H264_FU_HEADER_SIZE)
+			n = room - AVTP_H264_FU_HEADER_SIZE;
+
+		p[0] = (pk->nal[0] & 0xe0) | AVTP_H264_NAL_FU_A;
+		p[1] = AVTP_H264_NAL_TYPE(pk->nal[0]);
+		if (pk->off == 1)
+			p[1] |= 0x80;           /* S */
+		if (pk->off + n == pk->len)
+			p[1] |= 0x40;           /* E */
+		memcpy(p + AVTP_H264_FU_HEADER_SIZE, pk->nal + pk->off, n);
+
+		pk->off += n;
+		last = pk->off == pk->len;
+		n += AVTP_H264_FU_HEADER_SIZE;
+		pk->fragments++;
+	}
+
+	*m = last && pk->au_end;
+	if (last) {
+		pk->nals++;
+		if (pk->au_end)
+			pk->access_units++;
+		h264_advance(pk);
+	}
+
+	return AVTP_H264_TIMESTAMP_SIZE + n;
+}
+
+/*
+ * initialize depacketizer
+ *
+ * @dp           depacketizer
+ * @max_packets  packets an access unit may hold, it is dropped beyond
+ */
+int avtp_h264_depacketizer_init(struct avtp_h264_depacketizer *dp,
+				int max_packets)
+{
+	memset(dp, 0, sizeof(*dp));
+
+	if (max_packets < 1)
+		return -1;
+
+	/* a STAP-A packet takes a start code and a NAL unit per aggregate */
+	dp->max_packets = max_packets;
+	dp->max = max_packets * 2;
+	dp->iov = calloc(dp->max, sizeof(*dp->iov));
+	dp->cookies = calloc(dp->max, sizeof(*dp->cookies));
+	dp->frees = calloc(max_packets + 1, sizeof(*dp->frees));
+	if (!dp->iov || !dp->cookies || !dp->frees) {
+		avtp_h264_depacketizer_free(dp);
+		return -1;
+	}
+
+	return 0;
+}
+
+void avtp_h264_depacketizer_free(struct avtp_h264_depacketizer *dp)
+{
+	free(dp->iov);
+	free(dp->cookies);
+	free(dp->frees);
+	dp->iov = NULL;
+	dp->cookies = NULL;
+	dp->frees = NULL;
+}
+
+static const uint8_t h264_start_code[4] = { 0, 0, 0, 1 };
+
+static inline void h264_add(struct avtp_h264_depacketizer *dp, void *base,
+			    size_t len)
+{
+	dp->iov[dp->iovcnt].iov_base = base;
+	dp->iov[dp->iovcnt].iov_len = len;
+	dp->cookies[dp->iovcnt] = -1;
+	dp->iovcnt++;
+}
+
+static inline void h264_release(struct avtp_h264_depacketizer *dp,
+				int cookie)
+{
+	dp->frees[dp->freenum++] = cookie;
+}
+
+static void h264_clear(struct avtp_h264_depacketizer *dp)
+{
+	dp->iovcnt = 0;
+	dp->packets = 0;
+	dp->complete = false;
+	dp->vcl = false;
+	dp->idr = false;
+	dp->fu = false;
+}
+
+/* the packets of the access unit so far are given back */
+static void h264_drop(struct avtp_h264_depacketizer *dp)
+{
+	int i;
+
+	for (i = 0; i < dp->iovcnt; i++)
+		if (dp->cookies[i] >= 0)
+			h264_release(dp, dp->cookies[i]);
+	if (dp->packets)
+		dp->dropped++;
+	h264_clear(dp);
+}
+
+/*
+ * nothing can be decoded until the next IDR picture. the packets lost
+ * may be the head of the access unit that goes on, it is skipped.
+ */
+static void h264_lose(struct avtp_h264_depacketizer *dp)
+{
+	h264_drop(dp);
+	dp->sync = false;
+	dp->skip = true;
+}
+
+/* an access unit is decoded alone if its first slice is of an IDR picture */
+static void h264_slice(struct avtp_h264_depacketizer *dp, const uint8_t *nal,
+		       size_t len)
+{
+	if (dp->vcl || !h264_is_vcl(nal))
+		return;
+
+	dp->vcl = true;
+	dp->idr = AVTP_H264_NAL_TYPE(nal[0]) == AVTP_H264_NAL_IDR &&
+		h264_starts_au(nal, len);
+}
+
+/*
+ * take a packet into the access unit
+ *
+ * @dp       depacketizer
+ * @packet   AVTP packet of H.264 CVF, its payload is modified
+ * @size     bytes of the packet received
+ * @cookie   identifier of packet, given back in cookies or frees
+ *
+ * returns 1 if iov holds a whole access unit, which is valid until the
+ * next call. each packet of it is given back in cookies at its last
+ * iovec, to be released when written. packets dropped are given back
+ * in frees, to be released at once.
+ */
+int avtp_h264_depacketize(struct avtp_h264_depacketizer *dp, void *packet,
+			  size_t size, int cookie)
+{
+	uint8_t *p = (uint8_t *)packet + AVTP_CVF_PAYLOAD_OFFSET;
+	uint8_t *q, *end;
+	size_t n, nal_len;
+	uint8_t seq, fu;
+	int iovcnt;
+
+	dp->freenum = 0;
+	if (dp->complete)
+		h264_clear(dp);
+
+	if (size < AVTP_CVF_PAYLOAD_OFFSET ||
+	    get_avtp_subtype(packet) != AVTP_SUBTYPE_CVF ||
+	    get_avtp_cvf_format(packet) != AVTP_CVF_FORMAT_RFC ||
+	    get_avtp_cvf_format_subtype(packet) !=
+	    AVTP_CVF_FORMAT_SUBTYPE_H264) {
+		dp->errors++;
+		h264_release(dp, cookie);
+		return 0;
+	}
+
+	seq = get_avtp_sequence_num(packet);
+	if (dp->seq_valid && seq != (uint8_t)(dp->seq + 1)) {
+		dp->lost += (uint8_t)(seq - dp->seq - 1);
+		h264_lose(dp);
+	}
+	dp->seq = seq;
+	dp->seq_valid = true;
+
+	/* an access unit without M is cut off */
+	if (dp->packets == dp->max_packets)
+		h264_lose(dp);
+
+	if (dp->skip) {
+		h264_release(dp, cookie);
+		dp->skip = !get_avtp_cvf_m(packet);
+		return 0;
+	}
+
+	/* the iovecs are written out, not beyond the bytes received */
+	n = get_avtp_stream_data_length(packet);
+	if (n <= AVTP_H264_TIMESTAMP_SIZE || n > size - AVTP_CVF_PAYLOAD_OFFSET)
+		goto error;
+	p += AVTP_H264_TIMESTAMP_SIZE;
+	n -= AVTP_H264_TIMESTAMP_SIZE;
+	end = p + n;
+	iovcnt = dp->iovcnt;
+
+	/* aggregates of STAP-A before may have taken the iovecs left */
+	if (iovcnt + 1 > dp->max)
+		goto error;
+
+	switch (AVTP_H264_NAL_TYPE(p[0])) {
+	case AVTP_H264_NAL_FU_A:
+		if (n <= AVTP_H264_FU_HEADER_SIZE)
+			goto error;
+
+		fu = p[1];
+		if (fu & 0x80) {
+			if (dp->fu)
+				goto error;
+
+			/* the NAL header is put back before its payload */
+			p[1] = (p[0] & 0xe0) | AVTP_H264_NAL_TYPE(fu);
+			memcpy(p - 3, h264_start_code, sizeof(h264_start_code));
+			h264_slice(dp, p + 1, n - 1);
+			h264_add(dp, p - 3, n + 3);
+			dp->nals++;
+			dp->fu = true;
+		} else if (dp->fu) {
+			h264_add(dp, p + AVTP_H264_FU_HEADER_SIZE,
+				 n - AVTP_H264_FU_HEADER_SIZE);
+		} else {
+			goto error;
+		}
+
+		if (fu & 0x40)
+			dp->fu = false;
+		dp->fragments++;
+		break;
+	case AVTP_H264_NAL_STAP_A:
+		if (dp->fu)
+			goto error;
+
+		for (q = p + 1; q < end; q += nal_len) {
+			if (end - q < 2)
+				goto error;
+			nal_len = q[0] << 8 | q[1];
+			q += 2;
+			if (!nal_len || nal_len > end - q ||
+			    dp->iovcnt + 2 > dp->max)
+				goto error;
+
+			h264_slice(dp, q, nal_len);
+			h264_add(dp, (void *)h264_start_code,
+				 sizeof(h264_start_code));
+			h264_add(dp, q, nal_len);
+			dp->nals++;
+		}
+		break;
+	case 0:
+	case 25 ... 27:
+	case 29 ... 31:
+		/* STAP-B, MTAP and FU-B are of interleaved mode */
+		goto error;
+	default:
+		if (dp->fu)
+			goto error;
+
+		/* the start code replaces the h264_timestamp */
+		memcpy(p - 4, h264_start_code, sizeof(h264_start_code));
+		h264_slice(dp, p, n);
+		h264_add(dp, p - 4, n + 4);
+		dp->nals++;
+		break;
+	}
+
+	if (dp->iovcnt == iovcnt)
+		goto error;
+	dp->cookies[dp->iovcnt - 1] = cookie;
+	dp->packets++;
+
+	if (!get_avtp_cvf_m(packet))
+		return 0;
+
+	if (dp->fu) {
+		dp->errors++;
+		h264_lose(dp);
+		dp->skip = false;
+		return 0;
+	}
+
+	if (!dp->sync && !dp->idr) {
+		h264_drop(dp);
+		return 0;
+	}
+
+	dp->sync = true;
+	dp->complete = true;
+	dp->access_units++;
+
+	return 1;
+
+error:
+	dp->errors++;
+	h264_lose(dp);
+	h264_release(dp, cookie);
+	dp->skip = !get_avtp_cvf_m(packet);
+
+	return 0;
+}
@@ -0,0 +1,123 @@
+/*
+ * Copyright (c) 2014-2016 Renesas Electronics Corporation
+ * Released under the MIT license
+ * http://opensource.org/licenses/mit-license.php
+ */
+
+#ifndef __AVTP_H264_H__
+#define __AVTP_H264_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <sys/uio.h>
+
+/*
+ * H.264 CVF stream (IEEE1722-2016 8.5.3)
+ *
+ * the payload of a packet is the h264_timestamp followed by a NAL unit
+ * or a fragment of one in RFC 6184 FU-A, and counts in the
+ * stream_data_length. the input is an Annex B byte stream.
+ */
+#define AVTP_H264_TIMESTAMP_SIZE (4)
+#define AVTP_H264_FU_HEADER_SIZE (2)
+
+/* H.264 Table 7-1 and RFC 6184 Table 1. NAL unit types */
+enum AVTP_H264_NAL {
+	AVTP_H264_NAL_SLICE  = 1,
+	AVTP_H264_NAL_IDR    = 5,
+	AVTP_H264_NAL_SEI    = 6,
+	AVTP_H264_NAL_SPS    = 7,
+	AVTP_H264_NAL_PPS    = 8,
+	AVTP_H264_NAL_AUD    = 9,
+	AVTP_H264_NAL_STAP_A = 24,
+	AVTP_H264_NAL_FU_A   = 28,
+};
+
+#define AVTP_H264_NAL_TYPE(b) ((b) & 0x1f)
+
+/* NAL units of an Annex B byte stream */
+struct avtp_h264_parser {
+	const uint8_t *pos;
+	const uint8_t *end;
+};
+
+/* packets of an Annex B byte stream */
+struct avtp_h264_packetizer {
+	struct avtp_h264_parser parser;
+	size_t        max;        /* bytes of a payload */
+
+	const uint8_t *nal;       /* NAL unit being sent */
+	size_t        len;
+	size_t        off;        /* bytes of it sent */
+	bool          au_end;     /* it ends an access unit */
+	bool          vcl;        /* the access unit has a slice so far */
+
+	const uint8_t *next;      /* NAL unit after it, NULL:none */
+	size_t        next_len;
+
+	uint64_t      nals;
+	uint64_t      fragments;  /* FU-A packets */
+	uint64_t      access_units;
+};
+
+/*
+ * Annex B byte stream of CVF packets, without copy
+ *
+ * the NAL units of an access unit are collected as iovecs into the
+ * packets, whose h264_timestamp and FU indicator are overwritten by
+ * the start codes. a packet is held from its arrival until the access
+ * unit is given back complete or dropped. after a loss, the rest of
+ * the access unit and the ones up to an IDR picture are dropped.
+ */
+struct avtp_h264_depacketizer {
+	int           max;        /* iovecs of an access unit */
+	int           max_packets; /* packets held by an access unit */
+
+	struct iovec  *iov;       /* access unit */
+	int           *cookies;   /* packet written out by the iovec, -1:none */
+	int           iovcnt;
+	int           packets;
+	bool          complete;   /* iov is a whole access unit */
+	bool          vcl;        /* the access unit has a slice so far */
+	bool          idr;        /* its first slice starts an IDR picture */
+	bool          fu;         /* a FU-A NAL unit is open */
+	bool          sync;       /* no loss since the last IDR picture */
+	bool          skip;       /* packets are dropped until M */
+
+	int           *frees;     /* packets given back by the last call */
+	int           freenum;
+
+	bool          seq_valid;
+	uint8_t       seq;
+
+	uint64_t      access_units;
+	uint64_t      nals;
+	uint64_t      fragments;  /* FU-A packets */
+	uint64_t      lost;       /* packets missing in the sequence */
+	uint64_t      dropped;    /* access units not given back */
+	uint64_t      errors;     /* packets of no H.264 CVF payload */
+};
+
+extern const uint8_t *avtp_h264_find_start(const uint8_t *p,
+					   const uint8_t *end);
+extern void avtp_h264_parser_init(struct avtp_h264_parser *ps,
+				  const void *buf, size_t len);
+extern int avtp_h264_parser_next(struct avtp_h264_parser *ps,
+				 const uint8_t **nal, size_t *len);
+
+extern int avtp_h264_packetizer_init(struct avtp_h264_packetizer *pk,
+				     const void *buf, size_t len, size_t max);
+extern size_t avtp_h264_packetize(struct avtp_h264_packetizer *pk,
+				  void *payload, bool *m);
+
+extern int avtp_h264_depacketizer_init(struct avtp_h264_depacketizer *dp,
+					int max_packets);
+extern void avtp_h264_depacketizer_free(struct avtp_h264_depacketizer *dp);
+extern int avtp_h264_depacketize(struct avtp_h264_depacketizer *dp,
+				 void *packet, size_t size, int cookie);
+
+extern int avtp_h264_select(const char *name);
+extern const char *avtp_h264_name(void);
+
+#endif /* __AVTP_H264_H__ */
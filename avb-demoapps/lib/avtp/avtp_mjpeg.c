@@ -0,0 +1,329 @@
+/*
+ * Copyright (c) 2014-2016 Renesas Electronics Corporation
+ * Released under the MIT license
+ * http://opensource.org/licenses/mit-license.php
+ */
+
+#define _GNU_SOURCE
+#include <string.h>
+
+#include "avtp_mjpeg.h"
+
+/* JPEG markers, ITU-T T.81 Table B.1 */
+#define JPEG_SOF0  (0xc0)
+#define JPEG_DHT   (0xc4)
+#define JPEG_JPG   (0xc8)
+#define JPEG_DAC   (0xcc)
+#define JPEG_RST0  (0xd0)
+#define JPEG_RST7  (0xd7)
+#define JPEG_SOI   (0xd8)
+#define JPEG_EOI   (0xd9)
+#define JPEG_SOS   (0xda)
+#define JPEG_DQT   (0xdb)
+#define JPEG_DRI   (0xdd)
+
+/* the fragment offset is of 24 bits */
+#define MJPEG_SCAN_MAX (0xffffff)
+
+static inline uint16_t mjpeg_u16(const uint8_t *p)
+{
+	return p[0] << 8 | p[1];
+}
+
+/*
+ * end of the entropy coded data, where a marker other than RSTn is.
+ * a 0xff of the data is followed by a stuffed 0x00.
+ */
+static const uint8_t *mjpeg_scan_end(const uint8_t *p, const uint8_t *end)
+{
+	uint8_t b;
+
+	while ((p = memchr(p, 0xff, end - p)) && end - p >= 2) {
+		b = p[1];
+		if (b == 0xff)
+			p++;
+		else if (!b || (b >= JPEG_RST0 && b <= JPEG_RST7))
+			p += 2;
+		else
+			return p;
+	}
+
+	return NULL;
+}
+
+/*
+ * parse a JPEG frame
+ *
+ * @f        frame
+ * @buf      data starting with SOI
+ * @len      length of data, the frame may be followed by others
+ *
+ * the scan and the quantization tables are pointed to, not copied.
+ * returns -1 if the frame is not baseline YCbCr 4:2:2 or 4:2:0 of
+ * RFC 2435, or is not whole.
+ */
+int avtp_mjpeg_parse(struct avtp_mjpeg_frame *f, const void *buf, size_t len)
+{
+	const uint8_t *p = buf, *end = p + len, *seg, *q;
+	const uint8_t *dqt[4] = { NULL };
+	uint16_t dqt_len[4] = { 0 };
+	uint8_t tq[3] = { 0 };
+	uint8_t hv[3] = { 0 };
+	size_t slen, n;
+	bool sof = false;
+	int i;
+
+	memset(f, 0, sizeof(*f));
+
+	if (len < 4 || p[0] != 0xff || p[1] != JPEG_SOI)
+		return -1;
+	p += 2;
+
+	for (;;) {
+		if (end - p < 4 || p[0] != 0xff)
+			return -1;
+		/* fill bytes before a marker */
+		if (p[1] == 0xff) {
+			p++;
+			continue;
+		}
+
+		slen = mjpeg_u16(p + 2);
+		if (slen < 2 || slen > (size_t)(end - p) - 2)
+			return -1;
+		seg = p + 4;
+		slen -= 2;
+
+		switch (p[1]) {
+		case JPEG_DQT:
+			while (slen) {
+				i = seg[0] & 0xf;
+				n = (seg[0] >> 4) ? 128 : 64;
+				if (i > 3 || 1 + n > slen)
+					return -1;
+				dqt[i] = seg + 1;
+				dqt_len[i] = n;
+				seg += 1 + n;
+				slen -= 1 + n;
+			}
+			break;
+		case JPEG_SOF0:
+			if (slen < 6 + 3 * 3 || seg[0] != 8 || seg[5] != 3)
+				return -1;
+			for (i = 0; i < 3; i++) {
+				hv[i] = seg[6 + i * 3 + 1];
+				tq[i] = seg[6 + i * 3 + 2] & 0x3;
+			}
+			f->height = (mjpeg_u16(seg + 1) + 7) / 8;
+			f->width = (mjpeg_u16(seg + 3) + 7) / 8;
+			if (mjpeg_u16(seg + 1) > 2040 || mjpeg_u16(seg + 3) > 2040)
+				return -1;
+			sof = true;
+			break;
+		case JPEG_DRI:
+			if (slen < 2)
+				return -1;
+			f->dri = mjpeg_u16(seg);
+			break;
+		case JPEG_SOS:
+			if (!sof)
+				return -1;
+			f->scan = seg + slen;
+			q = mjpeg_scan_end(f->scan, end);
+			if (!q || q[1] != JPEG_EOI)
+				return -1;
+			f->scan_len = q - f->scan;
+			f->len = q + 2 - (const uint8_t *)buf;
+			goto scan;
+		case JPEG_DHT:
+		case JPEG_DAC:
+			break;
+		default:
+			/* other SOFn are not of baseline */
+			if (p[1] > JPEG_SOF0 && p[1] < JPEG_RST0 &&
+			    p[1] != JPEG_JPG)
+				return -1;
+			break;
+		}
+
+		p = seg + slen;
+	}
+
+scan:
+	/* Y of 2x1 or 2x2, Cb and Cr of 1x1 with the same table */
+	if (hv[0] == 0x21)
+		f->type = AVTP_MJPEG_TYPE_422;
+	else if (hv[0] == 0x22)
+		f->type = AVTP_MJPEG_TYPE_420;
+	else
+		return -1;
+	if (hv[1] != 0x11 || hv[2] != 0x11 || tq[1] != tq[2] ||
+	    !dqt[tq[0]] || !dqt[tq[1]] || f->scan_len > MJPEG_SCAN_MAX)
+		return -1;
+
+	if (f->dri)
+		f->type += AVTP_MJPEG_TYPE_RESTART;
+
+	for (i = 0; i < 2; i++) {
+		f->qtables[i] = dqt[tq[i]];
+		f->qlen[i] = dqt_len[tq[i]];
+		if (f->qlen[i] == 128)
+			f->precision |= 1 << i;
+	}
+
+	return 0;
+}
+
+/*
+ * parse the next frame and lay out its packets, the tables are sent
+ * when they change or are to be refreshed. Q is changed with them, as
+ * a receiver keeps the tables of a Q.
+ */
+static void mjpeg_next(struct avtp_mjpeg_packetizer *pk)
+{
+	struct avtp_mjpeg_frame *f = &pk->frame;
+	const uint8_t *p;
+	size_t qlen;
+
+	for (;;) {
+		if (pk->pos == pk->end) {
+			f->scan = NULL;
+			return;
+		}
+		if (!avtp_mjpeg_parse(f, pk->pos, pk->end - pk->pos))
+			break;
+
+		/* not of RFC 2435, go on from the next SOI */
+		f->scan = NULL;
+		pk->skipped++;
+		p = memmem(pk->pos + 1, pk->end - pk->pos - 1, "\xff\xd8", 2);
+		pk->pos = p ? p : pk->end;
+	}
+	pk->pos += f->len;
+
+	qlen = f->qlen[0] + f->qlen[1];
+	pk->tables = qlen != pk->qlen || f->precision != pk->precision ||
+		memcmp(pk->qtables, f->qtables[0], f->qlen[0]) ||
+		memcmp(pk->qtables + f->qlen[0], f->qtables[1], f->qlen[1]);
+	if (pk->tables) {
+		memcpy(pk->qtables, f->qtables[0], f->qlen[0]);
+		memcpy(pk->qtables + f->qlen[0], f->qtables[1], f->qlen[1]);
+		pk->qlen = qlen;
+		pk->precision = f->precision;
+		pk->q = (pk->q == AVTP_MJPEG_Q_MAX) ? AVTP_MJPEG_Q_MIN :
+			pk->q + 1;
+	} else if (pk->refresh && ++pk->since >= pk->refresh) {
+		pk->tables = true;
+	}
+	if (pk->tables) {
+		pk->since = 0;
+		pk->table_headers++;
+	}
+
+	pk->hlen = AVTP_MJPEG_HEADER_SIZE;
+	if (f->dri)
+		pk->hlen += AVTP_MJPEG_RESTART_HEADER_SIZE;
+	pk->room = pk->max - pk->hlen;
+	pk->first = pk->room - AVTP_MJPEG_QTABLE_HEADER_SIZE -
+		(pk->tables ? qlen : 0);
+	pk->off = 0;
+}
+
+/*
+ * initialize packetizer
+ *
+ * @pk       packetizer
+ * @buf      JPEG frames, kept until the end
+ * @len      length of frames
+ * @max      bytes of a payload
+ * @refresh  frames the tables are sent again, 0:only when changed
+ */
+int avtp_mjpeg_packetizer_init(struct avtp_mjpeg_packetizer *pk,
+			       const void *buf, size_t len, size_t max,
+			       int refresh)
+{
+	memset(pk, 0, sizeof(*pk));
+
+	if (max <= AVTP_MJPEG_HEADER_SIZE + AVTP_MJPEG_RESTART_HEADER_SIZE +
+	    AVTP_MJPEG_QTABLE_HEADER_SIZE + AVTP_MJPEG_QTABLE_MAX ||
+	    refresh < 0)
+		return -1;
+
+	pk->pos = buf;
+	pk->end = pk->pos + len;
+	pk->max = max;
+	pk->refresh = refresh;
+	pk->q = AVTP_MJPEG_Q_MAX;
+	mjpeg_next(pk);
+
+	return 0;
+}
+
+/*
+ * payload of the next packet
+ *
+ * @pk       packetizer
+ * @payload  payload of the packet, max bytes
+ * @m        set if the packet ends a frame
+ *
+ * returns bytes of the payload, 0 after the last frame.
+ */
+size_t avtp_mjpeg_packetize(struct avtp_mjpeg_packetizer *pk, void *payload,
+			    bool *m)
+{
+	struct avtp_mjpeg_frame *f = &pk->frame;
+	uint8_t *p = payload;
+	size_t n, len;
+
+	if (!f->scan)
+		return 0;
+
+	n = pk->off ? pk->room : pk->first;
+	if (n > f->scan_len - pk->off)
+		n = f->scan_len - pk->off;
+
+	/* type-specific 0 is progressive */
+	p[0] = 0;
+	p[1] = pk->off >> 16;
+	p[2] = pk->off >> 8;
+	p[3] = pk->off;
+	p[4] = f->type;
+	p[5] = pk->q;
+	p[6] = f->width;
+	p[7] = f->height;
+	p += AVTP_MJPEG_HEADER_SIZE;
+
+	/* F and L set, the restart intervals are not counted */
+	if (f->dri) {
+		p[0] = f->dri >> 8;
+		p[1] = f->dri;
+		p[2] = 0xff;
+		p[3] = 0xff;
+		p += AVTP_MJPEG_RESTART_HEADER_SIZE;
+	}
+
+	/* a length of 0 refers to the tables sent before with Q */
+	if (!pk->off) {
+		len = pk->tables ? pk->qlen : 0;
+		p[0] = 0;
+		p[1] = pk->precision;
+		p[2] = len >> 8;
+		p[3] = len;
+		p += AVTP_MJPEG_QTABLE_HEADER_SIZE;
+		memcpy(p, pk->qtables, len);
+		p += len;
+	}
+
+	memcpy(p, f->scan + pk->off, n);
+	p += n;
+	pk->off += n;
+	pk->packets++;
+
+	*m = pk->off == f->scan_len;
+	if (*m) {
+		pk->frames++;
+		mjpeg_next(pk);
+	}
+
+	return p - (uint8_t *)payload;
+}
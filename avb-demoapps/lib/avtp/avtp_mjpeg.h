@@ -0,0 +1,88 @@
+/*
+ * Copyright (c) 2014-2016 Renesas Electronics Corporation
+ * Released under the MIT license
+ * http://opensource.org/licenses/mit-license.php
+ */
+
+#ifndef __AVTP_MJPEG_H__
+#define __AVTP_MJPEG_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+/*
+ * MJPEG CVF stream (IEEE1722-2016 8.5.2)
+ *
+ * the payload of a packet is of RFC 2435: the main JPEG header, the
+ * restart marker header if the frame has restart markers, and in the
+ * first packet of a frame the quantization table header, followed by
+ * a fragment of the entropy coded scan. the input is a sequence of
+ * baseline JPEG frames of YCbCr 4:2:2 or 4:2:0, e.g. an MJPEG file.
+ */
+#define AVTP_MJPEG_HEADER_SIZE         (8)
+#define AVTP_MJPEG_RESTART_HEADER_SIZE (4)
+#define AVTP_MJPEG_QTABLE_HEADER_SIZE  (4)
+#define AVTP_MJPEG_QTABLE_MAX          (2 * 128)
+
+/* RFC 2435 3.1.3. types, 64 is added if there are restart markers */
+enum AVTP_MJPEG_TYPE {
+	AVTP_MJPEG_TYPE_422     = 0,
+	AVTP_MJPEG_TYPE_420     = 1,
+	AVTP_MJPEG_TYPE_RESTART = 64,
+};
+
+/* RFC 2435 3.1.4. Q of tables in the quantization table header */
+#define AVTP_MJPEG_Q_MIN (128)
+#define AVTP_MJPEG_Q_MAX (254)
+
+/* a JPEG frame, pointers are into it */
+struct avtp_mjpeg_frame {
+	size_t        len;        /* from SOI to EOI */
+	const uint8_t *scan;      /* entropy coded data */
+	size_t        scan_len;
+	uint8_t       type;
+	uint8_t       width;      /* in 8 pixels */
+	uint8_t       height;
+	uint16_t      dri;        /* restart interval, 0:none */
+	uint8_t       precision;  /* bit 0 luma, bit 1 chroma: 16 bit table */
+	const uint8_t *qtables[2]; /* luma, chroma */
+	uint16_t      qlen[2];
+};
+
+/* packets of a sequence of JPEG frames */
+struct avtp_mjpeg_packetizer {
+	const uint8_t *pos;       /* frames to come */
+	const uint8_t *end;
+	size_t        max;        /* bytes of a payload */
+	int           refresh;    /* frames the tables are sent again, 0:never */
+
+	struct avtp_mjpeg_frame frame; /* being sent, scan NULL:none */
+	size_t        off;        /* scan bytes sent */
+	size_t        first;      /* scan bytes of the first packet */
+	size_t        room;       /* of the others */
+	size_t        hlen;       /* headers of a packet */
+	bool          tables;     /* the first packet carries the tables */
+
+	uint8_t       q;
+	uint8_t       precision;  /* tables sent last */
+	uint16_t      qlen;
+	uint8_t       qtables[AVTP_MJPEG_QTABLE_MAX];
+	int           since;      /* frames since they were sent */
+
+	uint64_t      frames;
+	uint64_t      packets;
+	uint64_t      table_headers; /* frames with tables */
+	uint64_t      skipped;    /* frames not of RFC 2435 */
+};
+
+extern int avtp_mjpeg_parse(struct avtp_mjpeg_frame *f, const void *buf,
+			    size_t len);
+
+extern int avtp_mjpeg_packetizer_init(struct avtp_mjpeg_packetizer *pk,
+				      const void *buf, size_t len,
+				      size_t max, int refresh);
+extern size_t avtp_mjpeg_packetize(struct avtp_mjpeg_packetizer *pk,
+				   void *payload, bool *m);
+
+#endif /* __AVTP_MJPEG_H__ */
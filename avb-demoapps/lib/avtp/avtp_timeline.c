@@ -0,0 +1,134 @@
+/*
+ * Copyright (c) 2014-2016 Renesas Electronics Corporation
+ * Released under the MIT license
+ * http://opensource.org/licenses/mit-license.php
+ */
+
+#include <string.h>
+
+#include "avtp_timeline.h"
+
+#define NSEC_SCALE (1000000000ull)
+
+static uint64_t gcd(uint64_t a, uint64_t b)
+{
+	uint64_t t;
+
+	while (b) {
+		t = a % b;
+		a = b;
+		b = t;
+	}
+
+	return a;
+}
+
+/* offset of frame n from start, whole ns and fraction [1/rate ns] */
+static void avtp_timeline_offset(struct avtp_timeline *tl, uint64_t n,
+				 uint64_t *ns, uint64_t *frac)
+{
+	uint64_t period = NSEC_SCALE * tl->per;
+	uint64_t r = n % tl->rate;
+
+	/* split so that no product overflows */
+	*ns = n / tl->rate * period + r * period / tl->rate;
+	*frac = r * period % tl->rate;
+}
+
+/*
+ * initialize timeline
+ *
+ * @tl       timeline
+ * @rate     units per second, frames or samples
+ * @per      units per frame
+ */
+int avtp_timeline_init(struct avtp_timeline *tl, uint64_t rate, uint64_t per)
+{
+	uint64_t d;
+
+	if (!rate || !per)
+		return -1;
+
+	memset(tl, 0, sizeof(*tl));
+
+	/* the smaller the rate, the longer until a product overflows */
+	d = gcd(rate, per);
+	tl->rate = rate / d;
+	tl->per = per / d;
+
+	tl->step = NSEC_SCALE * tl->per / tl->rate;
+	tl->step_frac = NSEC_SCALE * tl->per % tl->rate;
+
+	return 0;
+}
+
+/*
+ * start the timeline again at a discontinuity
+ *
+ * @tl       timeline
+ * @t        time of the next frame [ns]
+ */
+void avtp_timeline_anchor(struct avtp_timeline *tl, uint64_t t)
+{
+	if (tl->anchored)
+		tl->discontinuities++;
+
+	tl->anchored = true;
+	tl->start = t;
+	tl->frames = 0;
+	tl->now = t;
+	tl->frac = 0;
+}
+
+/*
+ * move the timeline to a frame
+ *
+ * @tl       timeline
+ * @n        frame number since the anchor
+ */
+void avtp_timeline_seek(struct avtp_timeline *tl, uint64_t n)
+{
+	uint64_t ns;
+
+	avtp_timeline_offset(tl, n, &ns, &tl->frac);
+	tl->now = tl->start + ns;
+	tl->frames = n;
+}
+
+/*
+ * time of a frame
+ *
+ * @tl       timeline
+ * @n        frame number since the anchor
+ */
+uint64_t avtp_timeline_at(struct avtp_timeline *tl, uint64_t n)
+{
+	uint64_t ns, frac;
+
+	avtp_timeline_offset(tl, n, &ns, &frac);
+
+	return tl->start + ns;
+}
+
+/*
+ * number of frames before a time
+ *
+ * @tl       timeline
+ * @t        time [ns]
+ *
+ * frames since the anchor which are earlier than t.
+ */
+uint64_t avtp_timeline_count(struct avtp_timeline *tl, uint64_t t)
+{
+	uint64_t period = NSEC_SCALE * tl->per;
+	uint64_t elapsed;
+
+	if (t <= tl->start)
+		return 0;
+
+	elapsed = t - tl->start;
+
+	/* frame n is earlier than t while n * period < elapsed * rate */
+	return elapsed / period * tl->rate +
+		(elapsed % period * tl->rate + period - 1) / period;
+}
@@ -0,0 +1,69 @@
+/*
+ * Copyright (c) 2014-2016 Renesas Electronics Corporation
+ * Released under the MIT license
+ * http://opensource.org/licenses/mit-license.php
+ */
+
+#ifndef __AVTP_TIMELINE_H__
+#define __AVTP_TIMELINE_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/*
+ * media timeline of a stream
+ *
+ * frame n of the timeline is at start + n * per / rate seconds.
+ * the frame period is kept as whole nanoseconds plus a fraction in
+ * units of 1/rate ns, so that the timeline never drifts from the
+ * exact time however long it runs.
+ *
+ *   class A, 1 frame per interval:   rate 8000,  per 1
+ *   48 kHz, 6 samples per frame:     rate 48000, per 6
+ *   44.1 kHz, 6 samples per frame:   rate 44100, per 6
+ */
+struct avtp_timeline {
+	uint64_t rate;       /* units per second */
+	uint64_t per;        /* units per frame */
+	uint64_t step;       /* whole ns per frame */
+	uint64_t step_frac;  /* fraction ns per frame [1/rate ns] */
+
+	bool     anchored;
+	uint64_t start;      /* time of frame 0 [ns] */
+	uint64_t frames;     /* frame number of now */
+	uint64_t now;        /* time of the next frame [ns] */
+	uint64_t frac;       /* fraction of now [1/rate ns] */
+
+	uint64_t discontinuities;
+};
+
+extern int avtp_timeline_init(struct avtp_timeline *tl, uint64_t rate,
+			      uint64_t per);
+extern void avtp_timeline_anchor(struct avtp_timeline *tl, uint64_t t);
+extern void avtp_timeline_seek(struct avtp_timeline *tl, uint64_t n);
+extern uint64_t avtp_timeline_at(struct avtp_timeline *tl, uint64_t n);
+extern uint64_t avtp_timeline_count(struct avtp_timeline *tl, uint64_t t);
+
+/* time of the next frame */
+static inline uint64_t avtp_timeline_peek(struct avtp_timeline *tl)
+{
+	return tl->now;
+}
+
+/* time of the next frame, the timeline moves to the frame after it */
+static inline uint64_t avtp_timeline_next(struct avtp_timeline *tl)
+{
+	uint64_t t = tl->now;
+
+	tl->now += tl->step;
+	tl->frac += tl->step_frac;
+	if (tl->frac >= tl->rate) {
+		tl->frac -= tl->rate;
+		tl->now++;
+	}
+	tl->frames++;
+
+	return t;
+}
+
+#endif /* __AVTP_TIMELINE_H__ */
@@ -13,12 +13,115 @@
 #include <sys/mman.h>
 #include <poll.h>
 #include <errno.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <inttypes.h>
+#include <time.h>
+#include <pthread.h>
 
 #include "eavb.h"
+#include "eavb_backend.h"
 
 #define LIBVERSION "0.3"
 
-static int lastseq_no;
+#define ARRAY_SIZE(a) (sizeof(a)/sizeof(a[0]))
+
+#define EAVB_CTX_MAX (1024)
+
+/* contexts of the stream queues opened by eavb_open(), indexed by fd */
+static struct eavb_ctx *ctx_table[EAVB_CTX_MAX];
+
+/*
+ * Renesas AVB Streaming driver backend
+ */
+static int ravb_open(const char *pathname, int flags)
+{
+	return open(pathname, flags);
+}
+
+static int ravb_ioctl(int fd, unsigned long request, void *arg)
+{
+	return ioctl(fd, request, arg);
+}
+
+static void *ravb_mmap(size_t length, int prot, int flags, int fd,
+		       off_t offset)
+{
+	return mmap(NULL, length, prot, flags, fd, offset);
+}
+
+const struct eavb_backend eavb_backend_ravb = {
+	.name   = "ravb",
+	.epoll  = true,
+	.open   = ravb_open,
+	.close  = close,
+	.ioctl  = ravb_ioctl,
+	.read   = read,
+	.write  = write,
+	.poll   = poll,
+	.mmap   = ravb_mmap,
+	.munmap = munmap,
+};
+
+static const struct eavb_backend *backends[] = {
+	&eavb_backend_ravb,
+	&eavb_backend_loopback,
+};
+
+static const struct eavb_backend *backend;
+
+/*
+ * get stream queue backend in use
+ */
+const struct eavb_backend *eavb_get_backend(void)
+{
+	if (!backend) {
+		char *name = getenv("EAVB_BACKEND");
+
+		backend = &eavb_backend_ravb;
+		if (name && eavb_set_backend(name) < 0)
+			fprintf(stderr, "eavb: unknown backend %s, using %s\n",
+					name, backend->name);
+	}
+
+	return backend;
+}
+
+/*
+ * select stream queue backend
+ *
+ * @name     backend name "ravb" (default) or "loopback"
+ *
+ * the backend is also selectable with the EAVB_BACKEND environment
+ * variable, it must be selected before the first eavb_open().
+ */
+int eavb_set_backend(const char *name)
+{
+	int i;
+
+	if (!name)
+		return -1;
+
+	for (i = 0; i < ARRAY_SIZE(backends); i++) {
+		if (!strcmp(name, backends[i]->name)) {
+			backend = backends[i];
+			return 0;
+		}
+	}
+
+	return -1;
+}
+
+static struct eavb_ctx *ctx_lookup(int fd)
+{
+	if (fd < 0 || fd >= EAVB_CTX_MAX || !ctx_table[fd]) {
+		errno = EBADF;
+		return NULL;
+	}
+
+	return ctx_table[fd];
+}
 
 /*
  * open stream queue
@@ -28,15 +131,21 @@ static int lastseq_no;
  */
 int eavb_open(char *devname, mode_t mode)
 {
-	int fd;
+	struct eavb_ctx *ctx;
 
-	fd = open(devname, mode);
-	if (fd < 0) {
-		perror(devname);
+	ctx = eavb_ctx_open(devname, mode);
+	if (!ctx)
+		return -1;
+
+	if (ctx->fd >= EAVB_CTX_MAX) {
+		fprintf(stderr, "%s: too many stream queues\n", devname);
+		eavb_ctx_close(ctx);
 		return -1;
 	}
 
-	return fd;
+	ctx_table[ctx->fd] = ctx;
+
+	return ctx->fd;
 }
 
 /*
@@ -46,7 +155,14 @@ int eavb_open(char *devname, mode_t mode)
  */
 void eavb_close(int fd)
 {
-	close(fd);
+	struct eavb_ctx *ctx;
+
+	ctx = ctx_lookup(fd);
+	if (!ctx)
+		return;
+
+	ctx_table[fd] = NULL;
+	eavb_ctx_close(ctx);
 }
 
 /*
@@ -59,7 +175,7 @@ int eavb_set_txparam(int fd, struct eavb_txparam *txparam)
 {
 	int ret;
 
-	ret = ioctl(fd, EAVB_SETTXPARAM, txparam);
+	ret = eavb_get_backend()->ioctl(fd, EAVB_SETTXPARAM, txparam);
 	if (ret < 0) {
 		perror("EAVB_SETTXPARAM");
 		return -1;
@@ -78,7 +194,7 @@ int eavb_get_txparam(int fd, struct eavb_txparam *txparam)
 {
 	int ret;
 
-	ret = ioctl(fd, EAVB_GETTXPARAM, txparam);
+	ret = eavb_get_backend()->ioctl(fd, EAVB_GETTXPARAM, txparam);
 	if (ret < 0) {
 		perror("EAVB_GETTXPARAM");
 		return -1;
@@ -97,7 +213,7 @@ int eavb_set_rxparam(int fd, struct eavb_rxparam *rxparam)
 {
 	int ret;
 
-	ret = ioctl(fd, EAVB_SETRXPARAM, rxparam);
+	ret = eavb_get_backend()->ioctl(fd, EAVB_SETRXPARAM, rxparam);
 	if (ret < 0) {
 		perror("EAVB_SETRXPARAM");
 		return -1;
@@ -116,7 +232,7 @@ int eavb_get_rxparam(int fd, struct eavb_rxparam *rxparam)
 {
 	int ret;
 
-	ret = ioctl(fd, EAVB_GETRXPARAM, rxparam);
+	ret = eavb_get_backend()->ioctl(fd, EAVB_GETRXPARAM, rxparam);
 	if (ret < 0) {
 		perror("EAVB_GETRXPARAM");
 		return -1;
@@ -125,13 +241,7 @@ int eavb_get_rxparam(int fd, struct eavb_rxparam *rxparam)
 	return 0;
 }
 
-/*
- * set Block mode option of stream queue
- *
- * @fd        specify fd of stream queue
- * @blockmode block mode parameter
- */
-int eavb_set_optblockmode(int fd, enum eavb_block blockmode)
+static int set_optblockmode(int fd, enum eavb_block blockmode)
 {
 	int ret;
 	struct eavb_option opt;
@@ -139,7 +249,7 @@ int eavb_set_optblockmode(int fd, enum eavb_block blockmode)
 	opt.id = EAVB_OPTIONID_BLOCKMODE;
 	opt.param = blockmode;
 
-	ret = ioctl(fd, EAVB_SETOPTION, &opt);
+	ret = eavb_get_backend()->ioctl(fd, EAVB_SETOPTION, &opt);
 	if (ret < 0) {
 		perror("EAVB_SETOPTION");
 		return -1;
@@ -148,6 +258,23 @@ int eavb_set_optblockmode(int fd, enum eavb_block blockmode)
 	return 0;
 }
 
+/*
+ * set Block mode option of stream queue
+ *
+ * @fd        specify fd of stream queue
+ * @blockmode block mode parameter
+ */
+int eavb_set_optblockmode(int fd, enum eavb_block blockmode)
+{
+	struct eavb_ctx *ctx;
+
+	ctx = ctx_lookup(fd);
+	if (ctx)
+		return eavb_ctx_set_optblockmode(ctx, blockmode);
+
+	return set_optblockmode(fd, blockmode);
+}
+
 /*
  * get Block mode of stream queue
  *
@@ -161,7 +288,7 @@ int eavb_get_optblockmode(int fd, enum eavb_block *blockmode)
 
 	opt.id = EAVB_OPTIONID_BLOCKMODE;
 
-	ret = ioctl(fd, EAVB_GETOPTION, &opt);
+	ret = eavb_get_backend()->ioctl(fd, EAVB_GETOPTION, &opt);
 	if (ret < 0) {
 		perror("EAVB_GETOPTION");
 		return -1;
@@ -181,34 +308,15 @@ int eavb_get_optblockmode(int fd, enum eavb_block *blockmode)
  */
 int eavb_push(int fd, struct eavb_entry *entrybuf, int entrynum)
 {
-	struct eavb_entry *e;
-	int i, push, ret;
+	struct eavb_ctx *ctx;
 
-	if (entrynum == 0)
-		return 0;
-
-	if (entrynum < 0) {
-		perror("invalid arguments");
+	ctx = ctx_lookup(fd);
+	if (!ctx) {
+		perror("cannot push entry");
 		return -1;
 	}
 
-	for (i = 0, e = entrybuf; i < entrynum; i++, e++)
-		e->seq_no = lastseq_no + i;
-
-	ret = write(fd, (void *)entrybuf, entrynum*sizeof(*e));
-	if (ret < 0) {
-		if (errno == EAGAIN) {
-			return 0;
-		} else {
-			perror("cannot push entry");
-			return -1;
-		}
-	}
-
-	push = ret / sizeof(*e);
-	lastseq_no += push;
-
-	return push;
+	return eavb_ctx_push(ctx, entrybuf, entrynum);
 }
 
 /*
@@ -220,28 +328,15 @@ int eavb_push(int fd, struct eavb_entry *entrybuf, int entrynum)
  */
 int eavb_take(int fd, struct eavb_entry *entrybuf, int entrynum)
 {
-	struct eavb_entry *e;
-	int ret;
-
-	if (entrynum == 0)
-		return 0;
+	struct eavb_ctx *ctx;
 
-	if (entrynum < 0) {
-		perror("invalid arguments");
+	ctx = ctx_lookup(fd);
+	if (!ctx) {
+		perror("cannot take entry");
 		return -1;
 	}
 
-	ret = read(fd, (void *)entrybuf, entrynum*sizeof(*e));
-	if (ret < 0) {
-		if (errno == EAGAIN) {
-			return 0;
-		} else {
-			perror("cannot take entry");
-			return -1;
-		}
-	}
-
-	return ret / sizeof(*e);
+	return eavb_ctx_take(ctx, entrybuf, entrynum);
 }
 
 /*
@@ -265,7 +360,7 @@ int eavb_wait(int fd, int flags, int timeout)
 	if (flags & EAVB_NOTIFY_WRITE)
 		pollfd[0].events |= POLLOUT;
 
-	ret = poll(pollfd, N_FD, timeout);
+	ret = eavb_get_backend()->poll(pollfd, N_FD, timeout);
 	if (ret < 0) {
 		if (errno != EINTR)
 			perror("poll failed");
@@ -284,29 +379,17 @@ int eavb_wait(int fd, int flags, int timeout)
 }
 
 
-/*
- * allocate page from kernel
- *
- * @fd       specify fd of stream queue
- * @page     page information
- */
-int eavb_dma_malloc_page(int fd, struct eavb_dma_alloc *page)
+static int dma_map_page(int fd, struct eavb_dma_alloc *page)
 {
 	int ret;
 
-	if (!page) {
-		perror("invalid pointer");
-		return -1;
-	}
-
-	ret = ioctl(fd, EAVB_MAPPAGE, page);
+	ret = eavb_get_backend()->ioctl(fd, EAVB_MAPPAGE, page);
 	if (ret < 0) {
 		perror("EAVB_MAPPAGE");
 		return -1;
 	}
 
-	page->dma_vaddr = (void *)mmap(NULL,
-			page->mmap_size,
+	page->dma_vaddr = eavb_get_backend()->mmap(page->mmap_size,
 			PROT_READ | PROT_WRITE,
 			MAP_SHARED,
 			fd,
@@ -314,12 +397,42 @@ int eavb_dma_malloc_page(int fd, struct eavb_dma_alloc *page)
 
 	if (MAP_FAILED == page->dma_vaddr) {
 		perror("mmap");
+		eavb_get_backend()->ioctl(fd, EAVB_UNMAPPAGE, page);
+		page->dma_vaddr = NULL;
 		return -1;
 	}
 
 	return 0;
 }
 
+static void dma_unmap_page(int fd, struct eavb_dma_alloc *page)
+{
+	eavb_get_backend()->munmap(page->dma_vaddr, page->mmap_size);
+	eavb_get_backend()->ioctl(fd, EAVB_UNMAPPAGE, page);
+}
+
+/*
+ * allocate page from kernel
+ *
+ * @fd       specify fd of stream queue
+ * @page     page information
+ */
+int eavb_dma_malloc_page(int fd, struct eavb_dma_alloc *page)
+{
+	struct eavb_ctx *ctx;
+
+	if (!page) {
+		perror("invalid pointer");
+		return -1;
+	}
+
+	ctx = ctx_lookup(fd);
+	if (ctx)
+		return eavb_ctx_dma_malloc_page(ctx, page);
+
+	return dma_map_page(fd, page);
+}
+
 /*
  * free page to kernel
  *
@@ -328,18 +441,438 @@ int eavb_dma_malloc_page(int fd, struct eavb_dma_alloc *page)
  */
 void eavb_dma_free_page(int fd, struct eavb_dma_alloc *page)
 {
+	struct eavb_ctx *ctx;
+
 	if (!page)
 		return;
 
 	if (!page->dma_paddr || !page->dma_vaddr)
 		return;
 
-	munmap(page->dma_vaddr, page->mmap_size);
-	ioctl(fd, EAVB_UNMAPPAGE, page);
+	ctx = ctx_lookup(fd);
+	if (ctx) {
+		eavb_ctx_dma_free_page(ctx, page);
+		return;
+	}
+
+	dma_unmap_page(fd, page);
 
 	page->dma_paddr = 0;
 	page->dma_vaddr = NULL;
 	page->mmap_size = 0;
+}
+
+/*
+ * stream queue context
+ *
+ * a context owns the fd, the sequence number, the block mode and the
+ * DMA pages of one stream queue. pushes of a context are serialized,
+ * and takes are, each with a lock of its own: a push blocked on a full
+ * queue waits for a take to free an entry. different contexts are
+ * independent of each other.
+ */
+
+/*
+ * statistics of stream queue context
+ */
+static bool stats_enabled(void)
+{
+	char *env = getenv("EAVB_STATS");
+
+	return env && *env && strcmp(env, "0");
+}
+
+static inline uint64_t stats_now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+static inline void hist_add(struct eavb_hist *hist, uint64_t value)
+{
+	int n = value ? 64 - __builtin_clzll(value) : 0;
+
+	if (n >= EAVB_HIST_BUCKETS)
+		n = EAVB_HIST_BUCKETS - 1;
+
+	hist->bucket[n]++;
+	hist->count++;
+	hist->total += value;
+	if (value > hist->max)
+		hist->max = value;
+}
+
+/* called with the lock of op held, ret is the return value of write/read */
+static void stats_update(struct eavb_op_stats *op, uint64_t start,
+			 int ret, size_t size)
+{
+	int err = errno;
+
+	hist_add(&op->duration, stats_now() - start);
+	op->calls++;
+
+	if (ret >= 0)
+		hist_add(&op->entries, ret / size);
+	else if (err == EAGAIN)
+		op->eagain++;
+	else
+		op->errors++;
+
+	errno = err;
+}
+
+static void hist_dump(FILE *fp, const char *title, struct eavb_hist *hist)
+{
+	int n;
+
+	if (!hist->count)
+		return;
+
+	fprintf(fp, "  %s: avg %" PRIu64 " max %" PRIu64 "\n", title,
+		hist->total / hist->count, hist->max);
+
+	for (n = 0; n < EAVB_HIST_BUCKETS; n++) {
+		if (!hist->bucket[n])
+			continue;
+		fprintf(fp, "    %10" PRIu64 " - %10" PRIu64 ": %" PRIu64 "\n",
+			n ? (uint64_t)1 << (n - 1) : 0,
+			n ? ((uint64_t)1 << n) - 1 : 0,
+			hist->bucket[n]);
+	}
+}
+
+static void op_stats_dump(FILE *fp, const char *name, const char *op,
+			  struct eavb_op_stats *stats)
+{
+	fprintf(fp, "[AVB] %s %s: calls %" PRIu64 " EAGAIN %" PRIu64
+		" (%.1f%%) errors %" PRIu64 "\n", name, op,
+		stats->calls, stats->eagain,
+		stats->calls ? 100.0 * stats->eagain / stats->calls : 0,
+		stats->errors);
+	hist_dump(fp, "duration [ns]", &stats->duration);
+	hist_dump(fp, "entries/call", &stats->entries);
+}
+
+/*
+ * enable statistics of stream queue context
+ *
+ * statistics are enabled on every context when the EAVB_STATS
+ * environment variable is set to non-zero.
+ *
+ * @ctx      specify context of stream queue
+ */
+int eavb_ctx_stats_enable(struct eavb_ctx *ctx)
+{
+	struct eavb_ctx_stats *stats;
+
+	if (!ctx)
+		return -1;
+
+	if (ctx->stats)
+		return 0;
+
+	stats = calloc(1, sizeof(*stats));
+	if (!stats) {
+		perror("cannot allocate statistics");
+		return -1;
+	}
+
+	pthread_mutex_lock(&ctx->push_lock);
+	pthread_mutex_lock(&ctx->take_lock);
+	ctx->stats = stats;
+	pthread_mutex_unlock(&ctx->take_lock);
+	pthread_mutex_unlock(&ctx->push_lock);
+
+	return 0;
+}
+
+/*
+ * dump statistics of stream queue context, nothing if disabled
+ *
+ * @ctx      specify context of stream queue
+ * @fp       output stream
+ * @name     name printed in front of the statistics
+ */
+void eavb_ctx_stats_dump(struct eavb_ctx *ctx, FILE *fp, const char *name)
+{
+	struct eavb_ctx_stats stats;
+
+	if (!ctx || !ctx->stats)
+		return;
+
+	pthread_mutex_lock(&ctx->push_lock);
+	stats.push = ctx->stats->push;
+	pthread_mutex_unlock(&ctx->push_lock);
+	pthread_mutex_lock(&ctx->take_lock);
+	stats.take = ctx->stats->take;
+	pthread_mutex_unlock(&ctx->take_lock);
+
+	op_stats_dump(fp, name, "push", &stats.push);
+	op_stats_dump(fp, name, "take", &stats.take);
+	fflush(fp);
+}
+
+/*
+ * open stream queue context
+ *
+ * @devname  specify device name
+ * @mode     specify open mode
+ */
+struct eavb_ctx *eavb_ctx_open(char *devname, mode_t mode)
+{
+	struct eavb_ctx *ctx;
+
+	ctx = calloc(1, sizeof(*ctx));
+	if (!ctx) {
+		perror("cannot allocate context");
+		return NULL;
+	}
+
+	ctx->fd = eavb_get_backend()->open(devname, mode);
+	if (ctx->fd < 0) {
+		perror(devname);
+		free(ctx);
+		return NULL;
+	}
+
+	ctx->blockmode = EAVB_BLOCK_NOWAIT;
+	pthread_mutex_init(&ctx->lock, NULL);
+	pthread_mutex_init(&ctx->push_lock, NULL);
+	pthread_mutex_init(&ctx->take_lock, NULL);
+
+	if (stats_enabled())
+		eavb_ctx_stats_enable(ctx);
+
+	return ctx;
+}
+
+/*
+ * close stream queue context, DMA pages of the context are freed
+ *
+ * @ctx      specify context of stream queue
+ */
+void eavb_ctx_close(struct eavb_ctx *ctx)
+{
+	int i;
+
+	if (!ctx)
+		return;
+
+	for (i = 0; i < ctx->pagenum; i++)
+		dma_unmap_page(ctx->fd, &ctx->pages[i]);
+
+	eavb_get_backend()->close(ctx->fd);
+
+	pthread_mutex_destroy(&ctx->lock);
+	pthread_mutex_destroy(&ctx->push_lock);
+	pthread_mutex_destroy(&ctx->take_lock);
+	free(ctx->stats);
+	free(ctx->pages);
+	free(ctx);
+}
+
+/*
+ * set Block mode option of stream queue context
+ *
+ * @ctx       specify context of stream queue
+ * @blockmode block mode parameter
+ */
+int eavb_ctx_set_optblockmode(struct eavb_ctx *ctx, enum eavb_block blockmode)
+{
+	int ret;
+
+	ret = set_optblockmode(ctx->fd, blockmode);
+	if (!ret)
+		ctx->blockmode = blockmode;
+
+	return ret;
+}
+
+/*
+ * push stream entry to stream queue context
+ *
+ * @ctx      specify context of stream queue
+ * @entrybuf base address of stream entry buffer (user, virtual)
+ * @entrynum number of stream entries
+ */
+int eavb_ctx_push(struct eavb_ctx *ctx, struct eavb_entry *entrybuf,
+		  int entrynum)
+{
+	struct eavb_entry *e;
+	uint64_t start = 0;
+	int i, ret;
+
+	if (entrynum == 0)
+		return 0;
+
+	if (entrynum < 0) {
+		perror("invalid arguments");
+		return -1;
+	}
+
+	/* entries go into the queue in the order of seq_no */
+	pthread_mutex_lock(&ctx->push_lock);
+
+	for (i = 0, e = entrybuf; i < entrynum; i++, e++)
+		e->seq_no = ctx->seq_no + i;
+
+	if (ctx->stats)
+		start = stats_now();
+
+	ret = eavb_get_backend()->write(ctx->fd, (void *)entrybuf,
+				   entrynum*sizeof(*e));
+	if (ret > 0)
+		ctx->seq_no += ret / sizeof(*e);
+
+	if (ctx->stats)
+		stats_update(&ctx->stats->push, start, ret, sizeof(*e));
+
+	pthread_mutex_unlock(&ctx->push_lock);
+
+	if (ret < 0) {
+		if (errno == EAGAIN) {
+			return 0;
+		} else {
+			perror("cannot push entry");
+			return -1;
+		}
+	}
+
+	return ret / sizeof(*e);
+}
+
+/*
+ * take stream log entry from stream queue context
+ *
+ * @ctx      specify context of stream queue
+ * @entrybuf base address of stream entry buffer (user, virtual)
+ * @entrynum max number of stream entries
+ */
+int eavb_ctx_take(struct eavb_ctx *ctx, struct eavb_entry *entrybuf,
+		  int entrynum)
+{
+	struct eavb_entry *e;
+	uint64_t start = 0;
+	int ret;
+
+	if (entrynum == 0)
+		return 0;
+
+	if (entrynum < 0) {
+		perror("invalid arguments");
+		return -1;
+	}
+
+	pthread_mutex_lock(&ctx->take_lock);
+
+	if (ctx->stats)
+		start = stats_now();
+
+	ret = eavb_get_backend()->read(ctx->fd, (void *)entrybuf,
+				  entrynum*sizeof(*e));
+
+	if (ctx->stats)
+		stats_update(&ctx->stats->take, start, ret, sizeof(*e));
+
+	pthread_mutex_unlock(&ctx->take_lock);
+
+	if (ret < 0) {
+		if (errno == EAGAIN) {
+			return 0;
+		} else {
+			perror("cannot take entry");
+			return -1;
+		}
+	}
+
+	return ret / sizeof(*e);
+}
+
+/*
+ * wait ready of push or take entry of stream queue context
+ *
+ * @ctx      specify context of stream queue
+ * @flags    target of wait events (specify bit OR)
+ * @timeout  timeout
+ */
+int eavb_ctx_wait(struct eavb_ctx *ctx, int flags, int timeout)
+{
+	return eavb_wait(ctx->fd, flags, timeout);
+}
+
+/*
+ * allocate page for stream queue context
+ *
+ * @ctx      specify context of stream queue
+ * @page     page information
+ */
+int eavb_ctx_dma_malloc_page(struct eavb_ctx *ctx, struct eavb_dma_alloc *page)
+{
+	struct eavb_dma_alloc *pages;
+	int pagemax, ret = -1;
 
-	return;
+	if (!page) {
+		perror("invalid pointer");
+		return -1;
+	}
+
+	pthread_mutex_lock(&ctx->lock);
+
+	if (ctx->pagenum == ctx->pagemax) {
+		pagemax = ctx->pagemax ? ctx->pagemax * 2 : 64;
+		pages = realloc(ctx->pages, pagemax * sizeof(*pages));
+		if (!pages) {
+			perror("cannot allocate page list");
+			goto out;
+		}
+		ctx->pages = pages;
+		ctx->pagemax = pagemax;
+	}
+
+	ret = dma_map_page(ctx->fd, page);
+	if (!ret)
+		ctx->pages[ctx->pagenum++] = *page;
+
+out:
+	pthread_mutex_unlock(&ctx->lock);
+
+	return ret;
+}
+
+/*
+ * free page of stream queue context
+ *
+ * @ctx      specify context of stream queue
+ * @page     page information
+ */
+void eavb_ctx_dma_free_page(struct eavb_ctx *ctx, struct eavb_dma_alloc *page)
+{
+	int i;
+
+	if (!page)
+		return;
+
+	if (!page->dma_paddr || !page->dma_vaddr)
+		return;
+
+	pthread_mutex_lock(&ctx->lock);
+
+	/* latest first, pages are usually freed in reverse order */
+	for (i = ctx->pagenum - 1; i >= 0; i--) {
+		if (ctx->pages[i].dma_paddr != page->dma_paddr)
+			continue;
+
+		dma_unmap_page(ctx->fd, &ctx->pages[i]);
+		ctx->pages[i] = ctx->pages[--ctx->pagenum];
+		break;
+	}
+
+	pthread_mutex_unlock(&ctx->lock);
+
+	page->dma_paddr = 0;
+	page->dma_vaddr = NULL;
+	page->mmap_size = 0;
 }
@@ -7,7 +7,11 @@
 #ifndef __EAVB_H__
 #define __EAVB_H__
 
+#include <stdio.h>
 #include <stdint.h>
+#include <stdbool.h>
+#include <pthread.h>
+#include <sys/types.h>
 #include "ravb_eavb.h"
 
 enum eavb_notify {
@@ -15,6 +19,97 @@ enum eavb_notify {
 	EAVB_NOTIFY_WRITE = 0x00000002,
 };
 
+#define EAVB_HIST_BUCKETS (32)
+
+/* log2 histogram, bucket n counts values in [2^(n-1), 2^n - 1] */
+struct eavb_hist {
+	uint64_t              bucket[EAVB_HIST_BUCKETS];
+	uint64_t              count;
+	uint64_t              total;
+	uint64_t              max;
+};
+
+/* statistics of push or take */
+struct eavb_op_stats {
+	uint64_t              calls;
+	uint64_t              eagain;
+	uint64_t              errors;
+	struct eavb_hist      duration; /* time in write/read [ns] */
+	struct eavb_hist      entries;  /* entries moved per call */
+};
+
+/* statistics of stream queue context */
+struct eavb_ctx_stats {
+	struct eavb_op_stats  push;
+	struct eavb_op_stats  take;
+};
+
+/* stream queue context */
+struct eavb_ctx {
+	int                   fd;
+	uint32_t              seq_no;
+	enum eavb_block       blockmode;
+	pthread_mutex_t       lock;       /* of pages */
+	pthread_mutex_t       push_lock;  /* of seq_no and push statistics */
+	pthread_mutex_t       take_lock;  /* of take statistics */
+	struct eavb_dma_alloc *pages;
+	int                   pagenum;
+	int                   pagemax;
+	struct eavb_ctx_stats *stats;   /* NULL unless enabled */
+};
+
+/* frame in DMA page */
+struct eavb_frame {
+	void                  *vaddr;
+	uint32_t              paddr;
+};
+
+/* DMA frame pool, frames packed into DMA pages */
+struct eavb_frame_pool {
+	struct eavb_ctx       *ctx;
+	int                   framesize;
+	int                   framenum;
+	int                   pagenum;
+	struct eavb_dma_alloc *pages;
+	struct eavb_frame     *frames;
+};
+
+#define EAVB_EVLOOP_SOURCE_MAX (64)
+
+/* handler of event loop, revents is bit OR of EAVB_NOTIFY_* */
+typedef void (*eavb_evloop_cb)(int fd, int revents, void *arg);
+
+/* event source of event loop */
+struct eavb_evsource {
+	int                   type;
+	int                   fd;
+	bool                  emulated; /* not pollable with epoll */
+	int                   events;
+	eavb_evloop_cb        cb;
+	void                  *arg;
+};
+
+/* event loop of stream queues, timers and other fds */
+struct eavb_evloop {
+	int                   epfd;
+	int                   notifyfd;
+	int                   emulatednum;
+	struct eavb_evsource  sources[EAVB_EVLOOP_SOURCE_MAX];
+};
+
+/* statistics of a stream queue of the loopback backend */
+struct eavb_loopback_stats {
+	uint64_t frames;        /* transmitted (Tx) or received (Rx) */
+	uint64_t bytes;
+	uint64_t dropped;       /* Tx: no Rx queue, Rx: no free entry */
+	uint64_t errors;        /* invalid entry vectors */
+	uint64_t latency_total; /* Rx: push on Tx to take on Rx [ns] */
+	uint64_t latency_max;
+	uint64_t latency_count;
+	int      users;         /* number of opened files */
+	uint32_t pending;       /* entries owned by the queue */
+};
+
 extern int eavb_open(char *devname, mode_t mode);
 extern void eavb_close(int fd);
 extern int eavb_set_txparam(int fd, struct eavb_txparam *txparam);
@@ -28,5 +123,45 @@ extern int eavb_take(int fd, struct eavb_entry *entrybuf, int entrynum);
 extern int eavb_wait(int fd, int flags, int timeout);
 extern int eavb_dma_malloc_page(int fd, struct eavb_dma_alloc *page);
 extern void eavb_dma_free_page(int fd, struct eavb_dma_alloc *page);
+extern struct eavb_ctx *eavb_ctx_open(char *devname, mode_t mode);
+extern void eavb_ctx_close(struct eavb_ctx *ctx);
+extern int eavb_ctx_set_optblockmode(struct eavb_ctx *ctx,
+				     enum eavb_block blockmode);
+extern int eavb_ctx_push(struct eavb_ctx *ctx, struct eavb_entry *entrybuf,
+			 int entrynum);
+extern int eavb_ctx_take(struct eavb_ctx *ctx, struct eavb_entry *entrybuf,
+			 int entrynum);
+extern int eavb_ctx_wait(struct eavb_ctx *ctx, int flags, int timeout);
+extern int eavb_ctx_dma_malloc_page(struct eavb_ctx *ctx,
+				    struct eavb_dma_alloc *page);
+extern void eavb_ctx_dma_free_page(struct eavb_ctx *ctx,
+				   struct eavb_dma_alloc *page);
+extern int eavb_ctx_stats_enable(struct eavb_ctx *ctx);
+extern void eavb_ctx_stats_dump(struct eavb_ctx *ctx, FILE *fp,
+				const char *name);
+extern struct eavb_frame_pool *eavb_frame_pool_new(struct eavb_ctx *ctx,
+						   int framesize, int framenum);
+extern struct eavb_frame_pool *eavb_frame_pool_new_align(
+		struct eavb_ctx *ctx, int framesize, int framenum, int align);
+extern void eavb_frame_pool_free(struct eavb_frame_pool *pool);
+extern struct eavb_evloop *eavb_evloop_new(void);
+extern void eavb_evloop_free(struct eavb_evloop *loop);
+extern int eavb_evloop_add(struct eavb_evloop *loop, struct eavb_ctx *ctx,
+			   int events, eavb_evloop_cb cb, void *arg);
+extern int eavb_evloop_mod(struct eavb_evloop *loop, struct eavb_ctx *ctx,
+			   int events);
+extern int eavb_evloop_del(struct eavb_evloop *loop, struct eavb_ctx *ctx);
+extern int eavb_evloop_add_fd(struct eavb_evloop *loop, int fd, int events,
+			      eavb_evloop_cb cb, void *arg);
+extern int eavb_evloop_del_fd(struct eavb_evloop *loop, int fd);
+extern int eavb_evloop_add_timer(struct eavb_evloop *loop, uint64_t interval,
+				 eavb_evloop_cb cb, void *arg);
+extern int eavb_evloop_set_notify(struct eavb_evloop *loop,
+				  eavb_evloop_cb cb, void *arg);
+extern void eavb_evloop_notify(struct eavb_evloop *loop);
+extern int eavb_evloop_run_once(struct eavb_evloop *loop, int timeout);
+extern int eavb_set_backend(const char *name);
+extern int eavb_loopback_get_stats(const char *devname,
+				   struct eavb_loopback_stats *stats);
 
 #endif /* __EAVB_H__ */
@@ -0,0 +1,39 @@
+/*
+ * Copyright (c) 2014-2016 Renesas Electronics Corporation
+ * Released under the MIT license
+ * http://opensource.org/licenses/mit-license.php
+ */
+
+#ifndef __EAVB_BACKEND_H__
+#define __EAVB_BACKEND_H__
+
+#include <stdbool.h>
+#include <sys/types.h>
+#include <poll.h>
+
+/*
+ * stream queue backend
+ *
+ * every access of libeavb to the stream queue goes through one of
+ * these operations, they follow the semantics of the system calls
+ * of the same name on the Renesas AVB Streaming driver.
+ */
+struct eavb_backend {
+	const char *name;
+	bool epoll;	/* fds are pollable with epoll */
+	int (*open)(const char *pathname, int flags);
+	int (*close)(int fd);
+	int (*ioctl)(int fd, unsigned long request, void *arg);
+	ssize_t (*read)(int fd, void *buf, size_t count);
+	ssize_t (*write)(int fd, const void *buf, size_t count);
+	int (*poll)(struct pollfd *fds, nfds_t nfds, int timeout);
+	void *(*mmap)(size_t length, int prot, int flags, int fd, off_t offset);
+	int (*munmap)(void *addr, size_t length);
+};
+
+extern const struct eavb_backend eavb_backend_ravb;
+extern const struct eavb_backend eavb_backend_loopback;
+
+extern const struct eavb_backend *eavb_get_backend(void);
+
+#endif /* __EAVB_BACKEND_H__ */
@@ -0,0 +1,563 @@
+/*
+ * Copyright (c) 2014-2016 Renesas Electronics Corporation
+ * Released under the MIT license
+ * http://opensource.org/licenses/mit-license.php
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <time.h>
+#include <poll.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/timerfd.h>
+
+#include "eavb.h"
+#include "eavb_backend.h"
+
+/* poll slice of stream queues not pollable with epoll [ms] */
+#define EVLOOP_EMULATED_SLICE (1)
+
+#define NSEC_SCALE (1000000000ull)
+
+enum evsource_type {
+	EVSOURCE_NONE = 0,
+	EVSOURCE_QUEUE,
+	EVSOURCE_FD,
+	EVSOURCE_TIMER,
+	EVSOURCE_NOTIFY,
+};
+
+static inline uint64_t evloop_now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return ts.tv_sec * NSEC_SCALE + ts.tv_nsec;
+}
+
+static uint32_t to_epoll(int events)
+{
+	uint32_t ev = 0;
+
+	if (events & EAVB_NOTIFY_READ)
+		ev |= EPOLLIN;
+	if (events & EAVB_NOTIFY_WRITE)
+		ev |= EPOLLOUT;
+
+	return ev;
+}
+
+static int from_epoll(uint32_t ev, int events)
+{
+	int revents = 0;
+
+	/* errors are reported to the handler as readiness */
+	if (ev & (EPOLLERR | EPOLLHUP))
+		return events;
+
+	if (ev & EPOLLIN)
+		revents |= EAVB_NOTIFY_READ;
+	if (ev & EPOLLOUT)
+		revents |= EAVB_NOTIFY_WRITE;
+
+	return revents & events;
+}
+
+static short to_poll(int events)
+{
+	short ev = 0;
+
+	if (events & EAVB_NOTIFY_READ)
+		ev |= POLLIN;
+	if (events & EAVB_NOTIFY_WRITE)
+		ev |= POLLOUT;
+
+	return ev;
+}
+
+static int from_poll(short ev, int events)
+{
+	int revents = 0;
+
+	if (ev & (POLLERR | POLLHUP | POLLNVAL))
+		return events;
+
+	if (ev & POLLIN)
+		revents |= EAVB_NOTIFY_READ;
+	if (ev & POLLOUT)
+		revents |= EAVB_NOTIFY_WRITE;
+
+	return revents & events;
+}
+
+static struct eavb_evsource *evloop_find(struct eavb_evloop *loop, int fd)
+{
+	int i;
+
+	for (i = 0; i < EAVB_EVLOOP_SOURCE_MAX; i++) {
+		if (loop->sources[i].type != EVSOURCE_NONE &&
+		    loop->sources[i].fd == fd)
+			return &loop->sources[i];
+	}
+
+	return NULL;
+}
+
+static int evloop_add(struct eavb_evloop *loop, int type, int fd,
+		      bool emulated, int events, eavb_evloop_cb cb, void *arg)
+{
+	struct eavb_evsource *src = NULL;
+	struct epoll_event ev;
+	int i;
+
+	if (evloop_find(loop, fd)) {
+		fprintf(stderr, "eavb: fd %d is already in event loop\n", fd);
+		return -1;
+	}
+
+	for (i = 0; i < EAVB_EVLOOP_SOURCE_MAX; i++) {
+		if (loop->sources[i].type == EVSOURCE_NONE) {
+			src = &loop->sources[i];
+			break;
+		}
+	}
+	if (!src) {
+		fprintf(stderr, "eavb: too many event sources\n");
+		return -1;
+	}
+
+	if (!emulated) {
+		memset(&ev, 0, sizeof(ev));
+		ev.events = to_epoll(events);
+		ev.data.u32 = i;
+		if (epoll_ctl(loop->epfd, EPOLL_CTL_ADD, fd, &ev) < 0) {
+			perror("epoll_ctl add failed");
+			return -1;
+		}
+	} else {
+		loop->emulatednum++;
+	}
+
+	src->type = type;
+	src->fd = fd;
+	src->emulated = emulated;
+	src->events = events;
+	src->cb = cb;
+	src->arg = arg;
+
+	return 0;
+}
+
+static int evloop_del(struct eavb_evloop *loop, int fd)
+{
+	struct eavb_evsource *src;
+
+	src = evloop_find(loop, fd);
+	if (!src)
+		return -1;
+
+	if (!src->emulated)
+		epoll_ctl(loop->epfd, EPOLL_CTL_DEL, fd, NULL);
+	else
+		loop->emulatednum--;
+
+	if (src->type == EVSOURCE_TIMER)
+		close(src->fd);
+
+	memset(src, 0, sizeof(*src));
+
+	return 0;
+}
+
+/*
+ * create event loop
+ *
+ * stream queues, timers and other fds are waited on in one epoll
+ * set, the readiness is dispatched to the handler of each source.
+ */
+struct eavb_evloop *eavb_evloop_new(void)
+{
+	struct eavb_evloop *loop;
+
+	loop = calloc(1, sizeof(*loop));
+	if (!loop) {
+		perror("cannot allocate event loop");
+		return NULL;
+	}
+
+	loop->notifyfd = -1;
+
+	loop->epfd = epoll_create1(EPOLL_CLOEXEC);
+	if (loop->epfd < 0) {
+		perror("epoll_create1 failed");
+		free(loop);
+		return NULL;
+	}
+
+	return loop;
+}
+
+/*
+ * free event loop, stream queues are not closed
+ *
+ * @loop     event loop
+ */
+void eavb_evloop_free(struct eavb_evloop *loop)
+{
+	int i;
+
+	if (!loop)
+		return;
+
+	for (i = 0; i < EAVB_EVLOOP_SOURCE_MAX; i++) {
+		if (loop->sources[i].type == EVSOURCE_TIMER)
+			close(loop->sources[i].fd);
+	}
+
+	if (loop->notifyfd >= 0)
+		close(loop->notifyfd);
+	close(loop->epfd);
+	free(loop);
+}
+
+/*
+ * add stream queue to event loop
+ *
+ * @loop     event loop
+ * @ctx      specify context of stream queue
+ * @events   target of wait events (specify bit OR of EAVB_NOTIFY_*)
+ * @cb       handler called with ready events
+ * @arg      argument of handler
+ */
+int eavb_evloop_add(struct eavb_evloop *loop, struct eavb_ctx *ctx,
+		    int events, eavb_evloop_cb cb, void *arg)
+{
+	if (!loop || !ctx || !cb)
+		return -1;
+
+	return evloop_add(loop, EVSOURCE_QUEUE, ctx->fd,
+			  !eavb_get_backend()->epoll, events, cb, arg);
+}
+
+/*
+ * change wait events of stream queue
+ *
+ * @loop     event loop
+ * @ctx      specify context of stream queue
+ * @events   target of wait events, 0 disables the queue
+ */
+int eavb_evloop_mod(struct eavb_evloop *loop, struct eavb_ctx *ctx,
+		    int events)
+{
+	struct eavb_evsource *src;
+	struct epoll_event ev;
+
+	if (!loop || !ctx)
+		return -1;
+
+	src = evloop_find(loop, ctx->fd);
+	if (!src)
+		return -1;
+
+	if (src->events == events)
+		return 0;
+
+	if (!src->emulated) {
+		memset(&ev, 0, sizeof(ev));
+		ev.events = to_epoll(events);
+		ev.data.u32 = src - loop->sources;
+		if (epoll_ctl(loop->epfd, EPOLL_CTL_MOD, src->fd, &ev) < 0) {
+			perror("epoll_ctl mod failed");
+			return -1;
+		}
+	}
+
+	src->events = events;
+
+	return 0;
+}
+
+/*
+ * remove stream queue from event loop
+ *
+ * @loop     event loop
+ * @ctx      specify context of stream queue
+ */
+int eavb_evloop_del(struct eavb_evloop *loop, struct eavb_ctx *ctx)
+{
+	if (!loop || !ctx)
+		return -1;
+
+	return evloop_del(loop, ctx->fd);
+}
+
+/*
+ * add file descriptor to event loop
+ *
+ * @loop     event loop
+ * @fd       file descriptor pollable with epoll
+ * @events   target of wait events (specify bit OR of EAVB_NOTIFY_*)
+ * @cb       handler called with ready events
+ * @arg      argument of handler
+ */
+int eavb_evloop_add_fd(struct eavb_evloop *loop, int fd, int events,
+		       eavb_evloop_cb cb, void *arg)
+{
+	if (!loop || fd < 0 || !cb)
+		return -1;
+
+	return evloop_add(loop, EVSOURCE_FD, fd, false, events, cb, arg);
+}
+
+/*
+ * remove file descriptor or timer from event loop
+ *
+ * @loop     event loop
+ * @fd       file descriptor, timers are closed
+ */
+int eavb_evloop_del_fd(struct eavb_evloop *loop, int fd)
+{
+	if (!loop)
+		return -1;
+
+	return evloop_del(loop, fd);
+}
+
+/*
+ * add periodic timer to event loop
+ *
+ * the expirations are consumed before the handler is called.
+ * returns fd of the timer.
+ *
+ * @loop     event loop
+ * @interval interval [ns]
+ * @cb       handler
+ * @arg      argument of handler
+ */
+int eavb_evloop_add_timer(struct eavb_evloop *loop, uint64_t interval,
+			  eavb_evloop_cb cb, void *arg)
+{
+	struct itimerspec its;
+	int fd;
+
+	if (!loop || !interval || !cb)
+		return -1;
+
+	fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+	if (fd < 0) {
+		perror("timerfd_create failed");
+		return -1;
+	}
+
+	its.it_interval.tv_sec = interval / NSEC_SCALE;
+	its.it_interval.tv_nsec = interval % NSEC_SCALE;
+	its.it_value = its.it_interval;
+	if (timerfd_settime(fd, 0, &its, NULL) < 0) {
+		perror("timerfd_settime failed");
+		close(fd);
+		return -1;
+	}
+
+	if (evloop_add(loop, EVSOURCE_TIMER, fd, false, EAVB_NOTIFY_READ,
+		       cb, arg) < 0) {
+		close(fd);
+		return -1;
+	}
+
+	return fd;
+}
+
+/*
+ * set handler of eavb_evloop_notify()
+ *
+ * @loop     event loop
+ * @cb       handler, NULL only wakes up the loop
+ * @arg      argument of handler
+ */
+int eavb_evloop_set_notify(struct eavb_evloop *loop, eavb_evloop_cb cb,
+			   void *arg)
+{
+	struct eavb_evsource *src;
+
+	if (!loop)
+		return -1;
+
+	if (loop->notifyfd < 0) {
+		loop->notifyfd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+		if (loop->notifyfd < 0) {
+			perror("eventfd failed");
+			return -1;
+		}
+		if (evloop_add(loop, EVSOURCE_NOTIFY, loop->notifyfd, false,
+			       EAVB_NOTIFY_READ, cb, arg) < 0) {
+			close(loop->notifyfd);
+			loop->notifyfd = -1;
+			return -1;
+		}
+		return 0;
+	}
+
+	src = evloop_find(loop, loop->notifyfd);
+	src->cb = cb;
+	src->arg = arg;
+
+	return 0;
+}
+
+/*
+ * wake up event loop, async-signal-safe
+ *
+ * @loop     event loop, eavb_evloop_set_notify() must be called
+ */
+void eavb_evloop_notify(struct eavb_evloop *loop)
+{
+	uint64_t one = 1;
+	int ret;
+
+	if (!loop || loop->notifyfd < 0)
+		return;
+
+	ret = write(loop->notifyfd, &one, sizeof(one));
+	(void)ret;
+}
+
+static int evloop_dispatch(struct eavb_evsource *src, int revents)
+{
+	uint64_t count;
+	int ret;
+
+	if (!revents)
+		return 0;
+
+	if (src->type == EVSOURCE_TIMER || src->type == EVSOURCE_NOTIFY) {
+		ret = read(src->fd, &count, sizeof(count));
+		if (ret != sizeof(count))
+			return 0;
+	}
+
+	if (src->cb)
+		src->cb(src->fd, revents, src->arg);
+
+	return 1;
+}
+
+static int evloop_wait_epoll(struct eavb_evloop *loop, int timeout)
+{
+	struct epoll_event evs[EAVB_EVLOOP_SOURCE_MAX];
+	struct eavb_evsource *src;
+	int i, n, dispatched = 0;
+
+	n = epoll_wait(loop->epfd, evs, EAVB_EVLOOP_SOURCE_MAX, timeout);
+	if (n < 0) {
+		if (errno == EINTR)
+			return 0;
+		perror("epoll_wait failed");
+		return -1;
+	}
+
+	for (i = 0; i < n; i++) {
+		src = &loop->sources[evs[i].data.u32];
+		if (src->type == EVSOURCE_NONE)
+			continue;
+		dispatched += evloop_dispatch(src,
+				from_epoll(evs[i].events, src->events));
+	}
+
+	return dispatched;
+}
+
+/* stream queues of a backend without pollable fds, timeout in ms */
+static int evloop_wait_emulated(struct eavb_evloop *loop, int timeout)
+{
+	struct pollfd pfds[EAVB_EVLOOP_SOURCE_MAX];
+	struct eavb_evsource *srcs[EAVB_EVLOOP_SOURCE_MAX];
+	int i, n, ret, dispatched = 0;
+
+	for (i = 0, n = 0; i < EAVB_EVLOOP_SOURCE_MAX; i++) {
+		if (!loop->sources[i].emulated || !loop->sources[i].events)
+			continue;
+		srcs[n] = &loop->sources[i];
+		pfds[n].fd = srcs[n]->fd;
+		pfds[n].events = to_poll(srcs[n]->events);
+		pfds[n].revents = 0;
+		n++;
+	}
+
+	if (!n) {
+		if (timeout > 0)
+			usleep(timeout * 1000);
+		return 0;
+	}
+
+	ret = eavb_get_backend()->poll(pfds, n, timeout);
+	if (ret < 0) {
+		if (errno == EINTR)
+			return 0;
+		perror("poll failed");
+		return -1;
+	}
+
+	for (i = 0; i < n && ret; i++) {
+		if (!pfds[i].revents)
+			continue;
+		dispatched += evloop_dispatch(srcs[i],
+				from_poll(pfds[i].revents, srcs[i]->events));
+	}
+
+	return dispatched;
+}
+
+/*
+ * wait events and dispatch them to the handlers once
+ *
+ * returns number of dispatched sources, 0 on timeout or signal.
+ *
+ * @loop     event loop
+ * @timeout  timeout [ms], -1 waits forever
+ */
+int eavb_evloop_run_once(struct eavb_evloop *loop, int timeout)
+{
+	uint64_t deadline = 0;
+	int ret, slice;
+
+	if (!loop)
+		return -1;
+
+	if (!loop->emulatednum)
+		return evloop_wait_epoll(loop, timeout);
+
+	/*
+	 * the loopback backend can not wake up epoll, poll its queues
+	 * and the other fds alternately in short slices.
+	 */
+	if (timeout >= 0)
+		deadline = evloop_now() + (uint64_t)timeout * 1000000;
+
+	for (;;) {
+		ret = evloop_wait_epoll(loop, 0);
+		if (ret)
+			return ret;
+
+		slice = EVLOOP_EMULATED_SLICE;
+		if (timeout >= 0) {
+			uint64_t now = evloop_now();
+
+			if (now >= deadline)
+				slice = 0;
+			else if (deadline - now < slice * 1000000ull)
+				slice = (deadline - now + 999999) / 1000000;
+		}
+
+		ret = evloop_wait_emulated(loop, slice);
+		if (ret)
+			return ret;
+
+		if (timeout >= 0 && evloop_now() >= deadline)
+			return 0;
+	}
+}
@@ -0,0 +1,121 @@
+/*
+ * Copyright (c) 2014-2016 Renesas Electronics Corporation
+ * Released under the MIT license
+ * http://opensource.org/licenses/mit-license.php
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "eavb.h"
+
+#define EAVB_FRAME_ALIGN (64)
+
+#define ALIGN(x, a) (((x) + (a) - 1) & ~((a) - 1))
+
+/*
+ * allocate DMA frame pool with alignment
+ *
+ * frames are packed into DMA pages without crossing a page boundary.
+ * each page is still allocated and mapped on its own, but shared by
+ * PAGE_SIZE / framesize frames, which saves the map calls of the others.
+ *
+ * @ctx       specify context of stream queue
+ * @framesize size of one frame
+ * @framenum  number of frames
+ * @align     alignment of frames, power of 2
+ */
+struct eavb_frame_pool *eavb_frame_pool_new_align(struct eavb_ctx *ctx,
+						  int framesize, int framenum,
+						  int align)
+{
+	struct eavb_frame_pool *pool;
+	struct eavb_dma_alloc *page = NULL;
+	int i, offset = 0;
+
+	if (!ctx || framesize <= 0 || framenum <= 0 ||
+	    align <= 0 || (align & (align - 1))) {
+		fprintf(stderr, "eavb: invalid frame pool parameter\n");
+		return NULL;
+	}
+
+	pool = calloc(1, sizeof(*pool));
+	if (!pool) {
+		perror("cannot allocate frame pool");
+		return NULL;
+	}
+
+	pool->ctx = ctx;
+	pool->framesize = ALIGN(framesize, align);
+	pool->framenum = framenum;
+
+	/* at most one page per frame */
+	pool->pages = calloc(framenum, sizeof(*pool->pages));
+	pool->frames = calloc(framenum, sizeof(*pool->frames));
+	if (!pool->pages || !pool->frames) {
+		perror("cannot allocate frame pool");
+		goto error;
+	}
+
+	for (i = 0; i < framenum; i++) {
+		if (!page || offset + pool->framesize > page->mmap_size) {
+			page = &pool->pages[pool->pagenum];
+			if (eavb_ctx_dma_malloc_page(ctx, page) < 0)
+				goto error;
+			pool->pagenum++;
+			offset = 0;
+
+			if (pool->framesize > page->mmap_size) {
+				fprintf(stderr, "eavb: frame size %d exceeds page size %u\n",
+					pool->framesize, page->mmap_size);
+				goto error;
+			}
+		}
+
+		pool->frames[i].vaddr = page->dma_vaddr + offset;
+		pool->frames[i].paddr = page->dma_paddr + offset;
+		offset += pool->framesize;
+	}
+
+	return pool;
+
+error:
+	eavb_frame_pool_free(pool);
+
+	return NULL;
+}
+
+/*
+ * allocate DMA frame pool, frames are aligned to cache line
+ *
+ * @ctx       specify context of stream queue
+ * @framesize size of one frame
+ * @framenum  number of frames
+ */
+struct eavb_frame_pool *eavb_frame_pool_new(struct eavb_ctx *ctx,
+					    int framesize, int framenum)
+{
+	return eavb_frame_pool_new_align(ctx, framesize, framenum,
+					 EAVB_FRAME_ALIGN);
+}
+
+/*
+ * free DMA frame pool
+ *
+ * @pool     frame pool
+ */
+void eavb_frame_pool_free(struct eavb_frame_pool *pool)
+{
+	int i;
+
+	if (!pool)
+		return;
+
+	for (i = pool->pagenum - 1; i >= 0; i--)
+		eavb_ctx_dma_free_page(pool->ctx, &pool->pages[i]);
+
+	free(pool->frames);
+	free(pool->pages);
+	free(pool);
+}
@@ -0,0 +1,961 @@
+/*
+ * Copyright (c) 2014-2016 Renesas Electronics Corporation
+ * Released under the MIT license
+ * http://opensource.org/licenses/mit-license.php
+ */
+
+/*
+ * userspace loopback backend
+ *
+ * emulates the Tx and Rx stream queues of the Renesas AVB Streaming
+ * driver in a POSIX shared memory segment, so that a talker and a
+ * listener can run against each other on a host without AVB hardware.
+ *
+ * - DMA pages are carved out of the shared segment, dma_paddr is the
+ *   offset in the page pool plus LOOP_PADDR_BASE.
+ * - frames pushed to avb_tx0/avb_tx1 are "transmitted" at the pace of
+ *   the CBS parameters (bandwidthFraction) of the queue and the link
+ *   speed (EAVB_LOOPBACK_SPEED [Mbps], default 100), then copied into
+ *   the next free entry of the avb_rxN queue whose separation filter
+ *   matches the StreamID, or of a queue without filter.
+ * - transmission is driven by whichever process is inside the backend,
+ *   waiters sleep on an event counter of the segment (a shared futex,
+ *   which unlike a condition variable survives a killed waiter) until
+ *   the next frame is due.
+ * - the segment outlives the processes. the queues opened and pages
+ *   allocated by a process that is gone without closing them are
+ *   reclaimed on the next open, and EAVB_LOOPBACK_SPEED, when set,
+ *   takes effect for every process from the next open on.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <time.h>
+#include <pthread.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/eventfd.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+#include <limits.h>
+
+#include "eavb.h"
+#include "eavb_backend.h"
+
+#define ARRAY_SIZE(a) (sizeof(a)/sizeof(a[0]))
+
+#define LOOP_SHM_NAME      "/eavb_loopback"
+#define LOOP_MAGIC         (0x4541564d)
+
+#define LOOP_QUEUE_TX_NUM  (2)
+#define LOOP_QUEUE_RX_NUM  (16)
+#define LOOP_QUEUE_NUM     (LOOP_QUEUE_TX_NUM + LOOP_QUEUE_RX_NUM)
+#define LOOP_QUEUE_ENTRIES (4096)
+#define LOOP_QUEUE_OWNERS  (16)   /* processes with a queue open */
+
+#define LOOP_PAGE_SIZE     (4096)
+#define LOOP_PAGE_NUM      (16384)
+#define LOOP_PADDR_BASE    (0x40000000u)
+
+#define LOOP_FILE_MAX      (1024)
+#define LOOP_FRAME_MAX     (2048)
+#define LOOP_DEFAULT_SPEED (100) /* Mbps */
+
+/* preamble(8), FCS(4) */
+#define LOOP_WIRE_OVERHEAD (8 + 4)
+/* IFG(12) */
+#define LOOP_WIRE_IFG      (12)
+/* DA + SA + Qtag + EthType(18), offset of stream_id in AVTPDU(4) */
+#define LOOP_STREAMID_OFFSET (18 + 4)
+#define LOOP_STREAMID_SIZE   (8)
+
+#define NSEC_SCALE (1000000000ull)
+
+enum {
+	LOOP_STATE_NONE = 0,
+	LOOP_STATE_INIT,
+	LOOP_STATE_READY,
+};
+
+struct loop_slot {
+	struct eavb_entry entry;
+	uint64_t          timestamp; /* pushed time on the Tx queue [ns] */
+};
+
+struct loop_owner {
+	pid_t              pid;   /* 0:unused */
+	int                users;
+};
+
+struct loop_queue {
+	int                users;
+	struct loop_owner  owner[LOOP_QUEUE_OWNERS];
+	uint32_t           head; /* written by the user */
+	uint32_t           done; /* completed by the loopback */
+	uint32_t           tail; /* read by the user */
+	uint64_t           next_tx;
+	struct eavb_txparam txparam;
+	struct eavb_rxparam rxparam;
+	struct eavb_loopback_stats stats;
+	struct loop_slot   slot[LOOP_QUEUE_ENTRIES];
+};
+
+struct loop_shm {
+	uint32_t           magic;
+	int                state;
+	uint32_t           speed;
+	pthread_mutex_t    lock;
+	uint32_t           event; /* bumped on every wake up */
+	uint32_t           page_hint;
+	uint8_t            page_owner[LOOP_PAGE_NUM]; /* queue index + 1 */
+	pid_t              page_pid[LOOP_PAGE_NUM];   /* allocated by */
+	struct loop_queue  queue[LOOP_QUEUE_NUM];
+	uint8_t            page[LOOP_PAGE_NUM][LOOP_PAGE_SIZE]
+				__attribute__((aligned(LOOP_PAGE_SIZE)));
+};
+
+struct loop_file {
+	int                qid; /* queue index + 1, 0:unused */
+	int                flags;
+	enum eavb_block    blockmode;
+};
+
+static struct loop_shm *shm;
+static struct loop_file files[LOOP_FILE_MAX];
+
+static inline uint64_t loop_now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return ts.tv_sec * NSEC_SCALE + ts.tv_nsec;
+}
+
+static void loop_init(struct loop_shm *p)
+{
+	pthread_mutexattr_t mattr;
+
+	pthread_mutexattr_init(&mattr);
+	pthread_mutexattr_setpshared(&mattr, PTHREAD_PROCESS_SHARED);
+	pthread_mutexattr_setrobust(&mattr, PTHREAD_MUTEX_ROBUST);
+	pthread_mutex_init(&p->lock, &mattr);
+	pthread_mutexattr_destroy(&mattr);
+
+	p->speed = LOOP_DEFAULT_SPEED;
+	p->magic = LOOP_MAGIC;
+}
+
+static void loop_lock(void)
+{
+	if (pthread_mutex_lock(&shm->lock) == EOWNERDEAD)
+		pthread_mutex_consistent(&shm->lock);
+}
+
+static void loop_unlock(void)
+{
+	pthread_mutex_unlock(&shm->lock);
+}
+
+static int loop_attach(void)
+{
+	struct loop_shm *p;
+	char *name, *speed;
+	int fd;
+
+	if (shm)
+		return 0;
+
+	name = getenv("EAVB_LOOPBACK_NAME");
+	if (!name)
+		name = LOOP_SHM_NAME;
+
+	fd = shm_open(name, O_RDWR | O_CREAT, 0600);
+	if (fd < 0) {
+		perror("shm_open");
+		return -1;
+	}
+
+	if (ftruncate(fd, sizeof(*p)) < 0) {
+		perror("ftruncate");
+		close(fd);
+		return -1;
+	}
+
+	p = mmap(NULL, sizeof(*p), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	close(fd);
+	if (p == MAP_FAILED) {
+		perror("mmap");
+		return -1;
+	}
+
+	if (__sync_bool_compare_and_swap(&p->state,
+				LOOP_STATE_NONE, LOOP_STATE_INIT)) {
+		loop_init(p);
+		__sync_synchronize();
+		p->state = LOOP_STATE_READY;
+	} else {
+		while (*(volatile int *)&p->state != LOOP_STATE_READY)
+			usleep(1000);
+	}
+
+	if (p->magic != LOOP_MAGIC) {
+		fprintf(stderr, "eavb: invalid loopback segment %s\n", name);
+		munmap(p, sizeof(*p));
+		return -1;
+	}
+
+	shm = p;
+
+	/* the segment may be of an earlier run, the speed is of this one */
+	speed = getenv("EAVB_LOOPBACK_SPEED");
+	if (speed && atoi(speed) > 0) {
+		loop_lock();
+		shm->speed = atoi(speed);
+		loop_unlock();
+	}
+
+	return 0;
+}
+
+static int loop_queue_index(const char *pathname)
+{
+	const char *name;
+	int n;
+
+	name = strrchr(pathname, '/');
+	name = name ? name + 1 : pathname;
+
+	if (sscanf(name, "avb_tx%d", &n) == 1 &&
+	    n >= 0 && n < LOOP_QUEUE_TX_NUM)
+		return n;
+	if (sscanf(name, "avb_rx%d", &n) == 1 &&
+	    n >= 0 && n < LOOP_QUEUE_RX_NUM)
+		return LOOP_QUEUE_TX_NUM + n;
+
+	return -1;
+}
+
+static inline bool loop_queue_is_tx(int qid)
+{
+	return qid < LOOP_QUEUE_TX_NUM;
+}
+
+static struct loop_file *loop_file(int fd)
+{
+	if (fd < 0 || fd >= LOOP_FILE_MAX || !files[fd].qid) {
+		errno = EBADF;
+		return NULL;
+	}
+
+	return &files[fd];
+}
+
+static inline struct loop_queue *loop_file_queue(struct loop_file *f)
+{
+	return &shm->queue[f->qid - 1];
+}
+
+static void *loop_paddr_to_vaddr(uint32_t paddr, uint32_t len)
+{
+	uint64_t offset;
+
+	if (paddr < LOOP_PADDR_BASE)
+		return NULL;
+
+	offset = paddr - LOOP_PADDR_BASE;
+	if (offset + len > sizeof(shm->page))
+		return NULL;
+
+	return (uint8_t *)shm->page + offset;
+}
+
+/*
+ * wire emulation
+ */
+static uint64_t loop_interval(struct loop_queue *q, int len)
+{
+	uint64_t ns, fraction;
+
+	fraction = q->txparam.cbs.bandwidthFraction;
+
+	if (!fraction) {
+		/* line rate */
+		ns = (uint64_t)(len + LOOP_WIRE_OVERHEAD + LOOP_WIRE_IFG) *
+			8 * 1000 / shm->speed;
+	} else {
+		/* credit based shaper */
+		ns = (uint64_t)(len + LOOP_WIRE_OVERHEAD) * 8 * 1000 / shm->speed;
+		ns = (ns << 32) / fraction;
+	}
+
+	return ns;
+}
+
+static int loop_gather(struct eavb_entry *e, uint8_t *frame)
+{
+	struct eavb_entryvec *evec;
+	void *src;
+	int i, len = 0;
+
+	for (i = 0; i < ARRAY_SIZE(e->vec); i++) {
+		evec = &e->vec[i];
+		if (!evec->len)
+			break;
+		if (len + evec->len > LOOP_FRAME_MAX)
+			return -1;
+
+		src = loop_paddr_to_vaddr(evec->base, evec->len);
+		if (!src)
+			return -1;
+
+		memcpy(frame + len, src, evec->len);
+		len += evec->len;
+	}
+
+	return len;
+}
+
+static struct loop_queue *loop_lookup_rx(uint8_t *streamid)
+{
+	static const uint8_t wildcard_id[LOOP_STREAMID_SIZE];
+	struct loop_queue *q, *wildcard = NULL;
+	int i;
+
+	for (i = LOOP_QUEUE_TX_NUM; i < LOOP_QUEUE_NUM; i++) {
+		q = &shm->queue[i];
+		if (!q->users)
+			continue;
+		if (!memcmp(q->rxparam.streamid, streamid, LOOP_STREAMID_SIZE))
+			return q;
+		if (!wildcard && !memcmp(q->rxparam.streamid, wildcard_id,
+					 LOOP_STREAMID_SIZE))
+			wildcard = q;
+	}
+
+	return wildcard;
+}
+
+static void loop_deliver(struct loop_queue *tx, uint8_t *frame, int len,
+			 uint64_t timestamp)
+{
+	struct loop_queue *rx;
+	struct loop_slot *s;
+	struct eavb_entryvec *evec;
+	void *dst;
+
+	rx = NULL;
+	if (len >= LOOP_STREAMID_OFFSET + LOOP_STREAMID_SIZE)
+		rx = loop_lookup_rx(frame + LOOP_STREAMID_OFFSET);
+	if (!rx) {
+		tx->stats.dropped++;
+		return;
+	}
+
+	/* no free entry, overrun */
+	if (rx->done == rx->head) {
+		rx->stats.dropped++;
+		return;
+	}
+
+	s = &rx->slot[rx->done % LOOP_QUEUE_ENTRIES];
+	evec = &s->entry.vec[0];
+	dst = loop_paddr_to_vaddr(evec->base, len);
+	if (!dst || evec->len < len) {
+		rx->stats.errors++;
+		return;
+	}
+
+	memcpy(dst, frame, len);
+	evec->len = len;
+	s->timestamp = timestamp;
+	rx->done++;
+
+	rx->stats.frames++;
+	rx->stats.bytes += len;
+}
+
+static uint64_t loop_tx_start(struct loop_queue *q)
+{
+	struct loop_slot *s = &q->slot[q->done % LOOP_QUEUE_ENTRIES];
+
+	return (q->next_tx > s->timestamp) ? q->next_tx : s->timestamp;
+}
+
+/* wake up all the waiters, called with the lock held */
+static void loop_wake(void)
+{
+	shm->event++;
+	syscall(SYS_futex, &shm->event, FUTEX_WAKE, INT_MAX, NULL, NULL, 0);
+}
+
+/* transmit every frame that is due, called with the lock held */
+static void loop_transmit(uint64_t now)
+{
+	uint8_t frame[LOOP_FRAME_MAX];
+	struct loop_queue *q;
+	struct loop_slot *s;
+	uint64_t start;
+	int i, len, n = 0;
+
+	for (i = 0; i < LOOP_QUEUE_TX_NUM; i++) {
+		q = &shm->queue[i];
+
+		while (q->done != q->head) {
+			start = loop_tx_start(q);
+			if (start > now)
+				break;
+
+			s = &q->slot[q->done % LOOP_QUEUE_ENTRIES];
+			len = loop_gather(&s->entry, frame);
+			if (len < 0) {
+				q->stats.errors++;
+				len = 0;
+			} else {
+				loop_deliver(q, frame, len, s->timestamp);
+				q->stats.frames++;
+				q->stats.bytes += len;
+			}
+
+			q->next_tx = start + loop_interval(q, len);
+			q->done++;
+			n++;
+		}
+	}
+
+	if (n)
+		loop_wake();
+}
+
+/* time of the next transmission, called with the lock held */
+static uint64_t loop_next_event(void)
+{
+	struct loop_queue *q;
+	uint64_t t, next = UINT64_MAX;
+	int i;
+
+	for (i = 0; i < LOOP_QUEUE_TX_NUM; i++) {
+		q = &shm->queue[i];
+		if (q->done == q->head)
+			continue;
+		t = loop_tx_start(q);
+		if (t < next)
+			next = t;
+	}
+
+	return next;
+}
+
+/* sleep until deadline or the next event, called with the lock held */
+static void loop_sleep(uint64_t deadline)
+{
+	struct timespec ts;
+	uint64_t next;
+	uint32_t event;
+
+	next = loop_next_event();
+	if (next < deadline)
+		deadline = next;
+
+	ts.tv_sec = deadline / NSEC_SCALE;
+	ts.tv_nsec = deadline % NSEC_SCALE;
+
+	/* a wake up after the unlock changes the event, no wait then */
+	event = shm->event;
+	loop_unlock();
+	syscall(SYS_futex, &shm->event, FUTEX_WAIT_BITSET, event,
+		(deadline == UINT64_MAX) ? NULL : &ts, NULL,
+		FUTEX_BITSET_MATCH_ANY);
+	loop_lock();
+}
+
+static short loop_revents(struct loop_queue *q, short events)
+{
+	short revents = 0;
+
+	if ((events & POLLIN) && q->done != q->tail)
+		revents |= POLLIN;
+	if ((events & POLLOUT) && (q->head - q->tail) < LOOP_QUEUE_ENTRIES)
+		revents |= POLLOUT;
+
+	return revents;
+}
+
+/*
+ * DMA pages, called with the lock held
+ */
+static int loop_page_alloc(int qid, struct eavb_dma_alloc *page)
+{
+	uint32_t i, n;
+
+	for (i = 0; i < LOOP_PAGE_NUM; i++) {
+		n = (shm->page_hint + i) % LOOP_PAGE_NUM;
+		if (shm->page_owner[n])
+			continue;
+
+		shm->page_owner[n] = qid + 1;
+		shm->page_pid[n] = getpid();
+		shm->page_hint = n + 1;
+		page->dma_paddr = LOOP_PADDR_BASE + n * LOOP_PAGE_SIZE;
+		page->mmap_size = LOOP_PAGE_SIZE;
+
+		return 0;
+	}
+
+	errno = ENOMEM;
+
+	return -1;
+}
+
+static int loop_page_free(int qid, struct eavb_dma_alloc *page)
+{
+	uint32_t n;
+
+	if (page->dma_paddr < LOOP_PADDR_BASE)
+		goto invalid;
+
+	n = (page->dma_paddr - LOOP_PADDR_BASE) / LOOP_PAGE_SIZE;
+	if (n >= LOOP_PAGE_NUM || shm->page_owner[n] != qid + 1)
+		goto invalid;
+
+	shm->page_owner[n] = 0;
+
+	return 0;
+
+invalid:
+	errno = EINVAL;
+
+	return -1;
+}
+
+/* pages of the queue, of process pid only unless 0 */
+static void loop_page_free_all(int qid, pid_t pid)
+{
+	uint32_t n;
+
+	for (n = 0; n < LOOP_PAGE_NUM; n++)
+		if (shm->page_owner[n] == qid + 1 &&
+		    (!pid || shm->page_pid[n] == pid))
+			shm->page_owner[n] = 0;
+}
+
+/*
+ * users of queues, called with the lock held
+ */
+static struct loop_owner *loop_owner(struct loop_queue *q, pid_t pid)
+{
+	int i;
+
+	for (i = 0; i < LOOP_QUEUE_OWNERS; i++)
+		if (q->owner[i].pid == pid)
+			return &q->owner[i];
+
+	return NULL;
+}
+
+/* the last user of a queue is gone, pending frames are discarded */
+static void loop_queue_release(int qid)
+{
+	struct loop_queue *q = &shm->queue[qid];
+
+	q->head = q->done;
+	loop_page_free_all(qid, 0);
+}
+
+/* queues and pages of processes gone without closing them */
+static void loop_reclaim(void)
+{
+	struct loop_queue *q;
+	struct loop_owner *o;
+	int qid, i;
+
+	for (qid = 0; qid < LOOP_QUEUE_NUM; qid++) {
+		q = &shm->queue[qid];
+		for (i = 0; i < LOOP_QUEUE_OWNERS; i++) {
+			o = &q->owner[i];
+			if (!o->pid || kill(o->pid, 0) == 0 || errno != ESRCH)
+				continue;
+
+			loop_page_free_all(qid, o->pid);
+			q->users -= (o->users < q->users) ? o->users : q->users;
+			o->pid = 0;
+			o->users = 0;
+			if (!q->users)
+				loop_queue_release(qid);
+		}
+	}
+}
+
+/*
+ * backend operations
+ */
+static int loop_open(const char *pathname, int flags)
+{
+	struct loop_queue *q;
+	struct loop_owner *o;
+	int qid, fd;
+
+	if (loop_attach() < 0)
+		return -1;
+
+	qid = loop_queue_index(pathname);
+	if (qid < 0) {
+		errno = ENOENT;
+		return -1;
+	}
+
+	/* a file descriptor as the handle of the queue */
+	fd = eventfd(0, EFD_CLOEXEC);
+	if (fd < 0)
+		return -1;
+	if (fd >= LOOP_FILE_MAX) {
+		close(fd);
+		errno = EMFILE;
+		return -1;
+	}
+
+	loop_lock();
+	loop_reclaim();
+
+	q = &shm->queue[qid];
+	o = loop_owner(q, getpid());
+	if (!o)
+		o = loop_owner(q, 0);
+	if (!o) {
+		loop_unlock();
+		close(fd);
+		errno = EBUSY;
+		return -1;
+	}
+	o->pid = getpid();
+	o->users++;
+
+	if (!q->users) {
+		q->head = 0;
+		q->done = 0;
+		q->tail = 0;
+		q->next_tx = 0;
+		memset(&q->txparam, 0, sizeof(q->txparam));
+		memset(&q->rxparam, 0, sizeof(q->rxparam));
+		memset(&q->stats, 0, sizeof(q->stats));
+	}
+	q->users++;
+	loop_unlock();
+
+	files[fd].qid = qid + 1;
+	files[fd].flags = flags;
+	files[fd].blockmode = EAVB_BLOCK_NOWAIT;
+
+	return fd;
+}
+
+static int loop_close(int fd)
+{
+	struct loop_file *f;
+	struct loop_queue *q;
+	struct loop_owner *o;
+
+	f = loop_file(fd);
+	if (!f)
+		return -1;
+
+	loop_lock();
+	q = loop_file_queue(f);
+	o = loop_owner(q, getpid());
+	if (o && !--o->users)
+		o->pid = 0;
+	if (q->users && !--q->users)
+		loop_queue_release(f->qid - 1);
+	loop_wake();
+	loop_unlock();
+
+	f->qid = 0;
+
+	return close(fd);
+}
+
+static int loop_ioctl(int fd, unsigned long request, void *arg)
+{
+	struct loop_file *f;
+	struct loop_queue *q;
+	struct eavb_option *opt;
+	int qid, ret = 0;
+
+	f = loop_file(fd);
+	if (!f)
+		return -1;
+
+	q = loop_file_queue(f);
+	qid = f->qid - 1;
+
+	loop_lock();
+	switch (request) {
+	case EAVB_SETTXPARAM:
+		memcpy(&q->txparam, arg, sizeof(q->txparam));
+		break;
+	case EAVB_GETTXPARAM:
+		memcpy(arg, &q->txparam, sizeof(q->txparam));
+		break;
+	case EAVB_SETRXPARAM:
+	case EAVB_GETRXPARAM:
+		if (loop_queue_is_tx(qid)) {
+			errno = EINVAL;
+			ret = -1;
+		} else if (request == EAVB_SETRXPARAM) {
+			memcpy(&q->rxparam, arg, sizeof(q->rxparam));
+		} else {
+			memcpy(arg, &q->rxparam, sizeof(q->rxparam));
+		}
+		break;
+	case EAVB_SETOPTION:
+	case EAVB_GETOPTION:
+		opt = arg;
+		if (opt->id != EAVB_OPTIONID_BLOCKMODE) {
+			errno = EINVAL;
+			ret = -1;
+		} else if (request == EAVB_SETOPTION) {
+			f->blockmode = opt->param;
+		} else {
+			opt->param = f->blockmode;
+		}
+		break;
+	case EAVB_MAPPAGE:
+		ret = loop_page_alloc(qid, arg);
+		break;
+	case EAVB_UNMAPPAGE:
+		ret = loop_page_free(qid, arg);
+		break;
+	default:
+		errno = ENOTTY;
+		ret = -1;
+		break;
+	}
+	loop_unlock();
+
+	return ret;
+}
+
+static ssize_t loop_write(int fd, const void *buf, size_t count)
+{
+	const struct eavb_entry *entry = buf;
+	struct loop_file *f;
+	struct loop_queue *q;
+	struct loop_slot *s;
+	uint64_t now;
+	uint32_t space;
+	int num, pushed = 0;
+
+	f = loop_file(fd);
+	if (!f)
+		return -1;
+
+	q = loop_file_queue(f);
+	num = count / sizeof(*entry);
+
+	loop_lock();
+	while (pushed < num) {
+		now = loop_now();
+		loop_transmit(now);
+
+		space = LOOP_QUEUE_ENTRIES - (q->head - q->tail);
+		if (!space) {
+			if (pushed && f->blockmode != EAVB_BLOCK_WAITALL)
+				break;
+			if (f->flags & O_NONBLOCK)
+				break;
+			loop_sleep(UINT64_MAX);
+			continue;
+		}
+
+		for (; space && pushed < num; space--, pushed++, q->head++) {
+			s = &q->slot[q->head % LOOP_QUEUE_ENTRIES];
+			s->entry = entry[pushed];
+			s->timestamp = now;
+		}
+
+		if (loop_queue_is_tx(f->qid - 1))
+			loop_transmit(now);
+		loop_wake();
+	}
+	loop_unlock();
+
+	if (!pushed && num) {
+		errno = EAGAIN;
+		return -1;
+	}
+
+	return pushed * sizeof(*entry);
+}
+
+static ssize_t loop_read(int fd, void *buf, size_t count)
+{
+	struct eavb_entry *entry = buf;
+	struct loop_file *f;
+	struct loop_queue *q;
+	struct loop_slot *s;
+	uint64_t now, latency;
+	int num, taken = 0;
+	bool rx;
+
+	f = loop_file(fd);
+	if (!f)
+		return -1;
+
+	q = loop_file_queue(f);
+	rx = !loop_queue_is_tx(f->qid - 1);
+	num = count / sizeof(*entry);
+
+	loop_lock();
+	while (taken < num) {
+		now = loop_now();
+		loop_transmit(now);
+
+		if (q->done == q->tail) {
+			if (taken && f->blockmode != EAVB_BLOCK_WAITALL)
+				break;
+			if (f->flags & O_NONBLOCK)
+				break;
+			loop_sleep(UINT64_MAX);
+			continue;
+		}
+
+		for (; q->done != q->tail && taken < num; taken++, q->tail++) {
+			s = &q->slot[q->tail % LOOP_QUEUE_ENTRIES];
+			entry[taken] = s->entry;
+			if (!rx)
+				continue;
+
+			latency = now - s->timestamp;
+			q->stats.latency_total += latency;
+			q->stats.latency_count++;
+			if (latency > q->stats.latency_max)
+				q->stats.latency_max = latency;
+		}
+		loop_wake();
+	}
+	loop_unlock();
+
+	if (!taken && num) {
+		errno = EAGAIN;
+		return -1;
+	}
+
+	return taken * sizeof(*entry);
+}
+
+static int loop_poll(struct pollfd *fds, nfds_t nfds, int timeout)
+{
+	struct loop_file *f;
+	uint64_t now, deadline;
+	nfds_t i;
+	int ready;
+
+	if (loop_attach() < 0)
+		return -1;
+
+	now = loop_now();
+	deadline = (timeout < 0) ? UINT64_MAX :
+			now + (uint64_t)timeout * 1000000;
+
+	loop_lock();
+	for (;;) {
+		loop_transmit(now);
+
+		for (i = 0, ready = 0; i < nfds; i++) {
+			f = loop_file(fds[i].fd);
+			if (!f) {
+				fds[i].revents = POLLNVAL;
+			} else {
+				fds[i].revents = loop_revents(
+					loop_file_queue(f), fds[i].events);
+			}
+			if (fds[i].revents)
+				ready++;
+		}
+
+		if (ready || now >= deadline)
+			break;
+
+		loop_sleep(deadline);
+		now = loop_now();
+	}
+	loop_unlock();
+
+	return ready;
+}
+
+static void *loop_mmap(size_t length, int prot, int flags, int fd,
+		       off_t offset)
+{
+	void *addr;
+
+	if (!loop_file(fd))
+		return MAP_FAILED;
+
+	addr = loop_paddr_to_vaddr(offset, length);
+	if (!addr) {
+		errno = EINVAL;
+		return MAP_FAILED;
+	}
+
+	return addr;
+}
+
+static int loop_munmap(void *addr, size_t length)
+{
+	/* pages stay mapped with the shared segment */
+	return 0;
+}
+
+const struct eavb_backend eavb_backend_loopback = {
+	.name   = "loopback",
+	.open   = loop_open,
+	.close  = loop_close,
+	.ioctl  = loop_ioctl,
+	.read   = loop_read,
+	.write  = loop_write,
+	.poll   = loop_poll,
+	.mmap   = loop_mmap,
+	.munmap = loop_munmap,
+};
+
+/*
+ * get statistics of loopback stream queue
+ *
+ * @devname  specify device name of stream queue
+ * @stats    statistics of the queue
+ */
+int eavb_loopback_get_stats(const char *devname,
+			    struct eavb_loopback_stats *stats)
+{
+	struct loop_queue *q;
+	int qid;
+
+	if (!devname || !stats)
+		return -1;
+
+	if (loop_attach() < 0)
+		return -1;
+
+	qid = loop_queue_index(devname);
+	if (qid < 0)
+		return -1;
+
+	q = &shm->queue[qid];
+
+	loop_lock();
+	loop_transmit(loop_now());
+	memcpy(stats, &q->stats, sizeof(*stats));
+	stats->users = q->users;
+	stats->pending = q->head - q->done;
+	loop_unlock();
+
+	return 0;
+}
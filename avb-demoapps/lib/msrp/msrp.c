@@ -244,7 +244,6 @@ static int msg_process(struct msrp_ctx *ctx, char *buf, int buflen)
 			break;
 		}
 	}
-	free(buf);
 	return rc;
 }
 
@@ -268,25 +267,22 @@ static void *msrp_monitor_thread(void *arg)
 
 	DEBUG_PRINTF("[MRP] monitor thread start\n");
 
+	msgbuf = ctx->recvbuf;
+
 	while (!ctx->halt_flag) {
-		msgbuf = (char *)calloc(1, MRPDCLIENT_MAX_MSG_SIZE);
-		if (msgbuf == NULL) {
-			fprintf(stderr, "[MRP] massage buf is NULL. recv\n");
-			pthread_exit(NULL);
-		}
-		rc = recv(ctx->mrpd_sock, msgbuf, MRPDCLIENT_MAX_MSG_SIZE, 0);
+		/* keep the message terminated for printing */
+		rc = recv(ctx->mrpd_sock, msgbuf, MRPDCLIENT_MAX_MSG_SIZE - 1, 0);
 
 		if (rc < 0) {
 			if (errno == EAGAIN) {
-				free(msgbuf);
 				continue;
 				/* the timeout expired before data was received. */
 			} else {
 				perror("[MRP] recv");
-				free(msgbuf);
 				break;
 			}
 		}
+		msgbuf[rc] = '\0';
 		msg_process(ctx, msgbuf, rc);
 	}
 
@@ -373,8 +369,18 @@ struct msrp_ctx *msrp_ctx_init(struct mrp_property *prop)
 		return NULL;
 	}
 
+	ctx->recvbuf = calloc(1, MRPDCLIENT_MAX_MSG_SIZE);
+	if (ctx->recvbuf == NULL) {
+		free(ctx->msgbuf);
+		free(ctx->prop);
+		free(ctx);
+		fprintf(stderr, "[MRP] could not allocate recvbuf in context.\n");
+		return NULL;
+	}
+
 	ctx->mrpd_sock = mrpdclient_init();
 	if (ctx->mrpd_sock == SOCKET_ERROR) {
+		free(ctx->recvbuf);
 		free(ctx->msgbuf);
 		free(ctx->prop);
 		free(ctx);
@@ -400,6 +406,7 @@ struct msrp_ctx *msrp_ctx_init(struct mrp_property *prop)
 
 	if (msrp_monitor(ctx)) {
 		mrpdclient_close(&ctx->mrpd_sock);
+		free(ctx->recvbuf);
 		free(ctx->msgbuf);
 		free(ctx->prop);
 		free(ctx);
@@ -432,6 +439,8 @@ int msrp_ctx_destroy(struct msrp_ctx *ctx)
 		free(ctx->prop);
 	if (ctx->msgbuf != NULL)
 		free(ctx->msgbuf);
+	if (ctx->recvbuf != NULL)
+		free(ctx->recvbuf);
 	free(ctx);
 
 	return rc;
@@ -97,6 +97,7 @@ struct msrp_ctx {
 	pthread_t monitor_thread;
 	struct mrp_property *prop;
 	char *msgbuf;
+	char *recvbuf; /* used by monitor thread only */
 	struct monitor_listener devices[MSRP_MAX_STREAMS];
 };
 